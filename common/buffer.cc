@@ -25,6 +25,13 @@
 
 #include <sys/uio.h>
 #include <limits.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define	BUFFER_FIND_AVX2
+#endif
 
 #include <iostream>
 
@@ -32,9 +39,81 @@
 
 #include <common/buffer.h>
 
-#if BUFFER_SEGMENT_CACHE_LIMIT > 0
-std::deque<BufferSegment *> BufferSegment::segment_cache;
+/*
+ * Largest set of characters find_any will compare against directly, rather
+ * than looking each byte up in a table.
+ */
+#define	BUFFER_FIND_SET_MAX	(8)
+
+namespace {
+	struct FindSet {
+		uint8_t table_[256];
+		uint8_t chars_[BUFFER_FIND_SET_MAX];
+		size_t count_;
+	};
+
+	typedef	const uint8_t *(*find_any_t)(const FindSet *, const uint8_t *, const uint8_t *);
+
+	static const uint8_t *find_any_scalar(const FindSet *, const uint8_t *, const uint8_t *);
+#if defined(__SSE2__)
+	static const uint8_t *find_any_sse2(const FindSet *, const uint8_t *, const uint8_t *);
+#endif
+#if defined(BUFFER_FIND_AVX2)
+	static const uint8_t *find_any_avx2(const FindSet *, const uint8_t *, const uint8_t *) __attribute__((__target__("avx2")));
 #endif
+	static const uint8_t *find_any_select(const FindSet *, const uint8_t *, const uint8_t *);
+
+	static find_any_t find_any_vector = find_any_select;
+}
+
+bool
+Buffer::find_any(const std::string& s, unsigned *offsetp, uint8_t *foundp) const
+{
+	segment_list_t::const_iterator it;
+	find_any_t func;
+	unsigned offset;
+	FindSet set;
+	size_t sit;
+
+	memset(set.table_, 0, sizeof set.table_);
+	set.count_ = 0;
+	for (sit = 0; sit < s.length(); sit++) {
+		uint8_t ch = s[sit];
+
+		if (set.table_[ch] != 0)
+			continue;
+		set.table_[ch] = 1;
+		if (set.count_ < BUFFER_FIND_SET_MAX)
+			set.chars_[set.count_] = ch;
+		set.count_++;
+	}
+
+	if (set.count_ == 0)
+		return (false);
+	if (set.count_ > BUFFER_FIND_SET_MAX)
+		func = find_any_scalar;
+	else
+		func = find_any_vector;
+
+	offset = 0;
+
+	for (it = data_.begin(); it != data_.end(); ++it) {
+		const BufferSegment *seg = *it;
+		const uint8_t *p;
+
+		p = func(&set, seg->data(), seg->end());
+		if (p == NULL) {
+			offset += seg->length();
+			continue;
+		}
+
+		if (foundp != NULL)
+			*foundp = *p;
+		*offsetp = offset + (p - seg->data());
+		return (true);
+	}
+	return (false);
+}
 
 size_t
 Buffer::fill_iovec(struct iovec *iov, size_t niov) const
@@ -157,3 +236,85 @@ operator<< (std::ostream& os, const Buffer& buf)
 {
 	return (os << &buf);
 }
+
+namespace {
+	static const uint8_t *
+	find_any_scalar(const FindSet *set, const uint8_t *p, const uint8_t *e)
+	{
+		while (p < e) {
+			if (set->table_[*p] != 0)
+				return (p);
+			p++;
+		}
+		return (NULL);
+	}
+
+#if defined(__SSE2__)
+	static const uint8_t *
+	find_any_sse2(const FindSet *set, const uint8_t *p, const uint8_t *e)
+	{
+		__m128i chars[BUFFER_FIND_SET_MAX];
+		size_t i;
+
+		for (i = 0; i < set->count_; i++)
+			chars[i] = _mm_set1_epi8((char)set->chars_[i]);
+
+		while (e - p >= 16) {
+			__m128i data = _mm_loadu_si128((const __m128i *)p);
+			__m128i match = _mm_cmpeq_epi8(data, chars[0]);
+			for (i = 1; i < set->count_; i++)
+				match = _mm_or_si128(match, _mm_cmpeq_epi8(data, chars[i]));
+			int mask = _mm_movemask_epi8(match);
+			if (mask != 0)
+				return (p + __builtin_ctz(mask));
+			p += 16;
+		}
+		return (find_any_scalar(set, p, e));
+	}
+#endif
+
+#if defined(BUFFER_FIND_AVX2)
+	static const uint8_t *
+	find_any_avx2(const FindSet *set, const uint8_t *p, const uint8_t *e)
+	{
+		__m256i chars[BUFFER_FIND_SET_MAX];
+		size_t i;
+
+		for (i = 0; i < set->count_; i++)
+			chars[i] = _mm256_set1_epi8((char)set->chars_[i]);
+
+		while (e - p >= 32) {
+			__m256i data = _mm256_loadu_si256((const __m256i *)p);
+			__m256i match = _mm256_cmpeq_epi8(data, chars[0]);
+			for (i = 1; i < set->count_; i++)
+				match = _mm256_or_si256(match, _mm256_cmpeq_epi8(data, chars[i]));
+			unsigned mask = _mm256_movemask_epi8(match);
+			if (mask != 0)
+				return (p + __builtin_ctz(mask));
+			p += 32;
+		}
+		return (find_any_scalar(set, p, e));
+	}
+#endif
+
+	/*
+	 * Pick the best implementation the CPU supports on first use.
+	 */
+	static const uint8_t *
+	find_any_select(const FindSet *set, const uint8_t *p, const uint8_t *e)
+	{
+		find_any_t func = find_any_scalar;
+
+#if defined(__SSE2__)
+		func = find_any_sse2;
+#endif
+#if defined(BUFFER_FIND_AVX2)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			func = find_any_avx2;
+#endif
+		find_any_vector = func;
+
+		return (func(set, p, e));
+	}
+}
@@ -29,8 +29,11 @@
 #include <string.h> /* memmove(3), memcpy(3), etc.  */
 
 #include <deque>
+#include <new>
 #include <vector>
 
+#include <common/buffer_allocator.h>
+#include <common/buffer_segment_list.h>
 #include <common/refcount.h>
 
 /*
@@ -51,68 +54,205 @@ struct iovec;
 
 /*
  * XXX
- * At one point I had code to add a further layer of indirection, BufferData
- * or something like that, which sat below a BufferSegment as it is today
- * and held the data buffer.  Then skip() and trim() and friends would
- * adjust offset and length members in the BufferSegment, but not need to
- * copy the data.  Then we don't even need to reference count BufferSegments,
- * just BufferData.  If we did this, then a lot of things would be cleaner
- * and there would be much less overhead in most cases, and the performance
- * loss could be minimal.
+ * There is now a layer of indirection, BufferData, which sits below a
+ * BufferSegment and holds the data buffer.  skip() and trim() and friends
+ * adjust offset and length members in the BufferSegment (or create a new
+ * BufferSegment viewing the same BufferData if the BufferSegment is shared)
+ * and never need to copy the data.  Both are still reference counted, since
+ * a great many things hold BufferSegment pointers directly; in principle we
+ * only need to reference count BufferData.
  *
  * It might even make sense to just move the offset/length of the view of
  * each BufferSegment into the Buffer, or up into some container class and
  * leave BufferSegment much as it is today.
  *
- * At the very least, it would be nice to allocate big slabs of data to point
- * BufferSegments at, so that perhaps we could opportunistically use smaller
+ * BufferSegments and BufferData come from BufferAllocator, which caches
+ * them per-thread and can carve them from big slabs.  BufferData comes in a
+ * few size classes, so that bulk data can be held in a handful of large
+ * BufferSegments.  It would be nice to also opportunistically use smaller
  * BufferSegments and not be so unfriendly as to constantly span page
  * boundaries, making swapping and all kinds of everything worse.
- *
- * Also at the very least, Buffers could contain their own offset field (and
- * likewise use their length field) to allow non-destructive skip and trim
- * within the first and last (respectively) BufferSegments.  Making this work
- * at the start of the Buffer is perhaps most useful as skip() is much more
- * likely than trim().
  */
 #define	BUFFER_SEGMENT_SIZE		(2048)
-#if 0 /* XXX MT should be thread-local.  */
-#define	BUFFER_SEGMENT_CACHE_LIMIT	((1024 * 1024) / BUFFER_SEGMENT_SIZE)
-#else
-#define	BUFFER_SEGMENT_CACHE_LIMIT	(0)
-#endif
+#define	BUFFER_SEGMENT_SIZE_LARGE	(16384)
+#define	BUFFER_SEGMENT_SIZE_MAX		(65536)
 
 typedef	unsigned buffer_segment_size_t;
 
 /*
- * A BufferSegment is a contiguous chunk of data which may be at most a fixed
- * size of BUFFER_SEGMENT_SIZE.  The data in a BufferSegment may begin at a
- * non-zero offset within the BufferSegment and may end prematurely.  This
- * allows for skip()/trim() semantics.
+ * A BufferData is a reference-counted block of storage of BUFFER_SEGMENT_SIZE,
+ * BUFFER_SEGMENT_SIZE_LARGE or BUFFER_SEGMENT_SIZE_MAX bytes, which follow it
+ * in memory.  It has no idea which of its bytes are meaningful; that is up to
+ * the BufferSegments which refer to it, of which there may be many, each with
+ * its own offset and length.
+ *
+ * A BufferData may only be written through a BufferSegment which holds the
+ * only reference to both itself and to the BufferData.
+ */
+class BufferData {
+	RefCount ref_;
+	buffer_segment_size_t size_;
+
+	BufferData(buffer_segment_size_t size)
+	: ref_(),
+	  size_(size)
+	{ }
+
+	/*
+	 * Should only be called from unref().
+	 */
+	~BufferData()
+	{ }
+
+	static BufferAllocator::Type type(size_t size)
+	{
+		switch (size) {
+		case BUFFER_SEGMENT_SIZE:
+			return (BufferAllocator::Data2K);
+		case BUFFER_SEGMENT_SIZE_LARGE:
+			return (BufferAllocator::Data16K);
+		case BUFFER_SEGMENT_SIZE_MAX:
+			return (BufferAllocator::Data64K);
+		default:
+			NOTREACHED("/buffer/data");
+		}
+	}
+
+public:
+	/*
+	 * Get a BufferData of the smallest size class which holds at least
+	 * size bytes, with a single reference.
+	 */
+	static BufferData *create(size_t size = BUFFER_SEGMENT_SIZE)
+	{
+		void *p;
+
+		ASSERT("/buffer/data", size <= BUFFER_SEGMENT_SIZE_MAX);
+		if (size <= BUFFER_SEGMENT_SIZE)
+			size = BUFFER_SEGMENT_SIZE;
+		else if (size <= BUFFER_SEGMENT_SIZE_LARGE)
+			size = BUFFER_SEGMENT_SIZE_LARGE;
+		else
+			size = BUFFER_SEGMENT_SIZE_MAX;
+
+		p = BufferAllocator::allocate(type(size), sizeof (BufferData) + size);
+		return (new (p) BufferData(size));
+	}
+
+	/*
+	 * Construct a BufferData of exactly size bytes in storage of the
+	 * caller's, which has room for size bytes after it.  The caller must
+	 * hold a reference for as long as the storage is valid, so that
+	 * unref() never frees it, and give it up with release().
+	 */
+	static BufferData *place(void *p, size_t size)
+	{
+		return (new (p) BufferData(size));
+	}
+
+	/*
+	 * Drop the last reference to a BufferData made by place().
+	 */
+	void release(void)
+	{
+		ASSERT("/buffer/data", exclusive());
+		ref_.drop();
+		this->~BufferData();
+	}
+
+	void ref(void)
+	{
+		ref_.hold();
+	}
+
+	void unref(void)
+	{
+		if (ref_.drop()) {
+			BufferAllocator::Type t = type(size_);
+
+			this->~BufferData();
+			BufferAllocator::deallocate(t, this);
+		}
+	}
+
+	bool exclusive(void) const
+	{
+		return (ref_.exclusive());
+	}
+
+	/*
+	 * See RefCount::share().
+	 */
+	void share(void)
+	{
+		ref_.share();
+	}
+
+	size_t size(void) const
+	{
+		return (size_);
+	}
+
+	uint8_t *data(void)
+	{
+		return ((uint8_t *)(this + 1));
+	}
+
+	const uint8_t *data(void) const
+	{
+		return ((const uint8_t *)(this + 1));
+	}
+};
+
+/*
+ * A BufferSegment is a view of a contiguous chunk of data which may be at
+ * most the size of its BufferData, usually BUFFER_SEGMENT_SIZE, but up to
+ * BUFFER_SEGMENT_SIZE_MAX for segments created to hold bulk data.  Code which
+ * needs exactly BUFFER_SEGMENT_SIZE bytes in a single segment should use
+ * Buffer::copyout(), which will create a view of a larger segment where it
+ * can.  The data in a BufferSegment may
+ * begin at a non-zero offset within the underlying BufferData and may end
+ * prematurely.  This allows for skip()/trim() semantics, which never copy
+ * data: if a BufferSegment is shared, a new BufferSegment viewing the same
+ * BufferData is created instead.
  *
  * BufferSegments are reference counted and mutable operations copy before
- * doing a write.  You must provide your own locking or use only a single
- * thread.  One normally does not use BufferSegments directly unless one is
- * importing or exporting data in a performance-critical path.  Normal usage
- * uses a Buffer.
+ * doing a write if either the BufferSegment or its BufferData is shared.  You
+ * must provide your own locking or use only a single thread.  One normally
+ * does not use BufferSegments directly unless one is importing or exporting
+ * data in a performance-critical path.  Normal usage uses a Buffer.
  */
 class BufferSegment {
-	uint8_t *data_;
+	friend class BufferWriter;
+
+	BufferData *data_;
 	buffer_segment_size_t offset_;
 	buffer_segment_size_t length_;
 	RefCount ref_;
 
 	/*
-	 * Creates a new, empty BufferSegment with a single reference.
+	 * Creates a new, empty BufferSegment with a single reference which
+	 * can hold at least size bytes.
 	 */
-	BufferSegment(void)
-	: data_(NULL),
+	BufferSegment(size_t size)
+	: data_(BufferData::create(size)),
 	  offset_(0),
 	  length_(0),
 	  ref_()
+	{ }
+
+	/*
+	 * Creates a new BufferSegment with a single reference which is a
+	 * view of existing data.
+	 */
+	BufferSegment(BufferData *data, buffer_segment_size_t offset,
+		      buffer_segment_size_t length)
+	: data_(data),
+	  offset_(offset),
+	  length_(length),
+	  ref_()
 	{
-		/* XXX Built-in slab allocator?  */
-		data_ = (uint8_t *)malloc(BUFFER_SEGMENT_SIZE);
+		data_->ref();
 	}
 
 	/*
@@ -121,7 +261,7 @@ class BufferSegment {
 	~BufferSegment()
 	{
 		if (data_ != NULL) {
-			free(data_);
+			data_->unref();
 			data_ = NULL;
 		}
 	}
@@ -132,20 +272,15 @@ public:
 	 */
 	static BufferSegment *create(void)
 	{
-#if BUFFER_SEGMENT_CACHE_LIMIT > 0
-		if (!segment_cache.empty()) {
-			BufferSegment *seg = segment_cache.front();
-			ASSERT("/buffer/segment", !seg->ref_.inuse());
-			segment_cache.pop_front();
-			seg->ref_.hold();
-
-			seg->offset_ = 0;
-			seg->length_ = 0;
+		return (new BufferSegment(BUFFER_SEGMENT_SIZE));
+	}
 
-			return (seg);
-		}
-#endif
-		return (new BufferSegment());
+	/*
+	 * Get an empty BufferSegment which can hold at least size bytes.
+	 */
+	static BufferSegment *create(size_t size)
+	{
+		return (new BufferSegment(size));
 	}
 
 	/*
@@ -155,15 +290,56 @@ public:
 	{
 		ASSERT("/buffer/segment", buf != NULL);
 		ASSERT("/buffer/segment", len != 0);
-		ASSERT("/buffer/segment", len <= BUFFER_SEGMENT_SIZE);
+		ASSERT("/buffer/segment", len <= BUFFER_SEGMENT_SIZE_MAX);
 
-		BufferSegment *seg = create();
-		memcpy(seg->data_, buf, len);
+		BufferSegment *seg = create(len);
+		memcpy(seg->data_->data(), buf, len);
 		seg->length_ = len;
 
 		return (seg);
 	}
 
+	/*
+	 * Get a BufferSegment of data of the given length, with its BufferData,
+	 * in storage of the caller's, which is laid out as for place_size().
+	 * As with BufferData::place(), the caller must keep a reference and
+	 * give it up with release().
+	 */
+	static BufferSegment *place(void *p, const uint8_t *buf, size_t len, size_t capacity)
+	{
+		ASSERT("/buffer/segment", len != 0);
+		ASSERT("/buffer/segment", len <= capacity);
+
+		BufferData *data = BufferData::place((BufferSegment *)p + 1, capacity);
+		memcpy(data->data(), buf, len);
+
+		BufferSegment *seg = ::new (p) BufferSegment(data, 0, len);
+		data->unref();
+		return (seg);
+	}
+
+	/*
+	 * How much storage place() needs for a given capacity.
+	 */
+	static size_t place_size(size_t capacity)
+	{
+		return (sizeof (BufferSegment) + sizeof (BufferData) + capacity);
+	}
+
+	/*
+	 * Drop the last reference to a BufferSegment made by place(), which
+	 * must be exclusive().
+	 */
+	void release(void)
+	{
+		ASSERT("/buffer/segment", exclusive());
+
+		BufferData *data = data_;
+		data_ = NULL;
+		ref_.drop();
+		this->~BufferSegment();
+		data->release();
+	}
 
 	/*
 	 * Bump the reference count.
@@ -179,24 +355,27 @@ public:
 	 */
 	void unref(void)
 	{
-		if (ref_.drop()) {
-#if BUFFER_SEGMENT_CACHE_LIMIT > 0
-			if (segment_cache.size() == BUFFER_SEGMENT_CACHE_LIMIT)
-#endif
-				delete this;
-#if BUFFER_SEGMENT_CACHE_LIMIT > 0
-			else
-				segment_cache.push_back(this);
-#endif
-		}
+		if (ref_.drop())
+			delete this;
 	}
 
 	/*
-	 * Returns true if the BufferSegment is held exclusively.
+	 * Returns true if the BufferSegment and the data it views are held
+	 * exclusively, i.e. if it may be written to.
 	 */
 	bool exclusive(void) const
 	{
-		return (ref_.exclusive());
+		return (ref_.exclusive() && data_->exclusive());
+	}
+
+	/*
+	 * Make this BufferSegment and its BufferData safe to hand to another
+	 * thread.  See RefCount::share().
+	 */
+	void share(void)
+	{
+		ref_.share();
+		data_->share();
 	}
 
 	/*
@@ -204,8 +383,8 @@ public:
 	 */
 	uint8_t *head(void)
 	{
-		ASSERT("/buffer/segment", ref_.exclusive());
-		return (&data_[offset_]);
+		ASSERT("/buffer/segment", exclusive());
+		return (&data_->data()[offset_]);
 	}
 
 	/*
@@ -214,8 +393,8 @@ public:
 	 */
 	uint8_t *tail(void)
 	{
-		ASSERT("/buffer/segment", ref_.exclusive());
-		return (&data_[offset_ + length_]);
+		ASSERT("/buffer/segment", exclusive());
+		return (&data_->data()[offset_ + length_]);
 	}
 
 	/*
@@ -226,7 +405,7 @@ public:
 		ASSERT("/buffer/segment", buf != NULL);
 		ASSERT("/buffer/segment", len != 0);
 		ASSERT("/buffer/segment", len <= avail());
-		if (!ref_.exclusive()) {
+		if (!exclusive()) {
 			BufferSegment *seg;
 
 			seg = this->copy();
@@ -264,7 +443,15 @@ public:
 	 */
 	size_t avail(void) const
 	{
-		return (BUFFER_SEGMENT_SIZE - length());
+		return (capacity() - length());
+	}
+
+	/*
+	 * Return the size of the underlying BufferData.
+	 */
+	size_t capacity(void) const
+	{
+		return (data_->size());
 	}
 
 	/*
@@ -277,6 +464,17 @@ public:
 		return (seg);
 	}
 
+	/*
+	 * Create a new BufferSegment which views len bytes of this one's data
+	 * starting at offset.  No data is copied.
+	 */
+	BufferSegment *view(unsigned offset, size_t len) const
+	{
+		ASSERT("/buffer/segment", len != 0);
+		ASSERT("/buffer/segment", offset + len <= length());
+		return (new BufferSegment(data_, offset_ + offset, len));
+	}
+
 	/*
 	 * Copy out the requested number of bytes or the entire available
 	 * length, whichever is smaller.  Returns the amount of data read.
@@ -296,7 +494,7 @@ public:
 	const uint8_t *data(void) const
 	{
 		ASSERT("/buffer/segment", length_ != 0);
-		return (&data_[offset_]);
+		return (&data_->data()[offset_]);
 	}
 
 	/*
@@ -307,7 +505,7 @@ public:
 	const uint8_t *end(void) const
 	{
 		ASSERT("/buffer/segment", length_ != 0);
-		return (&data_[offset_ + length_]);
+		return (&data_->data()[offset_ + length_]);
 	}
 
 	/*
@@ -327,10 +525,10 @@ public:
 	void pullup(void)
 	{
 		ASSERT("/buffer/segment", length_ != 0);
-		ASSERT("/buffer/segment", ref_.exclusive());
+		ASSERT("/buffer/segment", exclusive());
 		if (offset_ == 0)
 			return;
-		memmove(data_, data(), length());
+		memmove(data_->data(), data(), length());
 		offset_ = 0;
 	}
 
@@ -340,15 +538,15 @@ public:
 	 */
 	void set_length(size_t len)
 	{
-		ASSERT("/buffer/segment", ref_.exclusive());
+		ASSERT("/buffer/segment", exclusive());
 		ASSERT("/buffer/segment", offset_ == 0);
-		ASSERT("/buffer/segment", len <= BUFFER_SEGMENT_SIZE);
+		ASSERT("/buffer/segment", len <= capacity());
 		length_ = len;
 	}
 
 	/*
 	 * Skip a number of bytes at the start of a BufferSemgent.  Creates a
-	 * copy if there are other live references.
+	 * new view of the same data if there are other live references.
 	 */
 	BufferSegment *skip(unsigned bytes)
 	{
@@ -358,7 +556,7 @@ public:
 		if (!ref_.exclusive()) {
 			BufferSegment *seg;
 
-			seg = BufferSegment::create(this->data() + bytes, this->length() - bytes);
+			seg = this->view(bytes, this->length() - bytes);
 			this->unref();
 			return (seg);
 		}
@@ -370,8 +568,8 @@ public:
 
 	/*
 	 * Adjusts the length to ignore bytes at the end of a BufferSegment.
-	 * Like skip() but at the end rather than the start.  Creates a copy if
-	 * there are live references.
+	 * Like skip() but at the end rather than the start.  Creates a new
+	 * view of the same data if there are live references.
 	 */
 	BufferSegment *trim(unsigned bytes)
 	{
@@ -381,7 +579,7 @@ public:
 		if (!ref_.exclusive()) {
 			BufferSegment *seg;
 
-			seg = BufferSegment::create(this->data(), this->length() - bytes);
+			seg = this->view(0, this->length() - bytes);
 			this->unref();
 			return (seg);
 		}
@@ -392,7 +590,9 @@ public:
 
 	/*
 	 * Remove bytes at offset in the BufferSegment.  Creates a copy if
-	 * there are live references.
+	 * there are live references to it or its data, since a single view
+	 * cannot describe the result.  Buffer::cut() avoids this by using two
+	 * views instead.
 	 */
 	BufferSegment *cut(unsigned offset, unsigned bytes)
 	{
@@ -405,10 +605,11 @@ public:
 		if (offset + bytes == length())
 			return (this->trim(bytes));
 
-		if (!ref_.exclusive()) {
+		if (!exclusive()) {
 			BufferSegment *seg;
 
-			seg = BufferSegment::create(this->data(), offset);
+			seg = BufferSegment::create(this->length() - bytes);
+			seg->append(this->data(), offset);
 			seg->append(this->data() + offset + bytes,
 				    this->length() - (offset + bytes));
 			this->unref();
@@ -425,8 +626,8 @@ public:
 	/*
 	 * Adjusts the length to ignore bytes at the end of a BufferSegment.
 	 * Like trim() but takes the desired resulting length rather than the
-	 * number of bytes to trim.  Creates a copy if there are live
-	 * references.
+	 * number of bytes to trim.  Creates a new view of the same data if
+	 * there are live references.
 	 */
 	BufferSegment *truncate(size_t len)
 	{
@@ -464,10 +665,15 @@ public:
 		return (equal(seg->data(), seg->length()));
 	}
 
-#if BUFFER_SEGMENT_CACHE_LIMIT > 0
-private:
-	static std::deque<BufferSegment *> segment_cache;
-#endif
+	static void *operator new(size_t size)
+	{
+		return (BufferAllocator::allocate(BufferAllocator::Segment, size));
+	}
+
+	static void operator delete(void *p)
+	{
+		BufferAllocator::deallocate(BufferAllocator::Segment, p);
+	}
 };
 
 /*
@@ -488,8 +694,10 @@ private:
  * performance than scanning the entire list in every possible scenario.
  */
 class Buffer {
+	friend class BufferReader;
+	friend class BufferWriter;
 public:
-	typedef	std::deque<BufferSegment *> segment_list_t;
+	typedef	BufferSegmentList segment_list_t;
 
 	/*
 	 * A SegmentIterator allows for enumeration of the BufferSegments that
@@ -567,6 +775,17 @@ public:
 			append(source);
 	}
 
+	/*
+	 * Create a Buffer which takes over the data of another Buffer, which
+	 * is left empty.  No references are taken or dropped.
+	 */
+	Buffer(Buffer&& source)
+	: length_(0),
+	  data_()
+	{
+		source.moveout(this);
+	}
+
 	/*
 	 * Create a Buffer and append at most len bytes of data to it from
 	 * another Buffer.
@@ -608,6 +827,19 @@ public:
 		return (*this);
 	}
 
+	/*
+	 * Replace this Buffer's data with that of another Buffer, which is
+	 * left empty.
+	 */
+	Buffer& operator= (Buffer&& source)
+	{
+		if (&source == this)
+			return (*this);
+		clear();
+		source.moveout(this);
+		return (*this);
+	}
+
 	/*
 	 * Overwrite this Buffer's data with that of a C++ std::string.
 	 */
@@ -678,6 +910,22 @@ public:
 		length_ += seg->length();
 	}
 
+	/*
+	 * Append len bytes starting at offset within a single BufferSegment to
+	 * this Buffer without copying any data.
+	 */
+	void append(BufferSegment *seg, unsigned offset, size_t len)
+	{
+		ASSERT("/buffer", len != 0);
+		ASSERT("/buffer", offset + len <= seg->length());
+		if (offset == 0 && len == seg->length()) {
+			append(seg);
+			return;
+		}
+		data_.push_back(seg->view(offset, len));
+		length_ += len;
+	}
+
 	/*
 	 * Append a single byte to this Buffer.
 	 */
@@ -701,7 +949,7 @@ public:
 	void append(const uint8_t *buf, size_t len)
 	{
 		BufferSegment *seg;
-		unsigned o;
+		size_t o, n;
 
 		ASSERT("/buffer", len != 0);
 
@@ -721,16 +969,23 @@ public:
 		}
 
 		/*
-		 * Complete segments.
+		 * Complete segments, as large as will be filled, so that bulk
+		 * data does not end up spread over lots of small segments.
 		 */
-		for (o = 0; o < len / BUFFER_SEGMENT_SIZE; o++) {
-			seg = BufferSegment::create(buf + (o * BUFFER_SEGMENT_SIZE), BUFFER_SEGMENT_SIZE);
+		for (o = 0; len - o >= BUFFER_SEGMENT_SIZE; o += n) {
+			if (len - o >= BUFFER_SEGMENT_SIZE_MAX)
+				n = BUFFER_SEGMENT_SIZE_MAX;
+			else if (len - o >= BUFFER_SEGMENT_SIZE_LARGE)
+				n = BUFFER_SEGMENT_SIZE_LARGE;
+			else
+				n = BUFFER_SEGMENT_SIZE;
+			seg = BufferSegment::create(buf + o, n);
 			append(seg);
 			seg->unref();
 		}
-		if (len % BUFFER_SEGMENT_SIZE == 0)
+		if (o == len)
 			return;
-		seg = BufferSegment::create(buf + (o * BUFFER_SEGMENT_SIZE), len % BUFFER_SEGMENT_SIZE);
+		seg = BufferSegment::create(buf + o, len - o);
 		append(seg);
 		seg->unref();
 	}
@@ -773,6 +1028,18 @@ public:
 		append(data, sizeof data);
 	}
 
+	/*
+	 * Make everything in this Buffer safe to hand to another thread.  See
+	 * RefCount::share().
+	 */
+	void share(void)
+	{
+		segment_list_t::iterator it;
+
+		for (it = data_.begin(); it != data_.end(); ++it)
+			(*it)->share();
+	}
+
 	/*
 	 * Drop references to all BufferSegments in this Buffer and remove them
 	 * from its list.
@@ -851,7 +1118,7 @@ public:
 	void copyout(BufferSegment **segp, size_t len) const
 	{
 		ASSERT("/buffer", len != 0);
-		ASSERT("/buffer", len <= BUFFER_SEGMENT_SIZE);
+		ASSERT("/buffer", len <= BUFFER_SEGMENT_SIZE_MAX);
 		ASSERT("/buffer", length() >= len);
 		BufferSegment *src = data_.front();
 		if (src->length() == len) {
@@ -864,8 +1131,8 @@ public:
 			*segp = src->truncate(len);
 			return;
 		}
-		BufferSegment *seg = src->copy();
-		copyout(seg->tail(), seg->length(), len - seg->length());
+		BufferSegment *seg = BufferSegment::create(len);
+		copyout(seg->tail(), 0, len);
 		seg->set_length(len);
 		*segp = seg;
 	}
@@ -1068,38 +1335,11 @@ public:
 	 * Finds the first occurance of any character in s in this Buffer's
 	 * data and sets offsetp to the offset it was found at.  It indicates
 	 * via the foundp parameter which of the set was found.
+	 *
+	 * Sets of up to a few characters are searched for many bytes at a
+	 * time where the CPU allows.
 	 */
-	bool find_any(const std::string& s, unsigned *offsetp, uint8_t *foundp = NULL) const
-	{
-		uint8_t set[256];
-		segment_list_t::const_iterator it;
-		unsigned offset;
-		size_t sit;
-
-		memset(set, 0, sizeof set);
-		for (sit = 0; sit < s.length(); sit++)
-			set[(unsigned char)s[sit]] = 1;
-
-		offset = 0;
-
-		for (it = data_.begin(); it != data_.end(); ++it) {
-			const BufferSegment *seg = *it;
-			const uint8_t *p = seg->data();
-			size_t len = seg->length();
-			unsigned i;
-
-			for (i = 0; i < len; i++) {
-				if (set[p[i]] == 0)
-					continue;
-				if (foundp != NULL)
-					*foundp = p[i];
-				*offsetp = offset + i + (p - seg->data());
-				return (true);
-			}
-			offset += len;
-		}
-		return (false);
-	}
+	bool find_any(const std::string&, unsigned *, uint8_t * = NULL) const;
 
 	/*
 	 * Returns the current amount of data associated with this Buffer.
@@ -1164,8 +1404,7 @@ public:
 	void moveout(Buffer *dst)
 	{
 		if (dst->empty()) {
-			dst->data_ = data_;
-			data_.clear();
+			dst->data_.swap(data_);
 
 			dst->length_ = length_;
 			length_ = 0;
@@ -1392,7 +1631,7 @@ public:
 			 * Skip a partial segment.
 			 */
 			if (clip != NULL)
-				clip->append(seg->data(), bytes - skipped);
+				clip->append(seg, 0, bytes - skipped);
 			seg = seg->skip(bytes - skipped);
 			*it = seg;
 			skipped += bytes - skipped;
@@ -1411,6 +1650,7 @@ public:
 	{
 		segment_list_t::iterator it;
 		unsigned trimmed;
+		size_t clippos;
 
 		ASSERT("/buffer", bytes != 0);
 		ASSERT("/buffer", !empty());
@@ -1424,31 +1664,42 @@ public:
 			return;
 		}
 
+		/*
+		 * We walk backwards, so each clipped segment goes in front of
+		 * the ones clipped before it, but after anything already in the
+		 * clip.
+		 */
+		clippos = clip == NULL ? 0 : clip->data_.size();
+
 		trimmed = 0;
 
-		while ((it = --data_.end()) != data_.end()) {
+		while (trimmed != bytes) {
+			it = data_.end() - 1;
 			BufferSegment *seg = *it;
 
-			if (trimmed == bytes)
-				break;
-
 			/*
 			 * Trim entire segments.
 			 */
 			if ((bytes - trimmed) >= seg->length()) {
 				trimmed += seg->length();
 				data_.erase(it);
-				if (clip != NULL)
-					clip->append(seg);
-				seg->unref();
+				if (clip != NULL) {
+					clip->data_.insert(clip->data_.begin() + clippos, seg);
+					clip->length_ += seg->length();
+				} else {
+					seg->unref();
+				}
 				continue;
 			}
 
 			/*
 			 * Trim a partial segment.
 			 */
-			if (clip != NULL)
-				clip->append(seg->data() + (seg->length() - (bytes - trimmed)), bytes - trimmed);
+			if (clip != NULL) {
+				clip->data_.insert(clip->data_.begin() + clippos,
+						   seg->view(seg->length() - (bytes - trimmed), bytes - trimmed));
+				clip->length_ += bytes - trimmed;
+			}
 			seg = seg->trim(bytes - trimmed);
 			*it = seg;
 			trimmed += bytes - trimmed;
@@ -1516,14 +1767,19 @@ public:
 					continue;
 				}
 				if (clip != NULL)
-					clip->append(seg->data() + offset, seg->length() - offset);
+					clip->append(seg, offset, seg->length() - offset);
 				/* We need only the first offset bytes of this segment.  */
 				bytes -= seg->length() - offset;
 				seg = seg->truncate(offset);
 				ASSERT("/buffer", seg->length() == offset);
 				offset = 0;
 
-				data_.insert(it, seg);
+				/*
+				 * Inserting invalidates iterators, so point at
+				 * the element after the one just inserted.
+				 */
+				it = data_.insert(it, seg);
+				++it;
 
 				if (bytes == 0)
 					break;
@@ -1533,28 +1789,34 @@ public:
 			/*
 			 * This is the final segment.
 			 *
-			 * We could split this into two segments instead of
-			 * using BufferSegment::cut().  That would mean doing
-			 * (effectively):
+			 * If the segment or its data is shared, we split it
+			 * into two views of the same data:
 			 *     seg->ref();
 			 *     seg0 = seg->truncate(offset);
 			 *     seg1 = seg->skip(offset + bytes);
-			 * If the original seg has only one ref, we can do the
-			 * skip in-place on it without modifying data, but we
-			 * have to copy it for the truncate.  So we have to
-			 * do a copy and now we (inefficiently) have two
-			 * segments.
+			 * Neither of those needs to copy any data, and an
+			 * extra segment in this Buffer is much cheaper than
+			 * the copy BufferSegment::cut() would have to make.
 			 *
-			 * If we instead use BufferSegment::cut(), we have to
-			 * move data around a little if there's only one ref
-			 * and do a copy if there's more than one ref.  So we
-			 * have probably less overhead and demonstrably
-			 * fewer segments in this Buffer.
+			 * If we have the only reference to both, we use
+			 * BufferSegment::cut(), which just moves data around
+			 * a little and gives us demonstrably fewer segments
+			 * in this Buffer.
 			 */
 			if (clip != NULL)
-				clip->append(seg->data() + offset, bytes);
-			seg = seg->cut(offset, bytes);
-			data_.insert(it, seg);
+				clip->append(seg, offset, bytes);
+			if (offset != 0 && !seg->exclusive()) {
+				BufferSegment *seg0, *seg1;
+
+				seg->ref();
+				seg0 = seg->truncate(offset);
+				seg1 = seg->skip(offset + bytes);
+				it = data_.insert(it, seg1);
+				data_.insert(it, seg0);
+			} else {
+				seg = seg->cut(offset, bytes);
+				data_.insert(it, seg);
+			}
 
 			offset = 0;
 
@@ -1705,6 +1967,417 @@ public:
 	std::string hexdump(unsigned = 0) const;
 };
 
+/*
+ * A BufferWriter reserves contiguous space at the end of a Buffer, in its last
+ * BufferSegment if that is exclusive and has room or in a new one if not, and
+ * allows a number of small writes to be made to it directly, without any of
+ * the checks and copy-on-write logic of Buffer::append().  The data written
+ * is added to the Buffer by commit(), which the destructor calls.
+ *
+ * Until then, the Buffer must not be otherwise modified.
+ *
+ * The append() methods mirror those of Buffer, so that BigEndian::append()
+ * and friends work with a BufferWriter.  Unlike with Buffer, writing beyond
+ * the reserved space is an error.
+ */
+class BufferWriter {
+	Buffer *buf_;
+	BufferSegment *seg_;
+	bool owned_;
+	uint8_t *start_;
+	uint8_t *p_;
+	uint8_t *end_;
+public:
+	BufferWriter(Buffer *buf, size_t len)
+	: buf_(buf),
+	  seg_(NULL),
+	  owned_(false),
+	  start_(NULL),
+	  p_(NULL),
+	  end_(NULL)
+	{
+		reserve(len);
+	}
+
+	~BufferWriter()
+	{
+		commit();
+	}
+
+	/*
+	 * Commit anything written so far and reserve len more bytes.
+	 */
+	void reserve(size_t len)
+	{
+		BufferSegment *seg;
+
+		ASSERT("/buffer/writer", len != 0);
+		ASSERT("/buffer/writer", len <= BUFFER_SEGMENT_SIZE_MAX);
+
+		commit();
+
+		if (!buf_->data_.empty()) {
+			seg = buf_->data_.back();
+			if (seg->exclusive() && seg->avail() >= len) {
+				if (seg->capacity() - (seg->offset_ + seg->length_) < len)
+					seg->pullup();
+				seg_ = seg;
+				owned_ = false;
+				start_ = seg->tail();
+				p_ = start_;
+				end_ = seg->data_->data() + seg->capacity();
+				return;
+			}
+		}
+
+		seg = BufferSegment::create(len);
+		seg_ = seg;
+		owned_ = true;
+		start_ = seg->tail();
+		p_ = start_;
+		end_ = seg->data_->data() + seg->capacity();
+	}
+
+	/*
+	 * Add everything written to the Buffer.
+	 */
+	void commit(void)
+	{
+		size_t len;
+
+		if (seg_ == NULL)
+			return;
+
+		len = p_ - start_;
+		if (owned_) {
+			if (len != 0) {
+				seg_->length_ = len;
+				buf_->append(seg_);
+			}
+			seg_->unref();
+		} else {
+			seg_->length_ += len;
+			buf_->length_ += len;
+		}
+
+		seg_ = NULL;
+		owned_ = false;
+		start_ = NULL;
+		p_ = NULL;
+		end_ = NULL;
+	}
+
+	/*
+	 * Return the amount of reserved space which has not been written.
+	 */
+	size_t avail(void) const
+	{
+		return (end_ - p_);
+	}
+
+	/*
+	 * Return a pointer to which up to avail() bytes may be written
+	 * directly, to be followed by a call to advance().
+	 */
+	uint8_t *tail(void)
+	{
+		return (p_);
+	}
+
+	/*
+	 * Account for len bytes written through tail().
+	 */
+	void advance(size_t len)
+	{
+		ASSERT("/buffer/writer", len <= avail());
+		p_ += len;
+	}
+
+	void append(uint8_t ch)
+	{
+		ASSERT("/buffer/writer", avail() >= 1);
+		*p_++ = ch;
+	}
+
+	void append(const uint8_t *buf, size_t len)
+	{
+		ASSERT("/buffer/writer", len <= avail());
+		memcpy(p_, buf, len);
+		p_ += len;
+	}
+
+	void append(const uint16_t *p)
+	{
+		append((const uint8_t *)p, sizeof *p);
+	}
+
+	void append(const uint32_t *p)
+	{
+		append((const uint8_t *)p, sizeof *p);
+	}
+
+	void append(const uint64_t *p)
+	{
+		append((const uint8_t *)p, sizeof *p);
+	}
+
+private:
+	BufferWriter(const BufferWriter&);
+	BufferWriter& operator= (const BufferWriter&);
+};
+
+/*
+ * A BufferReader is a cursor into a Buffer which keeps track of the segment
+ * and offset it has reached, so that a parser can peek at, extract and move
+ * out data a piece at a time without walking the Buffer's segments from the
+ * start for each access, as the Buffer methods which take an offset must.
+ * Nothing is removed from the Buffer; once parsing is done, the caller skips
+ * position() bytes in it.
+ *
+ * The Buffer must not be modified while a BufferReader is in use.
+ *
+ * The extract() and moveout() methods mirror those of Buffer, so that
+ * BigEndian::extract() and friends work with a BufferReader.
+ */
+class BufferReader {
+	const Buffer *buf_;
+	Buffer::segment_list_t::const_iterator it_;
+	unsigned offset_;
+	size_t position_;
+public:
+	BufferReader(const Buffer *buf)
+	: buf_(buf),
+	  it_(buf->data_.begin()),
+	  offset_(0),
+	  position_(0)
+	{ }
+
+	~BufferReader()
+	{ }
+
+	/*
+	 * Returns the number of bytes left to be read.
+	 */
+	size_t length(void) const
+	{
+		return (buf_->length() - position_);
+	}
+
+	bool empty(void) const
+	{
+		return (length() == 0);
+	}
+
+	/*
+	 * Returns the number of bytes read so far.
+	 */
+	size_t position(void) const
+	{
+		return (position_);
+	}
+
+	/*
+	 * Returns a pointer to the contiguous data at the cursor, and its
+	 * length, which is at most that remaining in the current segment.
+	 */
+	const uint8_t *span(size_t *lenp) const
+	{
+		ASSERT("/buffer/reader", !empty());
+		const BufferSegment *seg = *it_;
+		*lenp = seg->length() - offset_;
+		return (seg->data() + offset_);
+	}
+
+	/*
+	 * Returns the byte at the cursor.
+	 */
+	uint8_t peek(void) const
+	{
+		ASSERT("/buffer/reader", !empty());
+		return ((*it_)->data()[offset_]);
+	}
+
+	/*
+	 * Copy dstsize bytes starting at offset bytes past the cursor to a
+	 * byte buffer, without moving the cursor.
+	 */
+	void copyout(uint8_t *dst, unsigned offset, size_t dstsize) const
+	{
+		Buffer::segment_list_t::const_iterator it;
+
+		ASSERT("/buffer/reader", offset + dstsize <= length());
+
+		offset += offset_;
+		for (it = it_; dstsize != 0; ++it) {
+			const BufferSegment *seg = *it;
+
+			if (offset >= seg->length()) {
+				offset -= seg->length();
+				continue;
+			}
+
+			size_t seglen = seg->length() - offset;
+			if (seglen > dstsize)
+				seglen = dstsize;
+			seg->copyout(dst, offset, seglen);
+			dst += seglen;
+			dstsize -= seglen;
+			offset = 0;
+		}
+	}
+
+	void extract(uint8_t *p, unsigned offset = 0) const
+	{
+		copyout(p, offset, sizeof *p);
+	}
+
+	void extract(uint16_t *p, unsigned offset = 0) const
+	{
+		copyout((uint8_t *)p, offset, sizeof *p);
+	}
+
+	void extract(uint32_t *p, unsigned offset = 0) const
+	{
+		copyout((uint8_t *)p, offset, sizeof *p);
+	}
+
+	void extract(uint64_t *p, unsigned offset = 0) const
+	{
+		copyout((uint8_t *)p, offset, sizeof *p);
+	}
+
+	/*
+	 * Find the first occurrence of ch at or after the cursor, returning
+	 * its offset from the cursor.
+	 */
+	bool find(uint8_t ch, size_t *offsetp) const
+	{
+		Buffer::segment_list_t::const_iterator it;
+		unsigned offset;
+		size_t skipped;
+
+		offset = offset_;
+		skipped = 0;
+		for (it = it_; it != buf_->data_.end(); ++it) {
+			const BufferSegment *seg = *it;
+			const uint8_t *p;
+
+			p = (const uint8_t *)memchr(seg->data() + offset, ch,
+						   seg->length() - offset);
+			if (p != NULL) {
+				*offsetp = skipped + (p - (seg->data() + offset));
+				return (true);
+			}
+			skipped += seg->length() - offset;
+			offset = 0;
+		}
+		return (false);
+	}
+
+	/*
+	 * Move the cursor forward by len bytes.
+	 */
+	void skip(size_t len)
+	{
+		ASSERT("/buffer/reader", len <= length());
+
+		position_ += len;
+		while (len != 0) {
+			size_t seglen = (*it_)->length() - offset_;
+			if (len < seglen) {
+				offset_ += len;
+				return;
+			}
+			len -= seglen;
+			offset_ = 0;
+			++it_;
+		}
+	}
+
+	/*
+	 * Copy len bytes at the cursor to a byte buffer and move past them.
+	 */
+	void moveout(uint8_t *dst, size_t len)
+	{
+		copyout(dst, 0, len);
+		skip(len);
+	}
+
+	void moveout(uint8_t *p)
+	{
+		moveout(p, sizeof *p);
+	}
+
+	void moveout(uint16_t *p)
+	{
+		moveout((uint8_t *)p, sizeof *p);
+	}
+
+	void moveout(uint32_t *p)
+	{
+		moveout((uint8_t *)p, sizeof *p);
+	}
+
+	void moveout(uint64_t *p)
+	{
+		moveout((uint8_t *)p, sizeof *p);
+	}
+
+	/*
+	 * Append len bytes at the cursor to another Buffer, by reference, and
+	 * move past them.
+	 */
+	void moveout(Buffer *dst, size_t len)
+	{
+		ASSERT("/buffer/reader", len <= length());
+
+		position_ += len;
+		while (len != 0) {
+			BufferSegment *seg = *it_;
+			size_t seglen = seg->length() - offset_;
+			if (len < seglen) {
+				dst->append(seg, offset_, len);
+				offset_ += len;
+				return;
+			}
+			dst->append(seg, offset_, seglen);
+			len -= seglen;
+			offset_ = 0;
+			++it_;
+		}
+	}
+
+	/*
+	 * Take a reference to a BufferSegment holding the len bytes at the
+	 * cursor, creating one if they are not all in the current segment, and
+	 * move past them.
+	 */
+	void moveout(BufferSegment **segp, size_t len)
+	{
+		ASSERT("/buffer/reader", len != 0);
+		ASSERT("/buffer/reader", len <= BUFFER_SEGMENT_SIZE_MAX);
+		ASSERT("/buffer/reader", len <= length());
+
+		BufferSegment *src = *it_;
+		if (offset_ == 0 && src->length() == len) {
+			src->ref();
+			*segp = src;
+		} else if (src->length() - offset_ >= len) {
+			*segp = src->view(offset_, len);
+		} else {
+			BufferSegment *seg = BufferSegment::create(len);
+			copyout(seg->tail(), 0, len);
+			seg->set_length(len);
+			*segp = seg;
+		}
+		skip(len);
+	}
+
+private:
+	BufferReader(const BufferReader&);
+	BufferReader& operator= (const BufferReader&);
+};
+
 std::ostream& operator<< (std::ostream&, const Buffer *);
 std::ostream& operator<< (std::ostream&, const Buffer&);
 
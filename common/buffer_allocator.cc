@@ -0,0 +1,333 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include <stdlib.h>
+
+#include <new>
+
+#include <common/buffer_allocator.h>
+
+namespace {
+	/*
+	 * Free objects are linked through their first bytes.  The first
+	 * object of a magazine in the depot also records the next magazine
+	 * and how many objects it holds.
+	 */
+	struct FreeObject {
+		FreeObject *next_;
+		FreeObject *next_magazine_;
+		size_t count_;
+	};
+
+	struct ThreadCache {
+		FreeObject *head_[BufferAllocator::Data64K + 1];
+		size_t count_[BufferAllocator::Data64K + 1];
+		uintmax_t allocations_[BufferAllocator::Data64K + 1];
+	};
+
+	struct Depot {
+		pthread_mutex_t mutex_;
+		size_t size_;
+		FreeObject *magazines_;
+		size_t count_;
+		uint8_t *slab_;
+		size_t slab_avail_;
+	};
+
+	static Depot depots[BufferAllocator::Data64K + 1] = {
+		{ PTHREAD_MUTEX_INITIALIZER, 0, NULL, 0, NULL, 0 },
+		{ PTHREAD_MUTEX_INITIALIZER, 0, NULL, 0, NULL, 0 },
+		{ PTHREAD_MUTEX_INITIALIZER, 0, NULL, 0, NULL, 0 },
+		{ PTHREAD_MUTEX_INITIALIZER, 0, NULL, 0, NULL, 0 },
+	};
+
+	static size_t thread_limit = BUFFER_ALLOCATOR_THREAD_LIMIT;
+	static size_t depot_limit = BUFFER_ALLOCATOR_DEPOT_LIMIT;
+	static bool use_hugepages;
+	static bool in_use;
+
+	static __thread ThreadCache *thread_cache;
+	static pthread_once_t thread_cache_once = PTHREAD_ONCE_INIT;
+	static pthread_key_t thread_cache_key;
+
+	static size_t scale(size_t, size_t);
+
+	static ThreadCache *thread_cache_get(void);
+	static void thread_cache_init(void);
+	static void thread_cache_exit(void *);
+
+	static FreeObject *magazine_detach(ThreadCache *, BufferAllocator::Type, size_t);
+	static void magazine_put(BufferAllocator::Type, FreeObject *);
+	static FreeObject *slab_carve(Depot *);
+}
+
+void *
+BufferAllocator::allocate(Type type, size_t size)
+{
+	ThreadCache *tc = thread_cache_get();
+	Depot *depot = &depots[type];
+	FreeObject *obj;
+
+	tc->allocations_[type]++;
+
+	obj = tc->head_[type];
+	if (obj == NULL) {
+		pthread_mutex_lock(&depot->mutex_);
+		if (depot->size_ == 0) {
+			ASSERT("/buffer/allocator", size >= sizeof (FreeObject));
+			depot->size_ = size;
+		}
+		ASSERT("/buffer/allocator", depot->size_ == size);
+		obj = depot->magazines_;
+		if (obj != NULL) {
+			depot->magazines_ = obj->next_magazine_;
+			depot->count_ -= obj->count_;
+			tc->count_[type] = obj->count_;
+		} else if (use_hugepages) {
+			obj = slab_carve(depot);
+			tc->count_[type] = scale(BUFFER_ALLOCATOR_MAGAZINE_SIZE, size);
+		}
+		pthread_mutex_unlock(&depot->mutex_);
+
+		if (obj == NULL) {
+			void *p = malloc(size);
+			if (p == NULL)
+				throw std::bad_alloc();
+			return (p);
+		}
+	}
+
+	tc->head_[type] = obj->next_;
+	tc->count_[type]--;
+
+	return (obj);
+}
+
+uintmax_t
+BufferAllocator::allocations(Type type)
+{
+	ThreadCache *tc = thread_cache;
+
+	if (tc == NULL)
+		return (0);
+	return (tc->allocations_[type]);
+}
+
+void
+BufferAllocator::deallocate(Type type, void *p)
+{
+	ThreadCache *tc = thread_cache_get();
+	FreeObject *obj = (FreeObject *)p;
+
+	obj->next_ = tc->head_[type];
+	tc->head_[type] = obj;
+	tc->count_[type]++;
+
+	if (tc->count_[type] <= scale(thread_limit, depots[type].size_))
+		return;
+
+	obj = magazine_detach(tc, type, scale(BUFFER_ALLOCATOR_MAGAZINE_SIZE, depots[type].size_));
+	magazine_put(type, obj);
+}
+
+void
+BufferAllocator::set_limits(size_t thread, size_t depot)
+{
+	thread_limit = thread;
+	depot_limit = depot;
+}
+
+bool
+BufferAllocator::set_hugepages(bool enable)
+{
+	if (in_use)
+		return (enable == use_hugepages);
+	use_hugepages = enable;
+	return (true);
+}
+
+namespace {
+	static size_t
+	scale(size_t count, size_t size)
+	{
+		if (size <= BUFFER_ALLOCATOR_UNIT || count == 0)
+			return (count);
+		count = (count * BUFFER_ALLOCATOR_UNIT) / size;
+		if (count == 0)
+			return (1);
+		return (count);
+	}
+
+	static ThreadCache *
+	thread_cache_get(void)
+	{
+		ThreadCache *tc = thread_cache;
+
+		if (tc != NULL)
+			return (tc);
+
+		pthread_once(&thread_cache_once, thread_cache_init);
+
+		tc = (ThreadCache *)calloc(1, sizeof *tc);
+		if (tc == NULL)
+			throw std::bad_alloc();
+		pthread_setspecific(thread_cache_key, tc);
+		thread_cache = tc;
+		in_use = true;
+
+		return (tc);
+	}
+
+	static void
+	thread_cache_init(void)
+	{
+		int rv = pthread_key_create(&thread_cache_key, thread_cache_exit);
+		if (rv != 0)
+			HALT("/buffer/allocator") << "Could not create thread cache key.";
+	}
+
+	/*
+	 * Hand everything a thread has cached back to the depot when it exits.
+	 */
+	static void
+	thread_cache_exit(void *arg)
+	{
+		ThreadCache *tc = (ThreadCache *)arg;
+		unsigned type;
+
+		for (type = BufferAllocator::Segment; type <= BufferAllocator::Data64K; type++) {
+			BufferAllocator::Type t = (BufferAllocator::Type)type;
+
+			while (tc->count_[t] != 0)
+				magazine_put(t, magazine_detach(tc, t, scale(BUFFER_ALLOCATOR_MAGAZINE_SIZE, depots[t].size_)));
+		}
+
+		thread_cache = NULL;
+		free(tc);
+	}
+
+	/*
+	 * Unlink up to count objects from the head of a thread's free list.
+	 */
+	static FreeObject *
+	magazine_detach(ThreadCache *tc, BufferAllocator::Type type, size_t count)
+	{
+		FreeObject *mag, *obj;
+		size_t n;
+
+		ASSERT("/buffer/allocator", tc->count_[type] != 0);
+		if (count > tc->count_[type])
+			count = tc->count_[type];
+
+		mag = tc->head_[type];
+		for (obj = mag, n = 1; n < count; n++)
+			obj = obj->next_;
+		tc->head_[type] = obj->next_;
+		tc->count_[type] -= count;
+
+		obj->next_ = NULL;
+		mag->next_magazine_ = NULL;
+		mag->count_ = count;
+
+		return (mag);
+	}
+
+	/*
+	 * Put a magazine in the depot or, if it is full, free its objects.
+	 */
+	static void
+	magazine_put(BufferAllocator::Type type, FreeObject *mag)
+	{
+		Depot *depot = &depots[type];
+		FreeObject *obj;
+
+		pthread_mutex_lock(&depot->mutex_);
+		if (use_hugepages ||
+		    depot->count_ + mag->count_ <= scale(depot_limit, depot->size_)) {
+			mag->next_magazine_ = depot->magazines_;
+			depot->magazines_ = mag;
+			depot->count_ += mag->count_;
+			pthread_mutex_unlock(&depot->mutex_);
+			return;
+		}
+		pthread_mutex_unlock(&depot->mutex_);
+
+		while (mag != NULL) {
+			obj = mag;
+			mag = mag->next_;
+			free(obj);
+		}
+	}
+
+	/*
+	 * Carve a magazine's worth of objects from the current slab, getting
+	 * a new slab as needed.  Called with the depot lock held.
+	 */
+	static FreeObject *
+	slab_carve(Depot *depot)
+	{
+		size_t size = (depot->size_ + 15) & ~(size_t)15;
+		FreeObject *mag, *obj;
+		size_t n;
+
+		mag = NULL;
+		for (n = 0; n < scale(BUFFER_ALLOCATOR_MAGAZINE_SIZE, depot->size_); n++) {
+			if (depot->slab_avail_ < size) {
+				int flags = MAP_PRIVATE | MAP_ANON;
+				void *p;
+
+				p = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+				p = mmap(NULL, BUFFER_ALLOCATOR_SLAB_SIZE, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+#endif
+				if (p == MAP_FAILED) {
+#if defined(MAP_ALIGNED_SUPER)
+					flags |= MAP_ALIGNED_SUPER;
+#endif
+					p = mmap(NULL, BUFFER_ALLOCATOR_SLAB_SIZE, PROT_READ | PROT_WRITE, flags, -1, 0);
+					if (p == MAP_FAILED)
+						throw std::bad_alloc();
+#if defined(MADV_HUGEPAGE)
+					madvise(p, BUFFER_ALLOCATOR_SLAB_SIZE, MADV_HUGEPAGE);
+#endif
+				}
+				depot->slab_ = (uint8_t *)p;
+				depot->slab_avail_ = BUFFER_ALLOCATOR_SLAB_SIZE;
+			}
+
+			obj = (FreeObject *)depot->slab_;
+			depot->slab_ += size;
+			depot->slab_avail_ -= size;
+
+			obj->next_ = mag;
+			mag = obj;
+		}
+
+		return (mag);
+	}
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef	COMMON_BUFFER_ALLOCATOR_H
+#define	COMMON_BUFFER_ALLOCATOR_H
+
+/*
+ * A caching allocator for the fixed-size objects that make up a Buffer, i.e.
+ * BufferSegments and BufferData.
+ *
+ * Each thread keeps a free list of each kind of object, up to a limit.  Past
+ * that limit, freed objects are handed in batches (magazines) to a global
+ * depot, and a thread whose free list runs dry takes a whole magazine back.
+ * A thread which mostly frees data allocated by another, which is the norm
+ * for data passed along a pipe, thus only takes the depot lock once per
+ * magazine.  Only what the depot has no room for is freed to the system.
+ *
+ * Limits and magazines are counted in objects of up to BUFFER_ALLOCATOR_UNIT
+ * bytes.  For larger objects they are scaled down to cover the same amount
+ * of memory.
+ *
+ * If hugepages are enabled, objects are instead carved out of large slabs,
+ * backed by superpages where the system allows, which are never returned
+ * to the system.  This must be done before the first Buffer is created.
+ */
+#define	BUFFER_ALLOCATOR_UNIT		(2048)
+#define	BUFFER_ALLOCATOR_MAGAZINE_SIZE	(64)
+#define	BUFFER_ALLOCATOR_THREAD_LIMIT	(512)
+#define	BUFFER_ALLOCATOR_DEPOT_LIMIT	(8192)
+#define	BUFFER_ALLOCATOR_SLAB_SIZE	(2 * 1024 * 1024)
+
+class BufferAllocator {
+public:
+	enum Type {
+		Segment,
+		Data2K,
+		Data16K,
+		Data64K,
+	};
+
+	static void *allocate(Type, size_t);
+	static void deallocate(Type, void *);
+
+	/*
+	 * How many objects of a type the calling thread has allocated, whether
+	 * from its cache, the depot or the system.
+	 */
+	static uintmax_t allocations(Type);
+
+	/*
+	 * Limits are in objects of each type, and should be a multiple of
+	 * BUFFER_ALLOCATOR_MAGAZINE_SIZE.  A thread limit of 0 disables the
+	 * per-thread cache, a depot limit of 0 the depot.
+	 */
+	static void set_limits(size_t, size_t);
+
+	/*
+	 * Returns false if it is too late to change whether to use hugepages.
+	 */
+	static bool set_hugepages(bool);
+};
+
+#endif /* !COMMON_BUFFER_ALLOCATOR_H */
@@ -0,0 +1,337 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef	COMMON_BUFFER_SEGMENT_LIST_H
+#define	COMMON_BUFFER_SEGMENT_LIST_H
+
+#include <string.h>
+
+#include <iterator>
+
+class BufferSegment;
+
+/*
+ * The list of BufferSegments in a Buffer.  Most Buffers hold only a few
+ * BufferSegments, so the first BUFFER_SEGMENT_LIST_INLINE of them are stored
+ * in the list itself and heap storage is only allocated past that.
+ *
+ * The occupied part of the storage can begin past its start, so that
+ * removing and inserting at the front, as Buffer::skip() and friends do all
+ * the time, need not move the rest of the list.
+ *
+ * Like std::deque, which this replaces, any insertion or removal may
+ * invalidate iterators.
+ */
+#define	BUFFER_SEGMENT_LIST_INLINE	(4)
+
+class BufferSegmentList {
+public:
+	typedef	BufferSegment *value_type;
+	typedef	BufferSegment **iterator;
+	typedef	BufferSegment *const *const_iterator;
+	typedef	std::reverse_iterator<iterator> reverse_iterator;
+	typedef	std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+private:
+	BufferSegment **heap_;
+	size_t capacity_;
+	size_t head_;
+	size_t tail_;
+	BufferSegment *inline_[BUFFER_SEGMENT_LIST_INLINE];
+
+public:
+	BufferSegmentList(void)
+	: heap_(NULL),
+	  capacity_(BUFFER_SEGMENT_LIST_INLINE),
+	  head_(0),
+	  tail_(0),
+	  inline_()
+	{ }
+
+	BufferSegmentList(const BufferSegmentList& src)
+	: heap_(NULL),
+	  capacity_(BUFFER_SEGMENT_LIST_INLINE),
+	  head_(0),
+	  tail_(0),
+	  inline_()
+	{
+		insert(end(), src.begin(), src.end());
+	}
+
+	~BufferSegmentList()
+	{
+		if (heap_ != NULL) {
+			delete[] heap_;
+			heap_ = NULL;
+		}
+	}
+
+	BufferSegmentList& operator= (const BufferSegmentList& src)
+	{
+		if (&src == this)
+			return (*this);
+		clear();
+		insert(end(), src.begin(), src.end());
+		return (*this);
+	}
+
+	iterator begin(void)
+	{
+		return (base() + head_);
+	}
+
+	const_iterator begin(void) const
+	{
+		return (base() + head_);
+	}
+
+	iterator end(void)
+	{
+		return (base() + tail_);
+	}
+
+	const_iterator end(void) const
+	{
+		return (base() + tail_);
+	}
+
+	reverse_iterator rbegin(void)
+	{
+		return (reverse_iterator(end()));
+	}
+
+	const_reverse_iterator rbegin(void) const
+	{
+		return (const_reverse_iterator(end()));
+	}
+
+	reverse_iterator rend(void)
+	{
+		return (reverse_iterator(begin()));
+	}
+
+	const_reverse_iterator rend(void) const
+	{
+		return (const_reverse_iterator(begin()));
+	}
+
+	bool empty(void) const
+	{
+		return (head_ == tail_);
+	}
+
+	size_t size(void) const
+	{
+		return (tail_ - head_);
+	}
+
+	BufferSegment *front(void) const
+	{
+		ASSERT("/buffer/segment/list", !empty());
+		return (base()[head_]);
+	}
+
+	BufferSegment *back(void) const
+	{
+		ASSERT("/buffer/segment/list", !empty());
+		return (base()[tail_ - 1]);
+	}
+
+	void clear(void)
+	{
+		head_ = 0;
+		tail_ = 0;
+	}
+
+	void push_back(BufferSegment *seg)
+	{
+		if (tail_ == capacity_)
+			reserve(1);
+		base()[tail_++] = seg;
+	}
+
+	void pop_front(void)
+	{
+		ASSERT("/buffer/segment/list", !empty());
+		if (++head_ == tail_)
+			clear();
+	}
+
+	/*
+	 * Insert seg before it, returning an iterator to it.
+	 */
+	iterator insert(iterator it, BufferSegment *seg)
+	{
+		size_t pos = it - base();
+
+		ASSERT("/buffer/segment/list", pos >= head_ && pos <= tail_);
+
+		if (pos == head_ && head_ != 0) {
+			base()[--head_] = seg;
+			return (begin());
+		}
+
+		if (tail_ == capacity_) {
+			pos -= head_;
+			reserve(1);
+			pos += head_;
+		}
+		it = base() + pos;
+		memmove(it + 1, it, (tail_ - pos) * sizeof *it);
+		*it = seg;
+		tail_++;
+		return (it);
+	}
+
+	/*
+	 * Insert the segments [first, last) before it.  They must not come
+	 * from this list.
+	 */
+	void insert(iterator it, const_iterator first, const_iterator last)
+	{
+		size_t pos = it - base();
+		size_t n = last - first;
+
+		ASSERT("/buffer/segment/list", pos >= head_ && pos <= tail_);
+
+		if (n == 0)
+			return;
+		if (tail_ + n > capacity_) {
+			pos -= head_;
+			reserve(n);
+			pos += head_;
+		}
+		it = base() + pos;
+		memmove(it + n, it, (tail_ - pos) * sizeof *it);
+		memcpy(it, first, n * sizeof *it);
+		tail_ += n;
+	}
+
+	/*
+	 * Remove the segment at it, returning an iterator to the one after
+	 * it.
+	 */
+	iterator erase(iterator it)
+	{
+		size_t pos = it - base();
+
+		ASSERT("/buffer/segment/list", pos >= head_ && pos < tail_);
+
+		if (pos == head_) {
+			pop_front();
+			return (begin());
+		}
+
+		memmove(it, it + 1, (tail_ - (pos + 1)) * sizeof *it);
+		tail_--;
+		return (it);
+	}
+
+	void swap(BufferSegmentList& other)
+	{
+		BufferSegmentList tmp;
+
+		tmp.take(*this);
+		take(other);
+		other.take(tmp);
+	}
+
+private:
+	BufferSegment **base(void)
+	{
+		if (heap_ != NULL)
+			return (heap_);
+		return (inline_);
+	}
+
+	BufferSegment *const *base(void) const
+	{
+		if (heap_ != NULL)
+			return (heap_);
+		return (inline_);
+	}
+
+	/*
+	 * Make room for n more segments at the end, by moving the occupied
+	 * part of the storage to its start or by growing it.
+	 */
+	void reserve(size_t n)
+	{
+		BufferSegment **storage;
+		size_t count = size();
+
+		if (count + n <= capacity_) {
+			memmove(base(), begin(), count * sizeof *storage);
+			head_ = 0;
+			tail_ = count;
+			return;
+		}
+
+		size_t capacity = capacity_ * 2;
+		while (capacity < count + n)
+			capacity *= 2;
+
+		storage = new BufferSegment *[capacity];
+		memcpy(storage, begin(), count * sizeof *storage);
+		if (heap_ != NULL)
+			delete[] heap_;
+		heap_ = storage;
+		capacity_ = capacity;
+		head_ = 0;
+		tail_ = count;
+	}
+
+	/*
+	 * Take the contents of other, which is left empty, in place of our
+	 * own, which must be empty.
+	 */
+	void take(BufferSegmentList& other)
+	{
+		ASSERT("/buffer/segment/list", empty());
+
+		if (heap_ != NULL) {
+			delete[] heap_;
+			heap_ = NULL;
+			capacity_ = BUFFER_SEGMENT_LIST_INLINE;
+		}
+
+		if (other.heap_ != NULL) {
+			heap_ = other.heap_;
+			capacity_ = other.capacity_;
+			head_ = other.head_;
+			tail_ = other.tail_;
+
+			other.heap_ = NULL;
+			other.capacity_ = BUFFER_SEGMENT_LIST_INLINE;
+		} else {
+			memcpy(inline_, other.begin(), other.size() * sizeof *inline_);
+			head_ = 0;
+			tail_ = other.size();
+		}
+		other.clear();
+	}
+};
+
+#endif /* !COMMON_BUFFER_SEGMENT_LIST_H */
@@ -1,6 +1,9 @@
 VPATH+=	${TOPDIR}/common
 
 SRCS+=	buffer.cc
+SRCS+=	buffer_allocator.cc
 SRCS+=	log.cc
 
 CXXFLAGS+=-include common/common.h
+
+LDADD+=	-lpthread
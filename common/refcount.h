@@ -26,34 +26,68 @@
 #ifndef	COMMON_REFCOUNT_H
 #define	COMMON_REFCOUNT_H
 
-/* XXX If !THREADS, do not use atomics.  */
 #include <common/thread/atomic.h>
 
+/*
+ * A RefCount is normally manipulated with atomic operations, since what it
+ * counts references to may be shared between threads.  A thread which knows
+ * that most of what it creates stays with it, like the EventThread, may call
+ * RefCount::confine(), after which RefCounts it creates are confined to it and
+ * use plain arithmetic instead.  Before anything holding such a RefCount is
+ * handed to another thread, its owner must share() it, which switches it to
+ * atomic operations for good.  Use of a confined RefCount from any other
+ * thread is caught and is fatal.
+ *
+ * Programs built without THREADS have only the one thread, to which every
+ * RefCount is confined.
+ */
 class RefCount {
+	const void *owner_;
+	unsigned local_;
 	Atomic<unsigned> refs_;
 public:
 	RefCount(void)
-	: refs_(1)
+	: owner_(confinement()),
+	  local_(owner_ == NULL ? 0 : 1),
+	  refs_(owner_ == NULL ? 1 : 0)
 	{ }
 
 	~RefCount()
 	{
-		ASSERT("/refcount", refs_.load() == 0);
+		ASSERT("/refcount", local_ == 0 && refs_.load(std::memory_order_relaxed) == 0);
 	}
 
 	bool exclusive(void) const
 	{
-		return (refs_.load() == 1);
+		if (owner_ != NULL) {
+			owned();
+			return (local_ == 1);
+		}
+		return (refs_.load(std::memory_order_acquire) == 1);
 	}
 
 	bool inuse(void) const
 	{
-		return (refs_.load() != 0);
+		if (owner_ != NULL) {
+			owned();
+			return (local_ != 0);
+		}
+		return (refs_.load(std::memory_order_acquire) != 0);
+	}
+
+	bool shared(void) const
+	{
+		return (owner_ == NULL);
 	}
 
 	void hold(void)
 	{
-		refs_.add(1);
+		if (owner_ != NULL) {
+			owned();
+			local_++;
+			return;
+		}
+		refs_.add(1, std::memory_order_relaxed);
 	}
 
 	/*
@@ -61,13 +95,74 @@ public:
 	 */
 	bool drop(void)
 	{
-		for (;;) {
-			unsigned r = refs_.load();
-			if (!refs_.cmpset(r, r - 1))
-				continue;
-			return (r == 1);
+		if (owner_ != NULL) {
+			owned();
+			return (--local_ == 0);
 		}
+		/*
+		 * Release our writes to whoever drops the last reference, which
+		 * must acquire everyone's before what is counted is torn down.
+		 */
+		if (refs_.subtract(1, std::memory_order_release) != 1)
+			return (false);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return (true);
+	}
+
+	/*
+	 * Switch a confined RefCount to atomic operations so that what it
+	 * counts may be handed to another thread.  Only the owning thread may
+	 * do this.
+	 */
+	void share(void)
+	{
+		if (owner_ == NULL)
+			return;
+		owned();
+		refs_.store(local_, std::memory_order_relaxed);
+		local_ = 0;
+		owner_ = NULL;
+	}
+
+	/*
+	 * Confine RefCounts subsequently created by the calling thread to it.
+	 */
+	static void confine(void)
+	{
+#if defined(THREADS)
+		static __thread char token;
+
+		thread_owner() = &token;
+#endif
+	}
+
+private:
+	void owned(void) const
+	{
+		if (owner_ != confinement())
+			HALT("/refcount") << "Use of RefCount confined to another thread.";
+	}
+
+#if defined(THREADS)
+	static const void *&thread_owner(void)
+	{
+		static __thread const void *owner;
+
+		return (owner);
+	}
+
+	static const void *confinement(void)
+	{
+		return (thread_owner());
+	}
+#else
+	static const void *confinement(void)
+	{
+		static const char token = 0;
+
+		return (&token);
 	}
+#endif
 };
 
 #endif /* !COMMON_REFCOUNT_H */
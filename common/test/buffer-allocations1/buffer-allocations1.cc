@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <new>
+
+#include <common/buffer.h>
+#include <common/test.h>
+
+/*
+ * Count calls to the global operator new, so we can check that the common
+ * operations on small Buffers do not need to allocate anything beyond their
+ * BufferSegments, which come from BufferAllocator instead.
+ */
+static unsigned allocations;
+
+void *
+operator new(size_t size)
+{
+	void *p;
+
+	allocations++;
+	p = malloc(size);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return (p);
+}
+
+void *
+operator new[](size_t size)
+{
+	return (operator new(size));
+}
+
+void
+operator delete(void *p) throw ()
+{
+	free(p);
+}
+
+void
+operator delete(void *p, size_t) throw ()
+{
+	free(p);
+}
+
+void
+operator delete[](void *p) throw ()
+{
+	free(p);
+}
+
+void
+operator delete[](void *p, size_t) throw ()
+{
+	free(p);
+}
+
+int
+main(void)
+{
+	static uint8_t data[BUFFER_SEGMENT_SIZE * 2];
+	unsigned before;
+
+	TestGroup g("/test/buffer/allocations1", "Buffer allocations #1");
+
+	/* Prime the per-thread BufferAllocator cache.  */
+	{
+		Buffer buf(data, sizeof data);
+	}
+
+	{
+		Test _(g, "Empty Buffer");
+		before = allocations;
+		{
+			Buffer buf;
+		}
+		if (allocations == before)
+			_.pass();
+	}
+	{
+		Test _(g, "One-byte Buffer");
+		before = allocations;
+		{
+			Buffer buf;
+			buf.append((uint8_t)'A');
+		}
+		if (allocations == before)
+			_.pass();
+	}
+	{
+		Test _(g, "Small appends");
+		before = allocations;
+		{
+			Buffer buf;
+			unsigned i;
+
+			for (i = 0; i < 100; i++)
+				buf.append("hello");
+		}
+		if (allocations == before)
+			_.pass();
+	}
+	{
+		Test _(g, "Copy, skip, trim and cut");
+		before = allocations;
+		{
+			Buffer buf(data, sizeof data);
+			Buffer tmp(buf);
+			Buffer clip;
+
+			tmp.skip(1);
+			tmp.trim(1);
+			tmp.cut(10, 10, &clip);
+		}
+		if (allocations == before)
+			_.pass();
+	}
+	{
+		Test _(g, "Moveout");
+		before = allocations;
+		{
+			Buffer buf(data, sizeof data);
+			Buffer tmp;
+
+			buf.moveout(&tmp);
+			buf.append(tmp);
+		}
+		if (allocations == before)
+			_.pass();
+	}
+	{
+		Test _(g, "Spill to heap");
+		before = allocations;
+		{
+			Buffer buf;
+			unsigned i;
+
+			for (i = 0; i < BUFFER_SEGMENT_LIST_INLINE * 2; i++)
+				buf.append(data, BUFFER_SEGMENT_SIZE);
+		}
+		if (allocations == before + 1)
+			_.pass();
+	}
+}
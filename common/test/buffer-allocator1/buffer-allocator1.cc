@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <pthread.h>
+
+#include <common/buffer.h>
+#include <common/test.h>
+
+#define	BUFFER_ALLOCATOR1_COUNT	(16384)
+
+static Buffer *buffers[BUFFER_ALLOCATOR1_COUNT];
+
+static void fill(Buffer *, unsigned);
+static bool check(const Buffer *, unsigned);
+static void *producer(void *);
+static void *consumer(void *);
+
+int
+main(void)
+{
+	{
+		TestGroup g("/test/buffer/allocator1", "BufferAllocator #1");
+
+		{
+			Test _(g, "Freed segment is reused");
+			BufferSegment *seg = BufferSegment::create();
+			BufferSegment *seg2;
+
+			seg->unref();
+			seg2 = BufferSegment::create();
+			if (seg2 == seg)
+				_.pass();
+			seg2->unref();
+		}
+		{
+			Test _(g, "Reused segment is empty");
+			BufferSegment *seg = BufferSegment::create();
+			seg->append("ABCD");
+			seg->unref();
+			seg = BufferSegment::create();
+			if (seg->length() == 0 && seg->avail() == BUFFER_SEGMENT_SIZE)
+				_.pass();
+			seg->unref();
+		}
+		{
+			Test _(g, "Hugepages cannot be toggled once in use");
+			if (!BufferAllocator::set_hugepages(true))
+				_.pass();
+		}
+	}
+
+	{
+		TestGroup g("/test/buffer/allocator2", "BufferAllocator #2");
+		pthread_t td;
+		unsigned i;
+		bool ok;
+
+		{
+			Test _(g, "Allocate in another thread");
+			if (pthread_create(&td, NULL, producer, NULL) == 0 &&
+			    pthread_join(td, NULL) == 0)
+				_.pass();
+		}
+		{
+			Test _(g, "Check and free in this thread");
+			ok = true;
+			for (i = 0; i < BUFFER_ALLOCATOR1_COUNT; i++) {
+				if (!check(buffers[i], i))
+					ok = false;
+				delete buffers[i];
+				buffers[i] = NULL;
+			}
+			if (ok)
+				_.pass();
+		}
+		{
+			Test _(g, "Reallocate in this thread");
+			for (i = 0; i < BUFFER_ALLOCATOR1_COUNT; i++) {
+				buffers[i] = new Buffer();
+				fill(buffers[i], i);
+			}
+			ok = true;
+			for (i = 0; i < BUFFER_ALLOCATOR1_COUNT; i++) {
+				if (!check(buffers[i], i))
+					ok = false;
+			}
+			if (ok)
+				_.pass();
+		}
+		{
+			Test _(g, "Free in another thread");
+			if (pthread_create(&td, NULL, consumer, NULL) == 0 &&
+			    pthread_join(td, NULL) == 0)
+				_.pass();
+		}
+		{
+			Test _(g, "Reallocate after thread exit");
+			for (i = 0; i < BUFFER_ALLOCATOR1_COUNT; i++) {
+				buffers[i] = new Buffer();
+				fill(buffers[i], i);
+			}
+			ok = true;
+			for (i = 0; i < BUFFER_ALLOCATOR1_COUNT; i++) {
+				if (!check(buffers[i], i))
+					ok = false;
+				delete buffers[i];
+				buffers[i] = NULL;
+			}
+			if (ok)
+				_.pass();
+		}
+	}
+}
+
+static void
+fill(Buffer *buf, unsigned n)
+{
+	uint8_t data[BUFFER_SEGMENT_SIZE + 1];
+
+	memset(data, n & 0xff, sizeof data);
+	buf->append(data, sizeof data);
+}
+
+static bool
+check(const Buffer *buf, unsigned n)
+{
+	uint8_t data[BUFFER_SEGMENT_SIZE + 1];
+
+	memset(data, n & 0xff, sizeof data);
+	return (buf->equal(data, sizeof data));
+}
+
+static void *
+producer(void *)
+{
+	unsigned i;
+
+	for (i = 0; i < BUFFER_ALLOCATOR1_COUNT; i++) {
+		buffers[i] = new Buffer();
+		fill(buffers[i], i);
+	}
+	return (NULL);
+}
+
+static void *
+consumer(void *)
+{
+	unsigned i;
+
+	for (i = 0; i < BUFFER_ALLOCATOR1_COUNT; i++) {
+		delete buffers[i];
+		buffers[i] = NULL;
+	}
+	return (NULL);
+}
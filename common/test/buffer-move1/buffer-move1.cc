@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <utility>
+
+#include <common/buffer.h>
+#include <common/test.h>
+
+int
+main(void)
+{
+	TestGroup g("/test/buffer/move1", "Buffer move #1");
+
+	{
+		Test _(g, "Move construction");
+		Buffer a("Hello, world!");
+		const BufferSegment *seg = *a.segments();
+		Buffer b(std::move(a));
+		if (a.empty() && b.equal("Hello, world!") &&
+		    *b.segments() == seg)
+			_.pass();
+	}
+	{
+		Test _(g, "Move assignment");
+		Buffer a("Hello, world!");
+		Buffer b("Goodbye.");
+		const BufferSegment *seg = *a.segments();
+		b = std::move(a);
+		if (a.empty() && b.equal("Hello, world!") &&
+		    *b.segments() == seg)
+			_.pass();
+	}
+	{
+		Test _(g, "Moved segment stays exclusive");
+		Buffer a("Hello, world!");
+		Buffer b(std::move(a));
+		const BufferSegment *seg = *b.segments();
+		if (seg->exclusive())
+			_.pass();
+	}
+	{
+		Test _(g, "Self move assignment");
+		Buffer a("Hello, world!");
+		Buffer& r = a;
+		a = std::move(r);
+		if (a.equal("Hello, world!"))
+			_.pass();
+	}
+
+	return (0);
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <common/buffer.h>
+#include <common/endian.h>
+#include <common/test.h>
+
+static uint8_t data[BUFFER_SEGMENT_SIZE * 3];
+
+int
+main(void)
+{
+	unsigned i;
+
+	for (i = 0; i < sizeof data; i++)
+		data[i] = random() & 0xff;
+
+	/*
+	 * Build the Buffer out of small pieces so that reads straddle
+	 * segment boundaries.
+	 */
+	Buffer buf;
+	for (i = 0; i < sizeof data; i += 7) {
+		Buffer piece(data + i, std::min<size_t>(7, sizeof data - i));
+		buf.append(piece);
+	}
+
+	TestGroup g("/test/buffer/reader1", "BufferReader #1");
+
+	{
+		Test _(g, "Byte-by-byte reads");
+		BufferReader r(&buf);
+		for (i = 0; i < sizeof data; i++) {
+			uint8_t ch;
+			if (r.peek() != data[i])
+				break;
+			r.moveout(&ch);
+			if (ch != data[i])
+				break;
+		}
+		if (i == sizeof data && r.empty() && r.position() == sizeof data)
+			_.pass();
+	}
+	{
+		Test _(g, "Big-endian reads");
+		BufferReader r(&buf);
+		r.skip(5);
+		uint32_t a, b;
+		BigEndian::extract(&a, &r);
+		r.moveout(&b);
+		b = BigEndian::decode(b);
+		uint32_t expected = (data[5] << 24) | (data[6] << 16) |
+		    (data[7] << 8) | data[8];
+		if (a == expected && b == expected && r.position() == 9)
+			_.pass();
+	}
+	{
+		Test _(g, "Extract at offset");
+		BufferReader r(&buf);
+		r.skip(3);
+		uint64_t v;
+		r.extract(&v, 10);
+		if (memcmp(&v, data + 13, sizeof v) == 0 && r.position() == 3)
+			_.pass();
+	}
+	{
+		Test _(g, "Spans cover the Buffer");
+		BufferReader r(&buf);
+		size_t off = 0;
+		bool ok = true;
+		while (!r.empty()) {
+			const uint8_t *p;
+			size_t len;
+
+			p = r.span(&len);
+			if (len == 0 || memcmp(p, data + off, len) != 0) {
+				ok = false;
+				break;
+			}
+			off += len;
+			r.skip(len);
+		}
+		if (ok && off == sizeof data)
+			_.pass();
+	}
+	{
+		Test _(g, "Move out to Buffer");
+		BufferReader r(&buf);
+		Buffer a, b;
+		r.skip(10);
+		r.moveout(&a, 100);
+		r.moveout(&b, r.length());
+		if (a.equal(data + 10, 100) && b.equal(data + 110, sizeof data - 110))
+			_.pass();
+	}
+	{
+		Test _(g, "Move out to BufferSegment across segments");
+		BufferReader r(&buf);
+		BufferSegment *seg;
+		r.skip(1);
+		r.moveout(&seg, 100);
+		if (seg->length() == 100 && memcmp(seg->data(), data + 1, 100) == 0)
+			_.pass();
+		seg->unref();
+	}
+	{
+		Test _(g, "Move out to BufferSegment within a segment");
+		BufferReader r(&buf);
+		BufferSegment *seg;
+		r.skip(2);
+		r.moveout(&seg, 3);
+		if (seg->length() == 3 && memcmp(seg->data(), data + 2, 3) == 0)
+			_.pass();
+		seg->unref();
+	}
+	{
+		Test _(g, "Find");
+		Buffer hay("abcdefghij");
+		hay.append(std::string("klmnop"));
+		BufferReader r(&hay);
+		size_t off;
+		r.skip(4);
+		if (r.find('m', &off) && off == 8 && !r.find('a', &off))
+			_.pass();
+	}
+	{
+		Test _(g, "Source is unchanged");
+		if (buf.equal(data, sizeof data))
+			_.pass();
+	}
+
+	return (0);
+}
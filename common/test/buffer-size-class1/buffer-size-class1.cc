@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <common/buffer.h>
+#include <common/test.h>
+
+static uint8_t data[BUFFER_SEGMENT_SIZE_MAX + BUFFER_SEGMENT_SIZE_LARGE + 100];
+
+static unsigned count_segments(const Buffer *);
+
+int
+main(void)
+{
+	unsigned i;
+
+	for (i = 0; i < sizeof data; i++)
+		data[i] = random() & 0xff;
+
+	TestGroup g("/test/buffer/size/class1", "BufferSegment size classes #1");
+
+	{
+		Test _(g, "Small segment capacity");
+		BufferSegment *seg = BufferSegment::create();
+		if (seg->capacity() == BUFFER_SEGMENT_SIZE)
+			_.pass();
+		seg->unref();
+	}
+	{
+		Test _(g, "Large segment capacity");
+		BufferSegment *seg = BufferSegment::create(BUFFER_SEGMENT_SIZE + 1);
+		if (seg->capacity() == BUFFER_SEGMENT_SIZE_LARGE)
+			_.pass();
+		seg->unref();
+	}
+	{
+		Test _(g, "Bulk append uses large segments");
+		Buffer buf(data, sizeof data);
+		if (count_segments(&buf) == 3 && buf.equal(data, sizeof data))
+			_.pass();
+	}
+	{
+		Test _(g, "Exact-length copyout from a large segment");
+		Buffer buf(data, BUFFER_SEGMENT_SIZE_MAX);
+		BufferSegment *seg;
+
+		buf.skip(7);
+		buf.copyout(&seg, BUFFER_SEGMENT_SIZE);
+		if (seg->length() == BUFFER_SEGMENT_SIZE &&
+		    seg->capacity() == BUFFER_SEGMENT_SIZE_MAX &&
+		    seg->equal(data + 7, BUFFER_SEGMENT_SIZE))
+			_.pass();
+		seg->unref();
+	}
+	{
+		Test _(g, "Copy of a view is small");
+		Buffer buf(data, BUFFER_SEGMENT_SIZE_MAX);
+		BufferSegment *seg, *seg2;
+
+		buf.copyout(&seg, BUFFER_SEGMENT_SIZE);
+		seg2 = seg->copy();
+		if (seg2->capacity() == BUFFER_SEGMENT_SIZE &&
+		    seg2->equal(seg))
+			_.pass();
+		seg2->unref();
+		seg->unref();
+	}
+	{
+		Test _(g, "Cut within a large segment");
+		Buffer buf(data, BUFFER_SEGMENT_SIZE_MAX);
+		Buffer clip;
+
+		buf.cut(100, BUFFER_SEGMENT_SIZE_LARGE, &clip);
+		if (clip.equal(data + 100, BUFFER_SEGMENT_SIZE_LARGE) &&
+		    buf.length() == BUFFER_SEGMENT_SIZE_MAX - BUFFER_SEGMENT_SIZE_LARGE &&
+		    buf.prefix(data, 100))
+			_.pass();
+	}
+}
+
+static unsigned
+count_segments(const Buffer *buf)
+{
+	Buffer::SegmentIterator iter = buf->segments();
+	unsigned n;
+
+	for (n = 0; !iter.end(); iter.next())
+		n++;
+	return (n);
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <common/buffer.h>
+#include <common/endian.h>
+#include <common/test.h>
+
+int
+main(void)
+{
+	TestGroup g("/test/buffer/writer1", "BufferWriter #1");
+
+	{
+		Test _(g, "Write to empty Buffer");
+		Buffer buf;
+		{
+			BufferWriter w(&buf, 3);
+			w.append((uint8_t)'a');
+			w.append((const uint8_t *)"bc", 2);
+		}
+		if (buf.equal("abc"))
+			_.pass();
+	}
+	{
+		Test _(g, "Write into existing segment");
+		Buffer buf("hello");
+		const BufferSegment *seg = *buf.segments();
+		{
+			BufferWriter w(&buf, 6);
+			w.append((const uint8_t *)" world", 6);
+		}
+		if (buf.equal("hello world") && *buf.segments() == seg &&
+		    buf.length() == 11)
+			_.pass();
+	}
+	{
+		Test _(g, "Shared segment is not written to");
+		Buffer buf("hello");
+		Buffer copy(buf);
+		{
+			BufferWriter w(&buf, 1);
+			w.append((uint8_t)'!');
+		}
+		if (buf.equal("hello!") && copy.equal("hello"))
+			_.pass();
+	}
+	{
+		Test _(g, "Big-endian integers");
+		Buffer buf;
+		{
+			BufferWriter w(&buf, 7);
+			w.append((uint8_t)0x01);
+			BigEndian::append(&w, (uint16_t)0x0203);
+			BigEndian::append(&w, (uint32_t)0x04050607);
+		}
+		uint8_t expected[] = { 1, 2, 3, 4, 5, 6, 7 };
+		if (buf.equal(expected, sizeof expected))
+			_.pass();
+	}
+	{
+		Test _(g, "Direct writes via tail");
+		Buffer buf;
+		{
+			BufferWriter w(&buf, 16);
+			memset(w.tail(), 'x', 16);
+			w.advance(16);
+			w.commit();
+			w.reserve(2);
+			w.append((const uint8_t *)"yz", 2);
+		}
+		if (buf.length() == 18 && buf.equal("xxxxxxxxxxxxxxxxyz"))
+			_.pass();
+	}
+	{
+		Test _(g, "Empty write leaves Buffer empty");
+		Buffer buf;
+		{
+			BufferWriter w(&buf, 8);
+		}
+		if (buf.empty())
+			_.pass();
+	}
+
+	return (0);
+}
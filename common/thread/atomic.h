@@ -26,12 +26,19 @@
 #ifndef	COMMON_THREAD_ATOMIC_H
 #define	COMMON_THREAD_ATOMIC_H
 
+#include <atomic>
+
+/*
+ * Every operation takes an optional memory order, which defaults to
+ * sequential consistency.  Callers which know what they are synchronizing
+ * with should say so, e.g. counters which guard nothing may be relaxed.
+ */
 template<typename T>
 class Atomic {
-	volatile T val_;
+	std::atomic<T> val_;
 public:
 	Atomic(void)
-	: val_()
+	: val_(T())
 	{ }
 
 	template<typename Ta>
@@ -47,60 +54,53 @@ public:
 	 * deliberate use of this class.
 	 */
 
-#if defined(__GNUC__)
 	template<typename Ta>
-	T add(Ta arg)
+	T add(Ta arg, std::memory_order order = std::memory_order_seq_cst)
 	{
-		return (__sync_fetch_and_add(&val_, arg));
+		return (val_.fetch_add(arg, order));
 	}
 
 	template<typename Ta>
-	T subtract(Ta arg)
+	T subtract(Ta arg, std::memory_order order = std::memory_order_seq_cst)
 	{
-		return (__sync_fetch_and_sub(&val_, arg));
+		return (val_.fetch_sub(arg, order));
 	}
 
 	template<typename Ta>
-	T set(Ta arg)
+	T set(Ta arg, std::memory_order order = std::memory_order_seq_cst)
 	{
-		return (__sync_fetch_and_or(&val_, arg));
+		return (val_.fetch_or(arg, order));
 	}
 
 	template<typename Ta>
-	T mask(Ta arg)
+	T mask(Ta arg, std::memory_order order = std::memory_order_seq_cst)
 	{
-		return (__sync_fetch_and_and(&val_, arg));
+		return (val_.fetch_and(arg, order));
 	}
 
 	template<typename Ta>
-	T clear(Ta arg)
+	T clear(Ta arg, std::memory_order order = std::memory_order_seq_cst)
 	{
-		return (__sync_fetch_and_and(&val_, ~arg));
+		return (val_.fetch_and(~arg, order));
 	}
 
 	template<typename To, typename Tn>
-	bool cmpset(To oldval, Tn newval)
+	bool cmpset(To oldval, Tn newval, std::memory_order order = std::memory_order_seq_cst)
 	{
-		return (__sync_bool_compare_and_swap(&val_, oldval, newval));
+		T expected = oldval;
+		return (val_.compare_exchange_strong(expected, newval, order));
 	}
 
-	/* XXX GCC doesn't provide atomic loads/stores.  */
-	T load(void) const
+	T load(std::memory_order order = std::memory_order_seq_cst) const
 	{
-		return (val_);
+		return (val_.load(order));
 	}
 
 	template<typename Ta>
-	void store(Ta val)
+	void store(Ta val, std::memory_order order = std::memory_order_seq_cst)
 	{
-		for (;;) {
-			if (cmpset(load(), val))
-				return;
-		}
+		val_.store(val, order);
 	}
-#else
-#error "No support for atomic operations for your compiler.  Why not add some?"
-#endif
 };
 
 #endif /* !COMMON_THREAD_ATOMIC_H */
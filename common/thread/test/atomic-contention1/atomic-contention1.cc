@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <common/refcount.h>
+#include <common/test.h>
+
+#include <common/thread/atomic.h>
+#include <common/thread/thread.h>
+
+#include <common/time/time.h>
+
+#define	NTHREAD		4
+#define	ROUNDS		(1024 * 1024)
+
+/*
+ * Contention microbenchmark: every thread hammers the same RefCount and
+ * counters, and the time taken for each kind of operation is reported.
+ */
+
+enum ContentionOp {
+	ContentionRefCount,
+	ContentionAdd,
+	ContentionStore,
+};
+
+class ContentionThread : public WorkerThread {
+	ContentionOp op_;
+	RefCount *ref_;
+	Atomic<uintmax_t> *counter_;
+public:
+	ContentionThread(ContentionOp op, RefCount *ref, Atomic<uintmax_t> *counter)
+	: WorkerThread("ContentionThread"),
+	  op_(op),
+	  ref_(ref),
+	  counter_(counter)
+	{ }
+
+	~ContentionThread()
+	{ }
+
+	void work(void)
+	{
+		unsigned i;
+
+		switch (op_) {
+		case ContentionRefCount:
+			for (i = 0; i < ROUNDS; i++) {
+				ref_->hold();
+				ref_->drop();
+			}
+			break;
+		case ContentionAdd:
+			for (i = 0; i < ROUNDS; i++)
+				counter_->add(1, std::memory_order_relaxed);
+			break;
+		case ContentionStore:
+			for (i = 0; i < ROUNDS; i++)
+				counter_->store(i, std::memory_order_release);
+			break;
+		}
+		stop();
+	}
+};
+
+static void
+contention(ContentionOp op, const std::string& name, RefCount *ref, Atomic<uintmax_t> *counter)
+{
+	ContentionThread *threads[NTHREAD];
+	unsigned i;
+
+	for (i = 0; i < NTHREAD; i++) {
+		threads[i] = new ContentionThread(op, ref, counter);
+		threads[i]->start();
+	}
+
+	NanoTime start = NanoTime::current_time();
+	for (i = 0; i < NTHREAD; i++)
+		threads[i]->submit();
+	for (i = 0; i < NTHREAD; i++)
+		threads[i]->join();
+	NanoTime end = NanoTime::current_time();
+
+	for (i = 0; i < NTHREAD; i++)
+		delete threads[i];
+
+	end -= start;
+	uintmax_t ns = end.seconds_ * 1000000000 + end.nanoseconds_;
+	INFO("/test/atomic/contention1") << name << ": " << NTHREAD << " threads, " << (ns * 1000 / ((uintmax_t)NTHREAD * ROUNDS)) << "ps per operation.";
+}
+
+int
+main(void)
+{
+	TestGroup g("/test/atomic/contention1", "Atomic contention #1");
+
+	{
+		RefCount ref;
+		ref.hold();
+
+		contention(ContentionRefCount, "RefCount hold/drop", &ref, NULL);
+
+		{
+			Test _(g, "RefCount balanced after contention");
+			if (!ref.drop() && ref.exclusive() && ref.drop())
+				_.pass();
+		}
+	}
+
+	{
+		Atomic<uintmax_t> counter(0);
+
+		contention(ContentionAdd, "Atomic add", NULL, &counter);
+
+		Test _(g, "No lost additions", counter.load() == (uintmax_t)NTHREAD * ROUNDS);
+	}
+
+	{
+		Atomic<uintmax_t> counter(ROUNDS);
+
+		contention(ContentionStore, "Atomic store", NULL, &counter);
+
+		Test _(g, "Last store observed", counter.load() == ROUNDS - 1);
+	}
+
+	return (0);
+}
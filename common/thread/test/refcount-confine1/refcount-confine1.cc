@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <common/buffer.h>
+#include <common/refcount.h>
+#include <common/test.h>
+
+#include <common/thread/thread.h>
+
+static uint8_t data[BUFFER_SEGMENT_SIZE * 2 + 100];
+
+class ConfinedThread : public WorkerThread {
+	TestGroup& group_;
+	RefCount *ref_;
+	Buffer *buf_;
+public:
+	ConfinedThread(TestGroup& group)
+	: WorkerThread("ConfinedThread"),
+	  group_(group),
+	  ref_(NULL),
+	  buf_(NULL)
+	{ }
+
+	~ConfinedThread()
+	{ }
+
+	void work(void)
+	{
+		RefCount::confine();
+
+		{
+			Test _(group_, "RefCount is confined");
+			ref_ = new RefCount();
+			if (!ref_->shared() && ref_->exclusive())
+				_.pass();
+		}
+		{
+			Test _(group_, "Confined hold and drop");
+			ref_->hold();
+			ref_->hold();
+			bool last = ref_->drop();
+			if (!last && !ref_->exclusive() && !ref_->drop() &&
+			    ref_->exclusive())
+				_.pass();
+		}
+		{
+			Test _(group_, "Share confined RefCount");
+			ref_->hold();
+			ref_->share();
+			if (ref_->shared() && !ref_->exclusive())
+				_.pass();
+		}
+
+		buf_ = new Buffer(data, sizeof data);
+		Buffer copy(*buf_);
+		buf_->skip(10);
+		buf_->share();
+
+		stop();
+	}
+
+	RefCount *ref(void)
+	{
+		return (ref_);
+	}
+
+	Buffer *buffer(void)
+	{
+		return (buf_);
+	}
+};
+
+int
+main(void)
+{
+	unsigned i;
+
+	for (i = 0; i < sizeof data; i++)
+		data[i] = random() & 0xff;
+
+	TestGroup g("/test/refcount/confine1", "RefCount confinement #1");
+
+	{
+		Test _(g, "RefCount is not confined by default");
+		RefCount ref;
+		if (ref.shared())
+			_.pass();
+		ref.drop();
+	}
+
+	ConfinedThread *td = new ConfinedThread(g);
+	td->start();
+	td->submit();
+	td->join();
+
+	{
+		Test _(g, "Shared RefCount from another thread");
+		RefCount *ref = td->ref();
+		if (!ref->drop() && ref->exclusive() && ref->drop())
+			_.pass();
+		delete ref;
+	}
+	{
+		Test _(g, "Shared Buffer from another thread");
+		Buffer *buf = td->buffer();
+		Buffer copy(*buf);
+		copy.skip(1);
+		copy.trim(1);
+		if (buf->equal(data + 10, sizeof data - 10) &&
+		    copy.equal(data + 11, sizeof data - 12))
+			_.pass();
+		delete buf;
+	}
+
+	delete td;
+
+	return (0);
+}
@@ -31,6 +31,7 @@
 
 #include <set>
 
+#include <common/thread/atomic.h>
 #include <common/thread/mutex.h>
 #include <common/thread/sleep_queue.h>
 #include <common/thread/thread.h>
@@ -40,7 +41,7 @@
 #include "thread_posix.h"
 
 namespace {
-	static bool thread_posix_initialized;
+	static Atomic<bool> thread_posix_initialized(false);
 	static pthread_key_t thread_posix_key;
 
 	static Mutex thread_start_mutex("Thread::start");
@@ -88,9 +89,9 @@ Thread::join(void)
 void
 Thread::start(void)
 {
-	if (!thread_posix_initialized) {
+	if (!thread_posix_initialized.load(std::memory_order_acquire)) {
 		thread_posix_init();
-		if (!thread_posix_initialized) {
+		if (!thread_posix_initialized.load(std::memory_order_relaxed)) {
 			ERROR("/thread/posix") << "Unable to initialize POSIX threads.";
 			return;
 		}
@@ -117,9 +118,9 @@ Thread::start(void)
 Thread *
 Thread::self(void)
 {
-	if (!thread_posix_initialized)
+	if (!thread_posix_initialized.load(std::memory_order_acquire))
 		thread_posix_init();
-	ASSERT("/thread/posix", thread_posix_initialized);
+	ASSERT("/thread/posix", thread_posix_initialized.load(std::memory_order_relaxed));
 
 	void *ptr = pthread_getspecific(thread_posix_key);
 	if (ptr == NULL)
@@ -177,7 +178,7 @@ namespace {
 	static void
 	thread_posix_init(void)
 	{
-		ASSERT("/thread/posix", !thread_posix_initialized);
+		ASSERT("/thread/posix", !thread_posix_initialized.load(std::memory_order_relaxed));
 
 		signal(SIGINT, ThreadState::signal_stop);
 		signal(SIGUSR1, thread_posix_signal_ignore);
@@ -190,7 +191,7 @@ namespace {
 
 		ThreadState::start(thread_posix_key, &initial_thread);
 
-		thread_posix_initialized = true;
+		thread_posix_initialized.store(true, std::memory_order_release);
 	}
 
 	static void
@@ -121,7 +121,17 @@ private:
 			return;
 		}
 
+		/*
+		 * The callback may have been scheduled, and even run, while
+		 * drain still held the lock and had yet to record its action.
+		 */
 		ScopedLock _(&mtx_);
+		if (a->action_ != NULL) {
+			a->action_->cancel();
+			a->action_ = NULL;
+			return;
+		}
+
 		std::deque<CallbackAction *>::iterator it;
 		for (it = queue_.begin(); it != queue_.end(); ++it) {
 			if (*it != a)
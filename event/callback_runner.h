@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef	EVENT_CALLBACK_RUNNER_H
+#define	EVENT_CALLBACK_RUNNER_H
+
+#include <deque>
+
+#include <common/thread/mutex.h>
+
+#include <event/callback.h>
+
+/*
+ * Runs the callbacks scheduled on it only when run() is called, on the calling
+ * thread, so that tests can drive event-driven code a step at a time without
+ * an EventSystem.  As with CallbackThread, a callback must cancel its action
+ * while it is being run.  Callbacks may be scheduled from other threads, as
+ * when a CallbackQueue is drained, but are run on the thread calling run().
+ */
+class CallbackRunner : public CallbackScheduler {
+	LogHandle log_;
+	Mutex mtx_;
+	std::deque<CallbackBase *> queue_;
+	CallbackBase *inflight_;
+public:
+	CallbackRunner(void)
+	: log_("/callback/runner"),
+	  mtx_("CallbackRunner"),
+	  queue_(),
+	  inflight_(NULL)
+	{ }
+
+	~CallbackRunner()
+	{
+		ASSERT(log_, queue_.empty());
+	}
+
+	Action *schedule(CallbackBase *cb)
+	{
+		ScopedLock _(&mtx_);
+		queue_.push_back(cb);
+
+		return (cancellation(this, &CallbackRunner::cancel, cb));
+	}
+
+	/*
+	 * Run callbacks until there are none left, including any scheduled by
+	 * the callbacks themselves.  Returns how many were run.
+	 */
+	unsigned run(void)
+	{
+		unsigned n = 0;
+
+		for (;;) {
+			mtx_.lock();
+			if (queue_.empty()) {
+				mtx_.unlock();
+				break;
+			}
+			CallbackBase *cb = queue_.front();
+			queue_.pop_front();
+			mtx_.unlock();
+
+			inflight_ = cb;
+			cb->execute();
+			delete cb;
+			if (inflight_ != NULL)
+				HALT(log_) << "Callback not cancelled in execution.";
+			n++;
+		}
+		return (n);
+	}
+
+private:
+	void cancel(CallbackBase *cb)
+	{
+		if (inflight_ == cb) {
+			inflight_ = NULL;
+			return;
+		}
+
+		ScopedLock _(&mtx_);
+		std::deque<CallbackBase *>::iterator it;
+		for (it = queue_.begin(); it != queue_.end(); ++it) {
+			if (*it != cb)
+				continue;
+			queue_.erase(it);
+			delete cb;
+			return;
+		}
+
+		NOTREACHED(log_);
+	}
+};
+
+#endif /* !EVENT_CALLBACK_RUNNER_H */
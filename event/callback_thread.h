@@ -52,6 +52,7 @@ public:
 private:
 	void cancel(CallbackBase *);
 
+protected:
 	void main(void);
 
 public:
@@ -26,6 +26,8 @@
 #ifndef	EVENT_EVENT_H
 #define	EVENT_EVENT_H
 
+#include <utility>
+
 #include <common/buffer.h>
 
 /*
@@ -92,12 +94,34 @@ struct Event {
 	  buffer_(buffer)
 	{ }
 
+	/*
+	 * The rvalue variants take over the Buffer rather than holding
+	 * another reference to each of its segments.
+	 */
+	Event(Type type, Buffer&& buffer)
+	: type_(type),
+	  error_(0),
+	  buffer_(std::move(buffer))
+	{ }
+
+	Event(Type type, int error, Buffer&& buffer)
+	: type_(type),
+	  error_(error),
+	  buffer_(std::move(buffer))
+	{ }
+
 	Event(const Event& e)
 	: type_(e.type_),
 	  error_(e.error_),
 	  buffer_(e.buffer_)
 	{ }
 
+	Event(Event&& e)
+	: type_(e.type_),
+	  error_(e.error_),
+	  buffer_(std::move(e.buffer_))
+	{ }
+
 	Event& operator= (const Event& e)
 	{
 		type_ = e.type_;
@@ -105,6 +129,14 @@ struct Event {
 		buffer_ = e.buffer_;
 		return (*this);
 	}
+
+	Event& operator= (Event&& e)
+	{
+		type_ = e.type_;
+		error_ = e.error_;
+		buffer_ = std::move(e.buffer_);
+		return (*this);
+	}
 };
 
 static inline std::ostream&
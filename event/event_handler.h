@@ -145,7 +145,7 @@ private:
 			else
 				cb = default_;
 
-			cb->param(e);
+			cb->param(std::move(e));
 			cb->execute();
 			cb->reset();
 			return;
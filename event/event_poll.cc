@@ -38,7 +38,7 @@ EventPoll::PollHandler::callback(Event e)
 		return;
 	ASSERT("/event/poll/handler", action_ == NULL);
 	ASSERT("/event/poll/handler", callback_ != NULL);
-	callback_->param(e);
+	callback_->param(std::move(e));
 	Action *a = callback_->schedule();
 	callback_ = NULL;
 	action_ = a;
@@ -33,6 +33,19 @@ EventThread::EventThread(void)
   interest_queue_()
 { }
 
+void
+EventThread::main(void)
+{
+	/*
+	 * Nearly all work is done here, and most of what is allocated here
+	 * never leaves this thread, so confine our RefCounts to it.  What is
+	 * handed to the I/O threads is shared on the way.
+	 */
+	RefCount::confine();
+
+	CallbackThread::main();
+}
+
 void
 EventThread::stop(void)
 {
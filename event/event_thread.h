@@ -63,6 +63,9 @@ public:
 	}
 
 	void stop(void);
+
+protected:
+	void main(void);
 };
 
 #endif /* !EVENT_EVENT_THREAD_H */
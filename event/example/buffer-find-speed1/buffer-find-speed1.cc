@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <event/event_callback.h>
+#include <event/event_main.h>
+#include <event/event_system.h>
+#include <event/speed_test.h>
+
+/*
+ * Scans Buffers for bytes which they do not contain, with the segment
+ * layouts they typically have: a single large segment from a bulk read,
+ * full BUFFER_SEGMENT_SIZE segments, and the short segments left behind by
+ * protocol parsing.
+ */
+
+static uint8_t zbuf[65536];
+
+class BufferFindSpeed : SpeedTest {
+	Buffer bulk_;
+	Buffer full_;
+	Buffer fragmented_;
+	uintmax_t find_bytes_;
+	uintmax_t find_any_bytes_;
+public:
+	BufferFindSpeed(void)
+	: bulk_(zbuf, sizeof zbuf),
+	  full_(),
+	  fragmented_(),
+	  find_bytes_(0),
+	  find_any_bytes_(0)
+	{
+		BufferSegment *seg;
+		unsigned o;
+
+		for (o = 0; o < sizeof zbuf; o += BUFFER_SEGMENT_SIZE) {
+			seg = BufferSegment::create(zbuf + o, BUFFER_SEGMENT_SIZE);
+			full_.append(seg);
+			seg->unref();
+		}
+		for (o = 0; o + 100 <= sizeof zbuf; o += 100)
+			fragmented_.append(Buffer(zbuf + o, 100));
+
+		perform();
+	}
+
+	~BufferFindSpeed()
+	{ }
+
+private:
+	void perform(void)
+	{
+		scan(&bulk_);
+		scan(&full_);
+		scan(&fragmented_);
+
+		schedule();
+	}
+
+	void scan(const Buffer *buf)
+	{
+		unsigned off;
+
+		if (!buf->find(0xf1, &off))
+			find_bytes_ += buf->length();
+		if (!buf->find_any("\r\n", &off))
+			find_any_bytes_ += buf->length();
+	}
+
+	void finish(void)
+	{
+		INFO("/example/buffer/find/speed1") << "Timer expired; " << find_bytes_ << " bytes searched by find, " << find_any_bytes_ << " by find_any.";
+
+		EventSystem::instance()->stop();
+	}
+};
+
+int
+main(void)
+{
+	memset(zbuf, 'x', sizeof zbuf);
+
+	BufferFindSpeed *cs = new BufferFindSpeed();
+
+	event_main();
+
+	delete cs;
+}
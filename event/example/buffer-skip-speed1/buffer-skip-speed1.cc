@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <common/buffer_allocator.h>
+
+#include <event/event_callback.h>
+#include <event/event_main.h>
+#include <event/event_system.h>
+#include <event/speed_test.h>
+
+/*
+ * Measures how cheaply skip(), trim() and cut() can operate on a Buffer
+ * whose segments are shared with another Buffer, as happens whenever data
+ * is both forwarded and retained.  Every BufferSegment and BufferData
+ * allocation is counted so that any copy-on-write is visible as well as its
+ * cost in time.
+ */
+
+static uintmax_t
+allocations(void)
+{
+	return (BufferAllocator::allocations(BufferAllocator::Segment) +
+		BufferAllocator::allocations(BufferAllocator::Data2K) +
+		BufferAllocator::allocations(BufferAllocator::Data16K) +
+		BufferAllocator::allocations(BufferAllocator::Data64K));
+}
+
+static uint8_t zbuf[8192];
+
+class BufferSkipSpeed : SpeedTest {
+	Buffer shared_;
+	uintmax_t bytes_;
+	uintmax_t allocations_;
+public:
+	BufferSkipSpeed(void)
+	: shared_(),
+	  bytes_(0),
+	  allocations_(0)
+	{
+		shared_.append(zbuf, sizeof zbuf);
+
+		perform();
+	}
+
+	~BufferSkipSpeed()
+	{ }
+
+private:
+	void perform(void)
+	{
+		uintmax_t before = allocations();
+		Buffer tmp(shared_);
+		Buffer clip;
+
+		tmp.skip(17);
+		tmp.trim(23);
+		tmp.cut(1000, 3000, &clip);
+		bytes_ += tmp.length() + clip.length();
+
+		allocations_ += allocations() - before;
+
+		schedule();
+	}
+
+	void finish(void)
+	{
+		INFO("/example/buffer/skip/speed1") << "Timer expired; " << bytes_ << " bytes processed with " << allocations_ << " allocations.";
+
+		EventSystem::instance()->stop();
+	}
+};
+
+int
+main(void)
+{
+	memset(zbuf, 0, sizeof zbuf);
+
+	BufferSkipSpeed *cs = new BufferSkipSpeed();
+
+	event_main();
+
+	delete cs;
+}
@@ -46,12 +46,13 @@ TimeoutThread::TimeoutThread(void)
 { }
 
 /*
- * XXX
- * Locking?
+ * The queue is shared with threads adding timeouts, so is only touched with
+ * the lock held; wait() is already called with it held.
  */
 void
 TimeoutThread::work(void)
 {
+	ScopedLock _(&mtx_);
 	if (!timeout_queue_.empty()) {
 		/*
 		 * XXX
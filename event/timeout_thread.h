@@ -41,7 +41,9 @@ public:
 
 	Action *timeout(unsigned secs, SimpleCallback *cb)
 	{
+		mtx_.lock();
 		Action *a = timeout_queue_.append(secs, cb);
+		mtx_.unlock();
 		submit();
 		return (a);
 	}
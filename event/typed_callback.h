@@ -26,6 +26,8 @@
 #ifndef	EVENT_TYPED_CALLBACK_H
 #define	EVENT_TYPED_CALLBACK_H
 
+#include <utility>
+
 #include <event/callback.h>
 
 template<typename T>
@@ -47,18 +49,29 @@ protected:
 	virtual void operator() (T) = 0;
 
 public:
+	/*
+	 * The parameter is moved into the call, since a callback is only
+	 * executed once per param().
+	 */
 	void execute(void)
 	{
 		ASSERT("/typed/callback", have_param_);
-		(*this)(param_);
+		have_param_ = false;
+		(*this)(std::move(param_));
 	}
 
-	void param(T p)
+	void param(const T& p)
 	{
 		param_ = p;
 		have_param_ = true;
 	}
 
+	void param(T&& p)
+	{
+		param_ = std::move(p);
+		have_param_ = true;
+	}
+
 	void reset(void)
 	{
 		param_ = T();
@@ -88,7 +101,7 @@ public:
 private:
 	void operator() (T p)
 	{
-		(obj_->*method_)(p);
+		(obj_->*method_)(std::move(p));
 	}
 };
 
@@ -116,7 +129,7 @@ public:
 private:
 	void operator() (T p)
 	{
-		(obj_->*method_)(p, arg_);
+		(obj_->*method_)(std::move(p), arg_);
 	}
 };
 
@@ -202,6 +202,7 @@ IOSystem::write(int fd, Channel *owner, off_t offset, Buffer *buffer, EventCallb
 	ASSERT(log_, h->write_buffer_.empty());
 
 	ASSERT(log_, !buffer->empty());
+	buffer->share();
 	buffer->moveout(&h->write_buffer_);
 
 	h->write_offset_ = offset;
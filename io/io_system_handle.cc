@@ -104,7 +104,7 @@ IOSystem::Handle::read_callback(Event e)
 		break;
 	case Event::Error: {
 		DEBUG(log_) << "Poll returned error: " << e;
-		read_callback_->param(e);
+		read_callback_->param(std::move(e));
 		Action *a = read_callback_->schedule();
 		read_action_ = a;
 		read_callback_ = NULL;
@@ -143,10 +143,11 @@ IOSystem::Handle::read_do(void)
 	if (!read_buffer_.empty() && read_buffer_.length() >= read_amount_) {
 		if (read_amount_ == 0)
 			read_amount_ = read_buffer_.length();
-		read_callback_->param(Event(Event::Done, Buffer(read_buffer_, read_amount_)));
+		Event e(Event::Done);
+		read_buffer_.moveout(&e.buffer_, read_amount_);
+		read_callback_->param(std::move(e));
 		Action *a = read_callback_->schedule();
 		read_callback_ = NULL;
-		read_buffer_.skip(read_amount_);
 		read_amount_ = 0;
 		return (a);
 	}
@@ -206,10 +207,9 @@ IOSystem::Handle::read_do(void)
 		case EAGAIN:
 			return (NULL);
 		default:
-			read_callback_->param(Event(Event::Error, errno, read_buffer_));
+			read_callback_->param(Event(Event::Error, errno, std::move(read_buffer_)));
 			Action *a = read_callback_->schedule();
 			read_callback_ = NULL;
-			read_buffer_.clear();
 			read_amount_ = 0;
 			return (a);
 		}
@@ -226,24 +226,28 @@ IOSystem::Handle::read_do(void)
 	 * and so we shouldn't just use a short read as an indicator?
 	 */
 	if (len == 0) {
-		read_callback_->param(Event(Event::EOS, read_buffer_));
+		read_callback_->param(Event(Event::EOS, std::move(read_buffer_)));
 		Action *a = read_callback_->schedule();
 		read_callback_ = NULL;
-		read_buffer_.clear();
 		read_amount_ = 0;
 		return (a);
 	}
 
+	/*
+	 * The read buffer is used from both the caller's thread and ours.
+	 */
 	read_buffer_.append(data, len);
+	read_buffer_.share();
 
 	if (!read_buffer_.empty() &&
 	    read_buffer_.length() >= read_amount_) {
 		if (read_amount_ == 0)
 			read_amount_ = read_buffer_.length();
-		read_callback_->param(Event(Event::Done, Buffer(read_buffer_, read_amount_)));
+		Event e(Event::Done);
+		read_buffer_.moveout(&e.buffer_, read_amount_);
+		read_callback_->param(std::move(e));
 		Action *a = read_callback_->schedule();
 		read_callback_ = NULL;
-		read_buffer_.skip(read_amount_);
 		read_amount_ = 0;
 		return (a);
 	}
@@ -283,7 +287,7 @@ IOSystem::Handle::write_callback(Event e)
 		break;
 	case Event::Error: {
 		DEBUG(log_) << "Poll returned error: " << e;
-		write_callback_->param(e);
+		write_callback_->param(std::move(e));
 		Action *a = write_callback_->schedule();
 		write_action_ = a;
 		write_callback_ = NULL;
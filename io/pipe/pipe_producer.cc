@@ -34,7 +34,11 @@
 
 PipeProducer::PipeProducer(const LogHandle& log)
 : log_(log),
+  input_action_(NULL),
+  input_callback_(NULL),
+  input_paused_(false),
   output_buffer_(),
+  output_priority_(),
   output_action_(NULL),
   output_callback_(NULL),
   output_eos_(false),
@@ -44,6 +48,8 @@ PipeProducer::PipeProducer(const LogHandle& log)
 
 PipeProducer::~PipeProducer()
 {
+	ASSERT(log_, input_action_ == NULL);
+	ASSERT(log_, input_callback_ == NULL);
 	ASSERT(log_, output_action_ == NULL);
 	ASSERT(log_, output_callback_ == NULL);
 }
@@ -54,8 +60,7 @@ PipeProducer::input(Buffer *buf, EventCallback *cb)
 	if (!error_) {
 		/*
 		 * XXX
-		 * Allow consume() to only consume part of buf, and to
-		 * delay further input.
+		 * Allow consume() to only consume part of buf.
 		 */
 		consume(buf);
 		if (error_ && !buf->empty())
@@ -65,6 +70,19 @@ PipeProducer::input(Buffer *buf, EventCallback *cb)
 		buf->clear();
 	}
 
+	/*
+	 * Hold on to the callback while input is paused or while output is
+	 * backed up, so that whoever is feeding us stops for a while.
+	 */
+	if (input_wait()) {
+		ASSERT(log_, input_action_ == NULL);
+		ASSERT(log_, input_callback_ == NULL);
+
+		input_callback_ = cb;
+
+		return (cancellation(this, &PipeProducer::input_cancel));
+	}
+
 	if (error_)
 		cb->param(Event::Error);
 	else
@@ -72,6 +90,58 @@ PipeProducer::input(Buffer *buf, EventCallback *cb)
 	return (cb->schedule());
 }
 
+void
+PipeProducer::input_cancel(void)
+{
+	if (input_action_ != NULL) {
+		ASSERT(log_, input_callback_ == NULL);
+
+		input_action_->cancel();
+		input_action_ = NULL;
+	}
+
+	if (input_callback_ != NULL) {
+		delete input_callback_;
+		input_callback_ = NULL;
+	}
+}
+
+/*
+ * Stop completing input until input_resume() is called.  Data already passed
+ * to input() is still consumed.
+ */
+void
+PipeProducer::input_pause(void)
+{
+	input_paused_ = true;
+}
+
+void
+PipeProducer::input_resume(void)
+{
+	input_paused_ = false;
+	input_do();
+}
+
+/*
+ * Complete held input once there is no longer any reason to hold it.
+ */
+void
+PipeProducer::input_do(void)
+{
+	if (input_callback_ == NULL || input_wait())
+		return;
+
+	ASSERT(log_, input_action_ == NULL);
+
+	if (error_)
+		input_callback_->param(Event::Error);
+	else
+		input_callback_->param(Event::Done);
+	input_action_ = input_callback_->schedule();
+	input_callback_ = NULL;
+}
+
 Action *
 PipeProducer::output(EventCallback *cb)
 {
@@ -108,15 +178,26 @@ PipeProducer::output_do(EventCallback *cb)
 {
 	if (error_) {
 		ASSERT(log_, output_buffer_.empty());
+		ASSERT(log_, output_priority_.empty());
 
 		cb->param(Event::Error);
 		return (cb->schedule());
 	}
 
+	/*
+	 * Priority output goes ahead of whatever was produced before it and
+	 * has not been taken yet.
+	 */
+	if (!output_priority_.empty()) {
+		output_buffer_.moveout(&output_priority_);
+		output_priority_.moveout(&output_buffer_);
+	}
+
 	if (!output_buffer_.empty()) {
-		cb->param(Event(Event::Done, output_buffer_));
-		output_buffer_.clear();
-		return (cb->schedule());
+		cb->param(Event(Event::Done, std::move(output_buffer_)));
+		Action *a = cb->schedule();
+		input_do();
+		return (a);
 	}
 
 	if (output_eos_) {
@@ -151,6 +232,40 @@ PipeProducer::produce(Buffer *buf)
 	}
 }
 
+/*
+ * Produce data which is to be taken ahead of any other data which has not been
+ * taken yet.  Data is only ever put ahead of whole produced Buffers, so each
+ * produced Buffer stays together.
+ */
+void
+PipeProducer::produce_priority(Buffer *buf)
+{
+	ASSERT(log_, !error_);
+	ASSERT(log_, !output_eos_);
+	ASSERT(log_, !buf->empty());
+
+	buf->moveout(&output_priority_);
+
+	if (output_callback_ != NULL) {
+		ASSERT(log_, output_action_ == NULL);
+
+		Action *a = output_do(output_callback_);
+		if (a != NULL) {
+			output_action_ = a;
+			output_callback_ = NULL;
+		}
+	}
+}
+
+/*
+ * Produce a temporary Buffer, taking over its data.
+ */
+void
+PipeProducer::produce(Buffer&& buf)
+{
+	produce(&buf);
+}
+
 void
 PipeProducer::produce_eos(Buffer *buf)
 {
@@ -186,6 +301,12 @@ PipeProducer::produce_error(void)
 
 	error_ = true;
 	output_buffer_.clear();
+	output_priority_.clear();
+
+	/*
+	 * Don't leave input waiting on output that will never be taken.
+	 */
+	input_do();
 
 	if (output_callback_ != NULL) {
 		ASSERT(log_, output_action_ == NULL);
@@ -26,6 +26,11 @@
 #ifndef	IO_PIPE_PIPE_PRODUCER_H
 #define	IO_PIPE_PIPE_PRODUCER_H
 
+/*
+ * How much output may be waiting to be taken before input is held.
+ */
+#define	PIPE_PRODUCER_OUTPUT_MAX	(1024 * 1024)
+
 class Action;
 
 class PipeProducer : public Pipe {
@@ -33,7 +38,12 @@ protected:
 	LogHandle log_;
 
 private:
+	Action *input_action_;
+	EventCallback *input_callback_;
+	bool input_paused_;
+
 	Buffer output_buffer_;
+	Buffer output_priority_;
 	Action *output_action_;
 	EventCallback *output_callback_;
 	bool output_eos_;
@@ -47,11 +57,26 @@ protected:
 	Action *output(EventCallback *);
 
 private:
+	void input_cancel(void);
+	void input_do(void);
+
+	bool input_wait(void) const
+	{
+		if (error_)
+			return (false);
+		return (input_paused_ || output_buffer_.length() + output_priority_.length() > PIPE_PRODUCER_OUTPUT_MAX);
+	}
+
 	void output_cancel(void);
 	Action *output_do(EventCallback *);
 
 public:
+	void input_pause(void);
+	void input_resume(void);
+
 	void produce(Buffer *);
+	void produce(Buffer&&);
+	void produce_priority(Buffer *);
 	void produce_eos(Buffer * = NULL);
 	void produce_error(void);
 
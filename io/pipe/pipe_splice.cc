@@ -94,7 +94,7 @@ PipeSplice::output_complete(Event e)
 	ASSERT(log_, !source_eos_);
 
 	if (e.type_ == Event::Error) {
-		callback_->param(e);
+		callback_->param(std::move(e));
 		action_ = callback_->schedule();
 		callback_ = NULL;
 
@@ -128,7 +128,7 @@ PipeSplice::input_complete(Event e)
 	}
 
 	if (e.type_ == Event::Error) {
-		callback_->param(e);
+		callback_->param(std::move(e));
 		action_ = callback_->schedule();
 		callback_ = NULL;
 
@@ -153,7 +153,7 @@ Splice::complete(Event e)
 		shutdown_action_ = NULL;
 	}
 
-	callback_->param(e);
+	callback_->param(std::move(e));
 	callback_action_ = callback_->schedule();
 	callback_ = NULL;
 }
@@ -132,7 +132,7 @@ SplicePair::splice_complete(Event e, Splice *splice)
 		callback_->param(Event::Done);
 	} else {
 		ASSERT(log_, e.type_ != Event::Done);
-		callback_->param(e);
+		callback_->param(std::move(e));
 	}
 	callback_action_ = callback_->schedule();
 	callback_ = NULL;
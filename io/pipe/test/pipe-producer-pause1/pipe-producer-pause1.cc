@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <common/test.h>
+
+#include <event/callback_runner.h>
+#include <event/event_callback.h>
+
+#include <io/pipe/pipe.h>
+#include <io/pipe/pipe_producer.h>
+#include <io/pipe/pipe_producer_wrapper.h>
+
+#define	TEST_SMALL	(1024)
+#define	TEST_LARGE	(PIPE_PRODUCER_OUTPUT_MAX + 1024)
+
+static CallbackRunner runner;
+
+class Tester {
+	LogHandle log_;
+	TestGroup group_;
+	PipeProducerWrapper<Tester> *producer_;
+	Pipe *pipe_;
+	Action *input_action_;
+	Action *output_action_;
+	unsigned inputs_;
+	size_t output_length_;
+public:
+	Tester(void)
+	: log_("/tester"),
+	  group_("/test/io/pipe/producer/pause", "PipeProducer input pause"),
+	  producer_(NULL),
+	  pipe_(NULL),
+	  input_action_(NULL),
+	  output_action_(NULL),
+	  inputs_(0),
+	  output_length_(0)
+	{
+		producer_ = new PipeProducerWrapper<Tester>(log_ + "/producer", this, &Tester::consume);
+		pipe_ = producer_;
+
+		producer_->input_pause();
+
+		Buffer buf;
+		buf.append(std::string(TEST_SMALL, 'x'));
+		input_action_ = pipe_->input(&buf, callback(&runner, this, &Tester::input_complete));
+	}
+
+	~Tester()
+	{
+		{
+			Test _(group_, "No pending action");
+			if (input_action_ == NULL && output_action_ == NULL)
+				_.pass();
+		}
+
+		{
+			Test _(group_, "All input completed");
+			if (inputs_ == 2)
+				_.pass();
+		}
+
+		{
+			Test _(group_, "All input produced");
+			if (output_length_ == TEST_SMALL + TEST_LARGE)
+				_.pass();
+		}
+
+		delete producer_;
+		producer_ = NULL;
+	}
+
+	void paused(void)
+	{
+		{
+			Test _(group_, "Input held while paused");
+			if (inputs_ == 0)
+				_.pass();
+		}
+
+		producer_->input_resume();
+	}
+
+	void backed_up(void)
+	{
+		{
+			Test _(group_, "Input held while output backed up");
+			if (inputs_ == 1)
+				_.pass();
+		}
+
+		output_action_ = pipe_->output(callback(&runner, this, &Tester::output_complete));
+	}
+
+private:
+	void consume(Buffer *buf)
+	{
+		producer_->produce(buf);
+	}
+
+	void input_complete(Event e)
+	{
+		input_action_->cancel();
+		input_action_ = NULL;
+
+		{
+			Test _(group_, "Expected event");
+			if (e.type_ == Event::Done)
+				_.pass();
+		}
+
+		switch (++inputs_) {
+		case 1: {
+			/*
+			 * Nobody is taking output, so a large input is held
+			 * until somebody does.
+			 */
+			Buffer buf;
+			buf.append(std::string(TEST_LARGE, 'y'));
+			input_action_ = pipe_->input(&buf, callback(&runner, this, &Tester::input_complete));
+			break;
+		}
+		case 2:
+			{
+				Test _(group_, "Input completed after output taken");
+				if (output_length_ != 0)
+					_.pass();
+			}
+			break;
+		default:
+			NOTREACHED(log_);
+		}
+	}
+
+	void output_complete(Event e)
+	{
+		output_action_->cancel();
+		output_action_ = NULL;
+
+		{
+			Test _(group_, "Expected event");
+			if (e.type_ == Event::Done)
+				_.pass();
+		}
+
+		output_length_ += e.buffer_.length();
+	}
+};
+
+int
+main(void)
+{
+	Tester tester;
+
+	/*
+	 * Run everything that can run at each step, so that what is held is
+	 * held for good until the next.
+	 */
+	runner.run();
+	tester.paused();
+	runner.run();
+	tester.backed_up();
+	runner.run();
+}
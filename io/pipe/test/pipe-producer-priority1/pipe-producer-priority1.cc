@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <common/test.h>
+
+#include <event/callback_runner.h>
+#include <event/event_callback.h>
+
+#include <io/pipe/pipe.h>
+#include <io/pipe/pipe_producer.h>
+#include <io/pipe/pipe_producer_wrapper.h>
+
+static CallbackRunner runner;
+
+class Tester {
+	LogHandle log_;
+	TestGroup group_;
+	PipeProducerWrapper<Tester> *producer_;
+	Action *output_action_;
+	Buffer output_;
+public:
+	Tester(void)
+	: log_("/tester"),
+	  group_("/test/io/pipe/producer/priority", "PipeProducer priority output"),
+	  producer_(NULL),
+	  output_action_(NULL),
+	  output_()
+	{
+		producer_ = new PipeProducerWrapper<Tester>(log_ + "/producer", this, &Tester::consume);
+
+		produce("first", false);
+		produce("PRIORITY1", true);
+		produce("second", false);
+		produce("PRIORITY2", true);
+
+		Pipe *pipe = producer_;
+		output_action_ = pipe->output(callback(&runner, this, &Tester::output_complete));
+	}
+
+	~Tester()
+	{
+		{
+			Test _(group_, "No pending action");
+			if (output_action_ == NULL)
+				_.pass();
+		}
+
+		{
+			Test _(group_, "Priority output taken first, each in order");
+			if (output_.equal("PRIORITY1PRIORITY2firstsecond"))
+				_.pass();
+		}
+
+		delete producer_;
+		producer_ = NULL;
+	}
+
+private:
+	void consume(Buffer *)
+	{
+		NOTREACHED(log_);
+	}
+
+	void produce(const std::string& str, bool priority)
+	{
+		Buffer buf(str);
+		if (priority)
+			producer_->produce_priority(&buf);
+		else
+			producer_->produce(&buf);
+	}
+
+	void output_complete(Event e)
+	{
+		output_action_->cancel();
+		output_action_ = NULL;
+
+		{
+			Test _(group_, "Expected event");
+			if (e.type_ == Event::Done)
+				_.pass();
+		}
+
+		output_.append(e.buffer_);
+	}
+};
+
+int
+main(void)
+{
+	Tester tester;
+
+	runner.run();
+}
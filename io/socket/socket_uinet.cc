@@ -543,19 +543,17 @@ SocketUinet::read_callback(void)
 			 * end of the socket has been closed, otherwise a
 			 * zero-length result would be reported with EWOULDBLOCK.
 			 */
-			read_callback_->param(Event(Event::EOS, read_buffer_));
+			read_callback_->param(Event(Event::EOS, std::move(read_buffer_)));
 			read_action_ = read_callback_->schedule();
 			read_callback_ = NULL;
-			read_buffer_.clear();
 			read_amount_remaining_ = 0;
 		} else if (0 == read_amount_remaining_) {
 			/*
 			 * No more reads to do, so pass it all along.
 			 */
-			read_callback_->param(Event(Event::Done, read_buffer_));
+			read_callback_->param(Event(Event::Done, std::move(read_buffer_)));
 			read_action_ = read_callback_->schedule();
 			read_callback_ = NULL;
-			read_buffer_.skip(bytes_read);
 		} else if (0 == uio.uio_resid) {
 			/*
 			 * This individual read was completely fulfilled,
@@ -582,10 +580,9 @@ SocketUinet::read_callback(void)
 		/*
 		 * Deliver the error along with whatever data we have.
 		 */
-		read_callback_->param(Event(Event::Error, uinet_errno_to_os(error), read_buffer_));
+		read_callback_->param(Event(Event::Error, uinet_errno_to_os(error), std::move(read_buffer_)));
 		read_action_ = read_callback_->schedule();
 		read_callback_ = NULL;
-		read_buffer_.clear();
 		read_amount_remaining_ = 0;
 		break;
 	}
@@ -680,6 +677,7 @@ SocketUinet::write(Buffer *buffer, EventCallback *cb)
 	ASSERT(log_, write_action_ == NULL);
 	ASSERT(log_, write_buffer_.empty());
 
+	buffer->share();
 	buffer->moveout(&write_buffer_);
 	write_callback_ = cb;
 
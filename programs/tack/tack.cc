@@ -60,6 +60,7 @@ static void hashes(int, int, unsigned, Timer *);
 static bool fill(int, Buffer *);
 static void flush(int, Buffer *);
 static void print_ratio(const std::string&, uint64_t, uint64_t);
+static void print_cache_stats(const XCodecCacheStatistics&);
 static void process_file(const std::string&, int, int, FileAction, XCodec *, unsigned, Timer *);
 static void process_files(int, char *[], FileAction, XCodec *, unsigned);
 static void time_samples(const std::string&, Timer *);
@@ -80,8 +81,13 @@ public:
 		return (NULL);
 	}
 
-	void enter(const uint64_t&, BufferSegment *)
-	{ }
+	void enter(const uint64_t&, BufferSegment *seg, BufferSegment **keptp)
+	{
+		if (keptp != NULL) {
+			seg->ref();
+			*keptp = seg;
+		}
+	}
 
 	bool out_of_band(void) const
 	{
@@ -131,9 +137,19 @@ public:
 		return (cache_->lookup(hash));
 	}
 
-	void enter(const uint64_t& hash, BufferSegment *seg)
+	void lookup_batch(const uint64_t *hashes, BufferSegment **segs, unsigned n) const
 	{
-		cache_->enter(hash, seg);
+		cache_->lookup_batch(hashes, segs, n);
+	}
+
+	const XCodecCacheStatistics& statistics(void) const
+	{
+		return (cache_->statistics());
+	}
+
+	void enter(const uint64_t& hash, BufferSegment *seg, BufferSegment **keptp)
+	{
+		cache_->enter(hash, seg, keptp);
 		new_data_.append(seg);
 	}
 
@@ -254,6 +270,9 @@ main(int argc, char *argv[])
 
 	process_files(argc, argv, action, &codec, flags);
 
+	if ((flags & TACK_FLAG_BYTE_STATS) != 0)
+		print_cache_stats(cache->statistics());
+
 	delete cache;
 
 	return (0);
@@ -284,6 +303,15 @@ compress(const std::string& name, int ifd, int ofd, XCodec *codec, unsigned flag
 		flush(ofd, &output);
 	}
 	ASSERT("/compress", input.empty());
+
+	if ((flags & TACK_FLAG_CODEC_TIMING) != 0)
+		timer->start();
+	encoder.flush(&output);
+	if ((flags & TACK_FLAG_CODEC_TIMING) != 0)
+		timer->stop();
+	if ((flags & TACK_FLAG_BYTE_STATS) != 0)
+		outbytes += output.length();
+	flush(ofd, &output);
 	ASSERT("/compress", output.empty());
 
 	if ((flags & TACK_FLAG_BYTE_STATS) != 0)
@@ -347,10 +375,13 @@ hashes(int ifd, int ofd, unsigned flags, Timer *timer)
 			const uint8_t *p = seg->data();
 			const uint8_t *q = seg->end();
 			for (;;) {
-				while (o < XCODEC_SEGMENT_LENGTH && p != q) {
-					xcodec_hash.add(*p++);
-					o++;
-				}
+				unsigned n = std::min((size_t)(XCODEC_SEGMENT_LENGTH - o), (size_t)(q - p));
+				if (n == XCODEC_SEGMENT_LENGTH)
+					xcodec_hash.fill(p);
+				else
+					xcodec_hash.add(p, n);
+				p += n;
+				o += n;
 				if (o == XCODEC_SEGMENT_LENGTH) {
 					uint64_t hash = xcodec_hash.mix();
 					xcodec_hash.reset();
@@ -428,6 +459,19 @@ print_ratio(const std::string& name, uint64_t inbytes, uint64_t outbytes)
 	}
 }
 
+static void
+print_cache_stats(const XCodecCacheStatistics& stats)
+{
+	if (stats.lookups_ == 0)
+		return;
+
+	uintmax_t misses = stats.lookups_ - stats.hits_;
+	INFO("/cache_stats") << stats.lookups_ << " lookups, " << stats.hits_ << " hits, " << misses << " misses.";
+	if (misses == 0)
+		return;
+	INFO("/cache_stats") << "filter rejected " << stats.filtered_ << " misses, " << stats.false_positives_ << " false positives (" << (100.0 * stats.false_positives_ / misses) << "% of misses.)";
+}
+
 static void
 process_file(const std::string& name, int ifd, int ofd, FileAction action, XCodec *codec, unsigned flags, Timer *timer)
 {
@@ -70,9 +70,11 @@ ProxySocksConnection::read_complete(Event e)
 		return;
 	}
 
+	BufferReader r(&e.buffer_);
+
 	switch (state_) {
 	case GetSOCKSVersion:
-		switch (e.buffer_.peek()) {
+		switch (r.peek()) {
 		case 0x04:
 			state_ = GetSOCKS4Command;
 			schedule_read(1);
@@ -94,7 +96,7 @@ ProxySocksConnection::read_complete(Event e)
 
 		/* SOCKS4 */
 	case GetSOCKS4Command:
-		if (e.buffer_.peek() != 0x01) {
+		if (r.peek() != 0x01) {
 			schedule_close();
 			break;
 		}
@@ -102,21 +104,21 @@ ProxySocksConnection::read_complete(Event e)
 		schedule_read(2);
 		break;
 	case GetSOCKS4Port:
-		e.buffer_.extract(&network_port_);
+		r.extract(&network_port_);
 		network_port_ = BigEndian::decode(network_port_);
 
 		state_ = GetSOCKS4Address;
 		schedule_read(4);
 		break;
 	case GetSOCKS4Address:
-		e.buffer_.extract(&network_address_);
+		r.extract(&network_address_);
 		network_address_ = BigEndian::decode(network_address_);
 
 		state_ = GetSOCKS4User;
 		schedule_read(1);
 		break;
 	case GetSOCKS4User:
-		if (e.buffer_.peek() == 0x00) {
+		if (r.peek() == 0x00) {
 			schedule_write();
 			break;
 		}
@@ -126,24 +128,19 @@ ProxySocksConnection::read_complete(Event e)
 		/* SOCKS5 */
 	case GetSOCKS5AuthLength:
 		state_ = GetSOCKS5Auth;
-		schedule_read(e.buffer_.peek());
+		schedule_read(r.peek());
 		break;
 	case GetSOCKS5Auth:
-		while (!e.buffer_.empty()) {
-			if (e.buffer_.peek() == 0x00) {
-				schedule_write();
-				break;
-			}
-			e.buffer_.skip(1);
-		}
-		if (e.buffer_.empty()) {
+		size_t off;
+		if (!r.find(0x00, &off)) {
 			schedule_close();
 			break;
 		}
+		schedule_write();
 		break;
 
 	case GetSOCKS5Command:
-		if (e.buffer_.peek() != 0x01) {
+		if (r.peek() != 0x01) {
 			schedule_close();
 			break;
 		}
@@ -151,7 +148,7 @@ ProxySocksConnection::read_complete(Event e)
 		schedule_read(1);
 		break;
 	case GetSOCKS5Reserved:
-		if (e.buffer_.peek() != 0x00) {
+		if (r.peek() != 0x00) {
 			schedule_close();
 			break;
 		}
@@ -159,7 +156,7 @@ ProxySocksConnection::read_complete(Event e)
 		schedule_read(1);
 		break;
 	case GetSOCKS5AddressType:
-		switch (e.buffer_.peek()) {
+		switch (r.peek()) {
 		case 0x01:
 			state_ = GetSOCKS5Address;
 			schedule_read(4);
@@ -175,7 +172,7 @@ ProxySocksConnection::read_complete(Event e)
 		}
 		break;
 	case GetSOCKS5Address:
-		e.buffer_.extract(&network_address_);
+		r.extract(&network_address_);
 		network_address_ = BigEndian::decode(network_address_);
 
 		state_ = GetSOCKS5Port;
@@ -183,18 +180,22 @@ ProxySocksConnection::read_complete(Event e)
 		break;
 	case GetSOCKS5NameLength:
 		state_ = GetSOCKS5Name;
-		schedule_read(e.buffer_.peek());
+		schedule_read(r.peek());
 		break;
 	case GetSOCKS5Name:
-		while (!e.buffer_.empty()) {
-			socks5_remote_name_ += (char)e.buffer_.peek();
-			e.buffer_.skip(1);
+		while (!r.empty()) {
+			const uint8_t *p;
+			size_t len;
+
+			p = r.span(&len);
+			socks5_remote_name_.append((const char *)p, len);
+			r.skip(len);
 		}
 		state_ = GetSOCKS5Port;
 		schedule_read(2);
 		break;
 	case GetSOCKS5Port:
-		e.buffer_.extract(&network_port_);
+		r.extract(&network_port_);
 		network_port_ = BigEndian::decode(network_port_);
 
 		schedule_write();
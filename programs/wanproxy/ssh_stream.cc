@@ -261,7 +261,7 @@ SSHStream::receive_complete(Event e)
 		break;
 	case Event::Error:
 		ERROR(log_) << "Error during receive: " << e;
-		read_callback_->param(e);
+		read_callback_->param(std::move(e));
 		read_action_ = read_callback_->schedule();
 		read_callback_ = NULL;
 		return;
@@ -292,11 +292,11 @@ SSHStream::receive_complete(Event e)
 			Buffer buf;
 			buf.append(&length);
 			e.buffer_.moveout(&buf);
-			e.buffer_ = buf;
+			e.buffer_ = std::move(buf);
 		}
 	}
 
-	read_callback_->param(e);
+	read_callback_->param(std::move(e));
 	read_action_ = read_callback_->schedule();
 	read_callback_ = NULL;
 }
@@ -38,6 +38,7 @@ struct WANProxyCodec {
 	intmax_t *codec_to_outgoing_bytes_;
 	intmax_t *incoming_to_codec_bytes_;
 	intmax_t *codec_to_incoming_bytes_;
+	intmax_t *queued_bytes_max_;
 
 	WANProxyCodec(void)
 	: name_(""),
@@ -47,7 +48,8 @@ struct WANProxyCodec {
 	  outgoing_to_codec_bytes_(NULL),
 	  codec_to_outgoing_bytes_(NULL),
 	  incoming_to_codec_bytes_(NULL),
-	  codec_to_incoming_bytes_(NULL)
+	  codec_to_incoming_bytes_(NULL),
+	  queued_bytes_max_(NULL)
 	{ }
 };
 
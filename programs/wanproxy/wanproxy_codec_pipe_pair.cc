@@ -102,7 +102,7 @@ WANProxyCodecPipePair::WANProxyCodecPipePair(WANProxyCodec *incoming, WANProxyCo
 		}
 
 		if (incoming->codec_ != NULL) {
-			PipePair *pair = new XCodecPipePair("/wanproxy/codec/" + incoming->name_, incoming->codec_, XCodecPipePairTypeServer);
+			PipePair *pair = new XCodecPipePair("/wanproxy/codec/" + incoming->name_, incoming->codec_, XCodecPipePairTypeServer, incoming->queued_bytes_max_);
 			pipe_pairs_.insert(pair);
 
 			incoming_pipe_list.push_back(pair->get_incoming());
@@ -134,7 +134,7 @@ WANProxyCodecPipePair::WANProxyCodecPipePair(WANProxyCodec *incoming, WANProxyCo
 		}
 
 		if (outgoing->codec_ != NULL) {
-			PipePair *pair = new XCodecPipePair("/wanproxy/codec/" + outgoing->name_, outgoing->codec_, XCodecPipePairTypeClient);
+			PipePair *pair = new XCodecPipePair("/wanproxy/codec/" + outgoing->name_, outgoing->codec_, XCodecPipePairTypeClient, outgoing->queued_bytes_max_);
 			pipe_pairs_.insert(pair);
 
 			incoming_pipe_list.push_back(pair->get_incoming());
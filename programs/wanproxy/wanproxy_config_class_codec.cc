@@ -30,6 +30,7 @@
 
 #include <xcodec/xcodec.h>
 #include <xcodec/xcodec_cache.h>
+#include <xcodec/xcodec_disk_cache.h>
 
 #include "wanproxy_config_class_codec.h"
 
@@ -43,18 +44,109 @@ WANProxyConfigClassCodec::Instance::activate(const ConfigObject *co)
 	switch (codec_type_) {
 	case WANProxyConfigCodecXCodec: {
 		/*
-		 * XXX
-		 * Fetch UUID from permanent storage if there is any.
+		 * The cache size is in megabytes, with 0 meaning no limit.
+		 * The same limit applies to the caches of peers' data.
 		 */
-		UUID uuid;
-		uuid.generate();
+		if (cache_size_ < 0) {
+			ERROR("/wanproxy/config/codec") << "Cache size must not be negative.";
+			return (false);
+		}
+
+		bool admission;
+		switch (cache_admission_) {
+		case WANProxyConfigAdmissionNone:
+			admission = false;
+			break;
+		case WANProxyConfigAdmissionFrequency:
+			if (cache_size_ == 0) {
+				ERROR("/wanproxy/config/codec") << "Cache admission set but no cache size.";
+				return (false);
+			}
+			admission = true;
+			break;
+		default:
+			ERROR("/wanproxy/config/codec") << "Invalid cache admission type.";
+			return (false);
+		}
+
+		/*
+		 * Cached data may be kept compressed in memory, so that more
+		 * of it fits in the cache size.
+		 */
+		bool compression;
+		switch (cache_compressor_) {
+		case WANProxyConfigCompressorNone:
+			compression = false;
+			break;
+		case WANProxyConfigCompressorZlib:
+			compression = true;
+			break;
+		default:
+			ERROR("/wanproxy/config/codec") << "Invalid cache compressor type.";
+			return (false);
+		}
+
+		/*
+		 * With a cache path, the cache and its UUID are kept on disk
+		 * there and survive restarts; otherwise both are new.
+		 */
+		XCodecCache *cache;
+		if (cache_path_ != "") {
+			cache = XCodecDiskCache::open(cache_path_, (size_t)cache_size_ << 20, admission, compression);
+			if (cache == NULL) {
+				ERROR("/wanproxy/config/codec") << "Could not open cache in " << cache_path_ << ".";
+				return (false);
+			}
+		} else {
+			UUID uuid;
+			uuid.generate();
+
+			cache = new XCodecMemoryCache(uuid, (size_t)cache_size_ << 20, admission, compression);
+		}
+		if (XCodecCache::lookup(cache->uuid()) != NULL) {
+			ERROR("/wanproxy/config/codec") << "Cache in " << cache_path_ << " is already in use.";
+			delete cache;
+			return (false);
+		}
+		XCodecCache::enter(cache->uuid(), cache);
+		bool chunking;
+		switch (chunking_) {
+		case WANProxyConfigChunkingFixed:
+			chunking = false;
+			break;
+		case WANProxyConfigChunkingContent:
+			chunking = true;
+			break;
+		default:
+			ERROR("/wanproxy/config/codec") << "Invalid chunking type.";
+			return (false);
+		}
+
+		/*
+		 * The lookahead is in kilobytes, with 0 meaning that decoders
+		 * stop at the first data they must ask for.
+		 */
+		size_t lookahead;
+		if (lookahead_ == -1) {
+			lookahead = XCODEC_LOOKAHEAD;
+		} else if (lookahead_ < 0) {
+			ERROR("/wanproxy/config/codec") << "Lookahead must not be negative.";
+			return (false);
+		} else {
+			lookahead = (size_t)lookahead_ << 10;
+		}
 
-		XCodecCache *cache = XCodecCache::lookup(uuid);
-		if (cache == NULL) {
-			cache = new XCodecMemoryCache(uuid);
-			XCodecCache::enter(uuid, cache);
+		/*
+		 * The pause threshold is in kilobytes, with 0 meaning that
+		 * peers are never told to pause.
+		 */
+		if (pause_ < 0) {
+			ERROR("/wanproxy/config/codec") << "Pause threshold must not be negative.";
+			return (false);
 		}
-		XCodec *xcodec = new XCodec(cache);
+		size_t pause = (size_t)pause_ << 10;
+
+		XCodec *xcodec = new XCodec(cache, chunking, lookahead, pause);
 
 		codec_.codec_ = xcodec;
 		break;
@@ -27,8 +27,11 @@
 #define	PROGRAMS_WANPROXY_WANPROXY_CONFIG_CLASS_CODEC_H
 
 #include <config/config_type_int.h>
+#include <config/config_type_string.h>
 
 #include "wanproxy_codec.h"
+#include "wanproxy_config_type_admission.h"
+#include "wanproxy_config_type_chunking.h"
 #include "wanproxy_config_type_codec.h"
 #include "wanproxy_config_type_compressor.h"
 
@@ -37,6 +40,13 @@ public:
 	struct Instance : public ConfigClassInstance {
 		WANProxyCodec codec_;
 		WANProxyConfigCodec codec_type_;
+		WANProxyConfigChunking chunking_;
+		intmax_t cache_size_;
+		WANProxyConfigAdmission cache_admission_;
+		std::string cache_path_;
+		WANProxyConfigCompressor cache_compressor_;
+		intmax_t lookahead_;
+		intmax_t pause_;
 		WANProxyConfigCompressor compressor_;
 		intmax_t compressor_level_;
 
@@ -44,21 +54,31 @@ public:
 		intmax_t codec_to_outgoing_bytes_;
 		intmax_t incoming_to_codec_bytes_;
 		intmax_t codec_to_incoming_bytes_;
+		intmax_t queued_bytes_max_;
 
 		Instance(void)
 		: codec_(),
 		  codec_type_(WANProxyConfigCodecNone),
+		  chunking_(WANProxyConfigChunkingFixed),
+		  cache_size_(0),
+		  cache_admission_(WANProxyConfigAdmissionNone),
+		  cache_path_(""),
+		  cache_compressor_(WANProxyConfigCompressorNone),
+		  lookahead_(-1),
+		  pause_(0),
 		  compressor_(WANProxyConfigCompressorNone),
 		  compressor_level_(0),
 		  outgoing_to_codec_bytes_(0),
 		  codec_to_outgoing_bytes_(0),
 		  incoming_to_codec_bytes_(0),
-		  codec_to_incoming_bytes_(0)
+		  codec_to_incoming_bytes_(0),
+		  queued_bytes_max_(0)
 		{
 			codec_.outgoing_to_codec_bytes_ = &outgoing_to_codec_bytes_;
 			codec_.codec_to_outgoing_bytes_ = &codec_to_outgoing_bytes_;
 			codec_.incoming_to_codec_bytes_ = &incoming_to_codec_bytes_;
 			codec_.codec_to_incoming_bytes_ = &codec_to_incoming_bytes_;
+			codec_.queued_bytes_max_ = &queued_bytes_max_;
 		}
 
 		bool activate(const ConfigObject *);
@@ -68,6 +88,13 @@ public:
 	: ConfigClass("codec", new ConstructorFactory<ConfigClassInstance, Instance>)
 	{
 		add_member("codec", &wanproxy_config_type_codec, &Instance::codec_type_);
+		add_member("chunking", &wanproxy_config_type_chunking, &Instance::chunking_);
+		add_member("cache_size", &config_type_int, &Instance::cache_size_);
+		add_member("cache_admission", &wanproxy_config_type_admission, &Instance::cache_admission_);
+		add_member("cache_path", &config_type_string, &Instance::cache_path_);
+		add_member("cache_compressor", &wanproxy_config_type_compressor, &Instance::cache_compressor_);
+		add_member("lookahead", &config_type_int, &Instance::lookahead_);
+		add_member("pause", &config_type_int, &Instance::pause_);
 		add_member("compressor", &wanproxy_config_type_compressor, &Instance::compressor_);
 		add_member("compressor_level", &config_type_int, &Instance::compressor_level_);
 
@@ -75,6 +102,7 @@ public:
 		add_member("codec_to_outgoing_bytes", &config_type_int, &Instance::codec_to_outgoing_bytes_);
 		add_member("incoming_to_codec_bytes", &config_type_int, &Instance::incoming_to_codec_bytes_);
 		add_member("codec_to_incoming_bytes", &config_type_int, &Instance::codec_to_incoming_bytes_);
+		add_member("queued_bytes_max", &config_type_int, &Instance::queued_bytes_max_);
 	}
 
 	~WANProxyConfigClassCodec()
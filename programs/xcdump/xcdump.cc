@@ -173,6 +173,44 @@ dump(int ifd, int ofd)
 					seg->unref();
 				}
 				continue;
+			case XCODEC_OP_EXTRACT_CHUNK:
+				if (input.length() < sizeof XCODEC_MAGIC + sizeof op + sizeof (uint16_t))
+					break;
+				else {
+					uint16_t len;
+					input.extract(&len, sizeof XCODEC_MAGIC + sizeof op);
+					len = BigEndian::decode(len);
+					if (len == 0 || len > XCODEC_CHUNK_MAX) {
+						ERROR("/dump") << "Invalid chunk length " << len << ".";
+						return;
+					}
+
+					if (input.length() < sizeof XCODEC_MAGIC + sizeof op + sizeof len + len)
+						break;
+					input.skip(sizeof XCODEC_MAGIC + sizeof op + sizeof len);
+
+					BufferSegment *seg;
+					input.copyout(&seg, len);
+					input.skip(len);
+
+					/*
+					 * Chunks are hashed under a key we do not
+					 * know, so their hashes can not be shown.
+					 */
+					bprintf(&output, "<chunk-declare");
+					if (dump_verbosity > 0) {
+						bprintf(&output, " length=\"%u\"", (unsigned)len);
+						if (dump_verbosity > 1) {
+							bprintf(&output, " data=\"");
+							bhexdump(&output, seg->data(), seg->length());
+							bprintf(&output, "\"");
+						}
+					}
+					bprintf(&output, "/>\n");
+
+					seg->unref();
+				}
+				continue;
 			case XCODEC_OP_REF:
 				if (input.length() < sizeof XCODEC_MAGIC + sizeof op + sizeof (uint64_t))
 					break;
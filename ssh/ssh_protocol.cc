@@ -88,16 +88,27 @@ SSH::MPInt::encode(Buffer *out, const BIGNUM *in)
 	if (BN_is_negative(in)) {
 		HALT("/ssh/mpint/encode") << "Negative numbers not yet implemented.";
 	}
-	uint8_t buf[BN_num_bytes(in)];
-	BN_bn2bin(in, buf);
-	if ((buf[0] & 0x80) == 0x80) {
-		SSH::UInt32::encode(out, sizeof buf + 1);
-		out->append((uint8_t)0x00);
-		out->append(buf, sizeof buf);
+	uint32_t len = BN_num_bytes(in);
+	if (len == 0) {
+		SSH::UInt32::encode(out, 0);
+		return;
+	}
+
+	/*
+	 * If the high bit is set, pad with a zero byte so the number is
+	 * not taken to be negative.  Write the number straight into the
+	 * output rather than via a temporary.
+	 */
+	bool pad = BN_num_bits(in) % 8 == 0;
+	BufferWriter w(out, sizeof len + (pad ? 1 : 0) + len);
+	if (pad) {
+		BigEndian::append(&w, len + 1);
+		w.append((uint8_t)0x00);
 	} else {
-		SSH::UInt32::encode(out, sizeof buf);
-		out->append(buf, sizeof buf);
+		BigEndian::append(&w, len);
 	}
+	BN_bn2bin(in, w.tail());
+	w.advance(len);
 }
 
 bool
@@ -133,10 +133,16 @@ SSH::TransportPipe::send(Buffer *payload)
 	padding_len = 4 + (block_size - ((sizeof packet_len + packet_len + 4) % block_size));
 	packet_len += padding_len;
 
-	BigEndian::append(&packet, packet_len);
-	packet.append(padding_len);
+	{
+		BufferWriter w(&packet, sizeof packet_len + sizeof padding_len);
+		BigEndian::append(&w, packet_len);
+		w.append(padding_len);
+	}
 	payload->moveout(&packet);
-	packet.append(zero_padding, padding_len);
+	{
+		BufferWriter w(&packet, padding_len);
+		w.append(zero_padding, padding_len);
+	}
 
 	if (mac_algorithm != NULL) {
 		Buffer mac_input;
@@ -381,25 +387,27 @@ SSH::TransportPipe::receive_do(void)
 				return;
 			}
 		}
-		packet.skip(sizeof packet_len);
 
 		session_->remote_sequence_number_++;
 
-		padding_len = packet.pop();
-		if (padding_len != 0) {
-			if (packet.length() < padding_len) {
-				ERROR(log_) << "Padding too large for packet.";
-				produce_error();
-				return;
-			}
-			packet.trim(padding_len);
+		BufferReader r(&packet);
+		r.skip(sizeof packet_len);
+		r.moveout(&padding_len);
+		if (r.length() < padding_len) {
+			ERROR(log_) << "Padding too large for packet.";
+			produce_error();
+			return;
 		}
-
-		if (packet.empty()) {
+		if (r.length() == padding_len) {
 			ERROR(log_) << "Need to handle empty packet.";
 			produce_error();
 			return;
 		}
+		msg = r.peek();
+
+		packet.skip(r.position());
+		if (padding_len != 0)
+			packet.trim(padding_len);
 
 		/*
 		 * Pass by range to registered handlers for each range.
@@ -424,7 +432,6 @@ SSH::TransportPipe::receive_do(void)
 		 *     A decoding failure should result in a disconnect,
 		 *     an error.
 		 */
-		msg = packet.peek();
 		if (msg >= SSH::Message::TransportRangeBegin &&
 		    msg <= SSH::Message::TransportRangeEnd) {
 			DEBUG(log_) << "Using default handler for transport message.";
@@ -471,7 +478,7 @@ SSH::TransportPipe::receive_do(void)
 			ERROR(log_) << "Message outside of protocol range received.  Passing to default handler, but not expecting much.";
 		}
 
-		receive_callback_->param(Event(Event::Done, packet));
+		receive_callback_->param(Event(Event::Done, std::move(packet)));
 		receive_action_ = receive_callback_->schedule();
 		receive_callback_ = NULL;
 
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <common/buffer.h>
+#include <common/uuid/uuid.h>
+
+#include <xcodec/xcodec.h>
+#include <xcodec/xcodec_cache.h>
+#include <xcodec/xcodec_hash.h>
+#include <xcodec/xcodec_index.h>
+
+/*
+ * Reports the resident memory per segment of a dictionary of 10GB, or of the
+ * number of megabytes given as an argument, held as the memory cache holds
+ * it, packed in an arena, and as it used to be held, with a BufferSegment
+ * and BufferData allocated for each entry.  Each is built in a process of
+ * its own, so that neither sees memory the other has freed.
+ */
+
+/*
+ * Distinct segments without the cost of hashing real data: each begins with
+ * its number, which is also its hash.
+ */
+static BufferSegment *
+segment(uint64_t n)
+{
+	BufferSegment *seg = BufferSegment::create();
+	memset(seg->head(), 0, XCODEC_SEGMENT_LENGTH);
+	memcpy(seg->head(), &n, sizeof n);
+	seg->set_length(XCODEC_SEGMENT_LENGTH);
+	return (seg);
+}
+
+static uintmax_t
+resident(void)
+{
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru) == -1)
+		HALT("/example/xcodec/arena/resident1") << "Could not get resource usage.";
+#if defined(__APPLE__)
+	return (ru.ru_maxrss);
+#else
+	return ((uintmax_t)ru.ru_maxrss * 1024);
+#endif
+}
+
+static void
+build(bool arena, uint64_t segments)
+{
+	uintmax_t before = resident();
+	uint64_t n;
+
+	if (arena) {
+		UUID uuid;
+		uuid.generate();
+
+		XCodecMemoryCache *cache = new XCodecMemoryCache(uuid);
+		for (n = 0; n < segments; n++) {
+			BufferSegment *seg = segment(n);
+			cache->enter(n, seg);
+			seg->unref();
+		}
+	} else {
+		XCodecIndex *index = new XCodecIndex();
+		for (n = 0; n < segments; n++) {
+			BufferSegment *seg = segment(n);
+			index->insert(n, seg);
+			seg->unref();
+		}
+	}
+
+	uintmax_t after = resident();
+	INFO("/example/xcodec/arena/resident1") << (arena ? "arena" : "separate") << ": " << segments << " segments, " << ((after - before) >> 20) << "MB resident, " << (after - before) / segments << " bytes per segment.";
+}
+
+int
+main(int argc, char *argv[])
+{
+	uint64_t megabytes = 10 * 1024;
+	if (argc > 1)
+		megabytes = strtoull(argv[1], NULL, 0);
+	uint64_t segments = (megabytes << 20) / XCODEC_SEGMENT_LENGTH;
+
+	unsigned i;
+	for (i = 0; i < 2; i++) {
+		pid_t pid = fork();
+		if (pid == -1)
+			HALT("/example/xcodec/arena/resident1") << "Could not fork.";
+		if (pid == 0) {
+			build(i == 1, segments);
+			_exit(0);
+		}
+
+		int status;
+		if (waitpid(pid, &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			HALT("/example/xcodec/arena/resident1") << "Child failed.";
+	}
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include <common/buffer.h>
+#include <common/time/time.h>
+#include <common/uuid/uuid.h>
+
+#include <xcodec/xcodec.h>
+#include <xcodec/xcodec_cache.h>
+
+/*
+ * Compares XCodecMemoryCache with and without compression for a cache of
+ * 64MB, or of the number of megabytes given as an argument.  Four times as
+ * much text-like data as fits uncompressed, lines of a web server's log, is
+ * entered into each, and then how much of it is held and how long hits take
+ * is reported, both for hits spread over all that is held and for hits on a
+ * set of data small enough to be kept decompressed.
+ */
+
+#define	LOOKUPS		(1024 * 1024)
+#define	HOT		(XCODEC_CACHE_HOT_MAX / 2)
+
+static const char *methods[] = { "GET", "GET", "GET", "POST", "HEAD" };
+static const char *paths[] = { "/", "/index.html", "/images/logo.png", "/api/v1/items", "/api/v1/users", "/static/app.js", "/static/style.css", "/favicon.ico" };
+static const char *agents[] = { "Mozilla/5.0 (X11; Linux x86_64)", "Mozilla/5.0 (Windows NT 10.0; Win64; x64)", "curl/8.4.0", "Wget/1.21" };
+
+#define	PICK(a)	(a[random() % (sizeof a / sizeof a[0])])
+
+/*
+ * A segment of log lines, different from every other.
+ */
+static BufferSegment *
+segment(uint64_t n)
+{
+	char text[XCODEC_SEGMENT_LENGTH + 256];
+	size_t len = 0;
+
+	while (len < XCODEC_SEGMENT_LENGTH) {
+		len += snprintf(text + len, sizeof text - len, "10.%u.%u.%u - - [17/Oct/2026:%02u:%02u:%02u +0000] \"%s %s?id=%ju HTTP/1.1\" %u %u \"-\" \"%s\"\n", (unsigned)(random() % 4), (unsigned)(random() % 256), (unsigned)(random() % 256), (unsigned)(random() % 24), (unsigned)(random() % 60), (unsigned)(random() % 60), PICK(methods), PICK(paths), (uintmax_t)n, random() % 8 == 0 ? 404 : 200, (unsigned)(random() % 65536), PICK(agents));
+	}
+
+	return (BufferSegment::create((const uint8_t *)text, XCODEC_SEGMENT_LENGTH));
+}
+
+static double
+elapsed(const NanoTime& start)
+{
+	NanoTime now = NanoTime::current_time();
+	now -= start;
+
+	return ((double)now.seconds_ + (double)now.nanoseconds_ / 1e9);
+}
+
+/*
+ * Look up random hashes of those held, from the first n of them.
+ */
+static void
+lookup(XCodecMemoryCache *cache, const std::vector<uint64_t>& held, size_t n, const char *what, const char *how)
+{
+	size_t i;
+
+	NanoTime start = NanoTime::current_time();
+	for (i = 0; i < LOOKUPS; i++) {
+		BufferSegment *seg = cache->lookup(held[random() % n]);
+		if (seg == NULL)
+			HALT("/example/xcodec/cache/compress-speed1") << "Lost entries.";
+		seg->unref();
+	}
+	double seconds = elapsed(start);
+
+	INFO("/example/xcodec/cache/compress-speed1") << what << ": " << how << ": " << (uintmax_t)(1e9 * seconds / LOOKUPS) << "ns each.";
+}
+
+static void
+run(size_t budget, bool compression)
+{
+	const char *what = compression ? "compressed" : "uncompressed";
+	UUID uuid;
+	uuid.generate();
+
+	XCodecMemoryCache cache(uuid, budget, false, compression);
+	uint64_t entries = 4 * budget / XCODEC_SEGMENT_LENGTH;
+	uint64_t n;
+
+	srandom(1);
+
+	NanoTime start = NanoTime::current_time();
+	for (n = 0; n < entries; n++) {
+		BufferSegment *seg = segment(n);
+		cache.enter(n, seg);
+		seg->unref();
+	}
+	double seconds = elapsed(start);
+
+	std::vector<uint64_t> held;
+	for (n = 0; n < entries; n++) {
+		if (cache.contains(n))
+			held.push_back(n);
+	}
+	if (held.size() < HOT)
+		HALT("/example/xcodec/cache/compress-speed1") << "Cache too small.";
+
+	INFO("/example/xcodec/cache/compress-speed1") << what << ": " << held.size() << " of " << entries << " segments held, " << ((held.size() * XCODEC_SEGMENT_LENGTH) >> 20) << "MB of data in " << (budget >> 20) << "MB; " << (uintmax_t)(1e9 * seconds / entries) << "ns per enter, including making the data.";
+
+	lookup(&cache, held, held.size(), what, "hit on any");
+	lookup(&cache, held, HOT, what, "hit on hot set");
+}
+
+int
+main(int argc, char *argv[])
+{
+	size_t budget = 64;
+
+	if (argc > 1)
+		budget = strtoull(argv[1], NULL, 0);
+
+	run(budget << 20, false);
+	run(budget << 20, true);
+}
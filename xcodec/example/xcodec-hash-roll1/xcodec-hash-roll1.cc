@@ -38,6 +38,7 @@ class Sink {
 
 	StreamHandle fd_;
 	XCodecHash hash_;
+	uint8_t window_[XCODEC_SEGMENT_LENGTH];
 	unsigned length_;
 	Action *action_;
 public:
@@ -45,6 +46,7 @@ public:
 	: log_("/sink"),
 	  fd_(fd),
 	  hash_(),
+	  window_(),
 	  length_(0),
 	  action_(NULL)
 	{
@@ -75,20 +77,21 @@ public:
 			BufferSegment *seg;
 			e.buffer_.moveout(&seg);
 
+			/*
+			 * Once the hash is full, length_ only matters modulo
+			 * XCODEC_SEGMENT_LENGTH, as the position in window_ of
+			 * the byte to roll out, so keep it from overflowing.
+			 */
 			const uint8_t *p, *q = seg->end();
-			if (length_ == XCODEC_SEGMENT_LENGTH) {
-				for (p = seg->data(); p < q; p++) {
-					hash_.roll(*p);
-				}
-			} else {
-				for (p = seg->data(); p < q; p++) {
-					if (length_ == XCODEC_SEGMENT_LENGTH) {
-						hash_.roll(*p);
-					} else {
-						hash_.add(*p);
-						length_++;
-					}
-				}
+			for (p = seg->data(); p < q; p++) {
+				unsigned start = length_ & (XCODEC_SEGMENT_LENGTH - 1);
+				if (length_ >= XCODEC_SEGMENT_LENGTH)
+					hash_.roll(*p, window_[start]);
+				else
+					hash_.add(*p);
+				window_[start] = *p;
+				if (++length_ == 2 * XCODEC_SEGMENT_LENGTH)
+					length_ = XCODEC_SEGMENT_LENGTH;
 			}
 			seg->unref();
 		}
@@ -54,7 +54,7 @@ private:
 
 		for (i = 0; i < sizeof zbuf; i += XCODEC_SEGMENT_LENGTH)
 			hash_ += XCodecHash::hash(zbuf + i);
-		zbuf[i] = hash_; /* So the compiler [hopefully] won't optimize out any iterations.  */
+		zbuf[0] = hash_; /* So the compiler [hopefully] won't optimize out any iterations.  */
 
 		bytes_ += sizeof zbuf;
 
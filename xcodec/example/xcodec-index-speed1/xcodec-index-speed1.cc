@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+
+#include <common/buffer.h>
+#include <common/time/time.h>
+
+#include <xcodec/xcodec.h>
+#include <xcodec/xcodec_filter.h>
+#include <xcodec/xcodec_index.h>
+
+/*
+ * Measures XCodecIndex inserts and lookups, one at a time and batched, at 1M
+ * and 50M entries or at the sizes given as arguments.  Every entry refers to
+ * the same BufferSegment, so only the index itself takes up memory.  Hashes
+ * which are looked up and missed are drawn from a separate sequence, so that
+ * lookups mimic an encoder on novel data.  Misses are also run through an
+ * XCodecFilter of the same hashes, as XCodecMemoryCache does.
+ */
+
+#define	LOOKUPS		(4 * 1024 * 1024)
+#define	BATCH		(8)
+
+static uint64_t
+next_hash(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return (z ^ (z >> 31));
+}
+
+static void
+report(size_t entries, const char *what, uintmax_t n, const NanoTime& start)
+{
+	NanoTime now = NanoTime::current_time();
+	now -= start;
+
+	double seconds = (double)now.seconds_ + (double)now.nanoseconds_ / 1e9;
+	INFO("/example/xcodec/index/speed1") << entries << " entries: " << what << ": " << (uintmax_t)(1e9 * seconds / n) << "ns each.";
+}
+
+/*
+ * Look up hashes BATCH at a time, either from random places in the sequence
+ * of inserted hashes or continuing a sequence of hashes not inserted.
+ */
+static uintmax_t
+lookup(const XCodecIndex& index, size_t entries, bool hit, bool batched, uint64_t *missp)
+{
+	uint64_t hashes[BATCH];
+	BufferSegment *segs[BATCH];
+	uintmax_t found = 0;
+	size_t i;
+	unsigned j;
+
+	for (i = 0; i < LOOKUPS; i += BATCH) {
+		for (j = 0; j < BATCH; j++) {
+			if (hit) {
+				uint64_t state = (random() % entries) * 0x9e3779b97f4a7c15ull;
+				hashes[j] = next_hash(&state);
+			} else {
+				hashes[j] = next_hash(missp);
+			}
+		}
+
+		if (batched) {
+			index.find(hashes, segs, BATCH);
+		} else {
+			for (j = 0; j < BATCH; j++)
+				segs[j] = index.find(hashes[j]);
+		}
+
+		for (j = 0; j < BATCH; j++) {
+			if (segs[j] != NULL)
+				found++;
+		}
+	}
+	return (found);
+}
+
+static void
+run(size_t entries, BufferSegment *seg)
+{
+	XCodecIndex index;
+	uint64_t state = 0;
+	size_t i;
+
+	{
+		NanoTime start = NanoTime::current_time();
+		for (i = 0; i < entries; i++)
+			index.insert(next_hash(&state), seg);
+		report(entries, "insert", entries, start);
+	}
+
+	static const struct {
+		const char *what_;
+		bool hit_;
+		bool batched_;
+	} passes[] = {
+		{ "find hit",		true,	false },
+		{ "batched find hit",	true,	true },
+		{ "find miss",		false,	false },
+		{ "batched find miss",	false,	true },
+	};
+
+	uint64_t miss = ~(uint64_t)0 / 3;
+	for (i = 0; i < sizeof passes / sizeof passes[0]; i++) {
+		NanoTime start = NanoTime::current_time();
+		uintmax_t found = lookup(index, entries, passes[i].hit_, passes[i].batched_, &miss);
+		report(entries, passes[i].what_, LOOKUPS, start);
+
+		if (passes[i].hit_ && found != LOOKUPS)
+			HALT("/example/xcodec/index/speed1") << "Lost entries.";
+		if (!passes[i].hit_ && found != 0)
+			INFO("/example/xcodec/index/speed1") << found << " false hits.";
+	}
+
+	XCodecFilter filter;
+	filter.reset(entries);
+	index.enumerate([&filter](uint64_t h) { filter.insert(h); });
+
+	{
+		uintmax_t positives = 0;
+
+		NanoTime start = NanoTime::current_time();
+		for (i = 0; i < LOOKUPS; i++) {
+			if (filter.test(next_hash(&miss)))
+				positives++;
+		}
+		report(entries, "filter miss", LOOKUPS, start);
+
+		INFO("/example/xcodec/index/speed1") << entries << " entries: filter false positives: " << (100.0 * positives / LOOKUPS) << "%.";
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	BufferSegment *seg = BufferSegment::create();
+
+	if (argc > 1) {
+		int i;
+
+		for (i = 1; i < argc; i++)
+			run(strtoull(argv[i], NULL, 0), seg);
+	} else {
+		run(1000 * 1000, seg);
+		run(50 * 1000 * 1000, seg);
+	}
+
+	seg->unref();
+}
@@ -0,0 +1,267 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <common/buffer.h>
+#include <common/time/time.h>
+#include <common/uuid/uuid.h>
+
+#include <xcodec/xcodec.h>
+#include <xcodec/xcodec_cache.h>
+#include <xcodec/xcodec_decoder.h>
+#include <xcodec/xcodec_disk_cache.h>
+#include <xcodec/xcodec_encoder.h>
+
+/*
+ * Encodes and decodes a stream of random data ten times the size of the
+ * caches' memory budget (8MB, or the number of megabytes given as an
+ * argument), and then the same stream again, first with caches in memory
+ * only and then with caches on disk.  With memory alone, the first part of
+ * the stream is long gone by the time it is sent again; with the disk, it is
+ * read back, with the encoder sending what is not yet back as new data and
+ * the decoder waiting for it.  An <ASK> is answered straight from the
+ * encoder's cache.
+ */
+
+#define	CHUNK		(64 * 1024)
+
+struct Pass {
+	uintmax_t in_;
+	uintmax_t out_;
+	uintmax_t asks_;
+	uintmax_t waits_;
+	NanoTime encode_;
+	NanoTime decode_;
+
+	Pass(void)
+	: in_(0),
+	  out_(0),
+	  asks_(0),
+	  waits_(0),
+	  encode_(),
+	  decode_()
+	{ }
+};
+
+static void
+fill(Buffer *buf, uint64_t *state)
+{
+	uint64_t words[CHUNK / sizeof (uint64_t)];
+	unsigned i;
+
+	for (i = 0; i < CHUNK / sizeof (uint64_t); i++) {
+		uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		words[i] = z ^ (z >> 31);
+	}
+	buf->append((const uint8_t *)words, sizeof words);
+}
+
+static void
+elapsed(NanoTime *total, const NanoTime& start)
+{
+	NanoTime now = NanoTime::current_time();
+	now -= start;
+	total->seconds_ += now.seconds_;
+	total->nanoseconds_ += now.nanoseconds_;
+	if (total->nanoseconds_ >= 1000000000) {
+		total->seconds_++;
+		total->nanoseconds_ -= 1000000000;
+	}
+}
+
+/*
+ * Have the decoder's cache learn data from the encoder's.
+ */
+static void
+ask(Pass *pass, XCodecCache *encoder_cache, XCodecCache *decoder_cache, uint64_t hash)
+{
+	BufferSegment *seg = encoder_cache->lookup_wait(hash);
+	if (seg == NULL)
+		HALT("/example/xcodec/tiered/speed1") << "Unknown hash in <ASK>.";
+	BufferSegment *copy = BufferSegment::create(seg->data(), seg->length());
+	decoder_cache->enter(hash, copy);
+	copy->unref();
+	seg->unref();
+	pass->asks_++;
+}
+
+/*
+ * Decode all of in, fetching or asking for what the decoder does not have,
+ * until it has nothing left to wait for.
+ */
+static void
+decode(Pass *pass, XCodecDecoder *decoder, XCodecCache *encoder_cache, XCodecCache *decoder_cache, Buffer *in, Buffer *out)
+{
+	for (;;) {
+		std::set<uint64_t> unknown;
+		if (!decoder->decode(out, in, unknown))
+			HALT("/example/xcodec/tiered/speed1") << "Decoder failed.";
+		if (unknown.empty())
+			break;
+
+		std::set<uint64_t> fetching;
+		std::set<uint64_t>::const_iterator it;
+		for (it = unknown.begin(); it != unknown.end(); ++it) {
+			if (decoder_cache->fetch(*it))
+				fetching.insert(*it);
+			else
+				ask(pass, encoder_cache, decoder_cache, *it);
+		}
+
+		while (!fetching.empty()) {
+			std::set<uint64_t>::iterator fit = fetching.begin();
+			while (fit != fetching.end()) {
+				if (decoder_cache->fetching(*fit)) {
+					++fit;
+					continue;
+				}
+				BufferSegment *seg = decoder_cache->lookup(*fit);
+				if (seg == NULL)
+					ask(pass, encoder_cache, decoder_cache, *fit);
+				else
+					seg->unref();
+				fetching.erase(fit++);
+			}
+			if (!fetching.empty()) {
+				pass->waits_++;
+				usleep(50);
+			}
+		}
+	}
+}
+
+static void
+run(const char *what, unsigned n, XCodecCache *encoder_cache, XCodecCache *decoder_cache, uintmax_t length)
+{
+	XCodecEncoder encoder(encoder_cache);
+	XCodecDecoder decoder(decoder_cache);
+	XCodecCacheStatistics before = encoder_cache->statistics();
+	uint64_t state = 0;
+	Pass pass;
+
+	Buffer expected;
+	while (pass.in_ < length) {
+		Buffer in;
+		fill(&in, &state);
+		pass.in_ += in.length();
+		expected.append(in);
+
+		Buffer encoded;
+		NanoTime encode_start = NanoTime::current_time();
+		encoder.encode(&encoded, &in);
+		if (pass.in_ >= length)
+			encoder.flush(&encoded);
+		elapsed(&pass.encode_, encode_start);
+		pass.out_ += encoded.length();
+
+		/*
+		 * Copy the encoded data, as if it had been sent over the
+		 * network, so that the decoder does not share segments with
+		 * the encoder.
+		 */
+		std::vector<uint8_t> bytes(encoded.length());
+		encoded.moveout(&bytes[0], bytes.size());
+		encoded.append(&bytes[0], bytes.size());
+
+		Buffer out;
+		NanoTime decode_start = NanoTime::current_time();
+		decode(&pass, &decoder, encoder_cache, decoder_cache, &encoded, &out);
+		elapsed(&pass.decode_, decode_start);
+
+		/*
+		 * The encoder holds back the end of its input until it knows
+		 * whether it is part of a reference, so only compare as much
+		 * as has come out.
+		 */
+		Buffer prefix;
+		expected.moveout(&prefix, out.length());
+		if (!prefix.equal(&out))
+			HALT("/example/xcodec/tiered/speed1") << "Decoded data differs.";
+	}
+	if (!expected.empty())
+		HALT("/example/xcodec/tiered/speed1") << "Decoded data short.";
+
+	const XCodecCacheStatistics& after = encoder_cache->statistics();
+	double encode = pass.encode_.seconds_ + pass.encode_.nanoseconds_ / 1e9;
+	double decode = pass.decode_.seconds_ + pass.decode_.nanoseconds_ / 1e9;
+
+	INFO("/example/xcodec/tiered/speed1") << what << " pass " << n << ": " << (100.0 * pass.out_ / pass.in_) << "% of input; encode " << (uintmax_t)(pass.in_ / encode / 1e6) << "MB/s; decode " << (uintmax_t)(pass.in_ / decode / 1e6) << "MB/s.";
+	INFO("/example/xcodec/tiered/speed1") << what << " pass " << n << ": encoder hits " << (after.hits_ - before.hits_) << " of " << (after.lookups_ - before.lookups_) << ", reads " << (after.fetches_ - before.fetches_) << "; decoder waits " << pass.waits_ << ", <ASK>s " << pass.asks_ << ".";
+}
+
+int
+main(int argc, char *argv[])
+{
+	size_t budget = 8;
+	if (argc > 1)
+		budget = strtoull(argv[1], NULL, 0);
+	budget <<= 20;
+
+	uintmax_t length = 10 * budget;
+	unsigned n;
+
+	{
+		UUID uuid;
+		uuid.generate();
+
+		XCodecMemoryCache encoder_cache(uuid, budget);
+		XCodecCache *decoder_cache = encoder_cache.peer(uuid, true);
+		for (n = 1; n <= 2; n++)
+			run("memory", n, &encoder_cache, decoder_cache, length);
+		delete decoder_cache;
+	}
+
+	char tmpl[] = "/tmp/xcodec-tiered-speed1.XXXXXX";
+	if (mkdtemp(tmpl) == NULL)
+		HALT("/example/xcodec/tiered/speed1") << "Could not create directory.";
+	std::string dir(tmpl);
+
+	{
+		XCodecDiskCache *encoder_cache = XCodecDiskCache::open(dir + "/encoder", budget);
+		XCodecDiskCache *decoder_cache = XCodecDiskCache::open(dir + "/decoder", budget);
+		if (encoder_cache == NULL || decoder_cache == NULL)
+			HALT("/example/xcodec/tiered/speed1") << "Could not open caches in " << dir;
+		for (n = 1; n <= 2; n++) {
+			run("tiered", n, encoder_cache, decoder_cache, length);
+
+			/*
+			 * Let everything reach the disk, as it would over the
+			 * time it takes for data to recur on a real link.
+			 */
+			encoder_cache->sync();
+			decoder_cache->sync();
+		}
+		delete decoder_cache;
+		delete encoder_cache;
+	}
+
+	std::string cmd = "rm -rf " + dir;
+	if (system(cmd.c_str()) != 0)
+		HALT("/example/xcodec/tiered/speed1") << "Could not remove " << dir;
+}
@@ -1,7 +1,16 @@
 VPATH+=	${TOPDIR}/xcodec
 
+SRCS+=	xcodec_arena.cc
 SRCS+=	xcodec_cache.cc
 SRCS+=	xcodec_decoder.cc
 SRCS+=	xcodec_encoder.cc
+SRCS+=	xcodec_filter.cc
+SRCS+=	xcodec_hash.cc
+SRCS+=	xcodec_index.cc
+SRCS+=	xcodec_sketch.cc
+
+SRCS_common_thread+=xcodec_disk_cache.cc
 
 SRCS_io_pipe+=xcodec_pipe_pair.cc
+
+LDADD+=	-lz
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <common/buffer.h>
+#include <common/test.h>
+
+#include <xcodec/xcodec.h>
+#include <xcodec/xcodec_arena.h>
+
+/*
+ * A segment of len bytes of n.
+ */
+static BufferSegment *
+segment(unsigned n, size_t len)
+{
+	BufferSegment *seg = BufferSegment::create(len);
+	memset(seg->head(), n, len);
+	seg->set_length(len);
+	return (seg);
+}
+
+int
+main(void)
+{
+	TestGroup g("/test/xcodec/arena1", "XCodecArena #1");
+
+	XCodecArena arena;
+	{
+		BufferSegment *seg = segment(1, XCODEC_SEGMENT_LENGTH);
+		BufferSegment *stored = arena.store(seg);
+		{
+			Test _(g, "Stored data intact.", stored->equal(seg));
+		}
+		{
+			Test _(g, "Stored data held by the arena alone.", stored->exclusive());
+		}
+		{
+			Test _(g, "Segment length room given.", stored->capacity() == XCODEC_SEGMENT_LENGTH);
+		}
+		{
+			Test _(g, "One region mapped.", arena.mapped() == XCODEC_ARENA_REGION_SIZE);
+		}
+
+		/*
+		 * Appending to the stored data while it is in use elsewhere must
+		 * not change it.
+		 */
+		Buffer buf;
+		buf.append(stored);
+		{
+			Test _(g, "Stored data in use.", !stored->exclusive());
+		}
+		buf.append((const uint8_t *)"x", 1);
+		{
+			Test _(g, "Stored data unchanged by writes to a copy.", stored->equal(seg));
+		}
+		buf.clear();
+		{
+			Test _(g, "Stored data no longer in use.", stored->exclusive());
+		}
+
+		arena.release(stored);
+		{
+			Test _(g, "Record released.", arena.count() == 0);
+		}
+
+		BufferSegment *again = arena.store(seg);
+		{
+			Test _(g, "Record reused.", again == stored && again->equal(seg));
+		}
+		arena.release(again);
+		seg->unref();
+	}
+
+	{
+		std::vector<BufferSegment *> stored;
+		unsigned i;
+
+		for (i = 0; i < 4096; i++) {
+			BufferSegment *seg = segment(i, XCODEC_CHUNK_MIN + (i % 7) * 1000);
+			stored.push_back(arena.store(seg));
+			seg->unref();
+		}
+
+		bool ok = true;
+		for (i = 0; i < stored.size(); i++) {
+			BufferSegment *seg = segment(i, XCODEC_CHUNK_MIN + (i % 7) * 1000);
+			if (!stored[i]->equal(seg) || stored[i]->capacity() != XCodecArena::capacity(seg->length()))
+				ok = false;
+			seg->unref();
+		}
+		{
+			Test _(g, "Chunks of many lengths intact.", ok);
+		}
+
+		size_t mapped = arena.mapped();
+		for (i = 0; i < stored.size(); i++)
+			arena.release(stored[i]);
+		for (i = 0; i < stored.size(); i++) {
+			BufferSegment *seg = segment(i, XCODEC_CHUNK_MIN + (i % 7) * 1000);
+			stored[i] = arena.store(seg);
+			seg->unref();
+		}
+		{
+			Test _(g, "Records of each size reused.", arena.mapped() == mapped);
+		}
+		for (i = 0; i < stored.size(); i++)
+			arena.release(stored[i]);
+		{
+			Test _(g, "All records released.", arena.count() == 0);
+		}
+	}
+}
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <common/buffer.h>
+#include <common/test.h>
+#include <common/uuid/uuid.h>
+
+#include <xcodec/xcodec.h>
+#include <xcodec/xcodec_cache.h>
+#include <xcodec/xcodec_decoder.h>
+#include <xcodec/xcodec_encoder.h>
+
+#define	ENTRIES		(8)
+#define	BUDGET		(ENTRIES * BUFFER_SEGMENT_SIZE)
+
+/*
+ * A segment of XCODEC_SEGMENT_LENGTH bytes of n over and over, which
+ * compresses well.
+ */
+static BufferSegment *
+segment(unsigned n)
+{
+	BufferSegment *seg = BufferSegment::create();
+	unsigned i;
+
+	for (i = 0; i < XCODEC_SEGMENT_LENGTH; i += sizeof n)
+		memcpy(seg->head() + i, &n, sizeof n);
+	seg->set_length(XCODEC_SEGMENT_LENGTH);
+	return (seg);
+}
+
+/*
+ * A segment of len random bytes, which does not.
+ */
+static BufferSegment *
+noise(size_t len)
+{
+	BufferSegment *seg = BufferSegment::create(len);
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		seg->head()[i] = random();
+	seg->set_length(len);
+	return (seg);
+}
+
+static void
+enter(XCodecCache *cache, unsigned n)
+{
+	BufferSegment *seg = segment(n);
+	cache->enter(n, seg);
+	seg->unref();
+}
+
+static bool
+present(XCodecCache *cache, unsigned n)
+{
+	BufferSegment *seg = cache->lookup(n);
+	if (seg == NULL)
+		return (false);
+	seg->unref();
+	return (true);
+}
+
+/*
+ * Whether the cache gives back the data of seg for hash.
+ */
+static bool
+intact(XCodecCache *cache, uint64_t hash, BufferSegment *seg)
+{
+	BufferSegment *found = cache->lookup(hash);
+	if (found == NULL)
+		return (false);
+	bool ok = found->equal(seg);
+	found->unref();
+	return (ok);
+}
+
+int
+main(void)
+{
+	TestGroup g("/test/xcodec/cache-compress1", "XCodecMemoryCache compression #1");
+
+	UUID uuid;
+	uuid.generate();
+
+	{
+		XCodecMemoryCache cache(uuid, 0, false, true);
+
+		BufferSegment *seg = segment(1);
+		cache.enter(1, seg);
+		{
+			Test _(g, "Compressible data kept compressed.", cache.size() < XCodecMemoryCache::size_class(XCODEC_SEGMENT_LENGTH));
+		}
+		{
+			Test _(g, "Compressed data intact.", intact(&cache, 1, seg));
+		}
+		seg->unref();
+
+		BufferSegment *first = cache.lookup(1);
+		BufferSegment *second = cache.lookup(1);
+		{
+			Test _(g, "Data decompressed once while hot.", first == second && cache.statistics().decompressions_ == 1);
+		}
+		first->unref();
+		second->unref();
+
+		size_t size = cache.size();
+		seg = noise(XCODEC_SEGMENT_LENGTH);
+		cache.enter(2, seg);
+		{
+			Test _(g, "Incompressible data kept as it is.", cache.size() - size == XCodecMemoryCache::size_class(XCODEC_SEGMENT_LENGTH + 2));
+		}
+		{
+			Test _(g, "Incompressible data intact.", intact(&cache, 2, seg));
+		}
+		seg->unref();
+
+		seg = noise(XCODEC_CHUNK_MAX);
+		cache.enter(3, seg);
+		{
+			Test _(g, "Largest chunk intact.", intact(&cache, 3, seg));
+		}
+		seg->unref();
+
+		XCodecCache *peer = cache.peer(uuid, true);
+		{
+			Test _(g, "Peer cache compressed like ours.", ((XCodecMemoryCache *)peer)->compression());
+		}
+		delete peer;
+	}
+
+	{
+		XCodecMemoryCache cache(uuid, BUDGET, false, true);
+		unsigned i;
+
+		for (i = 1; i <= 4 * ENTRIES; i++)
+			enter(&cache, i);
+		{
+			Test _(g, "Budget holds more compressed data.", cache.statistics().evictions_ == 0);
+		}
+
+		bool ok = true;
+		for (i = 1; i <= 4 * ENTRIES; i++) {
+			BufferSegment *seg = segment(i);
+			if (!intact(&cache, i, seg))
+				ok = false;
+			seg->unref();
+		}
+		{
+			Test _(g, "All of it intact.", ok);
+		}
+	}
+
+	{
+		XCodecMemoryCache cache(uuid, 0, false, true);
+		unsigned i;
+
+		for (i = 1; i <= XCODEC_CACHE_HOT_MAX + 1; i++) {
+			enter(&cache, i);
+			present(&cache, i);
+		}
+		{
+			Test _(g, "Every hit decompressed once.", cache.statistics().decompressions_ == XCODEC_CACHE_HOT_MAX + 1);
+		}
+
+		/*
+		 * Make room for the last, then go around once more so that the
+		 * hand reaches entries which were not looked up since.
+		 */
+		for (i = 1; i <= XCODEC_CACHE_HOT_MAX + 1; i++)
+			present(&cache, i);
+		{
+			Test _(g, "Recently decompressed data kept within limit.", cache.statistics().decompressions_ > XCODEC_CACHE_HOT_MAX + 1);
+		}
+	}
+
+	{
+		XCodecMemoryCache cache(uuid, ENTRIES * XCodecMemoryCache::size_class(1), false, true);
+		unsigned i;
+
+		/*
+		 * It is the decompressed data which is in use.
+		 */
+		enter(&cache, 1);
+		BufferSegment *held = cache.lookup(1);
+		for (i = 2; i <= 2 * ENTRIES; i++)
+			enter(&cache, i);
+		{
+			Test _(g, "Data in use survives.", present(&cache, 1) && cache.statistics().evictions_ != 0);
+		}
+		held->unref();
+
+		for (i = 2 * ENTRIES + 1; i <= 4 * ENTRIES; i++)
+			enter(&cache, i);
+		{
+			Test _(g, "Data no longer in use evicted.", !present(&cache, 1));
+		}
+	}
+
+	{
+		XCodecMemoryCache cache(uuid, ENTRIES * XCodecMemoryCache::size_class(1), false, true);
+		unsigned i;
+
+		/*
+		 * Data kept by whoever entered it is in use as it is, without
+		 * being decompressed.
+		 */
+		BufferSegment *seg = segment(1);
+		BufferSegment *kept;
+		cache.enter(1, seg, &kept);
+		seg->unref();
+
+		BufferSegment *found = cache.lookup(1);
+		{
+			Test _(g, "Data kept on entry not decompressed.", found == kept && cache.statistics().decompressions_ == 0);
+		}
+		found->unref();
+
+		for (i = 2; i <= 2 * ENTRIES; i++)
+			enter(&cache, i);
+		{
+			Test _(g, "Data kept on entry survives.", present(&cache, 1) && cache.statistics().evictions_ != 0);
+		}
+		kept->unref();
+	}
+
+	/*
+	 * Data the decoder must look up in its cache comes back intact.
+	 */
+	{
+		UUID duuid;
+		duuid.generate();
+
+		XCodecMemoryCache cache(uuid, 0, false, true);
+		XCodecMemoryCache dcache(duuid, 0, false, true);
+		XCodecEncoder encoder(&cache);
+		XCodecDecoder decoder(&dcache);
+
+		Buffer data;
+		unsigned i;
+		for (i = 0; i < XCODEC_WINDOW_COUNT + 2; i++) {
+			BufferSegment *seg = segment(i);
+			data.append(seg);
+			seg->unref();
+		}
+
+		std::set<uint64_t> unknown;
+		bool ok = true;
+		for (i = 0; i < 2; i++) {
+			Buffer in(data), out, decoded;
+			encoder.encode(&out, &in);
+			encoder.flush(&out);
+			if (!decoder.decode(&decoded, &out, unknown) || !unknown.empty() || !decoded.equal(&data))
+				ok = false;
+		}
+		{
+			Test _(g, "Encoded data decodes.", ok && dcache.statistics().hits_ != 0);
+		}
+	}
+
+	return (0);
+}
@@ -0,0 +1,333 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <common/buffer.h>
+#include <common/test.h>
+#include <common/uuid/uuid.h>
+
+#include <xcodec/xcodec.h>
+#include <xcodec/xcodec_cache.h>
+#include <xcodec/xcodec_decoder.h>
+#include <xcodec/xcodec_encoder.h>
+#include <xcodec/xcodec_hash.h>
+
+#define	ENTRIES		(8)
+#define	BUDGET		(ENTRIES * BUFFER_SEGMENT_SIZE)
+
+/*
+ * A segment of XCODEC_SEGMENT_LENGTH bytes of n, held only by the caller.
+ */
+static BufferSegment *
+segment(unsigned n)
+{
+	BufferSegment *seg = BufferSegment::create();
+	memset(seg->head(), n, XCODEC_SEGMENT_LENGTH);
+	seg->set_length(XCODEC_SEGMENT_LENGTH);
+	return (seg);
+}
+
+static void
+enter(XCodecCache *cache, unsigned n)
+{
+	BufferSegment *seg = segment(n);
+	cache->enter(n, seg);
+	seg->unref();
+}
+
+static bool
+present(XCodecCache *cache, unsigned n)
+{
+	BufferSegment *seg = cache->lookup(n);
+	if (seg == NULL)
+		return (false);
+	seg->unref();
+	return (true);
+}
+
+/*
+ * Copy encoded data, as if it had been sent over the network, so that the
+ * decoder does not share segments with the encoder.
+ */
+static void
+transmit(Buffer *buf)
+{
+	std::vector<uint8_t> bytes(buf->length());
+	buf->moveout(&bytes[0], bytes.size());
+	buf->append(&bytes[0], bytes.size());
+}
+
+int
+main(void)
+{
+	TestGroup g("/test/xcodec/cache-evict1", "XCodecMemoryCache eviction #1");
+
+	UUID uuid;
+	uuid.generate();
+
+	{
+		XCodecMemoryCache cache(uuid, BUDGET);
+		unsigned i;
+
+		for (i = 1; i <= 2 * ENTRIES; i++)
+			enter(&cache, i);
+		{
+			Test _(g, "Size kept within budget.", cache.size() == BUDGET);
+		}
+		{
+			Test _(g, "Evictions counted.", cache.statistics().evictions_ == ENTRIES);
+		}
+
+		bool ok = true;
+		uint64_t cursor = 0, hash;
+		for (i = 0; i < ENTRIES; i++) {
+			if (!cache.evicted(&cursor, &hash) || present(&cache, hash))
+				ok = false;
+		}
+		{
+			Test _(g, "Evicted hashes reported and gone.", ok && !cache.evicted(&cursor, &hash));
+		}
+
+		uint64_t other = 0;
+		ok = true;
+		for (i = 0; i < ENTRIES; i++) {
+			uint64_t ohash;
+			if (!cache.evicted(&other, &ohash))
+				ok = false;
+		}
+		{
+			Test _(g, "Evictions reported to each cursor.", ok && other == cursor);
+		}
+
+		ok = true;
+		for (i = ENTRIES + 1; i <= 2 * ENTRIES; i++) {
+			if (!present(&cache, i))
+				ok = false;
+		}
+		{
+			Test _(g, "Newest entries kept.", ok);
+		}
+	}
+
+	{
+		XCodecMemoryCache cache(uuid, BUDGET);
+		unsigned i;
+
+		/*
+		 * Once the hand has gone around, look up half of what is left
+		 * and fill the cache again.
+		 */
+		for (i = 1; i <= ENTRIES + 1; i++)
+			enter(&cache, i);
+
+		std::set<unsigned> referenced;
+		for (i = 1; i <= ENTRIES && referenced.size() < ENTRIES / 2; i++) {
+			if (present(&cache, i))
+				referenced.insert(i);
+		}
+
+		for (i = ENTRIES + 2; i <= ENTRIES + ENTRIES / 2; i++)
+			enter(&cache, i);
+
+		bool ok = true;
+		std::set<unsigned>::const_iterator it;
+		for (it = referenced.begin(); it != referenced.end(); ++it) {
+			if (!present(&cache, *it))
+				ok = false;
+		}
+		{
+			Test _(g, "Referenced entries survive.", ok);
+		}
+	}
+
+	{
+		XCodecMemoryCache cache(uuid, BUDGET);
+		unsigned i;
+
+		/*
+		 * The cache keeps its own copy of what is entered, so it is
+		 * what lookups return that is in use.
+		 */
+		enter(&cache, 1);
+		BufferSegment *held = cache.lookup(1);
+		for (i = 2; i <= 2 * ENTRIES; i++)
+			enter(&cache, i);
+		{
+			Test _(g, "Data in use survives.", present(&cache, 1));
+		}
+		held->unref();
+	}
+
+	{
+		XCodecMemoryCache cache(uuid, BUDGET);
+		unsigned i;
+
+		/*
+		 * Whoever enters data can keep the cache's copy in place of its
+		 * own, and is then using it as far as the cache can tell.
+		 */
+		BufferSegment *seg = segment(1);
+		BufferSegment *kept;
+		cache.enter(1, seg, &kept);
+		seg->unref();
+
+		BufferSegment *found = cache.lookup(1);
+		{
+			Test _(g, "Cache's copy kept by whoever entered it.", found == kept);
+		}
+		found->unref();
+
+		for (i = 2; i <= 2 * ENTRIES; i++)
+			enter(&cache, i);
+		{
+			Test _(g, "Data kept on entry survives.", present(&cache, 1));
+		}
+		kept->unref();
+	}
+
+	{
+		XCodecMemoryCache cache(uuid, BUDGET, true);
+		unsigned i, j;
+
+		for (i = 1; i <= ENTRIES; i++)
+			enter(&cache, i);
+		for (j = 0; j < 3; j++) {
+			for (i = 1; i <= ENTRIES; i++)
+				present(&cache, i);
+		}
+
+		{
+			Test _(g, "Admission rejects data seen once.", !cache.admit(100, XCODEC_SEGMENT_LENGTH));
+		}
+		{
+			Test _(g, "Rejections counted.", cache.statistics().rejections_ == 1);
+		}
+
+		bool admitted = false;
+		for (j = 0; j < 8 && !admitted; j++)
+			admitted = cache.admit(100, XCODEC_SEGMENT_LENGTH);
+		{
+			Test _(g, "Admission accepts data seen often.", admitted);
+		}
+	}
+
+	{
+		XCodecMemoryCache cache(uuid);
+		XCodecCache *peer = cache.peer(uuid, true);
+		{
+			Test _(g, "Peer cache unbounded like ours.", peer->budget() == 0);
+		}
+		delete peer;
+
+		XCodecMemoryCache bounded(uuid, BUDGET);
+		peer = bounded.peer(uuid, true);
+		{
+			Test _(g, "Peer cache bounded like ours.", peer->budget() == BUDGET);
+		}
+		delete peer;
+
+		peer = bounded.peer(uuid, false);
+		{
+			Test _(g, "Peer cache unbounded if it may not evict.", peer->budget() == 0);
+		}
+		delete peer;
+	}
+
+	/*
+	 * Data the peer has forgotten is extracted again rather than
+	 * referenced, and a decoder which had evicted it can decode that.
+	 */
+	{
+		UUID duuid;
+		duuid.generate();
+
+		XCodecMemoryCache cache(uuid);
+		XCodecMemoryCache dcache(duuid, XCODEC_SEGMENT_LENGTH);
+		XCodecEncoder encoder(&cache);
+		XCodecDecoder decoder(&dcache);
+
+		uint8_t bytes[XCODEC_SEGMENT_LENGTH];
+		unsigned i;
+		for (i = 0; i < sizeof bytes; i++)
+			bytes[i] = random();
+		Buffer data(bytes, sizeof bytes);
+		uint64_t hash = XCodecHash::hash(bytes);
+
+		Buffer in(data), first;
+		encoder.encode(&first, &in);
+		encoder.flush(&first);
+		transmit(&first);
+
+		std::set<uint64_t> unknown;
+		Buffer decoded;
+		bool ok = decoder.decode(&decoded, &first, unknown) && decoded.equal(&data);
+
+		/*
+		 * Push the data out of the decoder's window with other data,
+		 * and then out of its cache, which won't evict it before.
+		 */
+		for (i = 0; i < XCODEC_WINDOW_COUNT + 2; i++) {
+			Buffer other, out;
+			unsigned j;
+			for (j = 0; j < XCODEC_SEGMENT_LENGTH; j++)
+				other.append((uint8_t)random());
+			encoder.encode(&out, &other);
+			encoder.flush(&out);
+			transmit(&out);
+			decoded.clear();
+			if (!decoder.decode(&decoded, &out, unknown))
+				ok = false;
+		}
+		{
+			Test _(g, "Decoder evicted data.", ok && dcache.lookup(hash) == NULL);
+		}
+
+		uint64_t cursor = 0, evicted;
+		bool found = false;
+		while (dcache.evicted(&cursor, &evicted)) {
+			if (evicted == hash)
+				found = true;
+			encoder.forget(evicted);
+		}
+		{
+			Test _(g, "Eviction reported.", found);
+		}
+
+		Buffer second;
+		in = data;
+		encoder.encode(&second, &in);
+		encoder.flush(&second);
+		transmit(&second);
+		{
+			Test _(g, "Forgotten data is extracted.", second.length() > XCODEC_SEGMENT_LENGTH);
+		}
+
+		decoded.clear();
+		{
+			Test _(g, "Extracted data decodes.", decoder.decode(&decoded, &second, unknown) && unknown.empty() && decoded.equal(&data));
+		}
+	}
+
+	return (0);
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <common/buffer.h>
+#include <common/test.h>
+#include <common/uuid/uuid.h>
+
+#include <xcodec/xcodec.h>
+#include <xcodec/xcodec_cache.h>
+#include <xcodec/xcodec_decoder.h>
+#include <xcodec/xcodec_encoder.h>
+#include <xcodec/xcodec_hash.h>
+
+static void
+segment(Buffer *buf, uint8_t bytes[XCODEC_SEGMENT_LENGTH])
+{
+	unsigned i;
+
+	for (i = 0; i < XCODEC_SEGMENT_LENGTH; i++)
+		bytes[i] = random();
+	buf->append(bytes, XCODEC_SEGMENT_LENGTH);
+}
+
+/*
+ * Encode in with a new encoder, whose window is empty, as for a new stream.
+ */
+static void
+encode(XCodecCache *cache, const Buffer& in, Buffer *out)
+{
+	XCodecEncoder encoder(cache);
+	Buffer tmp(in);
+
+	encoder.encode(out, &tmp);
+	encoder.flush(out);
+
+	/*
+	 * Copy it, so that the decoder shares no segments with the encoder.
+	 */
+	std::vector<uint8_t> bytes(out->length());
+	out->moveout(&bytes[0], bytes.size());
+	out->append(&bytes[0], bytes.size());
+}
+
+/*
+ * Enter data into the decoder's cache as a <LEARN> would.
+ */
+static void
+learn(XCodecCache *cache, std::set<uint64_t>& unknown, const uint8_t bytes[XCODEC_SEGMENT_LENGTH])
+{
+	uint64_t hash = XCodecHash::hash(bytes);
+	BufferSegment *seg = BufferSegment::create(bytes, XCODEC_SEGMENT_LENGTH);
+	cache->enter(hash, seg);
+	seg->unref();
+	unknown.erase(hash);
+}
+
+int
+main(void)
+{
+	TestGroup g("/test/xcodec/decode-lookahead1", "XCodecDecoder lookahead #1");
+
+	UUID uuid;
+	uuid.generate();
+
+	XCodecMemoryCache cache(uuid);
+
+	/*
+	 * Known to the encoder but not the decoder: a, b and c.  In between
+	 * them, data new to both, and a again, as a <BACKREF>.
+	 */
+	uint8_t a[XCODEC_SEGMENT_LENGTH], b[XCODEC_SEGMENT_LENGTH], c[XCODEC_SEGMENT_LENGTH], x[XCODEC_SEGMENT_LENGTH];
+	Buffer known, data;
+	segment(&known, a);
+	segment(&known, b);
+	segment(&known, c);
+	{
+		Buffer declared;
+		encode(&cache, known, &declared);
+	}
+
+	data.append(a, sizeof a);
+	segment(&data, x);
+	data.append(b, sizeof b);
+	segment(&data, x);
+	data.append(a, sizeof a);
+	data.append(c, sizeof c);
+
+	Buffer encoded;
+	encode(&cache, data, &encoded);
+
+	{
+		UUID duuid;
+		duuid.generate();
+
+		XCodecMemoryCache dcache(duuid);
+		XCodecDecoder decoder(&dcache);
+		std::set<uint64_t> unknown;
+		Buffer in(encoded), out;
+
+		bool ok = decoder.decode(&out, &in, unknown);
+		{
+			Test _(g, "Decoder success.", ok);
+		}
+		{
+			Test _(g, "All unknown hashes at once.", unknown.size() == 3);
+		}
+		{
+			Test _(g, "Input decoded past them.", in.empty() && decoder.pending());
+		}
+		{
+			Test _(g, "Output held back.", out.empty());
+		}
+
+		learn(&dcache, unknown, c);
+		learn(&dcache, unknown, b);
+		ok = decoder.decode(&out, &in, unknown);
+		{
+			Test _(g, "Output held back until the first gap is filled.", ok && out.empty() && decoder.pending());
+		}
+
+		/*
+		 * Data which has gone again is asked for again.
+		 */
+		unknown.erase(XCodecHash::hash(a));
+		ok = decoder.decode(&out, &in, unknown);
+		{
+			Test _(g, "Missing data asked for again.", ok && unknown.size() == 1 && out.empty());
+		}
+
+		learn(&dcache, unknown, a);
+		ok = decoder.decode(&out, &in, unknown);
+		{
+			Test _(g, "Output in order once filled.", ok && !decoder.pending() && unknown.empty() && out.equal(&data));
+		}
+	}
+
+	{
+		UUID duuid;
+		duuid.generate();
+
+		XCodecMemoryCache dcache(duuid);
+		XCodecDecoder decoder(&dcache, 0);
+		std::set<uint64_t> unknown;
+		Buffer in(encoded), out;
+
+		bool ok = decoder.decode(&out, &in, unknown);
+		{
+			Test _(g, "Without lookahead, stop at the first gap.", ok && unknown.size() == 1 && !in.empty() && out.empty());
+		}
+
+		learn(&dcache, unknown, a);
+		ok = decoder.decode(&out, &in, unknown);
+		{
+			Test _(g, "Without lookahead, stop at the next gap.", ok && unknown.size() == 1 && !in.empty() && out.length() == 2 * XCODEC_SEGMENT_LENGTH);
+		}
+	}
+
+	{
+		UUID duuid;
+		duuid.generate();
+
+		XCodecMemoryCache dcache(duuid);
+		XCodecDecoder decoder(&dcache, 2 * XCODEC_SEGMENT_LENGTH);
+		std::set<uint64_t> unknown;
+		Buffer in(encoded), out;
+
+		bool ok = decoder.decode(&out, &in, unknown);
+		{
+			Test _(g, "Lookahead limited.", ok && unknown.size() == 1 && !in.empty() && out.empty());
+		}
+
+		learn(&dcache, unknown, a);
+		learn(&dcache, unknown, b);
+		learn(&dcache, unknown, c);
+		ok = decoder.decode(&out, &in, unknown);
+		{
+			Test _(g, "Limited lookahead decodes the rest.", ok && unknown.empty() && in.empty() && out.equal(&data));
+		}
+	}
+
+	return (0);
+}
@@ -0,0 +1,343 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <common/buffer.h>
+#include <common/test.h>
+#include <common/uuid/uuid.h>
+
+#include <event/callback_runner.h>
+#include <event/event_callback.h>
+
+#include <xcodec/xcodec.h>
+#include <xcodec/xcodec_disk_cache.h>
+#include <xcodec/xcodec_hash.h>
+
+#define	ENTRIES		(4096)
+
+static uint64_t hashes[ENTRIES];
+
+static CallbackRunner runner;
+
+/*
+ * Waits to be called back by a cache once it has read something.
+ */
+class FetchWaiter {
+	Action *action_;
+	bool fetched_;
+public:
+	FetchWaiter(void)
+	: action_(NULL),
+	  fetched_(false)
+	{ }
+
+	~FetchWaiter()
+	{
+		ASSERT("/fetch/waiter", action_ == NULL);
+	}
+
+	bool wait(XCodecCache *cache)
+	{
+		unsigned n;
+
+		action_ = cache->fetched(callback(&runner, this, &FetchWaiter::fetch_complete));
+		for (n = 0; n < 1000 && runner.run() == 0; n++)
+			usleep(1000);
+		if (action_ != NULL) {
+			action_->cancel();
+			action_ = NULL;
+		}
+		return (fetched_);
+	}
+
+private:
+	void fetch_complete(void)
+	{
+		action_->cancel();
+		action_ = NULL;
+
+		fetched_ = true;
+	}
+};
+
+/*
+ * A segment of XCODEC_SEGMENT_LENGTH bytes derived from n.
+ */
+static BufferSegment *
+segment(unsigned n)
+{
+	BufferSegment *seg = BufferSegment::create();
+	uint8_t *p = seg->head();
+	unsigned i;
+
+	for (i = 0; i < XCODEC_SEGMENT_LENGTH; i++)
+		p[i] = (n * 2654435761u + i * 40503u) >> 13;
+	seg->set_length(XCODEC_SEGMENT_LENGTH);
+	return (seg);
+}
+
+static void
+enter(XCodecCache *cache, unsigned first, unsigned last)
+{
+	unsigned i;
+
+	for (i = first; i < last; i++) {
+		BufferSegment *seg = segment(i);
+		hashes[i] = cache->hash(seg->data(), seg->length());
+		cache->enter(hashes[i], seg);
+		seg->unref();
+	}
+}
+
+static unsigned
+present(XCodecCache *cache, unsigned first, unsigned last)
+{
+	unsigned i, n;
+
+	n = 0;
+	for (i = first; i < last; i++) {
+		BufferSegment *seg = cache->lookup(hashes[i]);
+		if (seg == NULL)
+			continue;
+		BufferSegment *expected = segment(i);
+		if (seg->equal(expected))
+			n++;
+		expected->unref();
+		seg->unref();
+	}
+	return (n);
+}
+
+/*
+ * Wait for the cache to read back what it is reading, and for it to read any
+ * of the rest which looking it up has it read.
+ */
+static void
+settle(XCodecCache *cache, unsigned first, unsigned last)
+{
+	unsigned i, n;
+
+	for (i = first; i < last; i++) {
+		for (n = 0; n < 1000 && cache->fetching(hashes[i]); n++)
+			usleep(1000);
+
+		BufferSegment *seg = cache->lookup(hashes[i]);
+		if (seg != NULL) {
+			seg->unref();
+			continue;
+		}
+		for (n = 0; n < 1000 && cache->fetching(hashes[i]); n++)
+			usleep(1000);
+	}
+}
+
+static off_t
+file_size(const std::string& name)
+{
+	struct stat st;
+
+	if (stat(name.c_str(), &st) == -1)
+		return (-1);
+	return (st.st_size);
+}
+
+/*
+ * Write len bytes of junk at offset, as if a write had been interrupted.
+ */
+static void
+scribble(const std::string& name, off_t offset, size_t len)
+{
+	std::vector<uint8_t> junk(len, 0x5a);
+
+	int fd = open(name.c_str(), O_WRONLY);
+	if (fd == -1)
+		return;
+	if (pwrite(fd, &junk[0], junk.size(), offset) != (ssize_t)junk.size())
+		HALT("/test/xcodec/disk-cache1") << "Short write to " << name;
+	close(fd);
+}
+
+int
+main(void)
+{
+	TestGroup g("/test/xcodec/disk-cache1", "XCodecDiskCache #1");
+
+	char tmpl[] = "/tmp/xcodec-disk-cache1.XXXXXX";
+	if (mkdtemp(tmpl) == NULL)
+		HALT("/test/xcodec/disk-cache1") << "Could not create directory.";
+	std::string dir(tmpl);
+	std::string log_name = dir + "/local.log";
+	std::string index_name = dir + "/local.index";
+
+	Buffer uuid1, uuid2;
+
+	{
+		XCodecDiskCache *cache = XCodecDiskCache::open(dir);
+		{
+			Test _(g, "Created cache.", cache != NULL);
+		}
+		enter(cache, 0, ENTRIES / 2);
+		cache->sync();
+		cache->uuid_encode(&uuid1);
+		delete cache;
+	}
+
+	{
+		XCodecDiskCache *cache = XCodecDiskCache::open(dir);
+		cache->uuid_encode(&uuid2);
+		{
+			Test _(g, "UUID survives reopening.", uuid1.equal(&uuid2));
+		}
+		settle(cache, 0, ENTRIES / 2);
+		{
+			Test _(g, "Data survives reopening.", present(cache, 0, ENTRIES / 2) == ENTRIES / 2);
+		}
+		enter(cache, ENTRIES / 2, ENTRIES);
+		delete cache;
+	}
+
+	off_t log_size = file_size(log_name);
+	{
+		XCodecDiskCache *cache = XCodecDiskCache::open(dir);
+		settle(cache, 0, ENTRIES);
+		{
+			Test _(g, "Unsynced data written on close.", present(cache, 0, ENTRIES) == ENTRIES);
+		}
+
+		/*
+		 * Entering data already in the log does not add it again.
+		 */
+		XCodecDiskCache *small = XCodecDiskCache::open(dir + "/small");
+		enter(small, 0, 16);
+		small->sync();
+		delete small;
+
+		small = XCodecDiskCache::open(dir + "/small", 8 * BUFFER_SEGMENT_SIZE);
+		{
+			FetchWaiter waiter;
+			Test _(g, "Called back once data is read.", waiter.wait(small) && !small->fetching(hashes[15]));
+		}
+		{
+			unsigned i, n;
+
+			for (i = 8; i < 16; i++)
+				for (n = 0; n < 1000 && small->fetching(hashes[i]); n++)
+					usleep(1000);
+			Test _(g, "Newest data loaded within budget.", present(small, 8, 16) == 8 && present(small, 0, 1) == 0);
+		}
+		{
+			unsigned i;
+
+			for (i = 0; i < 1000 && small->fetching(hashes[0]); i++)
+				usleep(1000);
+			Test _(g, "Data beyond budget fetched from the log.", small->fetch(hashes[0]) && !small->fetching(hashes[0]) && present(small, 0, 1) == 1);
+		}
+		{
+			BufferSegment *seg = small->lookup_wait(hashes[1]);
+			BufferSegment *expected = segment(1);
+			Test _(g, "Data beyond budget read from the log.", seg != NULL && seg->equal(expected));
+			expected->unref();
+			if (seg != NULL)
+				seg->unref();
+		}
+		{
+			uint64_t cursor = 0, hash;
+			Test _(g, "Data in the log is never evicted.", !small->evicted(&cursor, &hash));
+		}
+		{
+			Test _(g, "Data not held not fetched.", !small->fetch(0) && small->lookup_wait(0) == NULL);
+		}
+		off_t small_size = file_size(dir + "/small/local.log");
+		enter(small, 0, 8);
+		small->sync();
+		{
+			Test _(g, "Data in the log not written again.", file_size(dir + "/small/local.log") == small_size);
+		}
+		delete small;
+		delete cache;
+	}
+
+	{
+		scribble(log_name, log_size, 100);
+		XCodecDiskCache *cache = XCodecDiskCache::open(dir);
+		{
+			Test _(g, "Torn record cut from log.", file_size(log_name) == log_size);
+		}
+		settle(cache, 0, ENTRIES);
+		{
+			Test _(g, "Data survives torn record.", present(cache, 0, ENTRIES) == ENTRIES);
+		}
+		delete cache;
+	}
+
+	{
+		scribble(index_name, 0, 1024);
+		XCodecDiskCache *cache = XCodecDiskCache::open(dir);
+		settle(cache, 0, ENTRIES);
+		{
+			Test _(g, "Data survives damaged index.", present(cache, 0, ENTRIES) == ENTRIES);
+		}
+		delete cache;
+	}
+
+	{
+		scribble(log_name, XCODEC_SEGMENT_LENGTH, 1);
+		XCodecDiskCache *cache = XCodecDiskCache::open(dir);
+		settle(cache, 0, ENTRIES);
+		{
+			Test _(g, "Corrupt segment not loaded.", present(cache, 0, ENTRIES) == ENTRIES - 1);
+		}
+		delete cache;
+	}
+
+	{
+		XCodecDiskCache *cache = XCodecDiskCache::open(dir);
+		UUID uuid;
+		uuid.generate();
+
+		XCodecCache *peer = cache->peer(uuid, true);
+		enter(peer, 0, 16);
+		delete peer;
+
+		peer = cache->peer(uuid, true);
+		settle(peer, 0, 16);
+		{
+			Test _(g, "Peer cache persists.", present(peer, 0, 16) == 16);
+		}
+		{
+			Test _(g, "Peer cache named for peer.", file_size(dir + "/" + uuid.string_ + ".log") > 0);
+		}
+		delete peer;
+		delete cache;
+	}
+
+	std::string cmd = "rm -rf " + dir;
+	if (system(cmd.c_str()) != 0)
+		HALT("/test/xcodec/disk-cache1") << "Could not remove " << dir;
+}
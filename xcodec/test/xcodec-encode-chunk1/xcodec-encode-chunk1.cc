@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <common/buffer.h>
+#include <common/test.h>
+#include <common/uuid/uuid.h>
+
+#include <xcodec/xcodec.h>
+#include <xcodec/xcodec_cache.h>
+#include <xcodec/xcodec_decoder.h>
+#include <xcodec/xcodec_encoder.h>
+
+#define	DATA_LENGTH	(256 * 1024)
+#define	SHIFT_LENGTH	37
+
+/*
+ * Encode input with chunking, split into pieces of the given length.
+ */
+static void
+encode(Buffer *out, XCodecEncoder *encoder, const Buffer& input, size_t piece)
+{
+	Buffer in(input);
+	while (!in.empty()) {
+		Buffer tmp;
+		in.moveout(&tmp, std::min(piece, in.length()));
+		encoder->encode(out, &tmp);
+	}
+	encoder->flush(out);
+}
+
+static bool
+decode(Buffer *out, XCodecDecoder *decoder, Buffer *input)
+{
+	std::set<uint64_t> unknown_hashes;
+	if (!decoder->decode(out, input, unknown_hashes))
+		return (false);
+	return (input->empty() && unknown_hashes.empty());
+}
+
+int
+main(void)
+{
+	TestGroup g("/test/xcodec/encode-chunk1", "XCodecEncoder chunking #1");
+
+	Buffer data;
+	while (data.length() < DATA_LENGTH) {
+		uint8_t ch = random();
+		data.append(ch);
+		if (random() % 64 == 0)
+			data.append(XCODEC_MAGIC);
+	}
+
+	Buffer shifted;
+	while (shifted.length() < SHIFT_LENGTH)
+		shifted.append((uint8_t)random());
+	shifted.append(data);
+
+	UUID uuid;
+	uuid.generate();
+	XCodecCache *cache = new XCodecMemoryCache(uuid);
+
+	UUID duuid;
+	duuid.generate();
+	XCodecCache *dcache = new XCodecMemoryCache(duuid);
+
+	XCodecEncoder encoder(cache);
+	XCodecDecoder decoder(dcache);
+
+	Buffer first;
+	encoder.set_chunking(&first);
+	{
+		Test _(g, "Nothing to flush on switch.", first.empty());
+	}
+	{
+		Test _(g, "Chunking set.", encoder.chunking());
+	}
+
+	encode(&first, &encoder, data, data.length());
+	{
+		Test _(g, "Novel data is not expanded much.", first.length() < data.length() + data.length() / 32);
+	}
+
+	Buffer second;
+	encode(&second, &encoder, shifted, shifted.length());
+	{
+		Test _(g, "Shifted data is referenced.", second.length() < shifted.length() / 16);
+	}
+
+	{
+		Buffer decoded;
+		Test _(g, "Decode declarations.", decode(&decoded, &decoder, &first) && decoded.equal(&data));
+	}
+	{
+		Buffer decoded;
+		Test _(g, "Decode references.", decode(&decoded, &decoder, &second) && decoded.equal(&shifted));
+	}
+
+	delete cache;
+	delete dcache;
+
+	/*
+	 * Chunk boundaries don't depend on how input is split.
+	 */
+	Buffer whole;
+	{
+		uuid.generate();
+		cache = new XCodecMemoryCache(uuid);
+		XCodecEncoder e(cache);
+		e.set_chunking(&whole);
+		encode(&whole, &e, data, data.length());
+		delete cache;
+	}
+
+	static const size_t pieces[] = { 1, 7, XCODEC_CHUNK_MIN, XCODEC_CHUNK_MAX + 1, 65536 };
+	unsigned i;
+	for (i = 0; i < sizeof pieces / sizeof pieces[0]; i++) {
+		uuid.generate();
+		cache = new XCodecMemoryCache(uuid);
+		XCodecEncoder e(cache);
+
+		Buffer split;
+		e.set_chunking(&split);
+		encode(&split, &e, data, pieces[i]);
+
+		Test _(g, "Arbitrary splits match whole.", split.equal(&whole));
+
+		delete cache;
+	}
+
+	/*
+	 * Switching with input held flushes it first.
+	 */
+	{
+		uuid.generate();
+		cache = new XCodecMemoryCache(uuid);
+		duuid.generate();
+		dcache = new XCodecMemoryCache(duuid);
+
+		XCodecEncoder e(cache);
+		XCodecDecoder d(dcache);
+
+		Buffer in(data), out;
+		Buffer head;
+		in.moveout(&head, DATA_LENGTH / 2 + 1);
+		e.encode(&out, &head);
+		{
+			Test _(g, "Input held before switch.", e.pending());
+		}
+		e.set_chunking(&out);
+		{
+			Test _(g, "Nothing held after switch.", !e.pending());
+		}
+		e.encode(&out, &in);
+		e.flush(&out);
+
+		Buffer decoded;
+		Test _(g, "Decode across switch.", decode(&decoded, &d, &out) && decoded.equal(&data));
+
+		delete cache;
+		delete dcache;
+	}
+
+	return (0);
+}
@@ -61,6 +61,7 @@ main(void)
 
 			Buffer out;
 			encoder.encode(&out, &in);
+			encoder.flush(&out);
 
 			{
 				Test _(g, "Empty input buffer after encode.", in.empty());
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <common/buffer.h>
+#include <common/test.h>
+#include <common/uuid/uuid.h>
+
+#include <xcodec/xcodec.h>
+#include <xcodec/xcodec_cache.h>
+#include <xcodec/xcodec_decoder.h>
+#include <xcodec/xcodec_encoder.h>
+
+#define	BLOCK_LENGTH	2048
+#define	READ_LENGTH	65536
+
+/*
+ * Encode input split into pieces of the given length, flushing only at the
+ * end.
+ */
+static void
+encode(Buffer *out, const Buffer& input, size_t piece)
+{
+	UUID uuid;
+	uuid.generate();
+
+	XCodecCache *cache = new XCodecMemoryCache(uuid);
+	XCodecEncoder encoder(cache);
+
+	Buffer in(input);
+	while (!in.empty()) {
+		Buffer tmp;
+		in.moveout(&tmp, std::min(piece, in.length()));
+		encoder.encode(out, &tmp);
+	}
+	encoder.flush(out);
+
+	delete cache;
+}
+
+int
+main(void)
+{
+	TestGroup g("/test/xcodec/encode-stream1", "XCodecEncoder streaming #1");
+
+	uint8_t block[BLOCK_LENGTH];
+	unsigned i;
+
+	for (i = 0; i < sizeof block; i++)
+		block[i] = random();
+
+	/*
+	 * Two reads of random data, with the same block repeated straddling
+	 * the boundary between them.
+	 */
+	Buffer input;
+	while (input.length() < READ_LENGTH - BLOCK_LENGTH / 2) {
+		uint8_t ch = random();
+		input.append(ch);
+		if (input.length() == READ_LENGTH / 4)
+			input.append(block, sizeof block);
+	}
+	input.append(block, sizeof block);
+	while (input.length() < 2 * READ_LENGTH)
+		input.append((uint8_t)random());
+
+	Buffer whole;
+	encode(&whole, input, input.length());
+
+	{
+		Buffer split;
+		encode(&split, input, READ_LENGTH);
+
+		Test _(g, "Split at read boundary matches whole.", split.equal(&whole));
+	}
+
+	{
+		Test _(g, "Repeated block is referenced.", whole.length() < input.length() - BLOCK_LENGTH / 2);
+	}
+
+	static const size_t pieces[] = { 1, 7, XCODEC_SEGMENT_LENGTH - 1, XCODEC_SEGMENT_LENGTH, 1000 };
+	for (i = 0; i < sizeof pieces / sizeof pieces[0]; i++) {
+		Buffer split;
+		encode(&split, input, pieces[i]);
+
+		Test _(g, "Arbitrary splits match whole.", split.equal(&whole));
+	}
+
+	{
+		UUID uuid;
+		uuid.generate();
+
+		XCodecCache *cache = new XCodecMemoryCache(uuid);
+		XCodecEncoder encoder(cache);
+
+		Buffer in(input), out;
+		encoder.encode(&out, &in);
+		{
+			Test _(g, "Input consumed by encode.", in.empty());
+		}
+		{
+			Test _(g, "Tail held until flush.", encoder.pending());
+		}
+		encoder.flush(&out);
+		{
+			Test _(g, "Nothing held after flush.", !encoder.pending());
+		}
+
+		XCodecDecoder decoder(cache);
+		std::set<uint64_t> unknown_hashes;
+		Buffer decoded;
+		{
+			Test _(g, "Decoder success.", decoder.decode(&decoded, &out, unknown_hashes));
+		}
+		{
+			Test _(g, "Expected data.", decoded.equal(&input));
+		}
+
+		delete cache;
+	}
+
+	/*
+	 * A block held by one encoder may be declared by another sharing its
+	 * cache before the first gets to declare it.
+	 */
+	{
+		UUID uuid;
+		uuid.generate();
+
+		XCodecCache *cache = new XCodecMemoryCache(uuid);
+		XCodecEncoder a(cache), b(cache);
+
+		Buffer a_input(block, sizeof block), a_out;
+		{
+			Buffer in(a_input);
+			a.encode(&a_out, &in);
+		}
+		{
+			Test _(g, "Block held by first encoder.", a.pending());
+		}
+
+		Buffer b_input(input), b_out;
+		b.encode(&b_out, &b_input);
+		b.flush(&b_out);
+
+		Buffer more;
+		while (more.length() < READ_LENGTH)
+			more.append((uint8_t)random());
+		a_input.append(more);
+		a.encode(&a_out, &more);
+		a.flush(&a_out);
+
+		XCodecDecoder decoder(cache);
+		std::set<uint64_t> unknown_hashes;
+		Buffer decoded;
+		{
+			Test _(g, "Decoder success after shared declaration.", decoder.decode(&decoded, &a_out, unknown_hashes));
+		}
+		{
+			Test _(g, "Expected data after shared declaration.", decoded.equal(&a_input));
+		}
+
+		delete cache;
+	}
+
+	return (0);
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <common/buffer.h>
+#include <common/test.h>
+
+#include <xcodec/xcodec.h>
+#include <xcodec/xcodec_cache.h>
+
+#define	ENTRIES		(100000)
+
+static uint64_t
+next_hash(uint64_t *state)
+{
+	uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return (z ^ (z >> 31));
+}
+
+int
+main(void)
+{
+	TestGroup g("/test/xcodec/filter1", "XCodecFilter #1");
+
+	{
+		XCodecFilter filter;
+		uint64_t state;
+		unsigned i;
+
+		filter.reset(ENTRIES);
+
+		state = 0;
+		for (i = 0; i < ENTRIES; i++)
+			filter.insert(next_hash(&state));
+
+		bool ok = true;
+		state = 0;
+		for (i = 0; i < ENTRIES; i++) {
+			if (!filter.test(next_hash(&state)))
+				ok = false;
+		}
+		{
+			Test _(g, "No false negatives.", ok);
+		}
+
+		unsigned positives = 0;
+		for (i = 0; i < ENTRIES; i++) {
+			if (filter.test(next_hash(&state)))
+				positives++;
+		}
+		{
+			Test _(g, "False positives under 5%.", positives < ENTRIES / 20);
+		}
+
+		filter.reset(ENTRIES);
+		state = 0;
+		positives = 0;
+		for (i = 0; i < ENTRIES; i++) {
+			if (filter.test(next_hash(&state)))
+				positives++;
+		}
+		{
+			Test _(g, "Reset empties the filter.", positives == 0);
+		}
+	}
+
+	{
+		UUID uuid;
+		uuid.generate();
+
+		XCodecMemoryCache cache(uuid);
+		BufferSegment *seg = BufferSegment::create((const uint8_t *)"x", 1);
+		uint64_t state;
+		unsigned i;
+
+		/*
+		 * Enough entries that the cache's filter is rebuilt several
+		 * times.
+		 */
+		state = 0;
+		for (i = 0; i < ENTRIES; i++)
+			cache.enter(next_hash(&state), seg);
+
+		bool ok = true;
+		state = 0;
+		for (i = 0; i < ENTRIES; i++) {
+			BufferSegment *found = cache.lookup(next_hash(&state));
+			if (found == NULL || !found->equal(seg))
+				ok = false;
+			if (found != NULL)
+				found->unref();
+		}
+		{
+			Test _(g, "Entries found after filter rebuilds.", ok);
+		}
+
+		uint64_t hashes[8];
+		BufferSegment *segs[8];
+		for (i = 0; i < 8; i++)
+			hashes[i] = next_hash(&state);
+		cache.lookup_batch(hashes, segs, 8);
+		ok = true;
+		for (i = 0; i < 8; i++) {
+			if (segs[i] != NULL)
+				ok = false;
+		}
+		{
+			Test _(g, "Batched misses.", ok);
+		}
+
+		const XCodecCacheStatistics& stats = cache.statistics();
+		{
+			Test _(g, "Lookups counted.", stats.lookups_ == ENTRIES + 8 && stats.hits_ == ENTRIES);
+		}
+		{
+			Test _(g, "Misses counted.", stats.filtered_ + stats.false_positives_ == 8);
+		}
+
+		seg->unref();
+	}
+
+	return (0);
+}
@@ -290,6 +290,50 @@ static uint64_t char_kats[] = {
 	0x8200400020040000ull
 };
 
+/*
+ * Pseudo-random data known-answer tests, for windows every 256 bytes into
+ * data generated by random_data().
+ */
+static uint64_t random_kats[] = {
+	0xfbc364b07bfdd867ull,
+	0xfeca7360b903c51aull,
+	0xfe556890f5ff297full,
+	0xfe43b440d204ca0eull,
+	0xfe3f8c40be9596a6ull,
+	0xfedee0408b0b6318ull,
+	0xfe9e60e097aec4b7ull,
+	0xfee44090842fcf0dull,
+	0xfc9895603112c13eull,
+};
+
+/*
+ * Chunks of n bytes 0, 1, ... n - 1 under the key 0, 1, ... 15, which are the
+ * SipHash-2-4 reference vectors.
+ */
+static struct {
+	unsigned length_;
+	uint64_t hash_;
+} chunk_kats[] = {
+	{ 1,	0x74f839c593dc67fdull },
+	{ 8,	0x93f5f5799a932462ull },
+	{ 15,	0xa129ca6149be45e5ull },
+	{ 63,	0x958a324ceb064572ull },
+};
+
+static uint8_t random_data[XCODEC_SEGMENT_LENGTH * 2];
+
+static void
+random_data_init(void)
+{
+	uint32_t x = 1;
+	unsigned i;
+
+	for (i = 0; i < sizeof random_data; i++) {
+		x = x * 1103515245 + 12345;
+		random_data[i] = x >> 16;
+	}
+}
+
 int
 main(void)
 {
@@ -310,5 +354,84 @@ main(void)
 		}
 	}
 
+	random_data_init();
+
+	{
+		TestGroup g("/test/xcodec/hash1/random_kat", "XCodecHash #1 / Pseudo-random KATs");
+
+		unsigned i;
+		for (i = 0; i < sizeof random_kats / sizeof random_kats[0]; i++) {
+			const uint8_t *data = random_data + i * 256;
+
+			XCodecHash hash;
+			unsigned j;
+			for (j = 0; j < XCODEC_SEGMENT_LENGTH; j++)
+				hash.add(data[j]);
+
+			std::ostringstream os;
+			os << "KAT #" << i;
+
+			{
+				Test _(g, os.str() + " byte at a time", random_kats[i] == hash.mix());
+			}
+			{
+				Test _(g, os.str() + " in bulk", random_kats[i] == XCodecHash::hash(data));
+			}
+		}
+	}
+
+	{
+		TestGroup g("/test/xcodec/hash1/roll", "XCodecHash #1 / Rolling matches fresh hash");
+
+		XCodecHash hash;
+		unsigned i;
+
+		/*
+		 * Fill in uneven pieces to exercise bulk and single adds.
+		 */
+		hash.add(random_data, 7);
+		for (i = 7; i < 40; i++)
+			hash.add(random_data[i]);
+		hash.add(random_data + i, XCODEC_SEGMENT_LENGTH - i);
+
+		bool ok = true;
+		for (i = XCODEC_SEGMENT_LENGTH; i < sizeof random_data; i++) {
+			if (hash.mix() != XCodecHash::hash(random_data + i - XCODEC_SEGMENT_LENGTH))
+				ok = false;
+			hash.roll(random_data[i], random_data[i - XCODEC_SEGMENT_LENGTH]);
+		}
+		{
+			Test _(g, "Every window", ok);
+		}
+		{
+			Test _(g, "Final window", hash.mix() == random_kats[8]);
+		}
+	}
+
+	{
+		TestGroup g("/test/xcodec/hash1/chunk_kat", "XCodecHash #1 / Keyed chunk KATs");
+
+		XCodecHashKey key(0x0706050403020100ull, 0x0f0e0d0c0b0a0908ull);
+		uint8_t data[64];
+		unsigned i;
+
+		for (i = 0; i < sizeof data; i++)
+			data[i] = i;
+
+		for (i = 0; i < sizeof chunk_kats / sizeof chunk_kats[0]; i++) {
+			std::ostringstream os;
+			os << "KAT #" << i;
+
+			Test _(g, os.str(), chunk_kats[i].hash_ == XCodecHash::hash(data, chunk_kats[i].length_, key));
+		}
+
+		{
+			Test _(g, "Segments are not keyed", XCodecHash::hash(random_data, XCODEC_SEGMENT_LENGTH, key) == random_kats[0]);
+		}
+		{
+			Test _(g, "Keys differ by UUID", XCodecHash::hash(data, 15, XCodecHashKey("a")) != XCodecHash::hash(data, 15, XCodecHashKey("b")));
+		}
+	}
+
 	return (0);
 }
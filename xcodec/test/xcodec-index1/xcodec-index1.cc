@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <set>
+
+#include <common/buffer.h>
+#include <common/test.h>
+
+#include <xcodec/xcodec.h>
+#include <xcodec/xcodec_index.h>
+
+#define	ENTRIES		(100000)
+
+int
+main(void)
+{
+	TestGroup g("/test/xcodec/index1", "XCodecIndex #1");
+
+	BufferSegment *segs[2];
+	segs[0] = BufferSegment::create();
+	segs[1] = BufferSegment::create();
+
+	{
+		XCodecIndex index;
+		unsigned i;
+
+		/*
+		 * Hashes which differ only in their low bits, and in their
+		 * high bits, as well as 0.
+		 */
+		for (i = 0; i < ENTRIES; i++)
+			index.insert((uint64_t)i, segs[i % 2]);
+		for (i = 1; i < ENTRIES; i++)
+			index.insert((uint64_t)i << 40, segs[i % 2]);
+
+		{
+			Test _(g, "Count.", index.count() == 2 * ENTRIES - 1);
+		}
+		{
+			Test _(g, "References held.", !segs[0]->exclusive() && !segs[1]->exclusive());
+		}
+
+		bool ok = true;
+		for (i = 0; i < ENTRIES; i++) {
+			if (index.find((uint64_t)i) != segs[i % 2])
+				ok = false;
+			if (i != 0 && index.find((uint64_t)i << 40) != segs[i % 2])
+				ok = false;
+		}
+		{
+			Test _(g, "Entries found after growing.", ok);
+		}
+
+		ok = true;
+		for (i = 0; i < ENTRIES; i++) {
+			if (index.find(((uint64_t)i << 20) | 0x80000) != NULL)
+				ok = false;
+		}
+		{
+			Test _(g, "Other hashes not found.", ok);
+		}
+
+		uint64_t hashes[4] = { 7, (uint64_t)7 << 40, ENTRIES, (uint64_t)ENTRIES << 40 };
+		BufferSegment *found[4];
+		index.find(hashes, found, 4);
+		{
+			Test _(g, "Batched find.", found[0] == segs[1] && found[1] == segs[1] && found[2] == NULL && found[3] == NULL);
+		}
+	}
+
+	{
+		Test _(g, "References dropped.", segs[0]->exclusive() && segs[1]->exclusive());
+	}
+
+	/*
+	 * Erase entries at random, including by the clock, with hashes which
+	 * crowd into a few lines, and check against a std::set.
+	 */
+	{
+		XCodecIndex index;
+		std::set<uint64_t> model;
+		bool ok = true;
+		unsigned i;
+
+		for (i = 0; i < ENTRIES; i++) {
+			uint64_t hash = random() % (ENTRIES / 4);
+			hash <<= 44;
+
+			if (model.find(hash) == model.end()) {
+				index.insert(hash, segs[0]);
+				model.insert(hash);
+			} else if (random() % 2 == 0) {
+				index.erase(hash);
+				model.erase(hash);
+			}
+
+			if (i % 16 == 0) {
+				uint64_t victim;
+				BufferSegment *seg;
+				if (index.clock(&victim, &seg)) {
+					if (seg != segs[0] || model.find(victim) == model.end())
+						ok = false;
+					index.erase(victim);
+					model.erase(victim);
+				}
+			}
+		}
+		{
+			Test _(g, "Clock finds entries.", ok);
+		}
+		{
+			Test _(g, "Count after erasing.", index.count() == model.size());
+		}
+
+		ok = true;
+		for (i = 0; i < ENTRIES / 4; i++) {
+			uint64_t hash = (uint64_t)i << 44;
+			bool found = index.find(hash) != NULL;
+			if (found != (model.find(hash) != model.end()))
+				ok = false;
+		}
+		{
+			Test _(g, "Entries found after erasing.", ok);
+		}
+	}
+
+	{
+		Test _(g, "References dropped after erasing.", segs[0]->exclusive());
+	}
+
+	segs[0]->unref();
+	segs[1]->unref();
+
+	return (0);
+}
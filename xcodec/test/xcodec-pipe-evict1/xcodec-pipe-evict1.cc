@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <common/buffer.h>
+#include <common/test.h>
+#include <common/uuid/uuid.h>
+
+#include <event/callback_runner.h>
+#include <event/event_callback.h>
+
+#include <io/pipe/pipe.h>
+#include <io/pipe/pipe_pair.h>
+
+#include <xcodec/xcodec.h>
+#include <xcodec/xcodec_cache.h>
+#include <xcodec/xcodec_decoder.h>
+#include <xcodec/xcodec_encoder.h>
+#include <xcodec/xcodec_pipe_pair.h>
+#include <xcodec/xcodec_window.h>
+
+#define	ENTRIES		(8)
+#define	BUDGET		(ENTRIES * BUFFER_SEGMENT_SIZE)
+
+/*
+ * Enough new segments after a reference for it to leave the encoder's window
+ * and for the cache to have to evict to take them.
+ */
+#define	SEGMENTS	(XCODEC_WINDOW_COUNT + 2 * ENTRIES)
+
+static CallbackRunner runner;
+
+/*
+ * Feeds a Pipe and takes what it has to output, running callbacks until the
+ * Pipe has nothing more to do, so that the two ends of a connection can be
+ * stepped through by hand.
+ */
+class PipeDriver {
+	LogHandle log_;
+	Pipe *pipe_;
+	Action *input_action_;
+	Action *output_action_;
+	Buffer output_;
+	bool eos_;
+	bool error_;
+public:
+	PipeDriver(const LogHandle& log, Pipe *pipe)
+	: log_(log),
+	  pipe_(pipe),
+	  input_action_(NULL),
+	  output_action_(NULL),
+	  output_(),
+	  eos_(false),
+	  error_(false)
+	{ }
+
+	~PipeDriver()
+	{
+		ASSERT(log_, input_action_ == NULL);
+		ASSERT(log_, output_action_ == NULL);
+	}
+
+	bool error(void) const
+	{
+		return (error_);
+	}
+
+	void input(Buffer *buf)
+	{
+		ASSERT(log_, input_action_ == NULL);
+		input_action_ = pipe_->input(buf, callback(&runner, this, &PipeDriver::input_complete));
+		runner.run();
+		ASSERT(log_, input_action_ == NULL);
+	}
+
+	/*
+	 * Take everything the Pipe has to output right now.
+	 */
+	void output(Buffer *buf)
+	{
+		while (!eos_ && !error_) {
+			ASSERT(log_, output_action_ == NULL);
+			output_action_ = pipe_->output(callback(&runner, this, &PipeDriver::output_complete));
+			runner.run();
+			if (output_action_ != NULL) {
+				output_action_->cancel();
+				output_action_ = NULL;
+				break;
+			}
+		}
+		buf->append(output_);
+		output_.clear();
+	}
+
+	/*
+	 * Pass what the Pipe has to output on to another, as a connection would.
+	 */
+	void transmit(PipeDriver *peer)
+	{
+		Buffer buf;
+		output(&buf);
+		if (buf.empty())
+			return;
+
+		/*
+		 * Copy it, so that the peer shares no segments with us.
+		 */
+		std::vector<uint8_t> bytes(buf.length());
+		buf.moveout(&bytes[0], bytes.size());
+		buf.append(&bytes[0], bytes.size());
+		peer->input(&buf);
+	}
+
+private:
+	void input_complete(Event e)
+	{
+		input_action_->cancel();
+		input_action_ = NULL;
+
+		if (e.type_ == Event::Error)
+			error_ = true;
+	}
+
+	void output_complete(Event e)
+	{
+		output_action_->cancel();
+		output_action_ = NULL;
+
+		switch (e.type_) {
+		case Event::Done:
+			output_.append(e.buffer_);
+			break;
+		case Event::EOS:
+			eos_ = true;
+			break;
+		default:
+			error_ = true;
+			break;
+		}
+	}
+};
+
+static uint64_t
+segment(XCodecCache *cache, Buffer *buf)
+{
+	uint8_t bytes[XCODEC_SEGMENT_LENGTH];
+	unsigned i;
+
+	for (i = 0; i < XCODEC_SEGMENT_LENGTH; i++)
+		bytes[i] = random();
+	buf->append(bytes, XCODEC_SEGMENT_LENGTH);
+	return (cache->hash(bytes, XCODEC_SEGMENT_LENGTH));
+}
+
+int
+main(void)
+{
+	TestGroup g("/test/xcodec/pipe-evict1", "XCodecPipePair eviction #1");
+
+	UUID client_uuid, server_uuid;
+	client_uuid.generate();
+	server_uuid.generate();
+
+	XCodecMemoryCache client_cache(client_uuid, BUDGET);
+	XCodecMemoryCache server_cache(server_uuid);
+	XCodec client_codec(&client_cache);
+	XCodec server_codec(&server_cache);
+
+	XCodecPipePair *client = new XCodecPipePair("/client", &client_codec, XCodecPipePairTypeClient);
+	XCodecPipePair *server = new XCodecPipePair("/server", &server_codec, XCodecPipePairTypeServer);
+
+	/*
+	 * The client's encoder and decoder, and the server's decoder and
+	 * encoder, which sends the server's <ASK>s and <ACK>s.
+	 */
+	PipeDriver client_encoder("/client/encoder", client->get_incoming());
+	PipeDriver client_decoder("/client/decoder", client->get_outgoing());
+	PipeDriver server_decoder("/server/decoder", server->get_incoming());
+	PipeDriver server_encoder("/server/encoder", server->get_outgoing());
+
+	/*
+	 * Data the client's cache has from some earlier connection, which the
+	 * server has never seen, followed by enough new data that the client's
+	 * cache evicts everything it can while the server is still to <ASK>
+	 * for the first.
+	 */
+	Buffer known;
+	uint64_t known_hash = segment(&client_cache, &known);
+	BufferSegment *seg;
+	known.copyout(&seg, XCODEC_SEGMENT_LENGTH);
+	client_cache.enter(known_hash, seg);
+	seg->unref();
+
+	Buffer in(known);
+	unsigned i;
+	for (i = 0; i < SEGMENTS; i++)
+		segment(&client_cache, &in);
+
+	Buffer tmp(in), eos;
+	client_encoder.input(&tmp);
+	client_encoder.input(&eos);
+
+	{
+		Test _(g, "Referenced data kept past the budget");
+		if (client_cache.contains(known_hash))
+			_.pass();
+	}
+
+	client_encoder.transmit(&server_decoder);
+	server_encoder.transmit(&client_decoder);
+	client_encoder.transmit(&server_decoder);
+
+	{
+		Test _(g, "<ASK> answered");
+		if (!client_decoder.error() && !client_encoder.error())
+			_.pass();
+	}
+
+	Buffer out;
+	server_decoder.output(&out);
+	{
+		Test _(g, "Data decoded");
+		if (!server_decoder.error() && out.equal(&in))
+			_.pass();
+	}
+
+	/*
+	 * Once the server has said it has decoded everything, nothing is kept
+	 * any more, and the next data to be entered pushes it out.
+	 */
+	server_encoder.transmit(&client_decoder);
+	for (i = 0; i < ENTRIES; i++) {
+		Buffer more;
+		uint64_t hash = segment(&client_cache, &more);
+		more.copyout(&seg, XCODEC_SEGMENT_LENGTH);
+		client_cache.enter(hash, seg);
+		seg->unref();
+	}
+
+	{
+		Test _(g, "Referenced data evicted once acknowledged");
+		if (!client_cache.contains(known_hash))
+			_.pass();
+	}
+
+	delete client;
+	delete server;
+}
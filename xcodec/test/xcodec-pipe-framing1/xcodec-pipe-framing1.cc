@@ -0,0 +1,416 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <common/buffer.h>
+#include <common/endian.h>
+#include <common/test.h>
+#include <common/uuid/uuid.h>
+
+#include <event/callback_runner.h>
+#include <event/event_callback.h>
+
+#include <io/pipe/pipe.h>
+#include <io/pipe/pipe_pair.h>
+
+#include <xcodec/xcodec.h>
+#include <xcodec/xcodec_cache.h>
+#include <xcodec/xcodec_decoder.h>
+#include <xcodec/xcodec_encoder.h>
+#include <xcodec/xcodec_pipe_pair.h>
+
+/*
+ * The pipe ops, as they are on the wire.
+ */
+#define	OP_HELLO	((uint8_t)0xff)
+#define	OP_ASK_N	((uint8_t)0xf6)
+#define	OP_LEARN_N	((uint8_t)0xf5)
+#define	OP_FRAME	((uint8_t)0x00)
+
+#define	HELLO_FLAGS	((uint8_t)0x1e)
+
+#define	BATCH_MAX	(256)
+#define	MAX_FRAME	(32768)
+
+/*
+ * Enough segments that asking for all of them takes more than one batch.
+ */
+#define	SEGMENTS	(BATCH_MAX + BATCH_MAX / 2)
+
+static CallbackRunner runner;
+
+/*
+ * Feeds a Pipe and takes what it has to output, running callbacks until the
+ * Pipe has nothing more to do, so that the two ends of a connection can be
+ * stepped through by hand.
+ */
+class PipeDriver {
+	LogHandle log_;
+	Pipe *pipe_;
+	Action *input_action_;
+	Action *output_action_;
+	Buffer output_;
+	bool eos_;
+	bool error_;
+public:
+	PipeDriver(const LogHandle& log, Pipe *pipe)
+	: log_(log),
+	  pipe_(pipe),
+	  input_action_(NULL),
+	  output_action_(NULL),
+	  output_(),
+	  eos_(false),
+	  error_(false)
+	{ }
+
+	~PipeDriver()
+	{
+		ASSERT(log_, input_action_ == NULL);
+		ASSERT(log_, output_action_ == NULL);
+	}
+
+	bool error(void) const
+	{
+		return (error_);
+	}
+
+	void input(Buffer *buf)
+	{
+		ASSERT(log_, input_action_ == NULL);
+		input_action_ = pipe_->input(buf, callback(&runner, this, &PipeDriver::input_complete));
+		runner.run();
+		ASSERT(log_, input_action_ == NULL);
+	}
+
+	/*
+	 * Take everything the Pipe has to output right now.
+	 */
+	void output(Buffer *buf)
+	{
+		while (!eos_ && !error_) {
+			ASSERT(log_, output_action_ == NULL);
+			output_action_ = pipe_->output(callback(&runner, this, &PipeDriver::output_complete));
+			runner.run();
+			if (output_action_ != NULL) {
+				output_action_->cancel();
+				output_action_ = NULL;
+				break;
+			}
+		}
+		buf->append(output_);
+		output_.clear();
+	}
+
+	/*
+	 * Pass what the Pipe has to output on to another, as a connection would.
+	 * Returns whether there was anything to pass on.
+	 */
+	bool transmit(PipeDriver *peer)
+	{
+		Buffer buf;
+		output(&buf);
+		if (buf.empty())
+			return (false);
+
+		/*
+		 * Copy it, so that the peer shares no segments with us.
+		 */
+		std::vector<uint8_t> bytes(buf.length());
+		buf.moveout(&bytes[0], bytes.size());
+		buf.append(&bytes[0], bytes.size());
+		peer->input(&buf);
+		return (true);
+	}
+
+private:
+	void input_complete(Event e)
+	{
+		input_action_->cancel();
+		input_action_ = NULL;
+
+		if (e.type_ == Event::Error)
+			error_ = true;
+	}
+
+	void output_complete(Event e)
+	{
+		output_action_->cancel();
+		output_action_ = NULL;
+
+		switch (e.type_) {
+		case Event::Done:
+			output_.append(e.buffer_);
+			break;
+		case Event::EOS:
+			eos_ = true;
+			break;
+		default:
+			error_ = true;
+			break;
+		}
+	}
+};
+
+static uint64_t
+segment(XCodecCache *cache, Buffer *buf)
+{
+	uint8_t bytes[XCODEC_SEGMENT_LENGTH];
+	unsigned i;
+
+	for (i = 0; i < XCODEC_SEGMENT_LENGTH; i++)
+		bytes[i] = random();
+	buf->append(bytes, XCODEC_SEGMENT_LENGTH);
+	return (cache->hash(bytes, XCODEC_SEGMENT_LENGTH));
+}
+
+static bool
+present(XCodecCache *cache, uint64_t hash)
+{
+	BufferSegment *seg = cache->lookup(hash);
+	if (seg == NULL)
+		return (false);
+	seg->unref();
+	return (true);
+}
+
+static void
+hello(Buffer *buf, const UUID& uuid)
+{
+	buf->append(OP_HELLO);
+	buf->append((uint8_t)(UUID_SIZE + 1));
+	uuid.encode(buf);
+	buf->append(HELLO_FLAGS);
+}
+
+/*
+ * Whether a server's decoder gives up on ops which follow a <HELLO> from
+ * a client with the given UUID.  The server has said <HELLO> itself, so
+ * that it can be asked for data.
+ */
+static bool
+rejected(XCodec *codec, const UUID& uuid, Buffer *ops)
+{
+	XCodecPipePair *pair = new XCodecPipePair("/rejected", codec, XCodecPipePairTypeServer);
+	bool error;
+
+	{
+		PipeDriver decoder("/rejected/decoder", pair->get_incoming());
+		PipeDriver encoder("/rejected/encoder", pair->get_outgoing());
+
+		Buffer eos, out;
+		encoder.input(&eos);
+		encoder.output(&out);
+
+		Buffer in;
+		hello(&in, uuid);
+		in.append(ops);
+		decoder.input(&in);
+
+		error = decoder.error();
+	}
+
+	delete pair;
+	return (error);
+}
+
+int
+main(void)
+{
+	TestGroup g("/test/xcodec/pipe-framing1", "XCodecPipePair framing #1");
+
+	UUID client_uuid, server_uuid;
+	client_uuid.generate();
+	server_uuid.generate();
+
+	XCodecMemoryCache client_cache(client_uuid);
+	XCodecMemoryCache server_cache(server_uuid);
+	XCodec client_codec(&client_cache);
+	XCodec server_codec(&server_cache);
+
+	{
+		XCodecPipePair *client = new XCodecPipePair("/client", &client_codec, XCodecPipePairTypeClient);
+		XCodecPipePair *server = new XCodecPipePair("/server", &server_codec, XCodecPipePairTypeServer);
+
+		PipeDriver client_encoder("/client/encoder", client->get_incoming());
+		PipeDriver client_decoder("/client/decoder", client->get_outgoing());
+		PipeDriver server_decoder("/server/decoder", server->get_incoming());
+		PipeDriver server_encoder("/server/encoder", server->get_outgoing());
+
+		/*
+		 * Data the client's cache has from some earlier connection,
+		 * which the server has never seen and must ask for in more
+		 * than one <ASK_N>.
+		 */
+		Buffer in;
+		unsigned i;
+		for (i = 0; i < SEGMENTS; i++) {
+			Buffer known;
+			uint64_t hash = segment(&client_cache, &known);
+
+			BufferSegment *seg;
+			known.copyout(&seg, XCODEC_SEGMENT_LENGTH);
+			client_cache.enter(hash, seg);
+			seg->unref();
+
+			in.append(known);
+		}
+
+		Buffer tmp(in), eos;
+		client_encoder.input(&tmp);
+		client_encoder.input(&eos);
+
+		for (i = 0; i < 8; i++) {
+			bool sent = client_encoder.transmit(&server_decoder);
+			if (server_encoder.transmit(&client_decoder))
+				sent = true;
+			if (!sent)
+				break;
+		}
+
+		Buffer out;
+		server_decoder.output(&out);
+		{
+			Test _(g, "Data asked for in batches decoded.", !server_decoder.error() && !client_decoder.error() && out.equal(&in));
+		}
+
+		delete client;
+		delete server;
+	}
+
+	/*
+	 * A <LEARN_N> is only learned once all of it is here.
+	 */
+	{
+		XCodecPipePair *server = new XCodecPipePair("/server", &server_codec, XCodecPipePairTypeServer);
+
+		{
+			PipeDriver server_decoder("/server/decoder", server->get_incoming());
+
+			Buffer hbuf;
+			hello(&hbuf, client_uuid);
+			server_decoder.input(&hbuf);
+
+			XCodecCache *peer_cache = XCodecCache::lookup(client_uuid);
+
+			Buffer first, second;
+			uint64_t first_hash = segment(peer_cache, &first);
+			uint64_t second_hash = segment(peer_cache, &second);
+
+			Buffer learn;
+			learn.append(OP_LEARN_N);
+			BigEndian::append(&learn, (uint16_t)2);
+			BigEndian::append(&learn, (uint16_t)XCODEC_SEGMENT_LENGTH);
+			learn.append(first);
+			BigEndian::append(&learn, (uint16_t)XCODEC_SEGMENT_LENGTH);
+			learn.append(second);
+
+			Buffer part;
+			learn.moveout(&part, learn.length() - XCODEC_SEGMENT_LENGTH / 2);
+			server_decoder.input(&part);
+			{
+				Test _(g, "Truncated <LEARN_N> held.", !server_decoder.error() && !present(peer_cache, first_hash) && !present(peer_cache, second_hash));
+			}
+
+			server_decoder.input(&learn);
+			{
+				Test _(g, "Truncated <LEARN_N> learned once completed.", !server_decoder.error() && present(peer_cache, first_hash) && present(peer_cache, second_hash));
+			}
+		}
+
+		delete server;
+	}
+
+	{
+		Buffer ops;
+		ops.append(OP_HELLO);
+		ops.append((uint8_t)(UUID_SIZE - 1));
+		ops.append(std::string(UUID_SIZE - 1, 'x'));
+
+		XCodecPipePair *pair = new XCodecPipePair("/rejected", &server_codec, XCodecPipePairTypeServer);
+		{
+			PipeDriver decoder("/rejected/decoder", pair->get_incoming());
+			decoder.input(&ops);
+			Test _(g, "Short <HELLO> rejected.", decoder.error());
+		}
+		delete pair;
+	}
+
+	{
+		Buffer ops;
+		ops.append(OP_ASK_N);
+		BigEndian::append(&ops, (uint16_t)0);
+		Test _(g, "Empty <ASK_N> rejected.", rejected(&server_codec, client_uuid, &ops));
+	}
+
+	{
+		Buffer ops;
+		ops.append(OP_ASK_N);
+		BigEndian::append(&ops, (uint16_t)(BATCH_MAX + 1));
+		Test _(g, "Oversized <ASK_N> rejected.", rejected(&server_codec, client_uuid, &ops));
+	}
+
+	{
+		Buffer ops;
+		ops.append(OP_LEARN_N);
+		BigEndian::append(&ops, (uint16_t)0);
+		Test _(g, "Empty <LEARN_N> rejected.", rejected(&server_codec, client_uuid, &ops));
+	}
+
+	{
+		Buffer ops;
+		ops.append(OP_LEARN_N);
+		BigEndian::append(&ops, (uint16_t)(BATCH_MAX + 1));
+		Test _(g, "Oversized <LEARN_N> rejected.", rejected(&server_codec, client_uuid, &ops));
+	}
+
+	{
+		Buffer ops;
+		ops.append(OP_LEARN_N);
+		BigEndian::append(&ops, (uint16_t)1);
+		BigEndian::append(&ops, (uint16_t)0);
+		Test _(g, "Empty <LEARN_N> data rejected.", rejected(&server_codec, client_uuid, &ops));
+	}
+
+	{
+		Buffer ops;
+		ops.append(OP_LEARN_N);
+		BigEndian::append(&ops, (uint16_t)1);
+		BigEndian::append(&ops, (uint16_t)(XCODEC_CHUNK_MAX + 1));
+		Test _(g, "Oversized <LEARN_N> data rejected.", rejected(&server_codec, client_uuid, &ops));
+	}
+
+	{
+		Buffer ops;
+		ops.append(OP_FRAME);
+		BigEndian::append(&ops, (uint16_t)0);
+		Test _(g, "Empty frame rejected.", rejected(&server_codec, client_uuid, &ops));
+	}
+
+	{
+		Buffer ops;
+		ops.append(OP_FRAME);
+		BigEndian::append(&ops, (uint16_t)(MAX_FRAME + 1));
+		Test _(g, "Oversized frame rejected.", rejected(&server_codec, client_uuid, &ops));
+	}
+}
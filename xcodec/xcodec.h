@@ -84,17 +84,51 @@
  */
 #define	XCODEC_OP_BACKREF	((uint8_t)0x03)
 
+/*
+ * Usage:
+ * 	<MAGIC> <OP_EXTRACT_CHUNK> length[uint16_t] data[uint8_t x length]
+ *
+ * Effects:
+ * 	As OP_EXTRACT, for a content-defined chunk of `length' bytes, which
+ * 	may not exceed XCODEC_CHUNK_MAX.
+ *
+ * Side-effects:
+ * 	The data is put into the backref FIFO.
+ */
+#define	XCODEC_OP_EXTRACT_CHUNK	((uint8_t)0x04)
+
 #define	XCODEC_SEGMENT_LENGTH	(2048)
 
+/*
+ * Bounds on and target length of content-defined chunks.  A chunk of exactly
+ * XCODEC_SEGMENT_LENGTH bytes hashes the same as a segment of the same data
+ * and is extracted with OP_EXTRACT.
+ */
+#define	XCODEC_CHUNK_MIN	(1024)
+#define	XCODEC_CHUNK_AVG	(4096)
+#define	XCODEC_CHUNK_MAX	(16384)
+
+/*
+ * How many bytes of decoded data a decoder may hold back by default while it
+ * waits for data it does not have.
+ */
+#define	XCODEC_LOOKAHEAD	(1024 * 1024)
+
 class XCodecCache;
 
 class XCodec {
 	LogHandle log_;
 	XCodecCache *cache_;
+	bool chunking_;
+	size_t lookahead_;
+	size_t pause_;
 public:
-	XCodec(XCodecCache *database)
+	XCodec(XCodecCache *database, bool chunking = false, size_t lookahead = XCODEC_LOOKAHEAD, size_t pause = 0)
 	: log_("/xcodec"),
-	  cache_(database)
+	  cache_(database),
+	  chunking_(chunking),
+	  lookahead_(lookahead),
+	  pause_(pause)
 	{ }
 
 	~XCodec()
@@ -104,6 +138,31 @@ public:
 	{
 		return (cache_);
 	}
+
+	/*
+	 * Whether to use content-defined chunking with peers that will too.
+	 */
+	bool chunking(void) const
+	{
+		return (chunking_);
+	}
+
+	/*
+	 * How much decoded data decoders may hold back, as XCodecDecoder.
+	 */
+	size_t lookahead(void) const
+	{
+		return (lookahead_);
+	}
+
+	/*
+	 * How many bytes of encoded data may be queued up waiting on <ASK>s
+	 * before the peer is told to pause, or 0 to never pause it.
+	 */
+	size_t pause(void) const
+	{
+		return (pause_);
+	}
 };
 
 #endif /* !XCODEC_XCODEC_H */
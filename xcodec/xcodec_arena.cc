@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <string.h>
+
+#include <common/buffer.h>
+
+#include <xcodec/xcodec.h>
+#include <xcodec/xcodec_arena.h>
+
+XCodecArena::XCodecArena(void)
+: regions_(),
+  next_(NULL),
+  avail_(0),
+  count_(0)
+{
+	unsigned i;
+
+	for (i = 0; i < XCODEC_ARENA_CLASSES; i++)
+		free_[i] = NULL;
+}
+
+/*
+ * If records are still in use, their regions must outlive us.
+ */
+XCodecArena::~XCodecArena()
+{
+	if (count_ != 0)
+		return;
+
+	std::vector<uint8_t *>::const_iterator it;
+	for (it = regions_.begin(); it != regions_.end(); ++it)
+		munmap(*it, XCODEC_ARENA_REGION_SIZE);
+}
+
+BufferSegment *
+XCodecArena::store(const uint8_t *buf, size_t len)
+{
+	ASSERT("/xcodec/arena", len <= XCODEC_ARENA_LENGTH_MAX);
+
+	size_t capacity = XCodecArena::capacity(len);
+	unsigned c = size_class(capacity);
+	void *p;
+
+	if (free_[c] != NULL) {
+		p = free_[c];
+		free_[c] = free_[c]->next_;
+	} else {
+		size_t size = BufferSegment::place_size(capacity);
+
+		/*
+		 * The end of a region too short for the record is left unused.
+		 */
+		if (avail_ < size) {
+			int flags = MAP_PRIVATE | MAP_ANON;
+
+			p = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+			p = mmap(NULL, XCODEC_ARENA_REGION_SIZE, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+#endif
+			if (p == MAP_FAILED) {
+#if defined(MAP_ALIGNED_SUPER)
+				flags |= MAP_ALIGNED_SUPER;
+#endif
+				p = mmap(NULL, XCODEC_ARENA_REGION_SIZE, PROT_READ | PROT_WRITE, flags, -1, 0);
+				if (p == MAP_FAILED)
+					HALT("/xcodec/arena") << "Could not map region: " << strerror(errno);
+#if defined(MADV_HUGEPAGE)
+				madvise(p, XCODEC_ARENA_REGION_SIZE, MADV_HUGEPAGE);
+#endif
+			}
+			regions_.push_back((uint8_t *)p);
+			next_ = (uint8_t *)p;
+			avail_ = XCODEC_ARENA_REGION_SIZE;
+		}
+
+		p = next_;
+		next_ += size;
+		avail_ -= size;
+	}
+	count_++;
+
+	return (BufferSegment::place(p, buf, len, capacity));
+}
+
+void
+XCodecArena::release(BufferSegment *seg)
+{
+	unsigned c = size_class(seg->capacity());
+
+	seg->release();
+
+	FreeRecord *fr = (FreeRecord *)(void *)seg;
+	fr->next_ = free_[c];
+	free_[c] = fr;
+	count_--;
+}
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef	XCODEC_XCODEC_ARENA_H
+#define	XCODEC_XCODEC_ARENA_H
+
+#include <vector>
+
+/*
+ * Storage for a cache's segments, packed into large regions rather than each
+ * allocated on its own.  Each record holds a BufferSegment, its BufferData
+ * and the data itself, in that order, so a cached segment costs no separate
+ * allocations and can be handed out by reference, as any other.  Records
+ * are sized to their data rounded up to a quantum; freed records are kept on
+ * a list for each size and reused before a region is extended.
+ *
+ * Regions are backed by superpages where the system allows.  They are only
+ * given back when the arena is destroyed, and then only if every record has
+ * been released.
+ *
+ * A record may hold a little more than a chunk, so that its user may keep a
+ * header with the data.
+ */
+#define	XCODEC_ARENA_REGION_SIZE	(2 * 1024 * 1024)
+#define	XCODEC_ARENA_QUANTUM		(256)
+#define	XCODEC_ARENA_LENGTH_MAX		(XCODEC_CHUNK_MAX + XCODEC_ARENA_QUANTUM)
+#define	XCODEC_ARENA_CLASSES		(XCODEC_ARENA_LENGTH_MAX / XCODEC_ARENA_QUANTUM)
+
+class XCodecArena {
+	struct FreeRecord {
+		FreeRecord *next_;
+	};
+
+	FreeRecord *free_[XCODEC_ARENA_CLASSES];
+	std::vector<uint8_t *> regions_;
+	uint8_t *next_;
+	size_t avail_;
+	size_t count_;
+public:
+	XCodecArena(void);
+	~XCodecArena();
+
+	/*
+	 * Copy a segment's data into the arena, returning a segment of it with
+	 * a single reference, which should be kept until release().
+	 */
+	BufferSegment *store(const BufferSegment *seg)
+	{
+		return (store(seg->data(), seg->length()));
+	}
+
+	BufferSegment *store(const uint8_t *, size_t);
+
+	/*
+	 * Free the record of an exclusive segment from store().
+	 */
+	void release(BufferSegment *);
+
+	size_t count(void) const
+	{
+		return (count_);
+	}
+
+	/*
+	 * How much memory the arena has mapped.
+	 */
+	size_t mapped(void) const
+	{
+		return (regions_.size() * XCODEC_ARENA_REGION_SIZE);
+	}
+
+	/*
+	 * How much room data of a given length is given.
+	 */
+	static size_t capacity(size_t length)
+	{
+		return ((length + XCODEC_ARENA_QUANTUM - 1) & ~(size_t)(XCODEC_ARENA_QUANTUM - 1));
+	}
+
+private:
+	static unsigned size_class(size_t capacity)
+	{
+		return (capacity / XCODEC_ARENA_QUANTUM - 1);
+	}
+};
+
+#endif /* !XCODEC_XCODEC_ARENA_H */
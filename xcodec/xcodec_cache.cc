@@ -29,3 +29,141 @@
 #include <xcodec/xcodec_cache.h>
 
 std::map<UUID, XCodecCache *> XCodecCache::cache_map;
+
+XCodecCache *
+XCodecCache::peer(const UUID& uuid, bool) const
+{
+	return (new XCodecMemoryCache(uuid));
+}
+
+/*
+ * Data is deflated on its own, without a zlib header, and so small a window
+ * and hash table as suffice for a chunk, since the stream is reset for each.
+ */
+#define	XCODEC_CACHE_DEFLATE_BITS	(14)
+#define	XCODEC_CACHE_DEFLATE_MEMORY	(6)
+
+void
+XCodecMemoryCache::compression_start(void)
+{
+	deflate_.zalloc = Z_NULL;
+	deflate_.zfree = Z_NULL;
+	deflate_.opaque = Z_NULL;
+
+	int error = deflateInit2(&deflate_, Z_BEST_SPEED, Z_DEFLATED, -XCODEC_CACHE_DEFLATE_BITS, XCODEC_CACHE_DEFLATE_MEMORY, Z_DEFAULT_STRATEGY);
+	if (error != Z_OK)
+		HALT(log_) << "Could not initialize deflate stream.";
+
+	inflate_.zalloc = Z_NULL;
+	inflate_.zfree = Z_NULL;
+	inflate_.opaque = Z_NULL;
+	inflate_.next_in = Z_NULL;
+	inflate_.avail_in = 0;
+
+	error = inflateInit2(&inflate_, -XCODEC_CACHE_DEFLATE_BITS);
+	if (error != Z_OK)
+		HALT(log_) << "Could not initialize inflate stream.";
+}
+
+void
+XCodecMemoryCache::compression_stop(void)
+{
+	deflateEnd(&deflate_);
+	inflateEnd(&inflate_);
+}
+
+BufferSegment *
+XCodecMemoryCache::pack(const BufferSegment *seg)
+{
+	uint8_t buf[sizeof (uint16_t) + XCODEC_CHUNK_MAX];
+	uint16_t len = seg->length();
+
+	memcpy(buf, &len, sizeof len);
+
+	/*
+	 * Only keep the data compressed if that is smaller.
+	 */
+	deflateReset(&deflate_);
+	deflate_.next_in = (Bytef *)(uintptr_t)seg->data();
+	deflate_.avail_in = len;
+	deflate_.next_out = buf + sizeof len;
+	deflate_.avail_out = len;
+
+	int error = deflate(&deflate_, Z_FINISH);
+	if (error == Z_STREAM_END && deflate_.avail_out != 0)
+		return (arena_.store(buf, sizeof len + len - deflate_.avail_out));
+
+	memcpy(buf + sizeof len, seg->data(), len);
+	return (arena_.store(buf, sizeof len + len));
+}
+
+BufferSegment *
+XCodecMemoryCache::unpack(const uint64_t& hash, BufferSegment *record) const
+{
+	BufferSegment *seg = hot_.find(hash);
+	if (seg != NULL) {
+		seg->ref();
+		return (seg);
+	}
+	statistics_.decompressions_++;
+
+	const uint8_t *p = record->data();
+	uint16_t len;
+	memcpy(&len, p, sizeof len);
+	p += sizeof len;
+
+	seg = BufferSegment::create(len);
+	if (record->length() == sizeof len + len) {
+		memcpy(seg->head(), p, len);
+	} else {
+		inflateReset(&inflate_);
+		inflate_.next_in = (Bytef *)(uintptr_t)p;
+		inflate_.avail_in = record->length() - sizeof len;
+		inflate_.next_out = seg->head();
+		inflate_.avail_out = len;
+
+		int error = inflate(&inflate_, Z_FINISH);
+		if (error != Z_STREAM_END || inflate_.avail_out != 0) {
+			ERROR(log_) << "Could not decompress cached data, dropping it.";
+			seg->unref();
+
+			/*
+			 * lookup() is const, but an entry which can not be
+			 * read back is as good as gone already.
+			 */
+			const_cast<XCodecMemoryCache *>(this)->drop(hash, record);
+			return (NULL);
+		}
+	}
+	seg->set_length(len);
+
+	if (hot_.count() >= XCODEC_CACHE_HOT_MAX)
+		cool();
+	hot_.insert(hash, seg);
+	return (seg);
+}
+
+/*
+ * Data still in use elsewhere is kept, and if all of it is, the set grows
+ * until some is not.
+ */
+void
+XCodecMemoryCache::cool(void) const
+{
+	size_t tries = 0;
+
+	while (hot_.count() >= XCODEC_CACHE_HOT_MAX) {
+		uint64_t hash;
+		BufferSegment *seg;
+		if (!hot_.clock(&hash, &seg))
+			break;
+
+		if (!seg->exclusive()) {
+			if (++tries > hot_.count())
+				break;
+			hot_.skip();
+			continue;
+		}
+		hot_.erase(hash);
+	}
+}
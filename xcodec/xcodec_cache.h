@@ -26,62 +26,181 @@
 #ifndef	XCODEC_XCODEC_CACHE_H
 #define	XCODEC_XCODEC_CACHE_H
 
-#include <ext/hash_map>
+#include <deque>
 #include <map>
 
+#include <zlib.h>
+
 #include <common/uuid/uuid.h>
 
+#include <xcodec/xcodec_arena.h>
+#include <xcodec/xcodec_filter.h>
+#include <xcodec/xcodec_hash.h>
+#include <xcodec/xcodec_index.h>
+#include <xcodec/xcodec_sketch.h>
+
+class Action;
+class SimpleCallback;
+
 /*
- * XXX
- * GCC supports hash<unsigned long> but not hash<unsigned long long>.  On some
- * of our platforms, the former is 64-bits, on some the latter.  As a result,
- * we need this wrapper structure to throw our hashes into so that GCC's hash
- * function can be reliably defined to use them.
+ * Lookups by hash, counted by caches which can.  Of the lookups which miss,
+ * some are rejected by a filter without searching the cache and the rest are
+ * false positives of that filter.  Caches with a memory budget also count
+ * the entries they evict and the new data they decline to admit, and caches
+ * which keep data elsewhere count the reads they start to bring it back.
+ * Caches which keep data compressed count the hits they decompress.
  */
-struct Hash64 {
-	uint64_t hash_;
+struct XCodecCacheStatistics {
+	uintmax_t lookups_;
+	uintmax_t hits_;
+	uintmax_t filtered_;
+	uintmax_t false_positives_;
+	uintmax_t evictions_;
+	uintmax_t rejections_;
+	uintmax_t fetches_;
+	uintmax_t decompressions_;
 
-	Hash64(const uint64_t& hash)
-	: hash_(hash)
+	XCodecCacheStatistics(void)
+	: lookups_(0),
+	  hits_(0),
+	  filtered_(0),
+	  false_positives_(0),
+	  evictions_(0),
+	  rejections_(0),
+	  fetches_(0),
+	  decompressions_(0)
 	{ }
-
-	bool operator== (const Hash64& hash) const
-	{
-		return (hash_ == hash.hash_);
-	}
-
-	bool operator< (const Hash64& hash) const
-	{
-		return (hash_ < hash.hash_);
-	}
 };
 
-namespace __gnu_cxx {
-	template<>
-	struct hash<Hash64> {
-		size_t operator() (const Hash64& x) const
-		{
-			return (x.hash_);
-		}
-	};
-}
-
 class XCodecCache {
 protected:
 	UUID uuid_;
+	XCodecHashKey key_;
+	mutable XCodecCacheStatistics statistics_;
 
 	XCodecCache(const UUID& uuid)
-	: uuid_(uuid)
+	: uuid_(uuid),
+	  key_(uuid.string_),
+	  statistics_()
 	{ }
 
 public:
 	virtual ~XCodecCache()
 	{ }
 
-	virtual void enter(const uint64_t&, BufferSegment *) = 0;
+	/*
+	 * Enter data, of which the cache may keep a copy of its own.  If keptp
+	 * is given, it is set to a reference to the data as the cache keeps
+	 * it, for the caller to hold on to in place of its own, so that the
+	 * data is not held twice and the cache can see it is in use.
+	 */
+	virtual void enter(const uint64_t&, BufferSegment *, BufferSegment ** = NULL) = 0;
 	virtual BufferSegment *lookup(const uint64_t&) const = 0;
 	virtual bool out_of_band(void) const = 0;
 
+	/*
+	 * Look up n hashes at once, which lets a cache overlap the lookups.
+	 */
+	virtual void lookup_batch(const uint64_t *hashes, BufferSegment **segs, unsigned n) const
+	{
+		unsigned i;
+
+		for (i = 0; i < n; i++)
+			segs[i] = lookup(hashes[i]);
+	}
+
+	/*
+	 * A cache may keep data which is not in memory, e.g. on disk, where
+	 * lookup() does not wait for it.  A lookup which misses may start it
+	 * being read back, and fetch() does so explicitly, returning false if
+	 * the cache does not have the data at all; once fetching() is false,
+	 * lookup() finds the data if it could be read.
+	 */
+	virtual bool fetch(const uint64_t&)
+	{
+		return (false);
+	}
+
+	virtual bool fetching(const uint64_t&) const
+	{
+		return (false);
+	}
+
+	/*
+	 * Call back, on the event thread, once more data has been read since
+	 * fetching() was last checked, so that it is worth checking again.
+	 * Only a cache which fetches has anything to call back for.
+	 */
+	virtual Action *fetched(SimpleCallback *)
+	{
+		NOTREACHED("/xcodec/cache");
+	}
+
+	/*
+	 * Look up data, waiting for it to be read if need be.  This blocks, so
+	 * it is only for programs without an event loop to go back to; others
+	 * fetch() and check back when called back by fetched().
+	 */
+	virtual BufferSegment *lookup_wait(const uint64_t& hash)
+	{
+		return (lookup(hash));
+	}
+
+	/*
+	 * Whether data about to be declared is worth keeping.  If not, the
+	 * encoder escapes it rather than declaring it.
+	 */
+	virtual bool admit(const uint64_t&, size_t)
+	{
+		return (true);
+	}
+
+	/*
+	 * Return a hash which has been evicted since *cursor, if there are any,
+	 * and move *cursor past it.  Each user of the cache which needs to know
+	 * keeps a cursor of its own, starting at 0, so that every one of them
+	 * is told of each eviction.  One which falls too far behind misses
+	 * some.
+	 */
+	virtual bool evicted(uint64_t *, uint64_t *)
+	{
+		return (false);
+	}
+
+	/*
+	 * How many bytes of data the cache may hold, or 0 if there is no
+	 * limit.
+	 */
+	virtual size_t budget(void) const
+	{
+		return (0);
+	}
+
+	/*
+	 * Create a cache for the data of a peer, which should have the same
+	 * limits as this one.  Unless evict is set the cache must never lose
+	 * data, since the peer could not be told that it had.
+	 */
+	virtual XCodecCache *peer(const UUID&, bool evict) const;
+
+	virtual const XCodecCacheStatistics& statistics(void) const
+	{
+		return (statistics_);
+	}
+
+	const UUID& uuid(void) const
+	{
+		return (uuid_);
+	}
+
+	/*
+	 * Hash data the way this cache knows it by.
+	 */
+	uint64_t hash(const uint8_t *data, size_t len) const
+	{
+		return (XCodecHash::hash(data, len, key_));
+	}
+
 	bool uuid_encode(Buffer *buf) const
 	{
 		return (uuid_.encode(buf));
@@ -108,33 +227,225 @@ private:
 	static std::map<UUID, XCodecCache *> cache_map;
 };
 
-class XCodecMemoryCache : public XCodecCache {
-	typedef __gnu_cxx::hash_map<Hash64, BufferSegment *> segment_hash_map_t;
+/*
+ * The memory cache keeps its own copy of the data entered into it, packed
+ * into an XCodecArena, and lookups hand out references to that copy, as does
+ * enter() to whoever entered the data.
+ *
+ * With a budget, the memory cache evicts entries to keep the data it holds
+ * within that many bytes, passing over entries which have been looked up
+ * since the last pass in the manner of CLOCK.  Entries whose data is still
+ * in use elsewhere, e.g. referenced by an encoder and still in its backref
+ * window, are not evicted, since a peer may yet <ASK> for them; if all of
+ * them are, the cache goes over budget until some are not.
+ *
+ * With admission as well, new data is only admitted once the cache is full
+ * if it has been seen more often recently than the entry it would evict, so
+ * data which is only seen once does not push out data which is used often.
+ *
+ * The hashes of evicted entries are kept, up to a limit, so that the peer
+ * whose data this is can be told to extract them again over each of its
+ * connections.
+ *
+ * With compression, data is kept deflated, behind a two-byte header giving
+ * its length, or as it is if it does not compress, and the budget counts what
+ * is kept.  A lookup which hits decompresses the data into a segment of its
+ * own, and a small set of those is kept, evicted in the manner of CLOCK, so
+ * that data used often is not decompressed each time.  Data just entered goes
+ * in that set as it is, if whoever entered it keeps it.  It is those segments
+ * which must not be in use elsewhere for an entry to be evicted.
+ */
+#define	XCODEC_CACHE_EVICTED_MAX	(1024)
+#define	XCODEC_CACHE_HOT_MAX		(1024)
 
+class XCodecMemoryCache : public XCodecCache {
 	LogHandle log_;
-	segment_hash_map_t segment_hash_map_;
+	XCodecArena arena_;
+	XCodecIndex index_;
+	XCodecFilter filter_;
+	size_t filter_entries_;
+	size_t budget_;
+	size_t size_;
+	bool admission_;
+	mutable XCodecSketch sketch_;
+	std::deque<uint64_t> evicted_;
+	uint64_t evicted_base_;
+	bool compression_;
+	mutable XCodecIndex hot_;
+	z_stream deflate_;
+	mutable z_stream inflate_;
 public:
-	XCodecMemoryCache(const UUID& uuid)
+	XCodecMemoryCache(const UUID& uuid, size_t budget = 0, bool admission = false, bool compression = false)
 	: XCodecCache(uuid),
 	  log_("/xcodec/cache/memory"),
-	  segment_hash_map_()
-	{ }
+	  arena_(),
+	  index_(),
+	  filter_(),
+	  filter_entries_(0),
+	  budget_(budget),
+	  size_(0),
+	  admission_(admission && budget != 0),
+	  sketch_(),
+	  evicted_(),
+	  evicted_base_(0),
+	  compression_(compression),
+	  hot_()
+	{
+		if (admission_)
+			sketch_.reset(budget_ / BUFFER_SEGMENT_SIZE);
+		if (compression_)
+			compression_start();
+	}
 
+	/*
+	 * Entries still in use elsewhere keep our reference, so that they are
+	 * never freed, and with it the arena's storage.
+	 */
 	~XCodecMemoryCache()
 	{
-		segment_hash_map_t::const_iterator it;
-		for (it = segment_hash_map_.begin();
-		     it != segment_hash_map_.end(); ++it)
-			it->second->unref();
-		segment_hash_map_.clear();
+		uint64_t hash;
+		BufferSegment *seg;
+
+		while (index_.clock(&hash, &seg)) {
+			seg->ref();
+			index_.erase(hash);
+			if (seg->exclusive())
+				arena_.release(seg);
+		}
+
+		/*
+		 * Decompressed copies are our own allocations; erasing them
+		 * drops our reference.
+		 */
+		while (hot_.clock(&hash, &seg))
+			hot_.erase(hash);
+
+		if (compression_)
+			compression_stop();
 	}
 
-	void enter(const uint64_t& hash, BufferSegment *seg)
+	void enter(const uint64_t& hash, BufferSegment *seg, BufferSegment **keptp = NULL)
 	{
-		ASSERT(log_, seg->length() == XCODEC_SEGMENT_LENGTH);
-		ASSERT(log_, segment_hash_map_.find(hash) == segment_hash_map_.end());
-		seg->ref();
-		segment_hash_map_[hash] = seg;
+		ASSERT(log_, seg->length() <= XCODEC_CHUNK_MAX);
+		ASSERT(log_, index_.find(hash) == NULL);
+
+		BufferSegment *record;
+		if (compression_)
+			record = pack(seg);
+		else
+			record = arena_.store(seg);
+
+		size_t size = record->capacity();
+		if (budget_ != 0)
+			evict(size);
+
+		index_.insert(hash, record);
+		size_ += size;
+
+		if (keptp != NULL) {
+			if (compression_) {
+				if (hot_.count() >= XCODEC_CACHE_HOT_MAX)
+					cool();
+				hot_.insert(hash, seg);
+				seg->ref();
+				*keptp = seg;
+			} else {
+				record->ref();
+				*keptp = record;
+			}
+		}
+		record->unref();
+
+		/*
+		 * Evicted entries stay in the filter until it is rebuilt, which
+		 * is done at the same size if the cache has not grown much.
+		 */
+		if (++filter_entries_ > filter_.capacity()) {
+			size_t n = filter_.capacity();
+			if (index_.count() > n / 2)
+				n *= 2;
+			filter_.reset(n);
+			index_.enumerate([this](uint64_t h) { filter_.insert(h); });
+			filter_entries_ = index_.count();
+		} else {
+			filter_.insert(hash);
+		}
+	}
+
+	bool admit(const uint64_t& hash, size_t length)
+	{
+		if (!admission_)
+			return (true);
+
+		sketch_.increment(hash);
+		if (size_ + size_class(length) <= budget_)
+			return (true);
+
+		uint64_t victim;
+		BufferSegment *vseg;
+		if (!index_.clock(&victim, &vseg))
+			return (true);
+		if (sketch_.estimate(hash) > sketch_.estimate(victim))
+			return (true);
+
+		statistics_.rejections_++;
+		return (false);
+	}
+
+	/*
+	 * The cursor counts evictions; evicted_ holds the most recent of them,
+	 * the first of which was eviction evicted_base_.
+	 */
+	bool evicted(uint64_t *cursorp, uint64_t *hashp)
+	{
+		if (*cursorp < evicted_base_)
+			*cursorp = evicted_base_;
+		if (*cursorp - evicted_base_ >= evicted_.size())
+			return (false);
+		*hashp = evicted_[*cursorp - evicted_base_];
+		(*cursorp)++;
+		return (true);
+	}
+
+	XCodecCache *peer(const UUID& uuid, bool evict) const
+	{
+		return (new XCodecMemoryCache(uuid, evict ? budget_ : 0, admission_, compression_));
+	}
+
+	size_t budget(void) const
+	{
+		return (budget_);
+	}
+
+	size_t size(void) const
+	{
+		return (size_);
+	}
+
+	bool admission(void) const
+	{
+		return (admission_);
+	}
+
+	bool compression(void) const
+	{
+		return (compression_);
+	}
+
+	/*
+	 * How much memory is mapped to hold the data.
+	 */
+	size_t resident(void) const
+	{
+		return (arena_.mapped());
+	}
+
+	/*
+	 * Whether the cache holds data, without counting a lookup.
+	 */
+	bool contains(const uint64_t& hash) const
+	{
+		return (filter_.test(hash) && index_.find(hash) != NULL);
 	}
 
 	bool out_of_band(void) const
@@ -148,16 +459,155 @@ public:
 
 	BufferSegment *lookup(const uint64_t& hash) const
 	{
-		segment_hash_map_t::const_iterator it;
-		it = segment_hash_map_.find(hash);
-		if (it == segment_hash_map_.end())
+		statistics_.lookups_++;
+		if (!filter_.test(hash)) {
+			statistics_.filtered_++;
 			return (NULL);
+		}
 
-		BufferSegment *seg;
+		BufferSegment *seg = index_.find(hash);
+		if (seg == NULL) {
+			statistics_.false_positives_++;
+			return (NULL);
+		}
+		if (compression_) {
+			seg = unpack(hash, seg);
+			if (seg == NULL)
+				return (NULL);
+		} else {
+			seg->ref();
+		}
+		statistics_.hits_++;
+		if (admission_)
+			sketch_.increment(hash);
+		return (seg);
+	}
+
+	/*
+	 * Only the lines of hashes which pass the filter are fetched from the
+	 * index.  Testing the filter again is cheap once its blocks are in L1.
+	 */
+	void lookup_batch(const uint64_t *hashes, BufferSegment **segs, unsigned n) const
+	{
+		unsigned i;
+
+		for (i = 0; i < n; i++) {
+			if (filter_.test(hashes[i]))
+				index_.prefetch(hashes[i]);
+		}
+
+		statistics_.lookups_ += n;
+		for (i = 0; i < n; i++) {
+			if (!filter_.test(hashes[i])) {
+				statistics_.filtered_++;
+				segs[i] = NULL;
+				continue;
+			}
+
+			segs[i] = index_.find(hashes[i]);
+			if (segs[i] == NULL) {
+				statistics_.false_positives_++;
+				continue;
+			}
+			if (compression_) {
+				segs[i] = unpack(hashes[i], segs[i]);
+				if (segs[i] == NULL)
+					continue;
+			} else {
+				segs[i]->ref();
+			}
+			statistics_.hits_++;
+			if (admission_)
+				sketch_.increment(hashes[i]);
+		}
+	}
+
+	/*
+	 * How many bytes an entry of a given length counts against the budget,
+	 * which is the room the arena gives its data, or at most that if it is
+	 * compressed.
+	 */
+	static size_t size_class(size_t length)
+	{
+		return (XCodecArena::capacity(length));
+	}
+
+private:
+	void compression_start(void);
+	void compression_stop(void);
 
-		seg = it->second;
+	/*
+	 * Store data compressed in the arena, returning its record with a
+	 * single reference.
+	 */
+	BufferSegment *pack(const BufferSegment *);
+
+	/*
+	 * Get a reference to the data of a compressed record, from the set of
+	 * those recently decompressed if it is there.  Data which can not be
+	 * decompressed is dropped, and the lookup misses.
+	 */
+	BufferSegment *unpack(const uint64_t&, BufferSegment *) const;
+
+	/*
+	 * Make room in the set of recently decompressed data.
+	 */
+	void cool(void) const;
+
+	/*
+	 * Whether an entry's data is in use outside of the cache.
+	 */
+	bool in_use(const uint64_t& hash, BufferSegment *seg) const
+	{
+		if (!compression_)
+			return (!seg->exclusive());
+
+		BufferSegment *hot = hot_.find(hash);
+		return (hot != NULL && !hot->exclusive());
+	}
+
+	/*
+	 * Make room for size more bytes.
+	 */
+	void evict(size_t size)
+	{
+		size_t tries = 0;
+
+		while (size_ + size > budget_) {
+			uint64_t hash;
+			BufferSegment *seg;
+			if (!index_.clock(&hash, &seg))
+				break;
+
+			if (in_use(hash, seg)) {
+				if (++tries > index_.count())
+					break;
+				index_.skip();
+				continue;
+			}
+
+			drop(hash, seg);
+			statistics_.evictions_++;
+		}
+	}
+
+	/*
+	 * Remove an entry, which is then reported as evicted.
+	 */
+	void drop(const uint64_t& hash, BufferSegment *seg)
+	{
+		size_ -= seg->capacity();
 		seg->ref();
-		return (seg);
+		index_.erase(hash);
+		arena_.release(seg);
+		if (compression_ && hot_.find(hash) != NULL)
+			hot_.erase(hash);
+
+		if (evicted_.size() == XCODEC_CACHE_EVICTED_MAX) {
+			evicted_.pop_front();
+			evicted_base_++;
+		}
+		evicted_.push_back(hash);
 	}
 };
 
@@ -30,140 +30,162 @@
 #include <xcodec/xcodec_cache.h>
 #include <xcodec/xcodec_decoder.h>
 #include <xcodec/xcodec_encoder.h>
-#include <xcodec/xcodec_hash.h>
 
-XCodecDecoder::XCodecDecoder(XCodecCache *cache)
+XCodecDecoder::XCodecDecoder(XCodecCache *cache, size_t lookahead)
 : log_("/xcodec/decoder"),
   cache_(cache),
-  window_()
+  window_(),
+  lookahead_(lookahead),
+  gaps_(),
+  ahead_(0)
 { }
 
 XCodecDecoder::~XCodecDecoder()
 { }
 
 /*
- * XXX These comments are out-of-date.
- *
  * Decode an XCodec-encoded stream.  Returns false if there was an
  * inconsistency, error or unrecoverable condition in the stream.
  * Returns true if we were able to process the stream entirely or
  * expect to be able to finish processing it once more data arrives.
  * The input buffer is cleared of anything we can parse right now.
  *
- * Since some events later in the stream (i.e. ASK or LEARN) may need
- * to be processed before some earlier in the stream (i.e. REF), we
- * parse the stream into a list of actions to take, performing them
- * as we go if possible, otherwise queueing them to occur until the
- * action that is blocking the stream has been satisfied or the stream
- * has been closed.
- *
- * XXX For now we will ASK in every stream where an unknown hash has
- * occurred and expect a LEARN in all of them.  In the future, it is
- * desirable to optimize this.  Especially once we start putting an
- * instance UUID in the HELLO message and can tell which streams
- * share an originator.
+ * The hashes of data we need and do not have are added to unknown_hashes,
+ * unless they are there already, and the caller removes them once it has
+ * entered their data into the cache, at which point decoding past them can
+ * be finished.  Data decoded after such a reference is held back until then,
+ * so that output stays in order.
  */
 bool
 XCodecDecoder::decode(Buffer *output, Buffer *input, std::set<uint64_t>& unknown_hashes)
 {
-	while (!input->empty()) {
-		unsigned off;
-		if (!input->find(XCODEC_MAGIC, &off)) {
-			input->moveout(output);
+	resolve(output, unknown_hashes);
+
+	BufferReader r(input);
+	Buffer *out;
+	size_t before;
+
+	while (!r.empty()) {
+		if (!gaps_.empty() && ahead_ >= lookahead_)
 			break;
-		}
 
-		if (off != 0) {
-			output->append(input, off);
-			input->skip(off);
+		out = target(output);
+		before = out->length();
+
+		size_t off;
+		if (!r.find(XCODEC_MAGIC, &off)) {
+			r.moveout(out, r.length());
+			if (out != output)
+				ahead_ += out->length() - before;
+			break;
 		}
-		ASSERT(log_, !input->empty());
+
+		if (off != 0)
+			r.moveout(out, off);
+		ASSERT(log_, !r.empty());
 
 		/*
 		 * Need the following byte at least.
 		 */
-		if (input->length() == 1)
-			break;
+		if (r.length() == 1)
+			goto done;
 
 		uint8_t op;
-		input->extract(&op, sizeof XCODEC_MAGIC);
+		r.extract(&op, sizeof XCODEC_MAGIC);
 
 		switch (op) {
 		case XCODEC_OP_ESCAPE:
-			output->append(XCODEC_MAGIC);
-			input->skip(sizeof XCODEC_MAGIC + sizeof op);
+			out->append(XCODEC_MAGIC);
+			r.skip(sizeof XCODEC_MAGIC + sizeof op);
 			break;
 		case XCODEC_OP_EXTRACT:
-			if (input->length() < sizeof XCODEC_MAGIC + sizeof op + XCODEC_SEGMENT_LENGTH)
+			if (r.length() < sizeof XCODEC_MAGIC + sizeof op + XCODEC_SEGMENT_LENGTH)
 				goto done;
 			else {
-				input->skip(sizeof XCODEC_MAGIC + sizeof op);
+				r.skip(sizeof XCODEC_MAGIC + sizeof op);
 
 				BufferSegment *seg;
-				input->copyout(&seg, XCODEC_SEGMENT_LENGTH);
-				input->skip(XCODEC_SEGMENT_LENGTH);
+				r.moveout(&seg, XCODEC_SEGMENT_LENGTH);
 
-				uint64_t hash = XCodecHash::hash(seg->data());
-				BufferSegment *oseg = cache_->lookup(hash);
-				if (oseg != NULL) {
-					if (oseg->equal(seg)) {
-						seg->unref();
-						seg = oseg;
-					} else {
-						ERROR(log_) << "Collision in <EXTRACT>.";
-						seg->unref();
-						return (false);
-					}
-				} else {
-					cache_->enter(hash, seg);
+				if (!decode_extract(out, seg))
+					return (false);
+			}
+			break;
+		case XCODEC_OP_EXTRACT_CHUNK:
+			if (r.length() < sizeof XCODEC_MAGIC + sizeof op + sizeof (uint16_t))
+				goto done;
+			else {
+				uint16_t len;
+				r.extract(&len, sizeof XCODEC_MAGIC + sizeof op);
+				len = BigEndian::decode(len);
+				if (len == 0 || len > XCODEC_CHUNK_MAX) {
+					ERROR(log_) << "Invalid <EXTRACT_CHUNK> length: " << len;
+					return (false);
 				}
 
-				window_.declare(hash, seg);
-				output->append(seg);
-				seg->unref();
+				if (r.length() < sizeof XCODEC_MAGIC + sizeof op + sizeof len + len)
+					goto done;
+
+				r.skip(sizeof XCODEC_MAGIC + sizeof op + sizeof len);
+
+				BufferSegment *seg;
+				r.moveout(&seg, len);
+
+				if (!decode_extract(out, seg))
+					return (false);
 			}
 			break;
 		case XCODEC_OP_REF:
-			if (input->length() < sizeof XCODEC_MAGIC + sizeof op + sizeof (uint64_t))
+			if (r.length() < sizeof XCODEC_MAGIC + sizeof op + sizeof (uint64_t))
 				goto done;
 			else {
 				uint64_t behash;
-				input->extract(&behash, sizeof XCODEC_MAGIC + sizeof op);
+				r.extract(&behash, sizeof XCODEC_MAGIC + sizeof op);
 				uint64_t hash = BigEndian::decode(behash);
 
+				r.skip(sizeof XCODEC_MAGIC + sizeof op + sizeof behash);
+
 				BufferSegment *oseg = cache_->lookup(hash);
 				if (oseg == NULL) {
-					if (unknown_hashes.find(hash) == unknown_hashes.end()) {
-						DEBUG(log_) << "Sending <ASK>, waiting for <LEARN>.";
-						unknown_hashes.insert(hash);
-					} else {
-						DEBUG(log_) << "Already sent <ASK>, waiting for <LEARN>.";
-					}
-
-					return (true);
+					window_.declare(hash, NULL);
+					decode_gap(hash, unknown_hashes);
+					break;
 				}
 
-				input->skip(sizeof XCODEC_MAGIC + sizeof op + sizeof behash);
-
 				window_.declare(hash, oseg);
-				output->append(oseg);
+				out->append(oseg);
 				oseg->unref();
 			}
 			break;
 		case XCODEC_OP_BACKREF:
-			if (input->length() < sizeof XCODEC_MAGIC + sizeof op + sizeof (uint8_t))
+			if (r.length() < sizeof XCODEC_MAGIC + sizeof op + sizeof (uint8_t))
 				goto done;
 			else {
 				uint8_t idx;
-				input->moveout(&idx, sizeof XCODEC_MAGIC + sizeof op, sizeof idx);
+				r.skip(sizeof XCODEC_MAGIC + sizeof op);
+				r.moveout(&idx);
 
+				/*
+				 * The window may have the hash without the
+				 * data, which may be in the cache by now.
+				 */
 				BufferSegment *oseg = window_.dereference(idx);
 				if (oseg == NULL) {
-					ERROR(log_) << "Index not present in <BACKREF> window: " << (unsigned)idx;
-					return (false);
+					uint64_t hash = window_.hash(idx);
+					if (hash == 0) {
+						ERROR(log_) << "Index not present in <BACKREF> window: " << (unsigned)idx;
+						return (false);
+					}
+
+					oseg = cache_->lookup(hash);
+					if (oseg == NULL) {
+						decode_gap(hash, unknown_hashes);
+						break;
+					}
+					window_.learn(hash, oseg);
 				}
 
-				output->append(oseg);
+				out->append(oseg);
 				oseg->unref();
 			}
 			break;
@@ -171,6 +193,101 @@ XCodecDecoder::decode(Buffer *output, Buffer *input, std::set<uint64_t>& unknown
 			ERROR(log_) << "Unsupported XCodec opcode " << (unsigned)op << ".";
 			return (false);
 		}
+
+		if (out != output)
+			ahead_ += out->length() - before;
+	}
+	if (r.position() != 0)
+		input->skip(r.position());
+	return (true);
+
+done:
+	/*
+	 * Data before an incomplete op may have been held back.
+	 */
+	if (out != output)
+		ahead_ += out->length() - before;
+	if (r.position() != 0)
+		input->skip(r.position());
+	return (true);
+}
+
+/*
+ * Enter extracted data into the cache and window and output it, consuming the
+ * caller's reference.
+ */
+bool
+XCodecDecoder::decode_extract(Buffer *output, BufferSegment *seg)
+{
+	uint64_t hash = cache_->hash(seg->data(), seg->length());
+	BufferSegment *oseg = cache_->lookup(hash);
+	if (oseg != NULL) {
+		if (oseg->equal(seg)) {
+			seg->unref();
+			seg = oseg;
+		} else {
+			ERROR(log_) << "Collision in <EXTRACT>.";
+			oseg->unref();
+			seg->unref();
+			return (false);
+		}
+	} else {
+		BufferSegment *kept;
+		cache_->enter(hash, seg, &kept);
+		seg->unref();
+		seg = kept;
+	}
+
+	window_.declare(hash, seg);
+	output->append(seg);
+	seg->unref();
+
+	return (true);
+}
+
+/*
+ * Leave a gap for data we do not have.
+ */
+void
+XCodecDecoder::decode_gap(uint64_t hash, std::set<uint64_t>& unknown_hashes)
+{
+	if (unknown_hashes.find(hash) == unknown_hashes.end()) {
+		DEBUG(log_) << "Sending <ASK>, decoding ahead.";
+		unknown_hashes.insert(hash);
+	} else {
+		DEBUG(log_) << "Already sent <ASK>, decoding ahead.";
+	}
+
+	gaps_.push_back(Gap(hash));
+	ahead_ += XCODEC_SEGMENT_LENGTH;
+}
+
+/*
+ * Fill what gaps we can, in order, and output what was held back behind them.
+ * A gap whose hash the caller no longer waits for but which is not in the
+ * cache, e.g. because it has been evicted again, is asked for again.
+ */
+void
+XCodecDecoder::resolve(Buffer *output, std::set<uint64_t>& unknown_hashes)
+{
+	while (!gaps_.empty()) {
+		Gap& gap = gaps_.front();
+		if (unknown_hashes.find(gap.hash_) != unknown_hashes.end())
+			return;
+
+		BufferSegment *seg = cache_->lookup(gap.hash_);
+		if (seg == NULL) {
+			DEBUG(log_) << "Data for gap has gone, sending <ASK> again.";
+			unknown_hashes.insert(gap.hash_);
+			return;
+		}
+
+		window_.learn(gap.hash_, seg);
+		output->append(seg);
+		seg->unref();
+
+		ahead_ -= XCODEC_SEGMENT_LENGTH + gap.data_.length();
+		output->append(&gap.data_);
+		gaps_.pop_front();
 	}
-done:	return (true);
 }
@@ -26,22 +26,75 @@
 #ifndef	XCODEC_XCODEC_DECODER_H
 #define	XCODEC_XCODEC_DECODER_H
 
+#include <deque>
 #include <set>
 
 #include <xcodec/xcodec_window.h>
 
 class XCodecCache;
 
+/*
+ * The decoder does not stop at a reference to data it does not have, but
+ * leaves a gap for it and keeps decoding, holding back what follows the gap
+ * until the data arrives, so that all of the data it needs from a stretch of
+ * the stream can be asked for at once.  It holds back up to lookahead bytes,
+ * counting each gap as a segment, before it stops; with no lookahead, it
+ * stops at the first gap.
+ */
 class XCodecDecoder {
+	struct Gap {
+		uint64_t hash_;
+		Buffer data_;
+
+		Gap(uint64_t hash)
+		: hash_(hash),
+		  data_()
+		{ }
+	};
+
 	LogHandle log_;
 	XCodecCache *cache_;
 	XCodecWindow window_;
+	size_t lookahead_;
+	std::deque<Gap> gaps_;
+	size_t ahead_;
 
 public:
-	XCodecDecoder(XCodecCache *);
+	XCodecDecoder(XCodecCache *, size_t = XCODEC_LOOKAHEAD);
 	~XCodecDecoder();
 
 	bool decode(Buffer *, Buffer *, std::set<uint64_t>&);
+
+	/*
+	 * Whether decoded data is being held back.
+	 */
+	bool pending(void) const
+	{
+		return (!gaps_.empty());
+	}
+
+	/*
+	 * How much is being held back, as counted against the lookahead.
+	 */
+	size_t held(void) const
+	{
+		return (ahead_);
+	}
+
+private:
+	bool decode_extract(Buffer *, BufferSegment *);
+	void decode_gap(uint64_t, std::set<uint64_t>&);
+	void resolve(Buffer *, std::set<uint64_t>&);
+
+	/*
+	 * Where decoded data goes: straight out, or behind the last gap.
+	 */
+	Buffer *target(Buffer *output)
+	{
+		if (gaps_.empty())
+			return (output);
+		return (&gaps_.back().data_);
+	}
 };
 
 #endif /* !XCODEC_XCODEC_DECODER_H */
@@ -0,0 +1,1346 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include <common/buffer.h>
+
+#include <common/thread/atomic.h>
+
+#include <event/callback_queue.h>
+
+#include <xcodec/xcodec.h>
+#include <xcodec/xcodec_disk_cache.h>
+#include <xcodec/xcodec_hash.h>
+
+/*
+ * Both files are in host byte order, since they never leave the host.
+ *
+ * The log starts with a header holding the UUID, followed by records of a
+ * hash, a length and that many bytes of data.  It is created complete with
+ * its header under a temporary name and renamed into place, so the header is
+ * never torn, and is only ever appended to after that.
+ *
+ * The index holds two copies of its header, written alternately, each with a
+ * generation and a checksum, so that one is intact if writing the other is
+ * interrupted.  The header records how much of the log is in the index; any
+ * records after that are replayed into the index when it is opened, up to the
+ * first which is incomplete or whose data does not match its hash, where the
+ * log is truncated.  If neither header is intact, the index is rebuilt from
+ * the whole log.  The slots of the index are laid out as in XCodecIndex, with
+ * the offset and length of a record in place of a segment.
+ *
+ * Records are synced to the log before they are entered into the index, and
+ * the index is synced before its header, so the index never refers to data
+ * which is not in the log.
+ */
+#define	XCODEC_DISK_LOG_MAGIC		(0x58434c4f47303031ull)	/* XCLOG001 */
+#define	XCODEC_DISK_INDEX_MAGIC		(0x5843494e44303031ull)	/* XCIND001 */
+
+#define	XCODEC_DISK_LOG_START		(64)
+#define	XCODEC_DISK_INDEX_HEADER(g)	(((g) & 1) * 512)
+#define	XCODEC_DISK_INDEX_START		(4096)
+#define	XCODEC_DISK_INDEX_SLOTS		(4)
+#define	XCODEC_DISK_INDEX_INITIAL_SHIFT	(10)	/* 1024 lines.  */
+
+/*
+ * How many bytes of new data may be waiting to be written before more is
+ * kept only in memory, how much of the log to read at once when opening the
+ * cache, and how much to read back at once when data is looked up.
+ */
+#define	XCODEC_DISK_QUEUE_MAX		(32 * 1024 * 1024)
+#define	XCODEC_DISK_READ_SIZE		(1024 * 1024)
+#define	XCODEC_DISK_FETCH_SIZE		(256 * 1024)
+
+namespace {
+	struct LogHeader {
+		uint64_t magic_;
+		char uuid_[UUID_SIZE];
+		uint32_t reserved_;
+		uint64_t check_;
+	};
+
+	struct LogRecord {
+		uint64_t hash_;
+		uint32_t length_;
+		uint32_t reserved_;
+	};
+
+	struct IndexHeader {
+		uint64_t magic_;
+		uint64_t generation_;
+		char uuid_[UUID_SIZE];
+		uint32_t shift_;
+		uint64_t log_length_;
+		uint64_t count_;
+		uint64_t check_;
+	};
+
+	struct IndexSlot {
+		uint64_t hash_;
+		uint64_t where_;
+	};
+
+	struct Extent {
+		uint64_t offset_;
+		uint64_t hash_;
+		uint32_t length_;
+
+		bool operator< (const Extent& b) const
+		{
+			return (offset_ < b.offset_);
+		}
+	};
+
+	/*
+	 * A record read back from the log, for the extent of the log which
+	 * starts at start_.
+	 */
+	struct Fetched {
+		uint64_t start_;
+		uint64_t hash_;
+		uint64_t offset_;
+		BufferSegment *seg_;
+	};
+
+	uint64_t where(uint64_t offset, uint32_t length)
+	{
+		return ((offset << 16) | length);
+	}
+
+	/*
+	 * Slots are probed a line of XCODEC_DISK_INDEX_SLOTS at a time, as in
+	 * XCodecIndex, from the line picked by the high bits of the hash after
+	 * multiplying by the golden ratio.
+	 */
+	bool slot_find(const IndexSlot *slots, unsigned shift, size_t mask, uint64_t hash, uint64_t *wherep)
+	{
+		size_t b = (hash * 0x9e3779b97f4a7c15ull) >> shift;
+
+		for (;;) {
+			const IndexSlot *sp = &slots[b * XCODEC_DISK_INDEX_SLOTS];
+			unsigned i;
+
+			for (i = 0; i < XCODEC_DISK_INDEX_SLOTS; i++) {
+				if (sp[i].where_ == 0)
+					return (false);
+				if (sp[i].hash_ == hash) {
+					if (wherep != NULL)
+						*wherep = sp[i].where_;
+					return (true);
+				}
+			}
+			b = (b + 1) & mask;
+		}
+	}
+
+	void slot_place(IndexSlot *slots, unsigned shift, size_t mask, uint64_t hash, uint64_t where)
+	{
+		size_t b = (hash * 0x9e3779b97f4a7c15ull) >> shift;
+
+		for (;;) {
+			IndexSlot *sp = &slots[b * XCODEC_DISK_INDEX_SLOTS];
+			unsigned i;
+
+			for (i = 0; i < XCODEC_DISK_INDEX_SLOTS; i++) {
+				if (sp[i].where_ == 0) {
+					sp[i].hash_ = hash;
+					sp[i].where_ = where;
+					return;
+				}
+			}
+			b = (b + 1) & mask;
+		}
+	}
+
+	bool slot_full(size_t count, size_t mask)
+	{
+		return (4 * (count + 1) > 3 * (mask + 1) * XCODEC_DISK_INDEX_SLOTS);
+	}
+
+	/*
+	 * Check that a record at offset in buf, which holds the log from start
+	 * up to end, is complete and that its data matches its hash under key.
+	 */
+	bool record_valid(const uint8_t *buf, uint64_t start, uint64_t end, uint64_t offset, LogRecord *record, const XCodecHashKey& key)
+	{
+		if (offset + sizeof *record > end)
+			return (false);
+		memcpy(record, &buf[offset - start], sizeof *record);
+		if (record->length_ == 0 || record->length_ > XCODEC_CHUNK_MAX)
+			return (false);
+		if (offset + sizeof *record + record->length_ > end)
+			return (false);
+		if (XCodecHash::hash(&buf[offset + sizeof *record - start], record->length_, key) != record->hash_)
+			return (false);
+		return (true);
+	}
+
+	/*
+	 * FNV-1a over everything in a header before its checksum.
+	 */
+	template<typename T>
+	uint64_t checksum(const T *header)
+	{
+		const uint8_t *p = (const uint8_t *)header;
+		const uint8_t *e = (const uint8_t *)&header->check_;
+		uint64_t h = 0xcbf29ce484222325ull;
+
+		while (p != e) {
+			h ^= *p++;
+			h *= 0x100000001b3ull;
+		}
+		return (h);
+	}
+
+	bool read_fully(int fd, void *buf, size_t len, off_t offset)
+	{
+		uint8_t *p = (uint8_t *)buf;
+
+		while (len != 0) {
+			ssize_t len1 = ::pread(fd, p, len, offset);
+			if (len1 == -1 && errno == EINTR)
+				continue;
+			if (len1 <= 0)
+				return (false);
+			p += len1;
+			len -= len1;
+			offset += len1;
+		}
+		return (true);
+	}
+
+	bool write_fully(int fd, const void *buf, size_t len, off_t offset)
+	{
+		const uint8_t *p = (const uint8_t *)buf;
+
+		while (len != 0) {
+			ssize_t len1 = ::pwrite(fd, p, len, offset);
+			if (len1 == -1 && errno == EINTR)
+				continue;
+			if (len1 <= 0)
+				return (false);
+			p += len1;
+			len -= len1;
+			offset += len1;
+		}
+		return (true);
+	}
+
+	/*
+	 * Make a rename or creation in a directory durable.
+	 */
+	void sync_directory(const std::string& name)
+	{
+		std::string::size_type slash = name.rfind('/');
+		std::string dir = slash == std::string::npos ? "." : name.substr(0, slash);
+
+		int fd = ::open(dir.c_str(), O_RDONLY);
+		if (fd == -1)
+			return;
+		::fsync(fd);
+		::close(fd);
+	}
+}
+
+/*
+ * Where in the log each hash is, for the cache's own thread.
+ */
+class XCodecDiskCache::Locations {
+	IndexSlot *slots_;
+	unsigned shift_;
+	size_t mask_;
+	size_t count_;
+public:
+	Locations(void)
+	: slots_(NULL),
+	  shift_(64 - XCODEC_DISK_INDEX_INITIAL_SHIFT),
+	  mask_(((size_t)1 << XCODEC_DISK_INDEX_INITIAL_SHIFT) - 1),
+	  count_(0)
+	{
+		slots_ = allocate(mask_ + 1);
+	}
+
+	~Locations()
+	{
+		free(slots_);
+		slots_ = NULL;
+	}
+
+	bool find(uint64_t hash, uint64_t *offsetp, uint32_t *lengthp) const
+	{
+		uint64_t w;
+
+		if (!slot_find(slots_, shift_, mask_, hash, &w))
+			return (false);
+		*offsetp = w >> 16;
+		*lengthp = w & 0xffff;
+		return (true);
+	}
+
+	void insert(uint64_t hash, uint64_t offset, uint32_t length)
+	{
+		if (slot_full(count_, mask_)) {
+			IndexSlot *old_slots = slots_;
+			size_t old_mask = mask_;
+			size_t i;
+
+			shift_--;
+			mask_ = 2 * mask_ + 1;
+			slots_ = allocate(mask_ + 1);
+
+			for (i = 0; i < (old_mask + 1) * XCODEC_DISK_INDEX_SLOTS; i++) {
+				if (old_slots[i].where_ != 0)
+					slot_place(slots_, shift_, mask_, old_slots[i].hash_, old_slots[i].where_);
+			}
+			free(old_slots);
+		}
+		slot_place(slots_, shift_, mask_, hash, where(offset, length));
+		count_++;
+	}
+
+	size_t count(void) const
+	{
+		return (count_);
+	}
+
+	template<typename F>
+	void enumerate(F f) const
+	{
+		size_t i;
+
+		for (i = 0; i < (mask_ + 1) * XCODEC_DISK_INDEX_SLOTS; i++) {
+			if (slots_[i].where_ != 0)
+				f(slots_[i].hash_);
+		}
+	}
+
+private:
+	static IndexSlot *allocate(size_t lines)
+	{
+		void *p;
+
+		if (posix_memalign(&p, XCODEC_INDEX_LINE, lines * XCODEC_DISK_INDEX_SLOTS * sizeof (IndexSlot)) != 0)
+			HALT("/xcodec/cache/disk/locations") << "Could not allocate " << lines << " lines.";
+		memset(p, 0, lines * XCODEC_DISK_INDEX_SLOTS * sizeof (IndexSlot));
+		return ((IndexSlot *)p);
+	}
+};
+
+class XCodecDiskCache::Writer : public WorkerThread {
+	LogHandle log_;
+	std::string name_;
+	UUID uuid_;
+	XCodecHashKey key_;
+	int log_fd_;
+	int index_fd_;
+	uint8_t *index_;
+	size_t index_size_;
+	unsigned shift_;
+	size_t mask_;
+	size_t count_;
+	uint64_t generation_;
+	uint64_t log_length_;
+	Atomic<uint64_t> written_;
+	SleepQueue synced_;
+	std::vector<uint8_t> queue_;
+	bool writing_;
+	bool failed_;
+	uintmax_t dropped_;
+public:
+	Writer(const std::string& name)
+	: WorkerThread("XCodecDiskCache::Writer"),
+	  log_("/xcodec/cache/disk/writer"),
+	  name_(name),
+	  uuid_(),
+	  key_(),
+	  log_fd_(-1),
+	  index_fd_(-1),
+	  index_(NULL),
+	  index_size_(0),
+	  shift_(0),
+	  mask_(0),
+	  count_(0),
+	  generation_(0),
+	  log_length_(0),
+	  written_(0),
+	  synced_("XCodecDiskCache::Writer", &mtx_),
+	  queue_(),
+	  writing_(false),
+	  failed_(false),
+	  dropped_(0)
+	{ }
+
+	~Writer()
+	{
+		if (dropped_ != 0)
+			INFO(log_) << name_ << ": " << dropped_ << " segments were not written.";
+		if (index_ != NULL) {
+			::munmap(index_, index_size_);
+			index_ = NULL;
+		}
+		if (index_fd_ != -1) {
+			::close(index_fd_);
+			index_fd_ = -1;
+		}
+		if (log_fd_ != -1) {
+			::close(log_fd_);
+			log_fd_ = -1;
+		}
+	}
+
+	const UUID& uuid(void) const
+	{
+		return (uuid_);
+	}
+
+	const XCodecHashKey& key(void) const
+	{
+		return (key_);
+	}
+
+	int fd(void) const
+	{
+		return (log_fd_);
+	}
+
+	/*
+	 * How much of the log has been written, and so may be read.
+	 */
+	uint64_t written(void) const
+	{
+		return (written_.load(std::memory_order_acquire));
+	}
+
+	bool open(const UUID *);
+	void load(Locations *, size_t, std::vector<uint64_t> *);
+
+	/*
+	 * Called from the cache's thread to queue a segment to be written
+	 * after those already queued.  Returns false if it will not be.
+	 */
+	bool write(const uint64_t& hash, const BufferSegment *seg)
+	{
+		LogRecord record;
+
+		record.hash_ = hash;
+		record.length_ = seg->length();
+		record.reserved_ = 0;
+
+		mtx_.lock();
+		if (failed_ || queue_.size() + sizeof record + seg->length() > XCODEC_DISK_QUEUE_MAX) {
+			dropped_++;
+			mtx_.unlock();
+			return (false);
+		}
+		const uint8_t *r = (const uint8_t *)&record;
+		queue_.insert(queue_.end(), r, r + sizeof record);
+		queue_.insert(queue_.end(), seg->data(), seg->end());
+		mtx_.unlock();
+
+		submit();
+		return (true);
+	}
+
+	void sync(void)
+	{
+		submit();
+
+		mtx_.lock();
+		while (!queue_.empty() || writing_)
+			synced_.wait();
+		mtx_.unlock();
+	}
+
+private:
+	void work(void);
+
+	void final(void)
+	{
+		work();
+	}
+
+	IndexSlot *slots(void) const
+	{
+		return ((IndexSlot *)(index_ + XCODEC_DISK_INDEX_START));
+	}
+
+	bool find(uint64_t hash) const
+	{
+		return (slot_find(slots(), shift_, mask_, hash, NULL));
+	}
+
+	bool insert(uint64_t, uint64_t, uint32_t);
+
+	bool create_log(const UUID *);
+	bool open_index(void);
+	bool create_index(unsigned);
+	bool commit(void);
+	bool replay(void);
+};
+
+/*
+ * Reads extents of the log, starting at a record, back into memory.
+ */
+class XCodecDiskCache::Reader : public WorkerThread {
+	LogHandle log_;
+	const Writer *writer_;
+	std::deque<uint64_t> requests_;
+	std::vector<Fetched> fetched_;
+	std::vector<uint64_t> done_;
+	Atomic<bool> ready_;
+	CallbackQueue ready_queue_;
+public:
+	Reader(const Writer *writer)
+	: WorkerThread("XCodecDiskCache::Reader"),
+	  log_("/xcodec/cache/disk/reader"),
+	  writer_(writer),
+	  requests_(),
+	  fetched_(),
+	  done_(),
+	  ready_(false),
+	  ready_queue_()
+	{ }
+
+	~Reader()
+	{
+		std::vector<Fetched>::const_iterator it;
+		for (it = fetched_.begin(); it != fetched_.end(); ++it)
+			it->seg_->unref();
+	}
+
+	void fetch(uint64_t start)
+	{
+		mtx_.lock();
+		requests_.push_back(start);
+		mtx_.unlock();
+
+		submit();
+	}
+
+	/*
+	 * Whether any reads have finished since collect() was last called.
+	 */
+	bool ready(void) const
+	{
+		return (ready_.load(std::memory_order_relaxed));
+	}
+
+	/*
+	 * Call back once reads have finished, which may be right away.
+	 */
+	Action *notify(SimpleCallback *cb)
+	{
+		ScopedLock _(&mtx_);
+		if (ready())
+			return (cb->schedule());
+		return (ready_queue_.schedule(cb));
+	}
+
+	/*
+	 * Take the records read and the starts of the extents they were read
+	 * from, whether or not anything could be read from them.
+	 */
+	void collect(std::vector<Fetched> *fetched, std::vector<uint64_t> *done)
+	{
+		mtx_.lock();
+		fetched->swap(fetched_);
+		done->swap(done_);
+		ready_.store(false, std::memory_order_relaxed);
+		mtx_.unlock();
+	}
+
+private:
+	void work(void);
+};
+
+XCodecDiskCache::XCodecDiskCache(const UUID& uuid, const std::string& directory, Writer *writer, size_t budget, bool admission, bool compression)
+: XCodecCache(uuid),
+  log_("/xcodec/cache/disk"),
+  directory_(directory),
+  cache_(new XCodecMemoryCache(uuid, budget, admission, compression)),
+  writer_(writer),
+  reader_(new Reader(writer)),
+  locations_(new Locations()),
+  filter_(),
+  log_end_(writer->written()),
+  fetching_()
+{ }
+
+XCodecDiskCache::~XCodecDiskCache()
+{
+	reader_->stop();
+	reader_->join();
+	delete reader_;
+	reader_ = NULL;
+
+	writer_->stop();
+	writer_->join();
+	delete writer_;
+	writer_ = NULL;
+
+	delete locations_;
+	locations_ = NULL;
+
+	delete cache_;
+	cache_ = NULL;
+}
+
+void
+XCodecDiskCache::enter(const uint64_t& hash, BufferSegment *seg, BufferSegment **keptp)
+{
+	uint64_t offset;
+	uint32_t length;
+
+	/*
+	 * What was read back from the log since a lookup missed may already
+	 * be in memory.
+	 */
+	if (!cache_->contains(hash)) {
+		cache_->enter(hash, seg, keptp);
+	} else if (keptp != NULL) {
+		seg->ref();
+		*keptp = seg;
+	}
+	if (filter_.test(hash) && locations_->find(hash, &offset, &length))
+		return;
+	if (!writer_->write(hash, seg))
+		return;
+
+	locations_->insert(hash, log_end_, seg->length());
+	log_end_ += sizeof (LogRecord) + seg->length();
+
+	if (locations_->count() > filter_.capacity()) {
+		filter_.reset(2 * filter_.capacity());
+		locations_->enumerate([this](uint64_t h) { filter_.insert(h); });
+	} else {
+		filter_.insert(hash);
+	}
+}
+
+BufferSegment *
+XCodecDiskCache::lookup(const uint64_t& hash) const
+{
+	if (reader_->ready())
+		collect();
+
+	BufferSegment *seg = cache_->lookup(hash);
+	if (seg == NULL)
+		request(hash);
+	return (seg);
+}
+
+void
+XCodecDiskCache::lookup_batch(const uint64_t *hashes, BufferSegment **segs, unsigned n) const
+{
+	unsigned i;
+
+	if (reader_->ready())
+		collect();
+
+	cache_->lookup_batch(hashes, segs, n);
+	for (i = 0; i < n; i++) {
+		if (segs[i] == NULL)
+			request(hashes[i]);
+	}
+}
+
+bool
+XCodecDiskCache::fetching(const uint64_t& hash) const
+{
+	uint64_t offset;
+	uint32_t length;
+
+	if (reader_->ready())
+		collect();
+
+	if (cache_->contains(hash))
+		return (false);
+	if (!filter_.test(hash) || !locations_->find(hash, &offset, &length))
+		return (false);
+
+	std::set<uint64_t>::const_iterator it = fetching_.upper_bound(offset);
+	if (it == fetching_.begin())
+		return (false);
+	--it;
+	return (offset + sizeof (LogRecord) + length <= *it + XCODEC_DISK_FETCH_SIZE);
+}
+
+Action *
+XCodecDiskCache::fetched(SimpleCallback *cb)
+{
+	return (reader_->notify(cb));
+}
+
+/*
+ * Read data straight from the log, on the calling thread.
+ */
+BufferSegment *
+XCodecDiskCache::lookup_wait(const uint64_t& hash)
+{
+	BufferSegment *seg = lookup(hash);
+	if (seg != NULL)
+		return (seg);
+
+	uint64_t offset;
+	uint32_t length;
+	if (!filter_.test(hash) || !locations_->find(hash, &offset, &length))
+		return (NULL);
+	if (offset + sizeof (LogRecord) + length > writer_->written())
+		return (NULL);
+
+	uint8_t buf[sizeof (LogRecord) + XCODEC_CHUNK_MAX];
+	LogRecord record;
+	if (!read_fully(writer_->fd(), buf, sizeof (LogRecord) + length, offset) ||
+	    !record_valid(buf, offset, offset + sizeof (LogRecord) + length, offset, &record, key_) ||
+	    record.hash_ != hash) {
+		ERROR(log_) << "Could not read " << hash << " from the log.";
+		return (NULL);
+	}
+
+	seg = BufferSegment::create(buf + sizeof (LogRecord), length);
+	if (!cache_->contains(hash))
+		cache_->enter(hash, seg);
+	return (seg);
+}
+
+bool
+XCodecDiskCache::evicted(uint64_t *cursorp, uint64_t *hashp)
+{
+	uint64_t hash, offset;
+	uint32_t length;
+
+	/*
+	 * Data evicted from memory is only gone if it was never written.
+	 */
+	while (cache_->evicted(cursorp, &hash)) {
+		if (filter_.test(hash) && locations_->find(hash, &offset, &length))
+			continue;
+		*hashp = hash;
+		return (true);
+	}
+	return (false);
+}
+
+XCodecCache *
+XCodecDiskCache::peer(const UUID& uuid, bool evict) const
+{
+	XCodecCache *cache = open(directory_, uuid.string_, &uuid, evict ? cache_->budget() : 0, cache_->admission(), cache_->compression());
+	if (cache == NULL) {
+		ERROR(log_) << "Could not open cache for peer " << uuid.string_ << "; keeping it in memory only.";
+		return (cache_->peer(uuid, evict));
+	}
+	return (cache);
+}
+
+void
+XCodecDiskCache::sync(void)
+{
+	writer_->sync();
+}
+
+/*
+ * Enter what has been read back into memory, unless it has been entered again
+ * since or its place in the log has been taken by something newer.  This is
+ * done backwards, so that what was asked for is entered after what was read
+ * ahead of it, and is not evicted to make room for it.
+ */
+void
+XCodecDiskCache::collect(void) const
+{
+	std::vector<Fetched> fetched;
+	std::vector<uint64_t> done;
+
+	reader_->collect(&fetched, &done);
+
+	std::vector<Fetched>::const_reverse_iterator it;
+	for (it = fetched.rbegin(); it != fetched.rend(); ++it) {
+		uint64_t offset;
+		uint32_t length;
+
+		if (!cache_->contains(it->hash_) &&
+		    locations_->find(it->hash_, &offset, &length) &&
+		    offset == it->offset_)
+			cache_->enter(it->hash_, it->seg_);
+		it->seg_->unref();
+	}
+
+	std::vector<uint64_t>::const_iterator dit;
+	for (dit = done.begin(); dit != done.end(); ++dit)
+		fetching_.erase(*dit);
+}
+
+/*
+ * Start reading data back from the log if it is there and is not already
+ * being read.
+ */
+bool
+XCodecDiskCache::request(const uint64_t& hash) const
+{
+	uint64_t offset;
+	uint32_t length;
+
+	if (!filter_.test(hash) || !locations_->find(hash, &offset, &length))
+		return (false);
+	if (offset + sizeof (LogRecord) + length > writer_->written())
+		return (false);
+
+	std::set<uint64_t>::const_iterator it = fetching_.upper_bound(offset);
+	if (it != fetching_.begin()) {
+		--it;
+		if (offset + sizeof (LogRecord) + length <= *it + XCODEC_DISK_FETCH_SIZE)
+			return (true);
+	}
+
+	fetching_.insert(offset);
+	reader_->fetch(offset);
+	statistics_.fetches_++;
+	return (true);
+}
+
+XCodecDiskCache *
+XCodecDiskCache::open(const std::string& directory, size_t budget, bool admission, bool compression)
+{
+	return (open(directory, "local", NULL, budget, admission, compression));
+}
+
+XCodecDiskCache *
+XCodecDiskCache::open(const std::string& directory, const std::string& name, const UUID *uuid, size_t budget, bool admission, bool compression)
+{
+	if (::mkdir(directory.c_str(), 0700) == -1 && errno != EEXIST) {
+		ERROR("/xcodec/cache/disk") << "Could not create " << directory << ": " << strerror(errno);
+		return (NULL);
+	}
+
+	Writer *writer = new Writer(directory + "/" + name);
+	if (!writer->open(uuid)) {
+		delete writer;
+		return (NULL);
+	}
+
+	XCodecDiskCache *cache = new XCodecDiskCache(writer->uuid(), directory, writer, budget, admission, compression);
+	std::vector<uint64_t> starts;
+	writer->load(cache->locations_, budget, &starts);
+	cache->filter_.reset(cache->locations_->count());
+	cache->locations_->enumerate([cache](uint64_t h) { cache->filter_.insert(h); });
+	writer->start();
+	cache->reader_->start();
+
+	std::vector<uint64_t>::const_iterator it;
+	for (it = starts.begin(); it != starts.end(); ++it) {
+		cache->fetching_.insert(*it);
+		cache->reader_->fetch(*it);
+	}
+
+	return (cache);
+}
+/*
+ * Open the log, creating it if need be, and then the index, replaying into it
+ * any of the log it is missing.
+ */
+bool
+XCodecDiskCache::Writer::open(const UUID *uuid)
+{
+	std::string log_name = name_ + ".log";
+
+	log_fd_ = ::open(log_name.c_str(), O_RDWR);
+	if (log_fd_ == -1) {
+		if (errno != ENOENT) {
+			ERROR(log_) << "Could not open " << log_name << ": " << strerror(errno);
+			return (false);
+		}
+		if (!create_log(uuid))
+			return (false);
+		log_fd_ = ::open(log_name.c_str(), O_RDWR);
+		if (log_fd_ == -1) {
+			ERROR(log_) << "Could not open " << log_name << ": " << strerror(errno);
+			return (false);
+		}
+	}
+
+	LogHeader header;
+	if (!read_fully(log_fd_, &header, sizeof header, 0) ||
+	    header.magic_ != XCODEC_DISK_LOG_MAGIC ||
+	    header.check_ != checksum(&header)) {
+		ERROR(log_) << log_name << " is not a cache log.";
+		return (false);
+	}
+	uuid_.string_.assign(header.uuid_, UUID_SIZE);
+	if (uuid != NULL && uuid->string_ != uuid_.string_) {
+		ERROR(log_) << log_name << " belongs to " << uuid_.string_ << " not " << uuid->string_ << ".";
+		return (false);
+	}
+	key_ = XCodecHashKey(uuid_.string_);
+
+	if (!open_index() || !replay())
+		return (false);
+	written_.store(log_length_, std::memory_order_release);
+	return (true);
+}
+
+/*
+ * Note where everything in the log is, and pick out where to read back from
+ * so that the memory cache gets the most recently written records which fit
+ * in its budget.  The reading is left to the Reader, so that whoever opened
+ * the cache need not wait on it.
+ */
+void
+XCodecDiskCache::Writer::load(Locations *locations, size_t budget, std::vector<uint64_t> *starts)
+{
+	std::vector<Extent> extents;
+	size_t i;
+
+	extents.reserve(count_);
+	for (i = 0; i < (mask_ + 1) * XCODEC_DISK_INDEX_SLOTS; i++) {
+		const IndexSlot *sp = &slots()[i];
+		if (sp->where_ == 0)
+			continue;
+
+		Extent e;
+		e.offset_ = sp->where_ >> 16;
+		e.length_ = sp->where_ & 0xffff;
+		e.hash_ = sp->hash_;
+		extents.push_back(e);
+
+		locations->insert(e.hash_, e.offset_, e.length_);
+	}
+	std::sort(extents.begin(), extents.end());
+
+	std::vector<Extent>::iterator first = extents.begin();
+	if (budget != 0) {
+		size_t size = 0;
+
+		first = extents.end();
+		while (first != extents.begin()) {
+			size_t size1 = XCodecMemoryCache::size_class((first - 1)->length_);
+			if (size + size1 > budget)
+				break;
+			size += size1;
+			--first;
+		}
+	}
+
+	uint64_t end = 0;
+	std::vector<Extent>::const_iterator it;
+	for (it = first; it != extents.end(); ++it) {
+		if (!starts->empty() && it->offset_ + sizeof (LogRecord) + it->length_ <= end)
+			continue;
+		starts->push_back(it->offset_);
+		end = it->offset_ + XCODEC_DISK_FETCH_SIZE;
+	}
+
+	if (first != extents.end())
+		INFO(log_) << "Reading back " << extents.end() - first << " of " << extents.size() << " segments from " << name_ << ".log.";
+}
+
+/*
+ * Write out everything queued, where the cache's thread expects it to be, and
+ * then enter it into the index.  If a write fails, give up on writing.
+ */
+void
+XCodecDiskCache::Writer::work(void)
+{
+	std::vector<uint8_t> batch;
+
+	mtx_.lock();
+	batch.swap(queue_);
+	writing_ = !batch.empty();
+	mtx_.unlock();
+
+	if (!batch.empty()) {
+		if (!write_fully(log_fd_, &batch[0], batch.size(), log_length_) ||
+		    ::fdatasync(log_fd_) == -1) {
+			ERROR(log_) << "Could not write " << name_ << ".log: " << strerror(errno);
+			mtx_.lock();
+			failed_ = true;
+			mtx_.unlock();
+		} else {
+			size_t off = 0;
+			while (off != batch.size()) {
+				const LogRecord *record = (const LogRecord *)&batch[off];
+				if (!insert(record->hash_, log_length_ + off, record->length_))
+					break;
+				off += sizeof *record + record->length_;
+			}
+			log_length_ += batch.size();
+			written_.store(log_length_, std::memory_order_release);
+			commit();
+		}
+	}
+
+	mtx_.lock();
+	writing_ = false;
+	synced_.signal();
+	mtx_.unlock();
+}
+
+/*
+ * Enter a record at offset, growing the index when it is three quarters full.
+ */
+bool
+XCodecDiskCache::Writer::insert(uint64_t hash, uint64_t offset, uint32_t length)
+{
+	ASSERT(log_, offset >= XCODEC_DISK_LOG_START);
+	ASSERT(log_, length != 0 && length <= XCODEC_CHUNK_MAX);
+
+	if (slot_full(count_, mask_)) {
+		if (!create_index(shift_ - 1))
+			return (false);
+	}
+
+	slot_place(slots(), shift_, mask_, hash, where(offset, length));
+	count_++;
+	return (true);
+}
+
+/*
+ * Create the log complete with its header under a temporary name and then
+ * move it into place.
+ */
+bool
+XCodecDiskCache::Writer::create_log(const UUID *uuid)
+{
+	std::string log_name = name_ + ".log";
+	std::string tmp_name = log_name + ".tmp";
+
+	if (uuid != NULL) {
+		uuid_ = *uuid;
+	} else {
+		uuid_.generate();
+	}
+
+	uint8_t buf[XCODEC_DISK_LOG_START];
+	LogHeader *header = (LogHeader *)buf;
+	memset(buf, 0, sizeof buf);
+	header->magic_ = XCODEC_DISK_LOG_MAGIC;
+	memcpy(header->uuid_, uuid_.string_.data(), UUID_SIZE);
+	header->check_ = checksum(header);
+
+	int fd = ::open(tmp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd == -1) {
+		ERROR(log_) << "Could not create " << tmp_name << ": " << strerror(errno);
+		return (false);
+	}
+	if (!write_fully(fd, buf, sizeof buf, 0) || ::fsync(fd) == -1) {
+		ERROR(log_) << "Could not write " << tmp_name << ": " << strerror(errno);
+		::close(fd);
+		::unlink(tmp_name.c_str());
+		return (false);
+	}
+	::close(fd);
+
+	if (::rename(tmp_name.c_str(), log_name.c_str()) == -1) {
+		ERROR(log_) << "Could not rename " << tmp_name << ": " << strerror(errno);
+		::unlink(tmp_name.c_str());
+		return (false);
+	}
+	sync_directory(log_name);
+
+	INFO(log_) << "Created " << log_name << " for " << uuid_.string_ << ".";
+	return (true);
+}
+
+/*
+ * Map the index if it is intact and belongs with the log, or else start a new
+ * one which the whole log will be replayed into.
+ */
+bool
+XCodecDiskCache::Writer::open_index(void)
+{
+	std::string index_name = name_ + ".index";
+	struct stat st;
+
+	::unlink((index_name + ".tmp").c_str());
+
+	index_fd_ = ::open(index_name.c_str(), O_RDWR);
+	if (index_fd_ != -1 && ::fstat(index_fd_, &st) != -1 &&
+	    st.st_size > XCODEC_DISK_INDEX_START) {
+		const IndexHeader *best = NULL;
+		IndexHeader headers[2];
+		unsigned g;
+
+		for (g = 0; g < 2; g++) {
+			IndexHeader *h = &headers[g];
+			if (!read_fully(index_fd_, h, sizeof *h, XCODEC_DISK_INDEX_HEADER(g)))
+				continue;
+			if (h->magic_ != XCODEC_DISK_INDEX_MAGIC || h->check_ != checksum(h))
+				continue;
+			if (XCODEC_DISK_INDEX_HEADER(h->generation_) != XCODEC_DISK_INDEX_HEADER(g))
+				continue;
+			if (best == NULL || h->generation_ > best->generation_)
+				best = h;
+		}
+
+		size_t lines = (st.st_size - XCODEC_DISK_INDEX_START) / (XCODEC_DISK_INDEX_SLOTS * sizeof (IndexSlot));
+		if (best != NULL && uuid_.string_.compare(0, UUID_SIZE, best->uuid_, UUID_SIZE) == 0 &&
+		    best->shift_ > 0 && best->shift_ <= 64 - XCODEC_DISK_INDEX_INITIAL_SHIFT &&
+		    lines == (size_t)1 << (64 - best->shift_) &&
+		    best->count_ < lines * XCODEC_DISK_INDEX_SLOTS) {
+			index_size_ = st.st_size;
+			index_ = (uint8_t *)::mmap(NULL, index_size_, PROT_READ | PROT_WRITE, MAP_SHARED, index_fd_, 0);
+			if (index_ == MAP_FAILED) {
+				index_ = NULL;
+				ERROR(log_) << "Could not map " << index_name << ": " << strerror(errno);
+				return (false);
+			}
+			shift_ = best->shift_;
+			mask_ = ((size_t)1 << (64 - shift_)) - 1;
+			count_ = best->count_;
+			generation_ = best->generation_;
+			log_length_ = best->log_length_;
+			return (true);
+		}
+		INFO(log_) << index_name << " is not usable; rebuilding it.";
+	}
+	if (index_fd_ != -1) {
+		::close(index_fd_);
+		index_fd_ = -1;
+	}
+
+	log_length_ = XCODEC_DISK_LOG_START;
+	count_ = 0;
+	return (create_index(64 - XCODEC_DISK_INDEX_INITIAL_SHIFT));
+}
+
+/*
+ * Create an index with 64 - shift bits' worth of lines, containing whatever
+ * is in the current index, under a temporary name and then move it into place.
+ */
+bool
+XCodecDiskCache::Writer::create_index(unsigned shift)
+{
+	std::string index_name = name_ + ".index";
+	std::string tmp_name = index_name + ".tmp";
+	size_t lines = (size_t)1 << (64 - shift);
+	size_t size = XCODEC_DISK_INDEX_START + lines * XCODEC_DISK_INDEX_SLOTS * sizeof (IndexSlot);
+
+	int fd = ::open(tmp_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (fd == -1) {
+		ERROR(log_) << "Could not create " << tmp_name << ": " << strerror(errno);
+		return (false);
+	}
+	if (::ftruncate(fd, size) == -1) {
+		ERROR(log_) << "Could not size " << tmp_name << ": " << strerror(errno);
+		::close(fd);
+		::unlink(tmp_name.c_str());
+		return (false);
+	}
+	uint8_t *map = (uint8_t *)::mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		ERROR(log_) << "Could not map " << tmp_name << ": " << strerror(errno);
+		::close(fd);
+		::unlink(tmp_name.c_str());
+		return (false);
+	}
+
+	uint8_t *old_index = index_;
+	size_t old_size = index_size_;
+	size_t old_mask = mask_;
+	int old_fd = index_fd_;
+
+	index_ = map;
+	index_size_ = size;
+	index_fd_ = fd;
+	shift_ = shift;
+	mask_ = lines - 1;
+	count_ = 0;
+
+	if (old_index != NULL) {
+		const IndexSlot *old_slots = (const IndexSlot *)(old_index + XCODEC_DISK_INDEX_START);
+		size_t i;
+
+		for (i = 0; i < (old_mask + 1) * XCODEC_DISK_INDEX_SLOTS; i++) {
+			if (old_slots[i].where_ == 0)
+				continue;
+			insert(old_slots[i].hash_, old_slots[i].where_ >> 16, old_slots[i].where_ & 0xffff);
+		}
+		::munmap(old_index, old_size);
+		::close(old_fd);
+	}
+
+	if (!commit())
+		return (false);
+	if (::rename(tmp_name.c_str(), index_name.c_str()) == -1) {
+		ERROR(log_) << "Could not rename " << tmp_name << ": " << strerror(errno);
+		return (false);
+	}
+	sync_directory(index_name);
+	return (true);
+}
+
+/*
+ * Sync the slots and then write and sync the older of the two headers.
+ */
+bool
+XCodecDiskCache::Writer::commit(void)
+{
+	if (::msync(index_, index_size_, MS_SYNC) == -1) {
+		ERROR(log_) << "Could not sync " << name_ << ".index: " << strerror(errno);
+		return (false);
+	}
+
+	generation_++;
+
+	IndexHeader *header = (IndexHeader *)(index_ + XCODEC_DISK_INDEX_HEADER(generation_));
+	header->magic_ = XCODEC_DISK_INDEX_MAGIC;
+	header->generation_ = generation_;
+	memcpy(header->uuid_, uuid_.string_.data(), UUID_SIZE);
+	header->shift_ = shift_;
+	header->log_length_ = log_length_;
+	header->count_ = count_;
+	header->check_ = checksum(header);
+
+	if (::msync(index_, XCODEC_DISK_INDEX_START, MS_SYNC) == -1) {
+		ERROR(log_) << "Could not sync " << name_ << ".index: " << strerror(errno);
+		return (false);
+	}
+	return (true);
+}
+
+/*
+ * Enter records in the log after those already in the index, and cut the log
+ * off at the first one which was not completely written.
+ */
+bool
+XCodecDiskCache::Writer::replay(void)
+{
+	struct stat st;
+
+	if (::fstat(log_fd_, &st) == -1) {
+		ERROR(log_) << "Could not stat " << name_ << ".log: " << strerror(errno);
+		return (false);
+	}
+
+	uint64_t size = st.st_size;
+	if (log_length_ > size) {
+		INFO(log_) << name_ << ".index is ahead of the log; rebuilding it.";
+		::munmap(index_, index_size_);
+		index_ = NULL;
+		::close(index_fd_);
+		index_fd_ = -1;
+		log_length_ = XCODEC_DISK_LOG_START;
+		count_ = 0;
+		if (!create_index(64 - XCODEC_DISK_INDEX_INITIAL_SHIFT))
+			return (false);
+	}
+	if (log_length_ == size)
+		return (true);
+
+	std::vector<uint8_t> buf(XCODEC_DISK_READ_SIZE);
+	uint64_t start = 0, end = 0;
+	size_t replayed = 0;
+	while (log_length_ != size) {
+		LogRecord record;
+
+		if (log_length_ + sizeof record + XCODEC_CHUNK_MAX > end && end != size) {
+			size_t len = std::min<uint64_t>(buf.size(), size - log_length_);
+			if (!read_fully(log_fd_, &buf[0], len, log_length_))
+				break;
+			start = log_length_;
+			end = log_length_ + len;
+		}
+		if (!record_valid(&buf[0], start, end, log_length_, &record, key_))
+			break;
+
+		if (!find(record.hash_)) {
+			if (!insert(record.hash_, log_length_, record.length_))
+				return (false);
+		}
+		log_length_ += sizeof record + record.length_;
+		replayed++;
+	}
+
+	if (log_length_ != size) {
+		INFO(log_) << "Truncating " << name_ << ".log from " << size << " to " << log_length_ << " bytes.";
+		if (::ftruncate(log_fd_, log_length_) == -1) {
+			ERROR(log_) << "Could not truncate " << name_ << ".log: " << strerror(errno);
+			return (false);
+		}
+	}
+	if (replayed != 0)
+		INFO(log_) << "Replayed " << replayed << " segments from " << name_ << ".log.";
+
+	return (commit());
+}
+
+/*
+ * Read each requested extent and the records in it which are complete within
+ * it and which have been written.
+ */
+void
+XCodecDiskCache::Reader::work(void)
+{
+	std::deque<uint64_t> requests;
+
+	mtx_.lock();
+	requests.swap(requests_);
+	mtx_.unlock();
+
+	std::vector<uint8_t> buf(XCODEC_DISK_FETCH_SIZE);
+	std::vector<Fetched> fetched;
+	while (!requests.empty()) {
+		uint64_t start = requests.front();
+		requests.pop_front();
+
+		uint64_t written = writer_->written();
+		size_t len = std::min<uint64_t>(buf.size(), written - start);
+		if (!read_fully(writer_->fd(), &buf[0], len, start)) {
+			ERROR(log_) << "Could not read log at " << start << ": " << strerror(errno);
+		} else {
+			uint64_t offset = start;
+			LogRecord record;
+
+			while (record_valid(&buf[0], start, start + len, offset, &record, writer_->key())) {
+				Fetched f;
+				f.start_ = start;
+				f.hash_ = record.hash_;
+				f.offset_ = offset;
+				f.seg_ = BufferSegment::create(&buf[offset + sizeof record - start], record.length_);
+				fetched.push_back(f);
+
+				offset += sizeof record + record.length_;
+			}
+		}
+
+		mtx_.lock();
+		fetched_.insert(fetched_.end(), fetched.begin(), fetched.end());
+		done_.push_back(start);
+		ready_.store(true, std::memory_order_relaxed);
+		mtx_.unlock();
+		fetched.clear();
+
+		ready_queue_.drain();
+	}
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef	XCODEC_XCODEC_DISK_CACHE_H
+#define	XCODEC_XCODEC_DISK_CACHE_H
+
+#include <set>
+
+#include <common/thread/thread.h>
+
+#include <xcodec/xcodec_cache.h>
+
+/*
+ * A cache kept in a directory on disk as well as in memory, so that it
+ * survives a restart along with its UUID, and so that it can hold far more
+ * data than fits in memory.  Each cache has two files there: an append-only
+ * log of segments, which begins with the UUID and is the authority on what
+ * the cache holds, and an index of the log by hash, which is mmap'd.  The
+ * local cache's files are named local.log and local.index; those of the
+ * caches of peers' data are named for the peer's UUID.
+ *
+ * Recently used data is held by an XCodecMemoryCache, which is filled from
+ * the most recently written part of the log, up to its budget, by the cache's
+ * own thread once the cache is opened.  The cache also keeps, in memory, where
+ * in the log everything it holds is, with a filter in front.  A lookup which misses in memory but finds
+ * the data in the log has a thread of the cache's own read that part of the
+ * log back into memory, and returns without waiting; since data tends to
+ * recur in the order it was first seen, the records after it are read too.
+ * The thread calls back to the event thread as each read finishes.
+ *
+ * New data is written behind by another thread, so that the event thread
+ * never waits on the disk.  If the disk falls far enough behind, new data is
+ * kept only in memory.
+ */
+class XCodecDiskCache : public XCodecCache {
+	class Locations;
+	class Reader;
+	class Writer;
+
+	LogHandle log_;
+	std::string directory_;
+	XCodecMemoryCache *cache_;
+	Writer *writer_;
+	Reader *reader_;
+	Locations *locations_;
+	XCodecFilter filter_;
+	uint64_t log_end_;
+	mutable std::set<uint64_t> fetching_;
+
+	XCodecDiskCache(const UUID&, const std::string&, Writer *, size_t, bool, bool);
+public:
+	~XCodecDiskCache();
+
+	void enter(const uint64_t&, BufferSegment *, BufferSegment ** = NULL);
+	BufferSegment *lookup(const uint64_t&) const;
+	void lookup_batch(const uint64_t *, BufferSegment **, unsigned) const;
+
+	bool fetch(const uint64_t& hash)
+	{
+		if (cache_->contains(hash))
+			return (true);
+		return (request(hash));
+	}
+
+	bool fetching(const uint64_t&) const;
+	Action *fetched(SimpleCallback *);
+	BufferSegment *lookup_wait(const uint64_t&);
+
+	bool admit(const uint64_t& hash, size_t length)
+	{
+		return (cache_->admit(hash, length));
+	}
+
+	bool evicted(uint64_t *, uint64_t *);
+
+	size_t budget(void) const
+	{
+		return (cache_->budget());
+	}
+
+	/*
+	 * Our own fetches_ are added to those of the memory cache.
+	 */
+	const XCodecCacheStatistics& statistics(void) const
+	{
+		uintmax_t fetches = statistics_.fetches_;
+		statistics_ = cache_->statistics();
+		statistics_.fetches_ = fetches;
+		return (statistics_);
+	}
+
+	bool out_of_band(void) const
+	{
+		return (false);
+	}
+
+	/*
+	 * Opens the peer's cache in the same directory, or falls back to one
+	 * in memory only if it cannot.  Data which could not be written would
+	 * be lost if it were evicted from memory, so without evict the peer's
+	 * cache keeps everything in memory as well.
+	 */
+	XCodecCache *peer(const UUID&, bool) const;
+
+	/*
+	 * Wait for everything entered so far to be written.
+	 */
+	void sync(void);
+
+	/*
+	 * Open or create the local cache in a directory, which is created if
+	 * it does not exist.  Returns NULL if the cache cannot be opened.
+	 */
+	static XCodecDiskCache *open(const std::string&, size_t = 0, bool = false, bool = false);
+
+private:
+	void collect(void) const;
+	bool request(const uint64_t&) const;
+
+	static XCodecDiskCache *open(const std::string&, const std::string&, const UUID *, size_t, bool, bool);
+};
+
+#endif /* !XCODEC_XCODEC_DISK_CACHE_H */
@@ -31,59 +31,134 @@
 #include <xcodec/xcodec_encoder.h>
 #include <xcodec/xcodec_hash.h>
 
-struct candidate_symbol {
-	bool set_;
-	unsigned offset_;
-	uint64_t symbol_;
-};
+/*
+ * How many offsets ahead the fixed-window encoder hashes and looks up.
+ */
+#define	XCODEC_ENCODER_LOOKAHEAD	(8)
+
+/*
+ * How many hashes the peer has evicted to remember.
+ */
+#define	XCODEC_ENCODER_FORGOTTEN_MAX	(65536)
+
+/*
+ * Content-defined chunk boundaries are found with a gear hash: each byte
+ * shifts the hash left and adds a random value for that byte, so the top bits
+ * depend on the last 64 bytes or so.  A chunk ends where the bits in the mask
+ * are all clear.  As in FastCDC, the mask used until a chunk is
+ * XCODEC_CHUNK_AVG bytes long has more bits than the one used after, which
+ * keeps most chunk lengths close to that.
+ *
+ * The table only needs to be the same wherever the same chunks should be
+ * found again, so it is generated from a fixed seed with SplitMix64.
+ */
+#define	XCODEC_CHUNK_MASK_SMALL	(0xfffc000000000000ull)	/* 14 bits.  */
+#define	XCODEC_CHUNK_MASK_LARGE	(0xffc0000000000000ull)	/* 10 bits.  */
+#define	XCODEC_CHUNK_GEAR_SEED	(0x786364636763ull)
+
+namespace {
+	struct GearTable {
+		uint64_t table_[256];
+
+		GearTable(void)
+		{
+			uint64_t x = XCODEC_CHUNK_GEAR_SEED;
+			unsigned i;
+
+			for (i = 0; i < 256; i++) {
+				uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+				z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+				z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+				table_[i] = z ^ (z >> 31);
+			}
+		}
+	};
+
+	static const GearTable gear_table;
+
+	/*
+	 * Add bytes from p up to e to the gear hash until the bits in mask
+	 * are all clear, and return where it stopped.
+	 */
+	static const uint8_t *
+	chunk_scan(const uint8_t *p, const uint8_t *e, uint64_t mask, uint64_t *gearp)
+	{
+		uint64_t gear = *gearp;
+
+		while (p < e) {
+			gear = (gear << 1) + gear_table.table_[*p++];
+			if ((gear & mask) == 0)
+				break;
+		}
+
+		*gearp = gear;
+		return (p);
+	}
+
+	/*
+	 * Drop the references from lookups which will not be used.
+	 */
+	static void
+	lookahead_release(BufferSegment **segs, unsigned n)
+	{
+		unsigned i;
+
+		for (i = 0; i < n; i++) {
+			if (segs[i] != NULL)
+				segs[i]->unref();
+		}
+	}
+}
 
 XCodecEncoder::XCodecEncoder(XCodecCache *cache)
 : log_("/xcodec/encoder"),
   cache_(cache),
   window_(),
-  stream_(!cache_->out_of_band())
+  stream_(!cache_->out_of_band()),
+  hash_(),
+  candidate_(),
+  queue_(),
+  offset_(0),
+  chunking_(false),
+  gear_(0),
+  forgotten_(),
+  pinning_(false),
+  pinned_()
 { }
 
 XCodecEncoder::~XCodecEncoder()
-{ }
+{
+	set_pinning(false);
+}
 
 /*
  * This takes a view of a data stream and turns it into a series of references
  * to other data, declarations of data to be referenced, and data that needs
  * escaped.
+ *
+ * Data that may yet become part of a reference or declaration is kept in
+ * queue_ for the next call, with offset_ bytes of it in the rolling hash.
+ *
+ * The hashes at up to XCODEC_ENCODER_LOOKAHEAD offsets are computed and looked
+ * up in the cache together, so that the cache can overlap those lookups.  The
+ * rolling hash then runs ahead of p, and hashes[next] is the hash at p.
  */
 void
 XCodecEncoder::encode(Buffer *output, Buffer *input)
 {
-	if (input->empty())
-		return;
-
-	if (input->length() < XCODEC_SEGMENT_LENGTH) {
-		encode_escape(output, input, input->length());
+	if (chunking_) {
+		encode_chunks(output, input);
 		return;
 	}
 
-	XCodecHash xcodec_hash;
-	candidate_symbol candidate;
-	Buffer outq;
-	unsigned o = 0;
-
-	candidate.set_ = false;
+	uint64_t hashes[XCODEC_ENCODER_LOOKAHEAD];
+	BufferSegment *osegs[XCODEC_ENCODER_LOOKAHEAD];
+	unsigned next = 0, ahead = 0;
 
 	/*
 	 * While there is input.
 	 */
 	while (!input->empty()) {
-		/*
-		 * If we cannot acquire a complete hash within this segment,
-		 * stop looking.
-		 */
-		if (o + input->length() < XCODEC_SEGMENT_LENGTH) {
-			DEBUG(log_) << "Buffer couldn't yield a hash.";
-			input->moveout(&outq);
-			break;
-		}
-
 		/*
 		 * Take the first BufferSegment out of the input Buffer.
 		 */
@@ -91,141 +166,163 @@ XCodecEncoder::encode(Buffer *output, Buffer *input)
 		input->moveout(&seg);
 
 		/*
-		 * And add it to a temporary Buffer where input is queued.
+		 * Keep a copy of the end of the queued data, so that bytes can
+		 * be rolled out of the hash while it still spans the start of
+		 * this BufferSegment.
+		 */
+		uint8_t tail[XCODEC_SEGMENT_LENGTH];
+		unsigned taillen = std::min(offset_, (unsigned)XCODEC_SEGMENT_LENGTH);
+		if (taillen != 0)
+			queue_.copyout(tail, offset_ - taillen, taillen);
+
+		/*
+		 * And add it to the Buffer where input is queued.
 		 */
-		outq.append(seg);
+		queue_.append(seg);
 
 		/*
 		 * And for every byte in this BufferSegment.
 		 */
 		const uint8_t *p, *q = seg->end();
 		for (p = seg->data(); p < q; p++) {
-			ptrdiff_t resid = q - p;
-
 			/*
-			 * If we cannot acquire a complete hash within this segment.
+			 * If we have no hashes looked up ahead, get some.
 			 */
-			if (o + resid < XCODEC_SEGMENT_LENGTH) {
+			if (next == ahead) {
+				ptrdiff_t resid = q - p;
+				unsigned j = 0;
+
 				/*
-				 * Hash all of the bytes from it and continue.
+				 * If we cannot acquire a complete hash within
+				 * this segment.
 				 */
-				o += resid;
-				while (p < q)
-					xcodec_hash.add(*p++);
-				break;
-			}
-
-			/*
-			 * If we don't have a complete hash.
-			 */
-			if (o < XCODEC_SEGMENT_LENGTH) {
-				for (;;) {
+				if (offset_ + resid < XCODEC_SEGMENT_LENGTH) {
 					/*
-					 * Add bytes to the hash.
+					 * Hash all of the bytes from it and
+					 * continue.
 					 */
-					xcodec_hash.add(*p);
+					hash_.add(p, resid);
+					offset_ += resid;
+					break;
+				}
 
+				/*
+				 * If we don't have a complete hash.
+				 */
+				if (offset_ < XCODEC_SEGMENT_LENGTH) {
 					/*
-					 * Until we have a complete hash.
+					 * Add bytes to the hash until we do,
+					 * leaving p on the last of them.
 					 */
-					if (++o == XCODEC_SEGMENT_LENGTH)
-						break;
+					unsigned n = XCODEC_SEGMENT_LENGTH - offset_;
+					if (offset_ == 0)
+						hash_.fill(p);
+					else
+						hash_.add(p, n);
+					offset_ += n - 1;
+					p += n - 1;
+
+					hashes[j++] = hash_.mix();
+				}
+
+				/*
+				 * Roll the bytes after that into the rolling
+				 * hash, and roll out the bytes from the start
+				 * of the hash, which may still be in the tail
+				 * of earlier data.
+				 */
+				ahead = std::min((ptrdiff_t)XCODEC_ENCODER_LOOKAHEAD, q - p);
+				for (; j < ahead; j++) {
+					size_t pos = (p + j) - seg->data();
+					uint8_t dead;
+					if (pos >= XCODEC_SEGMENT_LENGTH)
+						dead = (p + j)[-XCODEC_SEGMENT_LENGTH];
+					else
+						dead = tail[taillen - (XCODEC_SEGMENT_LENGTH - pos)];
+					hash_.roll(p[j], dead);
 
 					/*
-					 * Go to the next byte.
+					 * And then mix the hash's internal
+					 * state into a uint64_t that we can
+					 * use to refer to that data and to
+					 * look up possible past occurances of
+					 * that data in the XCodecCache.
 					 */
-					p++;
+					hashes[j] = hash_.mix();
 				}
-				ASSERT(log_, o == XCODEC_SEGMENT_LENGTH);
-			} else {
-				/*
-				 * Roll it into the rolling hash.
-				 */
-				xcodec_hash.roll(*p);
-				o++;
+
+				cache_->lookup_batch(hashes, osegs, ahead);
+				next = 0;
 			}
 
-			ASSERT(log_, o >= XCODEC_SEGMENT_LENGTH);
-			ASSERT(log_, p != q);
+			offset_++;
 
-			/*
-			 * And then mix the hash's internal state into a
-			 * uint64_t that we can use to refer to that data
-			 * and to look up possible past occurances of that
-			 * data in the XCodecCache.
-			 */
-			unsigned start = o - XCODEC_SEGMENT_LENGTH;
-			uint64_t hash = xcodec_hash.mix();
+			uint64_t hash = hashes[next];
+			BufferSegment *oseg = osegs[next];
+			next++;
+
+			ASSERT(log_, offset_ >= XCODEC_SEGMENT_LENGTH);
+
+			unsigned start = offset_ - XCODEC_SEGMENT_LENGTH;
 
 			/*
 			 * If there is a pending candidate hash that wouldn't
 			 * overlap with the data that the rolling hash presently
 			 * covers, declare it now.
 			 */
-			if (candidate.set_ && candidate.offset_ + XCODEC_SEGMENT_LENGTH <= start) {
-				BufferSegment *nseg;
-				encode_declaration(output, &outq, candidate.offset_, candidate.symbol_, &nseg);
+			if (candidate_.set_ && candidate_.offset_ + XCODEC_SEGMENT_LENGTH <= start) {
+				encode_declaration(output, &queue_, candidate_.offset_, candidate_.symbol_);
 
-				o -= candidate.offset_ + XCODEC_SEGMENT_LENGTH;
-				start = o - XCODEC_SEGMENT_LENGTH;
+				offset_ -= candidate_.offset_ + XCODEC_SEGMENT_LENGTH;
+				start = offset_ - XCODEC_SEGMENT_LENGTH;
 
-				candidate.set_ = false;
+				candidate_.set_ = false;
 
 				/*
 				 * If, on top of that, the just-declared hash is
-				 * the same as the current hash, consider referencing
-				 * it immediately.
+				 * the same as the current hash or one looked up
+				 * ahead, it can be referenced now, so look it
+				 * up again.
 				 */
-				if (hash == candidate.symbol_) {
-					/*
-					 * If it's a hash collision, though, nevermind.
-					 * Skip trying to use this hash as a reference,
-					 * too, and go on to the next one.
-					 */
-					if (!encode_reference(output, &outq, start, hash, nseg)) {
-						nseg->unref();
-						DEBUG(log_) << "Collision in adjacent-declare pass.";
-						continue;
-					}
-					nseg->unref();
-
-					/*
-					 * But if there's no collection, then we can move
-					 * on to looking for the *next* hash/data to declare
-					 * or reference.
-					 */
-					o = 0;
-					xcodec_hash.reset();
-
-					DEBUG(log_) << "Hit in adjacent-declare pass.";
-					continue;
+				if (hash == candidate_.symbol_ && oseg == NULL)
+					oseg = cache_->lookup(hash);
+				unsigned j;
+				for (j = next; j < ahead; j++) {
+					if (hashes[j] == candidate_.symbol_ && osegs[j] == NULL)
+						osegs[j] = cache_->lookup(hashes[j]);
 				}
-				nseg->unref();
 			}
 
 			/*
 			 * Now attempt to encode this hash as a reference if it
 			 * has been defined before.
 			 */
-			BufferSegment *oseg = cache_->lookup(hash);
 			if (oseg != NULL) {
 				/*
 				 * This segment already exists.  If it's
 				 * identical to this chunk of data, then that's
 				 * positively fantastic.
 				 */
-				if (encode_reference(output, &outq, start, hash, oseg)) {
+				if (encode_reference(output, &queue_, start, hash, oseg)) {
 					oseg->unref();
 
-					o = 0;
-					xcodec_hash.reset();
+					offset_ = 0;
+					hash_.reset();
+
+					/*
+					 * The hashes looked up ahead were
+					 * for data that has now been
+					 * referenced.
+					 */
+					lookahead_release(osegs + next, ahead - next);
+					next = ahead = 0;
 
 					/*
 					 * We have output any data before this hash
 					 * in escaped form, so any candidate hash
 					 * before it is invalid now.
 					 */
-					candidate.set_ = false;
+					candidate_.set_ = false;
 					continue;
 				}
 
@@ -236,7 +333,7 @@ XCodecEncoder::encode(Buffer *output, Buffer *input)
 				 *
 				 * XXX
 				 * If this is the first hash (i.e.
-				 * !candidate.set_) then we can adjust the
+				 * !candidate_.set_) then we can adjust the
 				 * start of the current window and escape the
 				 * first byte right away.  Does that help?
 				 */
@@ -249,14 +346,14 @@ XCodecEncoder::encode(Buffer *output, Buffer *input)
 			 * Not defined before, it's a candidate for declaration
 			 * if we don't already have one.
 			 */
-			if (candidate.set_) {
+			if (candidate_.set_) {
 				/*
 				 * We already have a hash that occurs earlier,
 				 * isn't a collision and includes data that's
 				 * covered by this hash, so don't remember it
 				 * and keep going.
 				 */
-				ASSERT(log_, candidate.offset_ + XCODEC_SEGMENT_LENGTH > start);
+				ASSERT(log_, candidate_.offset_ + XCODEC_SEGMENT_LENGTH > start);
 				continue;
 			}
 
@@ -267,53 +364,216 @@ XCodecEncoder::encode(Buffer *output, Buffer *input)
 			 * find something to reference we can declare this one
 			 * for future use.
 			 */
-			candidate.offset_ = start;
-			candidate.symbol_ = hash;
-			candidate.set_ = true;
+			candidate_.offset_ = start;
+			candidate_.symbol_ = hash;
+			candidate_.set_ = true;
 		}
+		ASSERT(log_, next == ahead);
 
 		seg->unref();
 	}
 
+	ASSERT(log_, offset_ == queue_.length());
+}
+
+/*
+ * Declare any candidate hash and escape any data that remains queued, so that
+ * everything passed to encode() so far is represented in the output.
+ */
+void
+XCodecEncoder::flush(Buffer *output)
+{
 	/*
-	 * Done processing input.  If there's still data in the outq Buffer,
-	 * then we need to declare any candidate hashes and escape any data
-	 * after them.
+	 * A chunk cut short is still worth declaring if it is at least as
+	 * long as the shortest chunk.
 	 */
+	if (chunking_ && offset_ >= XCODEC_CHUNK_MIN)
+		encode_chunk(output, offset_);
 
 	/*
 	 * There's a hash we can declare, do it.
 	 */
-	if (candidate.set_) {
-		ASSERT(log_, !outq.empty());
-		encode_declaration(output, &outq, candidate.offset_, candidate.symbol_, NULL);
-		candidate.set_ = false;
+	if (candidate_.set_) {
+		ASSERT(log_, !queue_.empty());
+		encode_declaration(output, &queue_, candidate_.offset_, candidate_.symbol_);
+		candidate_.set_ = false;
 	}
 
 	/*
 	 * There's data after that hash or no candidate hash, so
 	 * just escape it.
 	 */
-	if (!outq.empty()) {
-		encode_escape(output, &outq, outq.length());
+	if (!queue_.empty()) {
+		encode_escape(output, &queue_, queue_.length());
 	}
 
-	ASSERT(log_, !candidate.set_);
-	ASSERT(log_, outq.empty());
-	ASSERT(log_, input->empty());
+	offset_ = 0;
+	hash_.reset();
+	gear_ = 0;
+
+	ASSERT(log_, queue_.empty());
 }
 
+/*
+ * Switch to content-defined chunking, flushing anything held first.
+ */
 void
-XCodecEncoder::encode_declaration(Buffer *output, Buffer *input, unsigned offset, uint64_t hash, BufferSegment **segp)
+XCodecEncoder::set_chunking(Buffer *output)
+{
+	flush(output);
+	chunking_ = true;
+}
+
+/*
+ * Reference the chunk of length bytes at the start of queue_ if it is known,
+ * or else declare it.
+ */
+void
+XCodecEncoder::encode_chunk(Buffer *output, unsigned length)
+{
+	BufferSegment *seg;
+	queue_.copyout(&seg, length);
+
+	uint64_t hash = cache_->hash(seg->data(), length);
+
+	BufferSegment *oseg = cache_->lookup(hash);
+	if (oseg != NULL) {
+		if (oseg->equal(seg)) {
+			queue_.skip(length);
+			encode_symbol(output, hash, oseg);
+		} else {
+			/*
+			 * There is no other chunk to try, so escape it.
+			 */
+			DEBUG(log_) << "Collision in chunk.";
+			encode_escape(output, &queue_, length);
+		}
+		oseg->unref();
+		seg->unref();
+		return;
+	}
+
+	if (!cache_->admit(hash, length)) {
+		seg->unref();
+		encode_escape(output, &queue_, length);
+		return;
+	}
+
+	queue_.skip(length);
+
+	/*
+	 * Hold on to the cache's copy rather than ours.
+	 */
+	BufferSegment *kept;
+	cache_->enter(hash, seg, &kept);
+	seg->unref();
+	seg = kept;
+
+	if (!stream_) {
+		/*
+		 * Declarations occur out-of-band.
+		 */
+		encode_symbol(output, hash, seg);
+		seg->unref();
+		return;
+	}
+
+	/*
+	 * Declarations are extracted in-band.
+	 */
+	encode_extract(output, hash, seg);
+	seg->unref();
+}
+
+/*
+ * Cut input into content-defined chunks and encode each of them whole.  The
+ * chunk in progress is kept in queue_, offset_ bytes of it, with the gear hash
+ * over it in gear_.
+ */
+void
+XCodecEncoder::encode_chunks(Buffer *output, Buffer *input)
+{
+	while (!input->empty()) {
+		BufferSegment *seg;
+		input->moveout(&seg);
+
+		queue_.append(seg);
+
+		const uint8_t *p = seg->data(), *q = seg->end();
+		while (p < q) {
+			size_t resid = q - p;
+
+			/*
+			 * No chunk ends within its first XCODEC_CHUNK_MIN
+			 * bytes, so don't bother hashing them.
+			 */
+			if (offset_ < XCODEC_CHUNK_MIN) {
+				unsigned n = std::min(resid, (size_t)(XCODEC_CHUNK_MIN - offset_));
+				offset_ += n;
+				p += n;
+				continue;
+			}
+
+			uint64_t mask;
+			unsigned limit;
+			if (offset_ < XCODEC_CHUNK_AVG) {
+				mask = XCODEC_CHUNK_MASK_SMALL;
+				limit = XCODEC_CHUNK_AVG;
+			} else {
+				mask = XCODEC_CHUNK_MASK_LARGE;
+				limit = XCODEC_CHUNK_MAX;
+			}
+
+			const uint8_t *e = p + std::min(resid, (size_t)(limit - offset_));
+			const uint8_t *b = chunk_scan(p, e, mask, &gear_);
+			offset_ += b - p;
+			p = b;
+
+			if ((gear_ & mask) != 0 && offset_ != XCODEC_CHUNK_MAX)
+				continue;
+
+			encode_chunk(output, offset_);
+			offset_ = 0;
+			gear_ = 0;
+		}
+
+		seg->unref();
+	}
+
+	ASSERT(log_, offset_ == queue_.length());
+}
+
+void
+XCodecEncoder::encode_declaration(Buffer *output, Buffer *input, unsigned offset, uint64_t hash)
 {
 	if (offset != 0) {
 		encode_escape(output, input, offset);
 	}
 
-	BufferSegment *nseg;
-	input->copyout(&nseg, XCODEC_SEGMENT_LENGTH);
+	/*
+	 * Another encoder sharing the cache may have declared this hash while
+	 * it was our candidate, so reference it if it is now known.
+	 */
+	BufferSegment *oseg = cache_->lookup(hash);
+	if (oseg != NULL) {
+		if (!encode_reference(output, input, 0, hash, oseg)) {
+			DEBUG(log_) << "Collision in declaration.";
+			encode_escape(output, input, XCODEC_SEGMENT_LENGTH);
+		}
+		oseg->unref();
+		return;
+	}
+
+	if (!cache_->admit(hash, XCODEC_SEGMENT_LENGTH)) {
+		encode_escape(output, input, XCODEC_SEGMENT_LENGTH);
+		return;
+	}
+
+	BufferSegment *seg, *nseg;
+	input->copyout(&seg, XCODEC_SEGMENT_LENGTH);
 
-	cache_->enter(hash, nseg);
+	cache_->enter(hash, seg, &nseg);
+	seg->unref();
 
 	if (!stream_) {
 		/*
@@ -321,31 +581,20 @@ XCodecEncoder::encode_declaration(Buffer *output, Buffer *input, unsigned offset
 		 */
 		if (!encode_reference(output, input, 0, hash, nseg)) /* XXX Pass NULL not nseg to skip check?  */
 			NOTREACHED(log_);
-		if (segp == NULL)
-			nseg->unref();
-		else
-			*segp = nseg;
+		nseg->unref();
 		return;
 	}
 
 	/*
 	 * Declarations are extracted in-band.
 	 */
-	output->append(XCODEC_MAGIC);
-	output->append(XCODEC_OP_EXTRACT);
-	output->append(nseg);
-
-	window_.declare(hash, nseg);
-	if (segp == NULL)
-		nseg->unref();
+	encode_extract(output, hash, nseg);
+	nseg->unref();
 
 	/*
 	 * Skip to the end.
 	 */
 	input->skip(XCODEC_SEGMENT_LENGTH);
-
-	if (segp != NULL)
-		*segp = nseg;
 }
 
 void
@@ -367,8 +616,9 @@ XCodecEncoder::encode_escape(Buffer *output, Buffer *input, unsigned length)
 			input->skip(offset);
 		}
 
-		output->append(XCODEC_MAGIC);
-		output->append(XCODEC_OP_ESCAPE);
+		BufferWriter w(output, 2);
+		w.append(XCODEC_MAGIC);
+		w.append(XCODEC_OP_ESCAPE);
 
 		length -= sizeof XCODEC_MAGIC;
 		input->skip(sizeof XCODEC_MAGIC);
@@ -396,19 +646,106 @@ XCodecEncoder::encode_reference(Buffer *output, Buffer *input, unsigned offset,
 	/*
 	 * And output a reference.
 	 */
+	encode_symbol(output, hash, oseg);
+
+	return (true);
+}
+
+/*
+ * Output a reference to oseg, by its place in the window if it's there.  If
+ * the peer has evicted it, extract it again instead, and otherwise pin it if
+ * we are pinning.
+ */
+void
+XCodecEncoder::encode_symbol(Buffer *output, uint64_t hash, BufferSegment *oseg)
+{
 	uint8_t b;
 	if (window_.present(hash, &b)) {
-		output->append(XCODEC_MAGIC);
-		output->append(XCODEC_OP_BACKREF);
-		output->append(b);
-	} else {
-		output->append(XCODEC_MAGIC);
-		output->append(XCODEC_OP_REF);
-		uint64_t behash = BigEndian::encode(hash);
-		output->append(&behash);
-
-		window_.declare(hash, oseg);
+		if (pinning_) {
+			oseg->ref();
+			pinned_.push_back(oseg);
+		}
+
+		BufferWriter w(output, 3);
+		w.append(XCODEC_MAGIC);
+		w.append(XCODEC_OP_BACKREF);
+		w.append(b);
+		return;
 	}
 
-	return (true);
+	if (!forgotten_.empty() && forgotten_.erase(hash) != 0) {
+		DEBUG(log_) << "Extracting data the peer has evicted.";
+		encode_extract(output, hash, oseg);
+		return;
+	}
+
+	if (pinning_) {
+		oseg->ref();
+		pinned_.push_back(oseg);
+	}
+
+	BufferWriter w(output, 2 + sizeof hash);
+	w.append(XCODEC_MAGIC);
+	w.append(XCODEC_OP_REF);
+	BigEndian::append(&w, hash);
+
+	window_.declare(hash, oseg);
+}
+
+/*
+ * Output seg with its declaration.
+ */
+void
+XCodecEncoder::encode_extract(Buffer *output, uint64_t hash, BufferSegment *seg)
+{
+	{
+		BufferWriter w(output, 2 + sizeof (uint16_t));
+		w.append(XCODEC_MAGIC);
+		if (seg->length() == XCODEC_SEGMENT_LENGTH) {
+			w.append(XCODEC_OP_EXTRACT);
+		} else {
+			w.append(XCODEC_OP_EXTRACT_CHUNK);
+			BigEndian::append(&w, (uint16_t)seg->length());
+		}
+	}
+	output->append(seg);
+
+	window_.declare(hash, seg);
+}
+
+/*
+ * Note that the peer has evicted hash, so that it is extracted rather than
+ * referenced next time.  If the peer evicts more than can be remembered,
+ * forget them all; references to them will just cost an <ASK>.
+ */
+void
+XCodecEncoder::forget(uint64_t hash)
+{
+	if (forgotten_.size() == XCODEC_ENCODER_FORGOTTEN_MAX)
+		forgotten_.clear();
+	forgotten_.insert(hash);
+}
+
+void
+XCodecEncoder::set_pinning(bool pinning)
+{
+	pinning_ = pinning;
+	if (pinning_)
+		return;
+
+	std::vector<BufferSegment *>::const_iterator it;
+	for (it = pinned_.begin(); it != pinned_.end(); ++it)
+		(*it)->unref();
+	pinned_.clear();
+}
+
+/*
+ * Append the data pinned since the last call to segs, along with our
+ * references to it.
+ */
+void
+XCodecEncoder::pinned(std::vector<BufferSegment *> *segs)
+{
+	segs->insert(segs->end(), pinned_.begin(), pinned_.end());
+	pinned_.clear();
 }
@@ -26,25 +26,92 @@
 #ifndef	XCODEC_XCODEC_ENCODER_H
 #define	XCODEC_XCODEC_ENCODER_H
 
+#include <set>
+#include <vector>
+
+#include <xcodec/xcodec_hash.h>
 #include <xcodec/xcodec_window.h>
 
 class XCodecCache;
 
+/*
+ * The encoder is streaming: input which may yet be part of a reference or
+ * declaration is held, along with the rolling hash over it, until more input
+ * arrives or the caller calls flush().  Output therefore does not depend on
+ * how the input happens to be split between calls to encode().
+ *
+ * Once set_chunking() has been called, input is instead cut into
+ * content-defined chunks, each of which is looked up once and referenced or
+ * declared whole.  The decoder must support OP_EXTRACT_CHUNK.
+ */
 class XCodecEncoder {
+	struct Candidate {
+		bool set_;
+		unsigned offset_;
+		uint64_t symbol_;
+
+		Candidate(void)
+		: set_(false),
+		  offset_(0),
+		  symbol_(0)
+		{ }
+	};
+
 	LogHandle log_;
 	XCodecCache *cache_;
 	XCodecWindow window_;
 	bool stream_;
 
+	XCodecHash hash_;
+	Candidate candidate_;
+	Buffer queue_;
+	unsigned offset_;
+
+	bool chunking_;
+	uint64_t gear_;
+
+	std::set<uint64_t> forgotten_;
+
+	bool pinning_;
+	std::vector<BufferSegment *> pinned_;
+
 public:
 	XCodecEncoder(XCodecCache *);
 	~XCodecEncoder();
 
 	void encode(Buffer *, Buffer *);
+	void flush(Buffer *);
+
+	bool pending(void) const
+	{
+		return (!queue_.empty());
+	}
+
+	bool chunking(void) const
+	{
+		return (chunking_);
+	}
+
+	void set_chunking(Buffer *);
+
+	void forget(uint64_t);
+
+	/*
+	 * While pinning, the encoder takes a reference to the data of each
+	 * reference it outputs, which the caller takes over with pinned(), so
+	 * that the data can be kept until the peer will no longer <ASK> for
+	 * it.
+	 */
+	void set_pinning(bool);
+	void pinned(std::vector<BufferSegment *> *);
 private:
-	void encode_declaration(Buffer *, Buffer *, unsigned, uint64_t, BufferSegment **);
+	void encode_chunk(Buffer *, unsigned);
+	void encode_chunks(Buffer *, Buffer *);
+	void encode_declaration(Buffer *, Buffer *, unsigned, uint64_t);
 	void encode_escape(Buffer *, Buffer *, unsigned);
+	void encode_extract(Buffer *, uint64_t, BufferSegment *);
 	bool encode_reference(Buffer *, Buffer *, unsigned, uint64_t, BufferSegment *);
+	void encode_symbol(Buffer *, uint64_t, BufferSegment *);
 };
 
 #endif /* !XCODEC_XCODEC_ENCODER_H */
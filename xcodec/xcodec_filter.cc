@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <common/buffer.h>
+
+#include <xcodec/xcodec_filter.h>
+
+#define	XCODEC_FILTER_INITIAL_CAPACITY	(1024)
+
+XCodecFilter::XCodecFilter(void)
+: blocks_(NULL),
+  shift_(64),
+  capacity_(0)
+{
+	reset(XCODEC_FILTER_INITIAL_CAPACITY);
+}
+
+XCodecFilter::~XCodecFilter()
+{
+	free(blocks_);
+	blocks_ = NULL;
+}
+
+void
+XCodecFilter::reset(size_t n)
+{
+	size_t nblocks = 2;
+	unsigned bits = 1;
+
+	while (nblocks * XCODEC_FILTER_BLOCK_BITS < n * XCODEC_FILTER_ENTRY_BITS) {
+		nblocks *= 2;
+		bits++;
+	}
+
+	free(blocks_);
+
+	void *p;
+	if (posix_memalign(&p, XCODEC_FILTER_BLOCK, nblocks * sizeof (Block)) != 0)
+		HALT("/xcodec/filter") << "Could not allocate " << nblocks << " blocks.";
+	memset(p, 0, nblocks * sizeof (Block));
+
+	blocks_ = (Block *)p;
+	shift_ = 64 - bits;
+	capacity_ = nblocks * XCODEC_FILTER_BLOCK_BITS / XCODEC_FILTER_ENTRY_BITS;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef	XCODEC_XCODEC_FILTER_H
+#define	XCODEC_XCODEC_FILTER_H
+
+/*
+ * A blocked Bloom filter of hashes, for rejecting most lookups of hashes
+ * which are not in a cache without probing its index.  Each hash sets four
+ * bits within a single 64-byte block, so a test touches only one line, and
+ * the filter is kept at between 8 and 16 bits per entry, which is small
+ * enough to stay in L2 for caches of a few hundred thousand segments.
+ *
+ * Entries cannot be removed, and the filter must be rebuilt from its owner's
+ * entries when it fills up.
+ */
+#define	XCODEC_FILTER_BLOCK		(64)
+#define	XCODEC_FILTER_BLOCK_BITS	(XCODEC_FILTER_BLOCK * 8)
+#define	XCODEC_FILTER_BLOCK_WORDS	(XCODEC_FILTER_BLOCK / sizeof (uint64_t))
+#define	XCODEC_FILTER_BLOCK_HASHES	(4)
+#define	XCODEC_FILTER_ENTRY_BITS	(8)
+
+class XCodecFilter {
+	struct Block {
+		uint64_t words_[XCODEC_FILTER_BLOCK_WORDS];
+	} __attribute__((__aligned__(XCODEC_FILTER_BLOCK)));
+
+	Block *blocks_;
+	unsigned shift_;
+	size_t capacity_;
+public:
+	XCodecFilter(void);
+	~XCodecFilter();
+
+	void insert(uint64_t hash)
+	{
+		Block *bp = &blocks_[block(hash)];
+		unsigned i;
+
+		for (i = 0; i < XCODEC_FILTER_BLOCK_HASHES; i++) {
+			unsigned b = bit(hash, i);
+			bp->words_[b / 64] |= (uint64_t)1 << (b % 64);
+		}
+	}
+
+	/*
+	 * False if the hash has not been inserted, true if it may have been.
+	 */
+	bool test(uint64_t hash) const
+	{
+		const Block *bp = &blocks_[block(hash)];
+		unsigned i;
+
+		for (i = 0; i < XCODEC_FILTER_BLOCK_HASHES; i++) {
+			unsigned b = bit(hash, i);
+			if ((bp->words_[b / 64] & ((uint64_t)1 << (b % 64))) == 0)
+				return (false);
+		}
+		return (true);
+	}
+
+	void prefetch(uint64_t hash) const
+	{
+		__builtin_prefetch(&blocks_[block(hash)]);
+	}
+
+	/*
+	 * The number of entries the filter is sized for.
+	 */
+	size_t capacity(void) const
+	{
+		return (capacity_);
+	}
+
+	/*
+	 * Empty the filter and size it for at least n entries.
+	 */
+	void reset(size_t);
+
+private:
+	/*
+	 * Uses a different multiplier than XCodecIndex, so that hashes which
+	 * share a line there are spread across blocks here.
+	 */
+	size_t block(uint64_t hash) const
+	{
+		return ((hash * 0xc4ceb9fe1a85ec53ull) >> shift_);
+	}
+
+	/*
+	 * The bits within the block come 9 at a time from the top of yet
+	 * another product.
+	 */
+	static unsigned bit(uint64_t hash, unsigned i)
+	{
+		return (((hash * 0xff51afd7ed558ccdull) >> (64 - 9 * (i + 1))) & (XCODEC_FILTER_BLOCK_BITS - 1));
+	}
+};
+
+#endif /* !XCODEC_XCODEC_FILTER_H */
@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define	XCODEC_HASH_VECTOR
+#endif
+
+#include <string.h>
+
+#include <common/endian.h>
+
+#include <xcodec/xcodec.h>
+#include <xcodec/xcodec_hash.h>
+
+/*
+ * Hashing a whole segment at once from a reset state.
+ *
+ * With words w[i] = data[i] + 1 and bits b[i] = ffs(data[i]), adding all of
+ * them one at a time leaves sum1 = w[0] + ... + w[n-1] and sum2 = n * w[0] +
+ * (n - 1) * w[1] + ... + w[n-1], and the same for the bits.  The vector
+ * kernels compute these a block at a time, in the manner of Adler-32: sum2
+ * gains the block length times sum1 so far, plus the block's own sum weighted
+ * by position within it.  The + 1 in each word only adds the constants n and
+ * n * (n + 1) / 2.  ffs() of each byte is looked up a nibble at a time.
+ *
+ * Each kernel sets sums to bytes sum1, bytes sum2, bits sum1 and bits sum2.
+ */
+
+namespace {
+	typedef	bool (*hash_fill_t)(const uint8_t *, uint32_t *);
+
+	static bool hash_fill_none(const uint8_t *, uint32_t *);
+#if defined(XCODEC_HASH_VECTOR)
+	static bool hash_fill_ssse3(const uint8_t *, uint32_t *) __attribute__((__target__("ssse3")));
+	static bool hash_fill_avx2(const uint8_t *, uint32_t *) __attribute__((__target__("avx2")));
+#endif
+	static bool hash_fill_select(const uint8_t *, uint32_t *);
+
+	static hash_fill_t hash_fill_vector = hash_fill_select;
+}
+
+void
+XCodecHash::fill(const uint8_t *data)
+{
+#ifndef NDEBUG
+	ASSERT("/xcodec/hash", length_ == 0);
+#endif
+
+	uint32_t sums[4];
+	if (!hash_fill_vector(data, sums)) {
+		add(data, XCODEC_SEGMENT_LENGTH);
+		return;
+	}
+
+	bytes_.sum1_ = sums[0] + XCODEC_SEGMENT_LENGTH;
+	bytes_.sum2_ = sums[1] + XCODEC_SEGMENT_LENGTH * (XCODEC_SEGMENT_LENGTH + 1) / 2;
+	bits_.sum1_ = sums[2];
+	bits_.sum2_ = sums[3];
+
+#ifndef NDEBUG
+	length_ = XCODEC_SEGMENT_LENGTH;
+#endif
+}
+
+/*
+ * Chunks of other lengths are hashed once each, never rolled, so they can
+ * afford SipHash-2-4, under a key that peers share.
+ */
+#define	XCODEC_HASH_SIP_ROTATE(x, b)	(((x) << (b)) | ((x) >> (64 - (b))))
+
+namespace {
+	struct SipState {
+		uint64_t v0_, v1_, v2_, v3_;
+
+		SipState(const XCodecHashKey& key)
+		: v0_(key.k0_ ^ 0x736f6d6570736575ull),
+		  v1_(key.k1_ ^ 0x646f72616e646f6dull),
+		  v2_(key.k0_ ^ 0x6c7967656e657261ull),
+		  v3_(key.k1_ ^ 0x7465646279746573ull)
+		{ }
+
+		void round(void)
+		{
+			v0_ += v1_;
+			v1_ = XCODEC_HASH_SIP_ROTATE(v1_, 13);
+			v1_ ^= v0_;
+			v0_ = XCODEC_HASH_SIP_ROTATE(v0_, 32);
+			v2_ += v3_;
+			v3_ = XCODEC_HASH_SIP_ROTATE(v3_, 16);
+			v3_ ^= v2_;
+			v0_ += v3_;
+			v3_ = XCODEC_HASH_SIP_ROTATE(v3_, 21);
+			v3_ ^= v0_;
+			v2_ += v1_;
+			v1_ = XCODEC_HASH_SIP_ROTATE(v1_, 17);
+			v1_ ^= v2_;
+			v2_ = XCODEC_HASH_SIP_ROTATE(v2_, 32);
+		}
+
+		void compress(uint64_t m)
+		{
+			v3_ ^= m;
+			round();
+			round();
+			v0_ ^= m;
+		}
+
+		uint64_t finish(void)
+		{
+			v2_ ^= 0xff;
+			round();
+			round();
+			round();
+			round();
+			return (v0_ ^ v1_ ^ v2_ ^ v3_);
+		}
+	};
+
+	static uint64_t
+	hash_sip(const uint8_t *data, size_t len, const XCodecHashKey& key)
+	{
+		SipState sip(key);
+		uint64_t m = (uint64_t)len << 56;
+
+		while (len >= sizeof (uint64_t)) {
+			uint64_t w;
+			memcpy(&w, data, sizeof w);
+			sip.compress(LittleEndian::decode(w));
+			data += sizeof w;
+			len -= sizeof w;
+		}
+		while (len-- != 0)
+			m |= (uint64_t)data[len] << (8 * len);
+		sip.compress(m);
+
+		return (sip.finish());
+	}
+}
+
+XCodecHashKey::XCodecHashKey(const std::string& str)
+{
+	const uint8_t *data = (const uint8_t *)str.data();
+
+	k0_ = hash_sip(data, str.length(), XCodecHashKey(0, 0));
+	k1_ = hash_sip(data, str.length(), XCodecHashKey(k0_, 0));
+}
+
+uint64_t
+XCodecHash::hash(const uint8_t *data, size_t len, const XCodecHashKey& key)
+{
+	ASSERT("/xcodec/hash", len != 0 && len <= XCODEC_CHUNK_MAX);
+
+	if (len == XCODEC_SEGMENT_LENGTH)
+		return (hash(data));
+	return (hash_sip(data, len, key));
+}
+
+namespace {
+	static bool
+	hash_fill_none(const uint8_t *, uint32_t *)
+	{
+		return (false);
+	}
+
+#if defined(XCODEC_HASH_VECTOR)
+	static uint32_t
+	hash_sum_ssse3(__m128i v) __attribute__((__target__("ssse3")));
+
+	static uint32_t
+	hash_sum_ssse3(__m128i v)
+	{
+		v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+		v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+		return (_mm_cvtsi128_si32(v));
+	}
+
+	static bool
+	hash_fill_ssse3(const uint8_t *data, uint32_t *sums)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i ones = _mm_set1_epi16(1);
+		const __m128i nibble = _mm_set1_epi8(0x0f);
+		const __m128i weights = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+		const __m128i ffs_lo = _mm_setr_epi8(0, 1, 2, 1, 3, 1, 2, 1, 4, 1, 2, 1, 3, 1, 2, 1);
+		const __m128i ffs_hi = _mm_setr_epi8(0, 5, 6, 5, 7, 5, 6, 5, 8, 5, 6, 5, 7, 5, 6, 5);
+		__m128i bytes1 = zero, bytes2 = zero, bytesw = zero;
+		__m128i bits1 = zero, bits2 = zero, bitsw = zero;
+		unsigned i;
+
+		for (i = 0; i < XCODEC_SEGMENT_LENGTH; i += 16) {
+			__m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+			__m128i lo = _mm_and_si128(v, nibble);
+			__m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+			__m128i b = _mm_or_si128(_mm_shuffle_epi8(ffs_lo, lo),
+						 _mm_and_si128(_mm_cmpeq_epi8(lo, zero),
+							       _mm_shuffle_epi8(ffs_hi, hi)));
+
+			bytes2 = _mm_add_epi32(bytes2, bytes1);
+			bits2 = _mm_add_epi32(bits2, bits1);
+
+			bytes1 = _mm_add_epi32(bytes1, _mm_sad_epu8(v, zero));
+			bits1 = _mm_add_epi32(bits1, _mm_sad_epu8(b, zero));
+
+			bytesw = _mm_add_epi32(bytesw, _mm_madd_epi16(_mm_maddubs_epi16(v, weights), ones));
+			bitsw = _mm_add_epi32(bitsw, _mm_madd_epi16(_mm_maddubs_epi16(b, weights), ones));
+		}
+
+		sums[0] = hash_sum_ssse3(bytes1);
+		sums[1] = 16 * hash_sum_ssse3(bytes2) + hash_sum_ssse3(bytesw);
+		sums[2] = hash_sum_ssse3(bits1);
+		sums[3] = 16 * hash_sum_ssse3(bits2) + hash_sum_ssse3(bitsw);
+
+		return (true);
+	}
+
+	static uint32_t
+	hash_sum_avx2(__m256i v) __attribute__((__target__("avx2")));
+
+	static uint32_t
+	hash_sum_avx2(__m256i v)
+	{
+		__m128i h = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+		h = _mm_add_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(1, 0, 3, 2)));
+		h = _mm_add_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(2, 3, 0, 1)));
+		return (_mm_cvtsi128_si32(h));
+	}
+
+	static bool
+	hash_fill_avx2(const uint8_t *data, uint32_t *sums)
+	{
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i ones = _mm256_set1_epi16(1);
+		const __m256i nibble = _mm256_set1_epi8(0x0f);
+		const __m256i weights = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+							 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+		const __m256i ffs_lo = _mm256_setr_epi8(0, 1, 2, 1, 3, 1, 2, 1, 4, 1, 2, 1, 3, 1, 2, 1,
+							0, 1, 2, 1, 3, 1, 2, 1, 4, 1, 2, 1, 3, 1, 2, 1);
+		const __m256i ffs_hi = _mm256_setr_epi8(0, 5, 6, 5, 7, 5, 6, 5, 8, 5, 6, 5, 7, 5, 6, 5,
+							0, 5, 6, 5, 7, 5, 6, 5, 8, 5, 6, 5, 7, 5, 6, 5);
+		__m256i bytes1 = zero, bytes2 = zero, bytesw = zero;
+		__m256i bits1 = zero, bits2 = zero, bitsw = zero;
+		unsigned i;
+
+		for (i = 0; i < XCODEC_SEGMENT_LENGTH; i += 32) {
+			__m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+			__m256i lo = _mm256_and_si256(v, nibble);
+			__m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+			__m256i b = _mm256_or_si256(_mm256_shuffle_epi8(ffs_lo, lo),
+						    _mm256_and_si256(_mm256_cmpeq_epi8(lo, zero),
+								     _mm256_shuffle_epi8(ffs_hi, hi)));
+
+			bytes2 = _mm256_add_epi32(bytes2, bytes1);
+			bits2 = _mm256_add_epi32(bits2, bits1);
+
+			bytes1 = _mm256_add_epi32(bytes1, _mm256_sad_epu8(v, zero));
+			bits1 = _mm256_add_epi32(bits1, _mm256_sad_epu8(b, zero));
+
+			bytesw = _mm256_add_epi32(bytesw, _mm256_madd_epi16(_mm256_maddubs_epi16(v, weights), ones));
+			bitsw = _mm256_add_epi32(bitsw, _mm256_madd_epi16(_mm256_maddubs_epi16(b, weights), ones));
+		}
+
+		sums[0] = hash_sum_avx2(bytes1);
+		sums[1] = 32 * hash_sum_avx2(bytes2) + hash_sum_avx2(bytesw);
+		sums[2] = hash_sum_avx2(bits1);
+		sums[3] = 32 * hash_sum_avx2(bits2) + hash_sum_avx2(bitsw);
+
+		return (true);
+	}
+#endif
+
+	/*
+	 * Pick the best implementation the CPU supports on first use.
+	 */
+	static bool
+	hash_fill_select(const uint8_t *data, uint32_t *sums)
+	{
+		hash_fill_t func = hash_fill_none;
+
+#if defined(XCODEC_HASH_VECTOR)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			func = hash_fill_avx2;
+		else if (__builtin_cpu_supports("ssse3"))
+			func = hash_fill_ssse3;
+#endif
+		hash_fill_vector = func;
+
+		return (func(data, sums));
+	}
+}
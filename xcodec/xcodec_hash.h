@@ -28,43 +28,75 @@
 
 #include <strings.h>
 
+/*
+ * The rolling hash keeps only its sums.  Rolling a byte out of the hash needs
+ * the byte that is leaving, which the caller has in its own copy of the data
+ * and passes to roll().
+ *
+ * Bytes are hashed in blocks where possible.  Adding n values v[0..n-1] one
+ * at a time adds n * sum1 + n * v[0] + (n - 1) * v[1] + ... + v[n-1] to sum2,
+ * which is computed for the block independently of the running sums.
+ */
+#define	XCODEC_HASH_BLOCK	(16)
+
+/*
+ * The key under which chunks are hashed.  It is derived from the UUID of the
+ * cache whose data is being hashed, which both peers know but whoever supplies
+ * the data does not, so that data can not be chosen to collide.
+ */
+struct XCodecHashKey {
+	uint64_t k0_;
+	uint64_t k1_;
+
+	XCodecHashKey(void)
+	: k0_(0),
+	  k1_(0)
+	{ }
+
+	XCodecHashKey(uint64_t k0, uint64_t k1)
+	: k0_(k0),
+	  k1_(k1)
+	{ }
+
+	XCodecHashKey(const std::string&);
+};
+
 class XCodecHash {
 	struct RollingHash {
 		uint32_t sum1_;					/* Really <16-bit.  */
 		uint32_t sum2_;					/* Really <32-bit.  */
-		uint32_t buffer_[XCODEC_SEGMENT_LENGTH];	/* Really >8-bit.  */
 
 		RollingHash(void)
 		: sum1_(0),
-		  sum2_(0),
-		  buffer_()
+		  sum2_(0)
 		{ }
 
-		void add(uint32_t ch, unsigned start)
+		void add(uint32_t ch)
 		{
-			buffer_[start] = ch;
-
 			sum1_ += ch;
 			sum2_ += sum1_;
 		}
 
+		/*
+		 * Add n values with sum s and weighted sum w, as above.
+		 */
+		void add(unsigned n, uint32_t s, uint32_t w)
+		{
+			sum2_ += n * sum1_ + w;
+			sum1_ += s;
+		}
+
 		void reset(void)
 		{
 			sum1_ = 0;
 			sum2_ = 0;
 		}
 
-		void roll(uint32_t ch, unsigned start)
+		void roll(uint32_t ch, uint32_t dead)
 		{
-			uint32_t dead;
-
-			dead = buffer_[start];
-
 			sum1_ -= dead;
 			sum2_ -= dead * XCODEC_SEGMENT_LENGTH;
 
-			buffer_[start] = ch;
-
 			sum1_ += ch;
 			sum2_ += sum1_;
 		}
@@ -72,7 +104,6 @@ class XCodecHash {
 
 	RollingHash bytes_;
 	RollingHash bits_;
-	unsigned start_;
 #ifndef NDEBUG
 	unsigned length_;
 #endif
@@ -80,8 +111,7 @@ class XCodecHash {
 public:
 	XCodecHash(void)
 	: bytes_(),
-	  bits_(),
-	  start_(0)
+	  bits_()
 #ifndef NDEBUG
 	, length_(0)
 #endif
@@ -92,22 +122,60 @@ public:
 
 	void add(uint8_t ch)
 	{
-		unsigned bit = ffs(ch);
-		unsigned word = (unsigned)ch + 1;
-
 #ifndef NDEBUG
 		ASSERT("/xcodec/hash", length_ < XCODEC_SEGMENT_LENGTH);
 #endif
 
-		bytes_.add(word, start_);
-		bits_.add(bit, start_);
+		bytes_.add(word(ch));
+		bits_.add(bit(ch));
 
 #ifndef NDEBUG
 		length_++;
 #endif
-		start_ = (start_ + 1) % XCODEC_SEGMENT_LENGTH;
 	}
 
+	void add(const uint8_t *data, unsigned len)
+	{
+#ifndef NDEBUG
+		ASSERT("/xcodec/hash", length_ + len <= XCODEC_SEGMENT_LENGTH);
+		length_ += len;
+#endif
+
+		while (len >= XCODEC_HASH_BLOCK) {
+			uint32_t words = 0, wordw = 0;
+			uint32_t bits = 0, bitw = 0;
+			unsigned i;
+
+			for (i = 0; i < XCODEC_HASH_BLOCK; i++) {
+				uint32_t w = word(data[i]);
+				uint32_t b = bit(data[i]);
+
+				words += w;
+				wordw += (XCODEC_HASH_BLOCK - i) * w;
+				bits += b;
+				bitw += (XCODEC_HASH_BLOCK - i) * b;
+			}
+
+			bytes_.add(XCODEC_HASH_BLOCK, words, wordw);
+			bits_.add(XCODEC_HASH_BLOCK, bits, bitw);
+
+			data += XCODEC_HASH_BLOCK;
+			len -= XCODEC_HASH_BLOCK;
+		}
+
+		while (len-- != 0) {
+			bytes_.add(word(*data));
+			bits_.add(bit(*data));
+			data++;
+		}
+	}
+
+	/*
+	 * Hash exactly XCODEC_SEGMENT_LENGTH bytes into a reset hash, with
+	 * vector instructions where the CPU has them.
+	 */
+	void fill(const uint8_t *);
+
 	void reset(void)
 	{
 		bytes_.reset();
@@ -116,22 +184,20 @@ public:
 #ifndef NDEBUG
 		length_ = 0;
 #endif
-		start_ = 0;
 	}
 
-	void roll(uint8_t ch)
+	/*
+	 * Roll ch into the hash and dead, the byte added XCODEC_SEGMENT_LENGTH
+	 * bytes before it, out of it.
+	 */
+	void roll(uint8_t ch, uint8_t dead)
 	{
-		unsigned bit = ffs(ch);
-		unsigned word = (unsigned)ch + 1;
-
 #ifndef NDEBUG
 		ASSERT("/xcodec/hash", length_ == XCODEC_SEGMENT_LENGTH);
 #endif
 
-		bytes_.roll(word, start_);
-		bits_.roll(bit, start_);
-
-		start_ = (start_ + 1) % XCODEC_SEGMENT_LENGTH;
+		bytes_.roll(word(ch), word(dead));
+		bits_.roll(bit(ch), bit(dead));
 	}
 
 	/*
@@ -166,12 +232,28 @@ public:
 	static uint64_t hash(const uint8_t *data)
 	{
 		XCodecHash xchash;
-		unsigned i;
 
-		for (i = 0; i < XCODEC_SEGMENT_LENGTH; i++)
-			xchash.add(*data++);
+		xchash.fill(data);
 		return (xchash.mix());
 	}
+
+	/*
+	 * Hash a segment or content-defined chunk of len bytes.  A chunk is
+	 * hashed under key; a segment has no choice but to use the rolling
+	 * hash, since that is what the encoder finds it by.
+	 */
+	static uint64_t hash(const uint8_t *, size_t, const XCodecHashKey&);
+
+private:
+	static uint32_t word(uint8_t ch)
+	{
+		return ((uint32_t)ch + 1);
+	}
+
+	static uint32_t bit(uint8_t ch)
+	{
+		return (ffs(ch));
+	}
 };
 
 #endif /* !XCODEC_XCODEC_HASH_H */
@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <common/buffer.h>
+
+#include <xcodec/xcodec_index.h>
+
+#define	XCODEC_INDEX_INITIAL_SHIFT	(10)	/* 1024 buckets.  */
+
+XCodecIndex::XCodecIndex(void)
+: buckets_(NULL),
+  referenced_(NULL),
+  shift_(64 - XCODEC_INDEX_INITIAL_SHIFT),
+  mask_((1 << XCODEC_INDEX_INITIAL_SHIFT) - 1),
+  count_(0),
+  hand_(0)
+{
+	buckets_ = allocate(mask_ + 1);
+	referenced_ = allocate_referenced(mask_ + 1);
+}
+
+XCodecIndex::~XCodecIndex()
+{
+	size_t b;
+
+	for (b = 0; b <= mask_; b++) {
+		Bucket *bp = &buckets_[b];
+		unsigned i;
+
+		for (i = 0; i < XCODEC_INDEX_SLOTS; i++) {
+			if (bp->slots_[i].seg_ != NULL)
+				bp->slots_[i].seg_->unref();
+		}
+	}
+	free(buckets_);
+	buckets_ = NULL;
+
+	free(referenced_);
+	referenced_ = NULL;
+}
+
+void
+XCodecIndex::insert(uint64_t hash, BufferSegment *seg)
+{
+	ASSERT("/xcodec/index", seg != NULL);
+	ASSERT("/xcodec/index", find(hash) == NULL);
+
+	if (4 * (count_ + 1) > 3 * (mask_ + 1) * XCODEC_INDEX_SLOTS)
+		grow();
+
+	seg->ref();
+	place(hash, seg, true);
+	count_++;
+}
+
+/*
+ * Remove an entry and then move back any entries after it which would no
+ * longer be found past the hole it leaves, so that lookups can still stop at
+ * the first empty slot.
+ */
+void
+XCodecIndex::erase(uint64_t hash)
+{
+	size_t nslots = (mask_ + 1) * XCODEC_INDEX_SLOTS;
+	size_t hole = bucket(hash) * XCODEC_INDEX_SLOTS;
+
+	for (;;) {
+		Slot *sp = &buckets_[hole / XCODEC_INDEX_SLOTS].slots_[hole % XCODEC_INDEX_SLOTS];
+		ASSERT("/xcodec/index", sp->seg_ != NULL);
+		if (sp->hash_ == hash)
+			break;
+		hole = (hole + 1) % nslots;
+	}
+
+	Slot *hp = &buckets_[hole / XCODEC_INDEX_SLOTS].slots_[hole % XCODEC_INDEX_SLOTS];
+	hp->seg_->unref();
+	hp->seg_ = NULL;
+	referenced_[hole / XCODEC_INDEX_SLOTS] &= ~(1 << (hole % XCODEC_INDEX_SLOTS));
+	count_--;
+
+	size_t pos = hole;
+	for (;;) {
+		pos = (pos + 1) % nslots;
+
+		Slot *sp = &buckets_[pos / XCODEC_INDEX_SLOTS].slots_[pos % XCODEC_INDEX_SLOTS];
+		if (sp->seg_ == NULL)
+			return;
+
+		/*
+		 * Leave entries whose first slot is after the hole.
+		 */
+		size_t home = bucket(sp->hash_) * XCODEC_INDEX_SLOTS;
+		if ((hole - home + nslots) % nslots >= (pos - home + nslots) % nslots)
+			continue;
+
+		hp = &buckets_[hole / XCODEC_INDEX_SLOTS].slots_[hole % XCODEC_INDEX_SLOTS];
+		*hp = *sp;
+		sp->seg_ = NULL;
+
+		uint8_t bit = referenced_[pos / XCODEC_INDEX_SLOTS] & (1 << (pos % XCODEC_INDEX_SLOTS));
+		referenced_[pos / XCODEC_INDEX_SLOTS] &= ~(1 << (pos % XCODEC_INDEX_SLOTS));
+		if (bit != 0)
+			referenced_[hole / XCODEC_INDEX_SLOTS] |= 1 << (hole % XCODEC_INDEX_SLOTS);
+
+		hole = pos;
+	}
+}
+
+bool
+XCodecIndex::clock(uint64_t *hashp, BufferSegment **segp)
+{
+	if (count_ == 0)
+		return (false);
+
+	for (;;) {
+		size_t b = hand_ / XCODEC_INDEX_SLOTS;
+		unsigned i = hand_ % XCODEC_INDEX_SLOTS;
+		const Slot *sp = &buckets_[b].slots_[i];
+
+		if (sp->seg_ != NULL) {
+			if ((referenced_[b] & (1 << i)) == 0) {
+				*hashp = sp->hash_;
+				*segp = sp->seg_;
+				return (true);
+			}
+			referenced_[b] &= ~(1 << i);
+		}
+		skip();
+	}
+}
+
+/*
+ * Double the number of buckets and move every entry over, keeping the
+ * references already held.
+ */
+void
+XCodecIndex::grow(void)
+{
+	Bucket *old = buckets_;
+	size_t oldsize = mask_ + 1;
+
+	uint8_t *oldreferenced = referenced_;
+
+	shift_--;
+	mask_ = 2 * oldsize - 1;
+	buckets_ = allocate(mask_ + 1);
+	referenced_ = allocate_referenced(mask_ + 1);
+	hand_ = 0;
+
+	size_t b;
+	for (b = 0; b < oldsize; b++) {
+		const Bucket *bp = &old[b];
+		unsigned i;
+
+		for (i = 0; i < XCODEC_INDEX_SLOTS; i++) {
+			if (bp->slots_[i].seg_ != NULL)
+				place(bp->slots_[i].hash_, bp->slots_[i].seg_, (oldreferenced[b] & (1 << i)) != 0);
+		}
+	}
+	free(old);
+	free(oldreferenced);
+}
+
+/*
+ * Put an entry in the first free slot at or after its line.
+ */
+void
+XCodecIndex::place(uint64_t hash, BufferSegment *seg, bool referenced)
+{
+	size_t b = bucket(hash);
+
+	for (;;) {
+		Bucket *bp = &buckets_[b];
+		unsigned i;
+
+		for (i = 0; i < XCODEC_INDEX_SLOTS; i++) {
+			Slot *sp = &bp->slots_[i];
+			if (sp->seg_ == NULL) {
+				sp->hash_ = hash;
+				sp->seg_ = seg;
+				if (referenced)
+					referenced_[b] |= 1 << i;
+				return;
+			}
+		}
+		b = (b + 1) & mask_;
+	}
+}
+
+XCodecIndex::Bucket *
+XCodecIndex::allocate(size_t nbuckets)
+{
+	void *p;
+
+	if (posix_memalign(&p, XCODEC_INDEX_LINE, nbuckets * sizeof (Bucket)) != 0)
+		HALT("/xcodec/index") << "Could not allocate " << nbuckets << " buckets.";
+	memset(p, 0, nbuckets * sizeof (Bucket));
+	return ((Bucket *)p);
+}
+
+uint8_t *
+XCodecIndex::allocate_referenced(size_t nbuckets)
+{
+	uint8_t *p = (uint8_t *)calloc(nbuckets, sizeof *p);
+	if (p == NULL)
+		HALT("/xcodec/index") << "Could not allocate " << nbuckets << " referenced bits.";
+	return (p);
+}
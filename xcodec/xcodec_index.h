@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef	XCODEC_XCODEC_INDEX_H
+#define	XCODEC_XCODEC_INDEX_H
+
+/*
+ * An open-addressing table of segments by hash.  Entries are kept four to a
+ * cache line, each with the whole hash and the segment, and a lookup probes
+ * whole lines starting at the one chosen by the hash, so it usually touches
+ * only that line.  The table doubles when it is three quarters full.
+ *
+ * The table holds a reference to each segment in it.
+ *
+ * Each entry also has a referenced bit, kept apart from the lines so that
+ * they stay four to a line, which find() sets and which clock() uses to pick
+ * entries to evict in the manner of CLOCK.  Since an entry's place does not
+ * depend on when it was inserted, it may be just ahead of the hand, so new
+ * entries start out referenced to get a full turn of the clock.
+ */
+#define	XCODEC_INDEX_LINE	(64)
+#define	XCODEC_INDEX_SLOTS	(XCODEC_INDEX_LINE / (sizeof (uint64_t) + sizeof (BufferSegment *)))
+
+class XCodecIndex {
+	struct Slot {
+		uint64_t hash_;
+		BufferSegment *seg_;
+	};
+
+	struct Bucket {
+		Slot slots_[XCODEC_INDEX_SLOTS];
+	} __attribute__((__aligned__(XCODEC_INDEX_LINE)));
+
+	Bucket *buckets_;
+	uint8_t *referenced_;
+	unsigned shift_;
+	size_t mask_;
+	size_t count_;
+	size_t hand_;
+public:
+	XCodecIndex(void);
+	~XCodecIndex();
+
+	/*
+	 * Takes a reference to seg.
+	 */
+	void insert(uint64_t, BufferSegment *);
+
+	/*
+	 * Drops the reference to the segment.
+	 */
+	void erase(uint64_t);
+
+	/*
+	 * Does not take a reference to the segment found, but does mark it
+	 * referenced.
+	 */
+	BufferSegment *find(uint64_t hash) const
+	{
+		size_t b = bucket(hash);
+
+		for (;;) {
+			const Bucket *bp = &buckets_[b];
+			unsigned i;
+
+			for (i = 0; i < XCODEC_INDEX_SLOTS; i++) {
+				if (bp->slots_[i].seg_ == NULL)
+					return (NULL);
+				if (bp->slots_[i].hash_ == hash) {
+					referenced_[b] |= 1 << i;
+					return (bp->slots_[i].seg_);
+				}
+			}
+			b = (b + 1) & mask_;
+		}
+	}
+
+	/*
+	 * Find n hashes, with all of their lines fetched at once.
+	 */
+	void find(const uint64_t *hashes, BufferSegment **segs, unsigned n) const
+	{
+		unsigned i;
+
+		for (i = 0; i < n; i++)
+			prefetch(hashes[i]);
+		for (i = 0; i < n; i++)
+			segs[i] = find(hashes[i]);
+	}
+
+	void prefetch(uint64_t hash) const
+	{
+		__builtin_prefetch(&buckets_[bucket(hash)]);
+	}
+
+	size_t count(void) const
+	{
+		return (count_);
+	}
+
+	/*
+	 * Move the clock hand to the next entry which has not been referenced
+	 * since the hand last passed it, clearing the referenced bits of those
+	 * it passes, and return that entry without removing it.  The hand
+	 * stays on the entry until it is erased or skip() is called.
+	 */
+	bool clock(uint64_t *, BufferSegment **);
+
+	void skip(void)
+	{
+		hand_ = (hand_ + 1) % ((mask_ + 1) * XCODEC_INDEX_SLOTS);
+	}
+
+	/*
+	 * Call f with the hash of every entry, in no particular order.
+	 */
+	template<typename F>
+	void enumerate(F f) const
+	{
+		size_t b;
+
+		for (b = 0; b <= mask_; b++) {
+			const Bucket *bp = &buckets_[b];
+			unsigned i;
+
+			for (i = 0; i < XCODEC_INDEX_SLOTS; i++) {
+				if (bp->slots_[i].seg_ != NULL)
+					f(bp->slots_[i].hash_);
+			}
+		}
+	}
+
+private:
+	/*
+	 * The hash's low bits may not vary much, so use its high bits after
+	 * multiplying by the golden ratio.
+	 */
+	size_t bucket(uint64_t hash) const
+	{
+		return ((hash * 0x9e3779b97f4a7c15ull) >> shift_);
+	}
+
+	void grow(void);
+	void place(uint64_t, BufferSegment *, bool);
+
+	static Bucket *allocate(size_t);
+	static uint8_t *allocate_referenced(size_t);
+};
+
+#endif /* !XCODEC_XCODEC_INDEX_H */
@@ -27,6 +27,7 @@
 #include <common/endian.h>
 
 #include <event/event_callback.h>
+#include <event/event_system.h>
 
 #include <io/pipe/pipe.h>
 #include <io/pipe/pipe_pair.h>
@@ -35,7 +36,6 @@
 #include <xcodec/xcodec_cache.h>
 #include <xcodec/xcodec_decoder.h>
 #include <xcodec/xcodec_encoder.h>
-#include <xcodec/xcodec_hash.h>
 #include <xcodec/xcodec_pipe_pair.h>
 
 /*
@@ -78,6 +78,9 @@
  * Usage:
  * 	<OP_HELLO> length[uint8_t] data[uint8_t x length]
  *
+ * 	The data is the UUID of the sender's cache, which may be followed by a
+ * 	byte of XCODEC_PIPE_HELLO_* flags.  Anything after that is ignored.
+ *
  * Effects:
  * 	Must appear at the start of and only at the start of an encoded	stream.
  *
@@ -86,6 +89,34 @@
  */
 #define	XCODEC_PIPE_OP_HELLO	((uint8_t)0xff)
 
+/*
+ * The sender can decode OP_EXTRACT_CHUNK and <OP_LEARN_CHUNK>, and would like
+ * its peer to use content-defined chunking.  Each side chunks only if both
+ * set this.
+ */
+#define	XCODEC_PIPE_HELLO_CHUNKING	((uint8_t)0x01)
+
+/*
+ * The sender understands <OP_FORGET>.
+ */
+#define	XCODEC_PIPE_HELLO_FORGET	((uint8_t)0x02)
+
+/*
+ * The sender understands <OP_PAUSE> and <OP_RESUME>.
+ */
+#define	XCODEC_PIPE_HELLO_PAUSE		((uint8_t)0x04)
+
+/*
+ * The sender understands <OP_ASK_N> and <OP_LEARN_N>.
+ */
+#define	XCODEC_PIPE_HELLO_BATCH		((uint8_t)0x08)
+
+/*
+ * The sender understands <OP_ACK> and sends it as it decodes frames, so that
+ * its peer can keep the data it references from being evicted until then.
+ */
+#define	XCODEC_PIPE_HELLO_ACK		((uint8_t)0x10)
+
 /*
  * Usage:
  * 	<OP_LEARN> data[uint8_t x XCODEC_PIPE_SEGMENT_LENGTH]
@@ -138,6 +169,99 @@
  */
 #define	XCODEC_PIPE_OP_EOS_ACK	((uint8_t)0xfb)
 
+/*
+ * Usage:
+ * 	<OP_LEARN_CHUNK> length[uint16_t] data[uint8_t x length]
+ *
+ * Effects:
+ * 	As <OP_LEARN>, for data which is not XCODEC_SEGMENT_LENGTH bytes long.
+ *
+ * Side-effects:
+ * 	None.
+ */
+#define	XCODEC_PIPE_OP_LEARN_CHUNK	((uint8_t)0xfa)
+
+/*
+ * Usage:
+ * 	<OP_FORGET> hash[uint64_t]
+ *
+ * Effects:
+ * 	The sender has evicted the data for `hash' from its cache, so the
+ * 	data should be extracted rather than referenced the next time it is
+ * 	sent.  References sent before this is received are still answered by
+ * 	<ASK> and <LEARN>.
+ *
+ * Side-effects:
+ * 	None.
+ */
+#define	XCODEC_PIPE_OP_FORGET	((uint8_t)0xf9)
+
+/*
+ * Usage:
+ * 	<OP_PAUSE>
+ *
+ * Effects:
+ * 	The sender has too much encoded data queued up waiting on <ASK>s, so
+ * 	the encoder should stop reading new data to encode until <OP_RESUME>.
+ * 	<ASK>s are still answered.
+ *
+ * Side-effects:
+ * 	None.
+ */
+#define	XCODEC_PIPE_OP_PAUSE	((uint8_t)0xf8)
+
+/*
+ * Usage:
+ * 	<OP_RESUME>
+ *
+ * Effects:
+ * 	The encoder may read new data to encode again after <OP_PAUSE>.
+ *
+ * Side-effects:
+ * 	None.
+ */
+#define	XCODEC_PIPE_OP_RESUME	((uint8_t)0xf7)
+
+/*
+ * Usage:
+ * 	<OP_ASK_N> count[uint16_t] hash[uint64_t x count]
+ *
+ * Effects:
+ * 	As `count' <OP_ASK>s, which may not exceed XCODEC_PIPE_BATCH_MAX.  A
+ * 	single <OP_LEARN_N> will be sent in response with the data for all of
+ * 	the hashes.
+ *
+ * Side-effects:
+ * 	None.
+ */
+#define	XCODEC_PIPE_OP_ASK_N	((uint8_t)0xf6)
+
+/*
+ * Usage:
+ * 	<OP_LEARN_N> count[uint16_t] (length[uint16_t] data[uint8_t x length]) x count
+ *
+ * Effects:
+ * 	As `count' <OP_LEARN>s or <OP_LEARN_CHUNK>s, which may not exceed
+ * 	XCODEC_PIPE_BATCH_MAX.
+ *
+ * Side-effects:
+ * 	None.
+ */
+#define	XCODEC_PIPE_OP_LEARN_N	((uint8_t)0xf5)
+
+/*
+ * Usage:
+ * 	<OP_ACK> frames[uint64_t]
+ *
+ * Effects:
+ * 	The sender has decoded the first `frames' frames it has received in
+ * 	full, and so will not <ASK> for any of the data they reference.
+ *
+ * Side-effects:
+ * 	Data referenced by those frames may be evicted.
+ */
+#define	XCODEC_PIPE_OP_ACK	((uint8_t)0xf4)
+
 /*
  * Usage:
  * 	<FRAME> length[uint16_t] data[uint8_t x length]
@@ -152,7 +276,18 @@
 
 #define	XCODEC_PIPE_MAX_FRAME	(32768)
 
-static void encode_frame(Buffer *, Buffer *);
+/*
+ * The most hashes in an <ASK_N> and segments in a <LEARN_N>.
+ */
+#define	XCODEC_PIPE_BATCH_MAX	(256)
+
+/*
+ * How long the encoder may hold on to input which could still become part of
+ * a declaration or reference before it is flushed out as it stands.
+ */
+#define	XCODEC_PIPE_FLUSH_MS	(10)
+
+static unsigned encode_frame(Buffer *, Buffer *);
 
 void
 XCodecPipePair::decoder_consume(Buffer *buf)
@@ -174,8 +309,14 @@ XCodecPipePair::decoder_consume(Buffer *buf)
 
 	buf->moveout(&decoder_buffer_);
 
-	while (!decoder_buffer_.empty()) {
-		uint8_t op = decoder_buffer_.peek();
+	/*
+	 * Parse with a BufferReader and only drop what has been consumed from
+	 * decoder_buffer_ once we stop, whether for lack of data or not.
+	 */
+	BufferReader r(&decoder_buffer_);
+
+	while (!r.empty()) {
+		uint8_t op = r.peek();
 		switch (op) {
 		case XCODEC_PIPE_OP_HELLO:
 			if (decoder_cache_ != NULL) {
@@ -184,21 +325,22 @@ XCodecPipePair::decoder_consume(Buffer *buf)
 				return;
 			} else {
 				uint8_t len;
-				if (decoder_buffer_.length() < sizeof op + sizeof len)
-					return;
-				decoder_buffer_.extract(&len, sizeof op);
+				if (r.length() < sizeof op + sizeof len)
+					goto incomplete;
+				r.extract(&len, sizeof op);
 
-				if (decoder_buffer_.length() < sizeof op + sizeof len + len)
-					return;
+				if (r.length() < sizeof op + sizeof len + len)
+					goto incomplete;
 
-				if (len != UUID_SIZE) {
+				if (len < UUID_SIZE) {
 					ERROR(log_) << "Unsupported <HELLO> length: " << (unsigned)len;
 					decoder_error();
 					return;
 				}
 
 				Buffer uubuf;
-				decoder_buffer_.moveout(&uubuf, sizeof op + sizeof len, UUID_SIZE);
+				r.skip(sizeof op + sizeof len);
+				r.moveout(&uubuf, UUID_SIZE);
 
 				UUID uuid;
 				if (!uuid.decode(&uubuf)) {
@@ -207,14 +349,50 @@ XCodecPipePair::decoder_consume(Buffer *buf)
 					return;
 				}
 
+				uint8_t flags = 0;
+				if (len > UUID_SIZE) {
+					r.moveout(&flags);
+					r.skip(len - UUID_SIZE - sizeof flags);
+				}
+
+				if ((flags & XCODEC_PIPE_HELLO_CHUNKING) != 0 && codec_->chunking()) {
+					DEBUG(log_) << "Peer supports content-defined chunking.";
+					encoder_chunking_ = true;
+				}
+
+				if ((flags & XCODEC_PIPE_HELLO_FORGET) != 0)
+					decoder_forget_ = true;
+
+				if ((flags & XCODEC_PIPE_HELLO_PAUSE) != 0)
+					decoder_pause_ = true;
+
+				if ((flags & XCODEC_PIPE_HELLO_BATCH) != 0)
+					decoder_batch_ = true;
+
+				if ((flags & XCODEC_PIPE_HELLO_ACK) != 0)
+					decoder_ack_ = true;
+
+				/*
+				 * A peer which can not be told of evictions
+				 * gets a cache which does not evict.
+				 */
 				decoder_cache_ = XCodecCache::lookup(uuid);
 				if (decoder_cache_ == NULL) {
-					decoder_cache_ = new XCodecMemoryCache(uuid);
+					decoder_cache_ = codec_->cache()->peer(uuid, decoder_forget_);
 					XCodecCache::enter(uuid, decoder_cache_);
 				}
 
+				/*
+				 * Nothing can be unpinned for a peer which
+				 * will not <ACK>, so stop pinning.
+				 */
+				if (!decoder_ack_ && encoder_ != NULL) {
+					encoder_->set_pinning(false);
+					encoder_unpin(encoder_frames_);
+				}
+
 				ASSERT(log_, decoder_ == NULL);
-				decoder_ = new XCodecDecoder(decoder_cache_);
+				decoder_ = new XCodecDecoder(decoder_cache_, codec_->lookahead());
 
 				DEBUG(log_) << "Peer connected with UUID: " << uuid.string_;
 			}
@@ -226,69 +404,228 @@ XCodecPipePair::decoder_consume(Buffer *buf)
 				return;
 			} else {
 				uint64_t hash;
-				if (decoder_buffer_.length() < sizeof op + sizeof hash)
-					return;
+				if (r.length() < sizeof op + sizeof hash)
+					goto incomplete;
 
-				decoder_buffer_.skip(sizeof op);
+				r.skip(sizeof op);
 
-				decoder_buffer_.moveout(&hash);
+				r.moveout(&hash);
 				hash = BigEndian::decode(hash);
 
-				BufferSegment *oseg = codec_->cache()->lookup(hash);
-				if (oseg == NULL) {
-					ERROR(log_) << "Unknown hash in <ASK>: " << hash;
+				DEBUG(log_) << "Got <ASK>.";
+
+				encoder_ask(hash);
+				if (!encoder_learn()) {
+					decoder_error();
+					return;
+				}
+			}
+			break;
+		case XCODEC_PIPE_OP_ASK_N:
+			if (encoder_ == NULL) {
+				ERROR(log_) << "Got <ASK_N> before sending <HELLO>.";
+				decoder_error();
+				return;
+			} else {
+				uint16_t count;
+				if (r.length() < sizeof op + sizeof count)
+					goto incomplete;
+				r.extract(&count, sizeof op);
+				count = BigEndian::decode(count);
+				if (count == 0 || count > XCODEC_PIPE_BATCH_MAX) {
+					ERROR(log_) << "Invalid <ASK_N> count: " << count;
+					decoder_error();
+					return;
+				}
+
+				if (r.length() < sizeof op + sizeof count + count * sizeof (uint64_t))
+					goto incomplete;
+
+				r.skip(sizeof op + sizeof count);
+
+				DEBUG(log_) << "Got <ASK_N> of " << count << ".";
+
+				while (count-- != 0) {
+					uint64_t hash;
+					r.moveout(&hash);
+					hash = BigEndian::decode(hash);
+
+					encoder_ask(hash);
+				}
+
+				if (!encoder_learn()) {
 					decoder_error();
 					return;
 				}
+			}
+			break;
+		case XCODEC_PIPE_OP_FORGET:
+			if (encoder_ == NULL) {
+				ERROR(log_) << "Got <FORGET> before sending <HELLO>.";
+				decoder_error();
+				return;
+			} else {
+				uint64_t hash;
+				if (r.length() < sizeof op + sizeof hash)
+					goto incomplete;
 
-				DEBUG(log_) << "Responding to <ASK> with <LEARN>.";
+				r.skip(sizeof op);
 
-				Buffer learn;
-				learn.append(XCODEC_PIPE_OP_LEARN);
-				learn.append(oseg);
-				oseg->unref();
+				r.moveout(&hash);
+				hash = BigEndian::decode(hash);
 
-				encoder_produce(&learn);
+				encoder_->forget(hash);
 			}
 			break;
+		case XCODEC_PIPE_OP_ACK:
+			if (encoder_ == NULL) {
+				ERROR(log_) << "Got <ACK> before sending <HELLO>.";
+				decoder_error();
+				return;
+			} else {
+				uint64_t frames;
+				if (r.length() < sizeof op + sizeof frames)
+					goto incomplete;
+
+				r.skip(sizeof op);
+
+				r.moveout(&frames);
+				frames = BigEndian::decode(frames);
+
+				if (frames > encoder_frames_) {
+					ERROR(log_) << "Got <ACK> for frames not sent.";
+					decoder_error();
+					return;
+				}
+
+				encoder_unpin(frames);
+			}
+			break;
+		case XCODEC_PIPE_OP_PAUSE:
+			if (encoder_ == NULL) {
+				ERROR(log_) << "Got <PAUSE> before sending <HELLO>.";
+				decoder_error();
+				return;
+			}
+			r.skip(1);
+			DEBUG(log_) << "Peer asked us to pause.";
+			encoder_pipe_->input_pause();
+			break;
+		case XCODEC_PIPE_OP_RESUME:
+			if (encoder_ == NULL) {
+				ERROR(log_) << "Got <RESUME> before sending <HELLO>.";
+				decoder_error();
+				return;
+			}
+			r.skip(1);
+			DEBUG(log_) << "Peer asked us to resume.";
+			encoder_pipe_->input_resume();
+			break;
 		case XCODEC_PIPE_OP_LEARN:
 			if (decoder_cache_ == NULL) {
 				ERROR(log_) << "Got <LEARN> before <HELLO>.";
 				decoder_error();
 				return;
 			} else {
-				if (decoder_buffer_.length() < sizeof op + XCODEC_SEGMENT_LENGTH)
+				if (r.length() < sizeof op + XCODEC_SEGMENT_LENGTH)
+					goto incomplete;
+
+				r.skip(sizeof op);
+
+				BufferSegment *seg;
+				r.moveout(&seg, XCODEC_SEGMENT_LENGTH);
+
+				if (!decoder_learn(seg)) {
+					decoder_error();
 					return;
+				}
+			}
+			break;
+		case XCODEC_PIPE_OP_LEARN_CHUNK:
+			if (decoder_cache_ == NULL) {
+				ERROR(log_) << "Got <LEARN_CHUNK> before <HELLO>.";
+				decoder_error();
+				return;
+			} else {
+				uint16_t len;
+				if (r.length() < sizeof op + sizeof len)
+					goto incomplete;
+				r.extract(&len, sizeof op);
+				len = BigEndian::decode(len);
+				if (len == 0 || len > XCODEC_CHUNK_MAX) {
+					ERROR(log_) << "Invalid <LEARN_CHUNK> length: " << len;
+					decoder_error();
+					return;
+				}
+
+				if (r.length() < sizeof op + sizeof len + len)
+					goto incomplete;
 
-				decoder_buffer_.skip(sizeof op);
+				r.skip(sizeof op + sizeof len);
 
 				BufferSegment *seg;
-				decoder_buffer_.copyout(&seg, XCODEC_SEGMENT_LENGTH);
-				decoder_buffer_.skip(XCODEC_SEGMENT_LENGTH);
-
-				uint64_t hash = XCodecHash::hash(seg->data());
-				if (decoder_unknown_hashes_.find(hash) == decoder_unknown_hashes_.end()) {
-					INFO(log_) << "Gratuitous <LEARN> without <ASK>.";
-				} else {
-					decoder_unknown_hashes_.erase(hash);
+				r.moveout(&seg, len);
+
+				if (!decoder_learn(seg)) {
+					decoder_error();
+					return;
+				}
+			}
+			break;
+		case XCODEC_PIPE_OP_LEARN_N:
+			if (decoder_cache_ == NULL) {
+				ERROR(log_) << "Got <LEARN_N> before <HELLO>.";
+				decoder_error();
+				return;
+			} else {
+				uint16_t count;
+				if (r.length() < sizeof op + sizeof count)
+					goto incomplete;
+				r.extract(&count, sizeof op);
+				count = BigEndian::decode(count);
+				if (count == 0 || count > XCODEC_PIPE_BATCH_MAX) {
+					ERROR(log_) << "Invalid <LEARN_N> count: " << count;
+					decoder_error();
+					return;
 				}
 
-				BufferSegment *oseg = decoder_cache_->lookup(hash);
-				if (oseg != NULL) {
-					if (!oseg->equal(seg)) {
-						oseg->unref();
-						ERROR(log_) << "Collision in <LEARN>.";
-						seg->unref();
+				/*
+				 * Make sure all of it is here before learning
+				 * any of it.
+				 */
+				size_t off = sizeof op + sizeof count;
+				unsigned i;
+				for (i = 0; i < count; i++) {
+					uint16_t len;
+					if (r.length() < off + sizeof len)
+						goto incomplete;
+					r.extract(&len, off);
+					len = BigEndian::decode(len);
+					if (len == 0 || len > XCODEC_CHUNK_MAX) {
+						ERROR(log_) << "Invalid <LEARN_N> length: " << len;
+						decoder_error();
+						return;
+					}
+					off += sizeof len + len;
+				}
+				if (r.length() < off)
+					goto incomplete;
+
+				r.skip(sizeof op + sizeof count);
+
+				for (i = 0; i < count; i++) {
+					uint16_t len;
+					r.moveout(&len);
+					len = BigEndian::decode(len);
+
+					BufferSegment *seg;
+					r.moveout(&seg, len);
+
+					if (!decoder_learn(seg)) {
 						decoder_error();
 						return;
 					}
-					oseg->unref();
-					DEBUG(log_) << "Redundant <LEARN>.";
-				} else {
-					DEBUG(log_) << "Successful <LEARN>.";
-					decoder_cache_->enter(hash, seg);
 				}
-				seg->unref();
 			}
 			break;
 		case XCODEC_PIPE_OP_EOS:
@@ -297,7 +634,7 @@ XCodecPipePair::decoder_consume(Buffer *buf)
 				decoder_error();
 				return;
 			}
-			decoder_buffer_.skip(1);
+			r.skip(1);
 			decoder_received_eos_ = true;
 			break;
 		case XCODEC_PIPE_OP_EOS_ACK:
@@ -311,7 +648,7 @@ XCodecPipePair::decoder_consume(Buffer *buf)
 				decoder_error();
 				return;
 			}
-			decoder_buffer_.skip(1);
+			r.skip(1);
 			decoder_received_eos_ack_ = true;
 			break;
 		case XCODEC_PIPE_OP_FRAME:
@@ -321,9 +658,9 @@ XCodecPipePair::decoder_consume(Buffer *buf)
 				return;
 			} else {
 				uint16_t len;
-				if (decoder_buffer_.length() < sizeof op + sizeof len)
-					return;
-				decoder_buffer_.extract(&len, sizeof op);
+				if (r.length() < sizeof op + sizeof len)
+					goto incomplete;
+				r.extract(&len, sizeof op);
 				len = BigEndian::decode(len);
 				if (len == 0 || len > XCODEC_PIPE_MAX_FRAME) {
 					ERROR(log_) << "Invalid framed data length.";
@@ -331,10 +668,12 @@ XCodecPipePair::decoder_consume(Buffer *buf)
 					return;
 				}
 
-				if (decoder_buffer_.length() < sizeof op + sizeof len + len)
-					return;
+				if (r.length() < sizeof op + sizeof len + len)
+					goto incomplete;
 
-				decoder_buffer_.moveout(&decoder_frame_buffer_, sizeof op + sizeof len, len);
+				r.skip(sizeof op + sizeof len);
+				r.moveout(&decoder_frame_buffer_, len);
+				decoder_frames_++;
 			}
 			break;
 		default:
@@ -343,29 +682,42 @@ XCodecPipePair::decoder_consume(Buffer *buf)
 			return;
 		}
 
-		if (decoder_frame_buffer_.empty()) {
-			if (decoder_received_eos_ && !encoder_sent_eos_ack_) {
-				DEBUG(log_) << "Decoder finished, got <EOS>, sending <EOS_ACK>.";
+		if (!decoder_decode())
+			return;
+	}
+	decoder_buffer_.clear();
 
-				Buffer eos_ack;
-				eos_ack.append(XCODEC_PIPE_OP_EOS_ACK);
+	decoder_finish();
+	decoder_ack();
+	decoder_flow();
+	return;
 
-				encoder_produce(&eos_ack);
-				encoder_sent_eos_ack_ = true;
-			}
-			continue;
-		}
+incomplete:
+	if (r.position() != 0)
+		decoder_buffer_.skip(r.position());
+	decoder_ack();
+	decoder_flow();
+}
 
-		if (!decoder_unknown_hashes_.empty()) {
-			DEBUG(log_) << "Waiting for unknown hashes to continue processing data.";
-			continue;
-		}
+/*
+ * Decode what we can of the frame data we have, and send the <EOS_ACK> once
+ * all of it has been decoded after <EOS>.  Returns false after an error.
+ *
+ * The decoder keeps going past data it must ask for, so the <ASK>s for a
+ * stretch of frames go out together, and it is called again as data arrives
+ * to output what it has held back.
+ */
+bool
+XCodecPipePair::decoder_decode(void)
+{
+	if (!decoder_frame_buffer_.empty() || (decoder_ != NULL && decoder_->pending())) {
+		size_t unknown = decoder_unknown_hashes_.size();
 
 		Buffer output;
 		if (!decoder_->decode(&output, &decoder_frame_buffer_, decoder_unknown_hashes_)) {
 			ERROR(log_) << "Decoder exiting with error.";
 			decoder_error();
-			return;
+			return (false);
 		}
 
 		if (!output.empty()) {
@@ -374,46 +726,100 @@ XCodecPipePair::decoder_consume(Buffer *buf)
 		} else {
 			/*
 			 * We should only get no output from the decoder if
-			 * we're waiting on the next frame or we need an
-			 * unknown hash.  It would be nice to make the
+			 * we're waiting on the next frame or on data it is
+			 * holding output back for.  It would be nice to make the
 			 * encoder framing aware so that it would not end
 			 * up with encoded data that straddles a frame
 			 * boundary.  (Fixing that would also allow us to
 			 * simplify length checking within the decoder
 			 * considerably.)
 			 */
-			ASSERT(log_, !decoder_frame_buffer_.empty() || !decoder_unknown_hashes_.empty());
+			ASSERT(log_, !decoder_frame_buffer_.empty() || decoder_->pending());
 		}
 
-		Buffer ask;
+		/*
+		 * The decoder only adds hashes, so there are new ones to see to
+		 * only if there are more.  Only <ASK> for what our cache cannot
+		 * read back from disk itself.
+		 */
+		std::vector<uint64_t> ask;
 		std::set<uint64_t>::const_iterator it;
-		for (it = decoder_unknown_hashes_.begin(); it != decoder_unknown_hashes_.end(); ++it) {
+		for (it = decoder_unknown_hashes_.begin(); unknown != decoder_unknown_hashes_.size() && it != decoder_unknown_hashes_.end(); ++it) {
 			uint64_t hash = *it;
-			hash = BigEndian::encode(hash);
 
-			ask.append(XCODEC_PIPE_OP_ASK);
-			ask.append(&hash);
+			if (decoder_asked_hashes_.find(hash) != decoder_asked_hashes_.end() ||
+			    decoder_fetching_hashes_.find(hash) != decoder_fetching_hashes_.end())
+				continue;
+			unknown++;
+
+			if (decoder_cache_->fetch(hash)) {
+				decoder_fetching_hashes_.insert(hash);
+				continue;
+			}
+
+			ask.push_back(hash);
+			decoder_asked_hashes_.insert(hash);
 		}
 		if (!ask.empty()) {
-			DEBUG(log_) << "Sending <ASK>s.";
-			encoder_produce(&ask);
+			DEBUG(log_) << "Sending <ASK>s for " << ask.size() << " hashes.";
+			decoder_ask(ask);
+		}
+
+		if (!decoder_fetching_hashes_.empty() && decoder_fetch_action_ == NULL)
+			decoder_fetch_action_ = decoder_cache_->fetched(callback(this, &XCodecPipePair::decoder_fetch_complete));
+
+		/*
+		 * Tell the peer about data we have evicted, so that it does not
+		 * reference it and wait on an <ASK>.  The cache is shared by
+		 * all of the peer's connections, each of which has an encoder
+		 * to tell, so each keeps its own place in the evictions.
+		 */
+		Buffer forget;
+		uint64_t hash;
+		while (decoder_forget_ && decoder_cache_->evicted(&decoder_evicted_, &hash)) {
+			BufferWriter w(&forget, 1 + sizeof hash);
+			w.append(XCODEC_PIPE_OP_FORGET);
+			BigEndian::append(&w, hash);
+		}
+		if (!forget.empty()) {
+			DEBUG(log_) << "Sending <FORGET>s.";
+			encoder_control(&forget);
 		}
 	}
 
+	if (decoder_frame_buffer_.empty() && (decoder_ == NULL || !decoder_->pending()) &&
+	    decoder_received_eos_ && !encoder_sent_eos_ack_) {
+		DEBUG(log_) << "Decoder finished, got <EOS>, sending <EOS_ACK>.";
+
+		Buffer eos_ack;
+		eos_ack.append(XCODEC_PIPE_OP_EOS_ACK);
+
+		encoder_control(&eos_ack);
+		encoder_sent_eos_ack_ = true;
+	}
+	return (true);
+}
+
+/*
+ * Once all input has been parsed, send EOS on if we can.
+ */
+void
+XCodecPipePair::decoder_finish(void)
+{
 	/*
 	 * If we have received EOS and not yet sent it, we can send it now.
-	 * The only caveat is that if we have outstanding <ASK>s, i.e. we have
-	 * not yet emptied decoder_unknown_hashes_, then we can't send EOS yet.
+	 * The only caveat is that if the decoder is waiting on outstanding
+	 * <ASK>s, with frame data left or output held back, then we can't send
+	 * EOS yet.
 	 */
 	if (decoder_received_eos_ && !decoder_sent_eos_) {
 		ASSERT(log_, !decoder_sent_eos_);
-		if (decoder_unknown_hashes_.empty()) {
-			ASSERT(log_, decoder_frame_buffer_.empty());
+		if (decoder_frame_buffer_.empty() && (decoder_ == NULL || !decoder_->pending())) {
 			DEBUG(log_) << "Decoder finished, got <EOS>, shutting down decoder output channel.";
 			decoder_produce_eos();
 			decoder_sent_eos_ = true;
 		} else {
-			ASSERT(log_, !decoder_frame_buffer_.empty());
+			ASSERT(log_, !decoder_unknown_hashes_.empty());
 			DEBUG(log_) << "Decoder finished, waiting to send <EOS> until <ASK>s are answered.";
 		}
 	}
@@ -439,6 +845,185 @@ XCodecPipePair::decoder_consume(Buffer *buf)
 	}
 }
 
+/*
+ * Check on the data our cache is reading back once it has read some, and carry
+ * on decoding once all of it is there.  Anything which is no longer being read
+ * but which the cache still does not have is asked for.
+ */
+void
+XCodecPipePair::decoder_fetch_complete(void)
+{
+	decoder_fetch_action_->cancel();
+	decoder_fetch_action_ = NULL;
+
+	std::vector<uint64_t> ask;
+	std::set<uint64_t>::iterator it = decoder_fetching_hashes_.begin();
+	while (it != decoder_fetching_hashes_.end()) {
+		uint64_t hash = *it;
+
+		if (decoder_unknown_hashes_.find(hash) != decoder_unknown_hashes_.end()) {
+			if (decoder_cache_->fetching(hash)) {
+				++it;
+				continue;
+			}
+
+			BufferSegment *seg = decoder_cache_->lookup(hash);
+			if (seg != NULL) {
+				seg->unref();
+				decoder_unknown_hashes_.erase(hash);
+			} else {
+				ask.push_back(hash);
+				decoder_asked_hashes_.insert(hash);
+			}
+		}
+		decoder_fetching_hashes_.erase(it++);
+	}
+	if (!ask.empty()) {
+		DEBUG(log_) << "Sending <ASK>s for data not read from cache.";
+		decoder_ask(ask);
+	}
+
+	if (!decoder_fetching_hashes_.empty())
+		decoder_fetch_action_ = decoder_cache_->fetched(callback(this, &XCodecPipePair::decoder_fetch_complete));
+
+	if (!decoder_decode())
+		return;
+	if (decoder_buffer_.empty())
+		decoder_finish();
+	decoder_ack();
+	decoder_flow();
+}
+
+/*
+ * Ask the peer for data, with as few <ASK_N>s as possible if it can take them.
+ */
+void
+XCodecPipePair::decoder_ask(const std::vector<uint64_t>& hashes)
+{
+	Buffer ask;
+
+	std::vector<uint64_t>::const_iterator it = hashes.begin();
+	while (it != hashes.end()) {
+		if (!decoder_batch_) {
+			uint64_t hash = *it++;
+
+			BufferWriter w(&ask, 1 + sizeof hash);
+			w.append(XCODEC_PIPE_OP_ASK);
+			BigEndian::append(&w, hash);
+			continue;
+		}
+
+		uint16_t count = XCODEC_PIPE_BATCH_MAX;
+		if ((size_t)(hashes.end() - it) < count)
+			count = hashes.end() - it;
+
+		BufferWriter w(&ask, 1 + sizeof count + count * sizeof (uint64_t));
+		w.append(XCODEC_PIPE_OP_ASK_N);
+		BigEndian::append(&w, count);
+		while (count-- != 0)
+			BigEndian::append(&w, *it++);
+	}
+
+	encoder_control(&ask);
+}
+
+/*
+ * Tell a peer which pins the data it references how many frames we have
+ * decoded, once we are not waiting on any data for them.  This is done once
+ * for as much input as we have had, rather than for each frame.
+ */
+void
+XCodecPipePair::decoder_ack(void)
+{
+	if (!decoder_ack_ || encoder_produced_eos_)
+		return;
+	if (decoder_frames_ == decoder_acked_)
+		return;
+	if (!decoder_frame_buffer_.empty() || decoder_->pending())
+		return;
+
+	Buffer ack;
+	BufferWriter w(&ack, 1 + sizeof decoder_frames_);
+	w.append(XCODEC_PIPE_OP_ACK);
+	BigEndian::append(&w, decoder_frames_);
+	w.commit();
+
+	encoder_control(&ack);
+	decoder_acked_ = decoder_frames_;
+}
+
+/*
+ * Keep track of how much encoded data is queued up, and while we are waiting
+ * on data, tell a peer which can pause to do so once that is more than the
+ * codec allows, and to resume once it is down to half of that or we are no
+ * longer waiting.
+ */
+void
+XCodecPipePair::decoder_flow(void)
+{
+	size_t queued = decoder_buffer_.length() + decoder_frame_buffer_.length();
+	if (decoder_ != NULL)
+		queued += decoder_->held();
+
+	if (decoder_queued_max_ != NULL && (intmax_t)queued > *decoder_queued_max_)
+		*decoder_queued_max_ = queued;
+
+	if (!decoder_pause_ || codec_->pause() == 0 || encoder_produced_eos_)
+		return;
+
+	Buffer op;
+	if (!decoder_paused_) {
+		if (decoder_unknown_hashes_.empty() || queued <= codec_->pause())
+			return;
+
+		DEBUG(log_) << "Sending <PAUSE> with " << queued << " bytes queued.";
+		op.append(XCODEC_PIPE_OP_PAUSE);
+		decoder_paused_ = true;
+	} else {
+		if (!decoder_unknown_hashes_.empty() && queued > codec_->pause() / 2)
+			return;
+
+		DEBUG(log_) << "Sending <RESUME> with " << queued << " bytes queued.";
+		op.append(XCODEC_PIPE_OP_RESUME);
+		decoder_paused_ = false;
+	}
+	encoder_control(&op);
+}
+
+/*
+ * Enter learned data into the decoder's cache, consuming the caller's
+ * reference.
+ */
+bool
+XCodecPipePair::decoder_learn(BufferSegment *seg)
+{
+	uint64_t hash = decoder_cache_->hash(seg->data(), seg->length());
+	if (decoder_unknown_hashes_.find(hash) == decoder_unknown_hashes_.end()) {
+		INFO(log_) << "Gratuitous <LEARN> without <ASK>.";
+	} else {
+		decoder_unknown_hashes_.erase(hash);
+		decoder_asked_hashes_.erase(hash);
+	}
+
+	BufferSegment *oseg = decoder_cache_->lookup(hash);
+	if (oseg != NULL) {
+		if (!oseg->equal(seg)) {
+			oseg->unref();
+			ERROR(log_) << "Collision in <LEARN>.";
+			seg->unref();
+			return (false);
+		}
+		oseg->unref();
+		DEBUG(log_) << "Redundant <LEARN>.";
+	} else {
+		DEBUG(log_) << "Successful <LEARN>.";
+		decoder_cache_->enter(hash, seg);
+	}
+	seg->unref();
+
+	return (true);
+}
+
 void
 XCodecPipePair::encoder_consume(Buffer *buf)
 {
@@ -454,36 +1039,230 @@ XCodecPipePair::encoder_consume(Buffer *buf)
 			return;
 		}
 
+		ASSERT(log_, extra.length() == UUID_SIZE);
+
+		/*
+		 * Peers which don't know of any flags only accept a bare UUID,
+		 * and so can not talk to us at all.  What we can do is the
+		 * same whatever is configured, so we always say so.
+		 */
+		uint8_t flags = XCODEC_PIPE_HELLO_FORGET | XCODEC_PIPE_HELLO_PAUSE |
+		    XCODEC_PIPE_HELLO_BATCH | XCODEC_PIPE_HELLO_ACK;
+		if (codec_->chunking())
+			flags |= XCODEC_PIPE_HELLO_CHUNKING;
+		extra.append(flags);
+
 		uint8_t len = extra.length();
-		ASSERT(log_, len == UUID_SIZE);
 
 		output.append(XCODEC_PIPE_OP_HELLO);
 		output.append(len);
 		output.append(extra);
 
-		ASSERT(log_, output.length() == 2 + UUID_SIZE);
-
 		encoder_ = new XCodecEncoder(codec_->cache());
+
+		/*
+		 * Data we reference may only be evicted once the peer has
+		 * decoded it, if we have a budget at all and unless the peer
+		 * has said it will not tell us when that is.
+		 */
+		if (codec_->cache()->budget() != 0 && (decoder_cache_ == NULL || decoder_ack_))
+			encoder_->set_pinning(true);
+	}
+
+	/*
+	 * Once the peer's <HELLO> says it can decode chunks, start chunking.
+	 */
+	if (encoder_chunking_ && !encoder_->chunking()) {
+		Buffer encoded;
+		encoder_->set_chunking(&encoded);
+		if (!encoded.empty())
+			encoder_frame(&output, &encoded);
 	}
 
 	if (!buf->empty()) {
 		Buffer encoded;
 		encoder_->encode(&encoded, buf);
-		ASSERT(log_, !encoded.empty());
+		if (!encoded.empty())
+			encoder_frame(&output, &encoded);
 
-		encode_frame(&output, &encoded);
+		/*
+		 * Input held by the encoder is flushed when the timer fires,
+		 * so that it is not delayed indefinitely waiting for more.
+		 */
+		if (encoder_->pending() && encoder_flush_action_ == NULL)
+			encoder_flush_action_ = EventSystem::instance()->timeout(XCODEC_PIPE_FLUSH_MS, callback(this, &XCodecPipePair::encoder_flush));
 	} else {
+		if (encoder_flush_action_ != NULL) {
+			encoder_flush_action_->cancel();
+			encoder_flush_action_ = NULL;
+		}
+
+		Buffer encoded;
+		encoder_->flush(&encoded);
+		if (!encoded.empty())
+			encoder_frame(&output, &encoded);
+
 		ASSERT(log_, !encoder_sent_eos_);
 		output.append(XCODEC_PIPE_OP_EOS);
 		encoder_sent_eos_ = true;
 	}
-	ASSERT(log_, !output.empty());
+	if (!output.empty())
+		encoder_produce(&output);
+}
+
+/*
+ * Queue an <ASK>ed hash to be answered, and have the cache start reading its
+ * data back if that is where the data is.
+ */
+void
+XCodecPipePair::encoder_ask(uint64_t hash)
+{
+	codec_->cache()->fetch(hash);
+	encoder_asked_hashes_.push_back(hash);
+}
+
+/*
+ * Answer the <ASK>s whose data is at hand, in the order they were asked, with
+ * <OP_LEARN>s and <OP_LEARN_CHUNK>s, or <OP_LEARN_N>s if the peer can take
+ * them.  The responses refer to the cached data rather than copying it, so
+ * they go out as a single gathered write.  Anything still being read back is
+ * checked on again once the cache has read more, rather than waited for.
+ */
+bool
+XCodecPipePair::encoder_learn(void)
+{
+	XCodecCache *cache = codec_->cache();
+	Buffer learn, batch;
+	uint16_t count = 0;
+
+	if (encoder_produced_eos_) {
+		encoder_asked_hashes_.clear();
+		return (true);
+	}
+
+	while (!encoder_asked_hashes_.empty()) {
+		uint64_t hash = encoder_asked_hashes_.front();
+		if (cache->fetching(hash))
+			break;
+
+		BufferSegment *oseg = cache->lookup(hash);
+		if (oseg == NULL) {
+			ERROR(log_) << "Unknown hash in <ASK>: " << hash;
+			return (false);
+		}
+		encoder_asked_hashes_.pop_front();
+
+		uint16_t len = oseg->length();
+		if (decoder_batch_) {
+			BufferWriter w(&batch, sizeof len);
+			BigEndian::append(&w, len);
+			w.commit();
+			batch.append(oseg);
+		} else if (len == XCODEC_SEGMENT_LENGTH) {
+			learn.append(XCODEC_PIPE_OP_LEARN);
+			learn.append(oseg);
+		} else {
+			BufferWriter w(&learn, 1 + sizeof len);
+			w.append(XCODEC_PIPE_OP_LEARN_CHUNK);
+			BigEndian::append(&w, len);
+			w.commit();
+			learn.append(oseg);
+		}
+		oseg->unref();
+
+		if (!decoder_batch_)
+			continue;
+		if (++count != XCODEC_PIPE_BATCH_MAX && !encoder_asked_hashes_.empty())
+			continue;
+
+		BufferWriter w(&learn, 1 + sizeof count);
+		w.append(XCODEC_PIPE_OP_LEARN_N);
+		BigEndian::append(&w, count);
+		w.commit();
+		learn.append(batch);
+		batch.clear();
+		count = 0;
+	}
+	if (count != 0) {
+		BufferWriter w(&learn, 1 + sizeof count);
+		w.append(XCODEC_PIPE_OP_LEARN_N);
+		BigEndian::append(&w, count);
+		w.commit();
+		learn.append(batch);
+	}
+
+	if (!learn.empty()) {
+		DEBUG(log_) << "Responding to <ASK>s with <LEARN>s.";
+		encoder_control(&learn);
+	}
+
+	if (!encoder_asked_hashes_.empty() && encoder_learn_action_ == NULL)
+		encoder_learn_action_ = cache->fetched(callback(this, &XCodecPipePair::encoder_learn_complete));
+	return (true);
+}
+
+void
+XCodecPipePair::encoder_learn_complete(void)
+{
+	encoder_learn_action_->cancel();
+	encoder_learn_action_ = NULL;
+
+	if (!encoder_learn())
+		decoder_error();
+}
+
+void
+XCodecPipePair::encoder_flush(void)
+{
+	encoder_flush_action_->cancel();
+	encoder_flush_action_ = NULL;
+
+	ASSERT(log_, !encoder_sent_eos_);
+
+	Buffer encoded;
+	encoder_->flush(&encoded);
+	if (encoded.empty())
+		return;
+
+	Buffer output;
+	encoder_frame(&output, &encoded);
 	encoder_produce(&output);
 }
 
-static void
+/*
+ * Frame encoded data, and pin the data it references until the peer has
+ * decoded the frames it ends up in.
+ */
+void
+XCodecPipePair::encoder_frame(Buffer *output, Buffer *encoded)
+{
+	encoder_frames_ += encode_frame(output, encoded);
+
+	std::vector<BufferSegment *> pinned;
+	encoder_->pinned(&pinned);
+
+	std::vector<BufferSegment *>::const_iterator it;
+	for (it = pinned.begin(); it != pinned.end(); ++it)
+		encoder_pins_.push_back(std::make_pair(encoder_frames_, *it));
+}
+
+/*
+ * Release the data pinned by the first frames frames.
+ */
+void
+XCodecPipePair::encoder_unpin(uint64_t frames)
+{
+	while (!encoder_pins_.empty() && encoder_pins_.front().first <= frames) {
+		encoder_pins_.front().second->unref();
+		encoder_pins_.pop_front();
+	}
+}
+
+static unsigned
 encode_frame(Buffer *out, Buffer *in)
 {
+	unsigned frames = 0;
+
 	ASSERT("/xcodec/pipe/encode_frame", !in->empty());
 	while (!in->empty()) {
 		uint16_t framelen;
@@ -495,10 +1274,13 @@ encode_frame(Buffer *out, Buffer *in)
 		Buffer frame;
 		in->moveout(&frame, framelen);
 
-		framelen = BigEndian::encode(framelen);
+		BufferWriter w(out, 1 + sizeof framelen);
+		w.append(XCODEC_PIPE_OP_FRAME);
+		BigEndian::append(&w, framelen);
+		w.commit();
 
-		out->append(XCODEC_PIPE_OP_FRAME);
-		out->append(&framelen);
 		out->append(frame);
+		frames++;
 	}
+	return (frames);
 }
@@ -26,6 +26,9 @@
 #ifndef	XCODEC_XCODEC_PIPE_PAIR_H
 #define	XCODEC_XCODEC_PIPE_PAIR_H
 
+#include <deque>
+#include <vector>
+
 #include <io/pipe/pipe_producer.h>
 #include <io/pipe/pipe_producer_wrapper.h>
 
@@ -49,36 +52,72 @@ class XCodecPipePair : public PipePair {
 	XCodecDecoder *decoder_;
 	XCodecCache *decoder_cache_;
 	std::set<uint64_t> decoder_unknown_hashes_;
+	std::set<uint64_t> decoder_asked_hashes_;
+	std::set<uint64_t> decoder_fetching_hashes_;
+	Action *decoder_fetch_action_;
 	bool decoder_received_eos_;
 	bool decoder_received_eos_ack_;
 	bool decoder_sent_eos_;
+	bool decoder_forget_;
+	bool decoder_pause_;
+	bool decoder_paused_;
+	bool decoder_batch_;
+	bool decoder_ack_;
+	uint64_t decoder_frames_;
+	uint64_t decoder_acked_;
+	uint64_t decoder_evicted_;
+	intmax_t *decoder_queued_max_;
 	Buffer decoder_buffer_;
 	Buffer decoder_frame_buffer_;
 	PipeProducerWrapper<XCodecPipePair> *decoder_pipe_;
 
 	XCodecEncoder *encoder_;
+	std::deque<uint64_t> encoder_asked_hashes_;
+	Action *encoder_learn_action_;
+	uint64_t encoder_frames_;
+	std::deque<std::pair<uint64_t, BufferSegment *> > encoder_pins_;
+	bool encoder_chunking_;
 	bool encoder_produced_eos_;
 	bool encoder_sent_eos_;
 	bool encoder_sent_eos_ack_;
+	Action *encoder_flush_action_;
 	PipeProducerWrapper<XCodecPipePair> *encoder_pipe_;
 public:
-	XCodecPipePair(const LogHandle& log, XCodec *codec, XCodecPipePairType type)
+	XCodecPipePair(const LogHandle& log, XCodec *codec, XCodecPipePairType type, intmax_t *queued_max = NULL)
 	: log_(log + "/xcodec"),
 	  codec_(codec),
 	  type_(type),
 	  decoder_(NULL),
 	  decoder_cache_(NULL),
 	  decoder_unknown_hashes_(),
+	  decoder_asked_hashes_(),
+	  decoder_fetching_hashes_(),
+	  decoder_fetch_action_(NULL),
 	  decoder_received_eos_(false),
 	  decoder_received_eos_ack_(false),
 	  decoder_sent_eos_(false),
+	  decoder_forget_(false),
+	  decoder_pause_(false),
+	  decoder_paused_(false),
+	  decoder_batch_(false),
+	  decoder_ack_(false),
+	  decoder_frames_(0),
+	  decoder_acked_(0),
+	  decoder_evicted_(0),
+	  decoder_queued_max_(queued_max),
 	  decoder_buffer_(),
 	  decoder_frame_buffer_(),
 	  decoder_pipe_(NULL),
 	  encoder_(NULL),
+	  encoder_asked_hashes_(),
+	  encoder_learn_action_(NULL),
+	  encoder_frames_(0),
+	  encoder_pins_(),
+	  encoder_chunking_(false),
 	  encoder_produced_eos_(false),
 	  encoder_sent_eos_(false),
 	  encoder_sent_eos_ack_(false),
+	  encoder_flush_action_(NULL),
 	  encoder_pipe_(NULL)
 	{
 		decoder_pipe_ = new PipeProducerWrapper<XCodecPipePair>(log_ + "/decoder", this, &XCodecPipePair::decoder_consume);
@@ -87,6 +126,11 @@ public:
 
 	~XCodecPipePair()
 	{
+		if (decoder_fetch_action_ != NULL) {
+			decoder_fetch_action_->cancel();
+			decoder_fetch_action_ = NULL;
+		}
+
 		if (decoder_ != NULL) {
 			delete decoder_;
 			decoder_ = NULL;
@@ -97,6 +141,18 @@ public:
 			decoder_pipe_ = NULL;
 		}
 
+		if (encoder_learn_action_ != NULL) {
+			encoder_learn_action_->cancel();
+			encoder_learn_action_ = NULL;
+		}
+
+		if (encoder_flush_action_ != NULL) {
+			encoder_flush_action_->cancel();
+			encoder_flush_action_ = NULL;
+		}
+
+		encoder_unpin(encoder_frames_);
+
 		if (encoder_ != NULL) {
 			delete encoder_;
 			encoder_ = NULL;
@@ -110,6 +166,13 @@ public:
 
 private:
 	void decoder_consume(Buffer *);
+	bool decoder_decode(void);
+	void decoder_finish(void);
+	void decoder_fetch_complete(void);
+	void decoder_ask(const std::vector<uint64_t>&);
+	void decoder_ack(void);
+	void decoder_flow(void);
+	bool decoder_learn(BufferSegment *);
 
 	void decoder_error(void)
 	{
@@ -129,6 +192,12 @@ private:
 	}
 
 	void encoder_consume(Buffer *);
+	void encoder_ask(uint64_t);
+	bool encoder_learn(void);
+	void encoder_learn_complete(void);
+	void encoder_flush(void);
+	void encoder_frame(Buffer *, Buffer *);
+	void encoder_unpin(uint64_t);
 
 	void encoder_error(void)
 	{
@@ -142,6 +211,16 @@ private:
 		encoder_pipe_->produce(buf);
 	}
 
+	/*
+	 * Control ops are taken ahead of any frame data which has not been
+	 * taken yet, so that a peer waiting on one does not wait on that too.
+	 */
+	void encoder_control(Buffer *buf)
+	{
+		ASSERT(log_, !buf->empty());
+		encoder_pipe_->produce_priority(buf);
+	}
+
 	void encoder_produce_eos(Buffer *buf = NULL)
 	{
 		encoder_pipe_->produce_eos(buf);
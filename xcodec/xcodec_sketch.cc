@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+
+#include <common/buffer.h>
+
+#include <xcodec/xcodec_sketch.h>
+
+#define	XCODEC_SKETCH_MIN_WIDTH	(1024)
+
+XCodecSketch::XCodecSketch(void)
+: counters_(NULL),
+  shift_(64),
+  width_(0),
+  increments_(0),
+  samples_(0)
+{
+	reset(XCODEC_SKETCH_MIN_WIDTH);
+}
+
+XCodecSketch::~XCodecSketch()
+{
+	free(counters_);
+	counters_ = NULL;
+}
+
+void
+XCodecSketch::increment(uint64_t hash)
+{
+	unsigned row;
+
+	for (row = 0; row < XCODEC_SKETCH_ROWS; row++) {
+		uint8_t *cp = &counters_[counter(hash, row)];
+		if (*cp < XCODEC_SKETCH_MAX)
+			(*cp)++;
+	}
+
+	if (++increments_ == samples_)
+		age();
+}
+
+unsigned
+XCodecSketch::estimate(uint64_t hash) const
+{
+	unsigned row, min = XCODEC_SKETCH_MAX;
+
+	for (row = 0; row < XCODEC_SKETCH_ROWS; row++) {
+		unsigned c = counters_[counter(hash, row)];
+		if (c < min)
+			min = c;
+	}
+	return (min);
+}
+
+void
+XCodecSketch::reset(size_t n)
+{
+	size_t width = 2;
+	unsigned bits = 1;
+
+	while (width < n || width < XCODEC_SKETCH_MIN_WIDTH) {
+		width *= 2;
+		bits++;
+	}
+
+	free(counters_);
+	counters_ = (uint8_t *)calloc(XCODEC_SKETCH_ROWS * width, sizeof *counters_);
+	if (counters_ == NULL)
+		HALT("/xcodec/sketch") << "Could not allocate " << width << " counters.";
+
+	shift_ = 64 - bits;
+	width_ = width;
+	increments_ = 0;
+	samples_ = XCODEC_SKETCH_SAMPLES * width;
+}
+
+void
+XCodecSketch::age(void)
+{
+	size_t i;
+
+	for (i = 0; i < XCODEC_SKETCH_ROWS * width_; i++)
+		counters_[i] /= 2;
+	increments_ /= 2;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2026 Juli Mallett. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY AUTHOR AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL AUTHOR OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef	XCODEC_XCODEC_SKETCH_H
+#define	XCODEC_XCODEC_SKETCH_H
+
+/*
+ * A count-min sketch of how often hashes have been seen recently, for
+ * deciding whether new data is worth evicting old data for, as in TinyLFU.
+ * Counters saturate at 15 and are all halved once there have been ten
+ * increments for every entry the sketch is sized for, so that old popularity
+ * fades.
+ */
+#define	XCODEC_SKETCH_ROWS	(4)
+#define	XCODEC_SKETCH_MAX	(15)
+#define	XCODEC_SKETCH_SAMPLES	(10)
+
+class XCodecSketch {
+	uint8_t *counters_;
+	unsigned shift_;
+	size_t width_;
+	size_t increments_;
+	size_t samples_;
+public:
+	XCodecSketch(void);
+	~XCodecSketch();
+
+	void increment(uint64_t);
+	unsigned estimate(uint64_t) const;
+
+	/*
+	 * Zero the sketch and size it for n entries, or for a minimum so that
+	 * small sketches do not count everything together.
+	 */
+	void reset(size_t);
+
+private:
+	size_t counter(uint64_t hash, unsigned row) const
+	{
+		static const uint64_t multipliers[XCODEC_SKETCH_ROWS] = {
+			0x9e3779b97f4a7c15ull,
+			0xc2b2ae3d27d4eb4full,
+			0x165667b19e3779f9ull,
+			0xd6e8feb86659fd93ull,
+		};
+
+		return (row * width_ + ((hash * multipliers[row]) >> shift_));
+	}
+
+	void age(void);
+};
+
+#endif /* !XCODEC_XCODEC_SKETCH_H */
@@ -36,6 +36,9 @@
  * Make more like an LRU and make present() bump up in the window.
  *
  * Maybe add an explicit use() mechanism?
+ *
+ * A decoder may declare a hash before it has the data, with a NULL segment,
+ * and fill it in with learn() once the data arrives.
  */
 class XCodecWindow {
 	uint64_t window_[XCODEC_WINDOW_COUNT];
@@ -60,8 +63,10 @@ public:
 	{
 		std::map<uint64_t, BufferSegment *>::iterator it;
 
-		for (it = segments_.begin(); it != segments_.end(); ++it)
-			it->second->unref();
+		for (it = segments_.begin(); it != segments_.end(); ++it) {
+			if (it->second != NULL)
+				it->second->unref();
+		}
 		segments_.clear();
 	}
 
@@ -82,17 +87,32 @@ public:
 			it = segments_.find(old);
 			ASSERT("/xcodec/window", it != segments_.end());
 			BufferSegment *oseg = it->second;
-			oseg->unref();
+			if (oseg != NULL)
+				oseg->unref();
 			segments_.erase(it);
 		}
 
 		window_[cursor_] = hash;
 		present_[hash] = cursor_;
-		seg->ref();
+		if (seg != NULL)
+			seg->ref();
 		segments_[hash] = seg;
 		cursor_ = (cursor_ + 1) % XCODEC_WINDOW_COUNT;
 	}
 
+	/*
+	 * Give data to a hash declared without it, if it is still here.
+	 */
+	void learn(uint64_t hash, BufferSegment *seg)
+	{
+		std::map<uint64_t, BufferSegment *>::iterator it;
+		it = segments_.find(hash);
+		if (it == segments_.end() || it->second != NULL)
+			return;
+		seg->ref();
+		it->second = seg;
+	}
+
 	BufferSegment *dereference(unsigned c) const
 	{
 		if (window_[c] == 0)
@@ -101,10 +121,21 @@ public:
 		it = segments_.find(window_[c]);
 		ASSERT("/xcodec/window", it != segments_.end());
 		BufferSegment *seg = it->second;
+		if (seg == NULL)
+			return (NULL);
 		seg->ref();
 		return (seg);
 	}
 
+	/*
+	 * The hash declared at c, or 0 if none, which is how to tell a hash
+	 * declared without its data from nothing at all.
+	 */
+	uint64_t hash(unsigned c) const
+	{
+		return (window_[c]);
+	}
+
 	bool present(uint64_t hash, uint8_t *c) const
 	{
 		std::map<uint64_t, unsigned>::const_iterator it = present_.find(hash);